@@ -0,0 +1,65 @@
+// Helpers that the example and benchmark programs have in common.
+#include "ndiApplicationHelpers.h"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+//----------------------------------------------------------------------------
+bool IsNetworkName(const char* name)
+{
+  return (strrchr(name, ':') != nullptr && strncmp(name, "COM", 3) != 0 &&
+          strncmp(name, "capture:", 8) != 0);
+}
+
+//----------------------------------------------------------------------------
+ndicapi* OpenDevice(const char* name)
+{
+  if (IsNetworkName(name))
+  {
+    const char* colon = strrchr(name, ':');
+    std::string hostname(name, colon - name);
+    return ndiOpenNetwork(hostname.c_str(), atoi(colon + 1));
+  }
+  return ndiOpenSerial(name);
+}
+
+//----------------------------------------------------------------------------
+void CloseDevice(ndicapi* device)
+{
+  if (ndiGetDeviceHandle(device) != NDI_INVALID_HANDLE)
+  {
+    ndiCloseSerial(device);
+  }
+  else
+  {
+    ndiCloseNetwork(device);
+  }
+}
+
+//----------------------------------------------------------------------------
+bool EnableTools(ndicapi* device)
+{
+  ndiCommand(device, "PHSR:%02X", NDI_UNINITIALIZED_HANDLES);
+  int n = ndiGetPHSRNumberOfHandles(device);
+  for (int i = 0; i < n; i++)
+  {
+    ndiCommand(device, "PINIT:%02X", ndiGetPHSRHandle(device, i));
+    if (ndiGetError(device) != NDI_OKAY)
+    {
+      return false;
+    }
+  }
+
+  ndiCommand(device, "PHSR:%02X", NDI_UNENABLED_HANDLES);
+  n = ndiGetPHSRNumberOfHandles(device);
+  for (int i = 0; i < n; i++)
+  {
+    ndiCommand(device, "PENA:%02X%c", ndiGetPHSRHandle(device, i), NDI_DYNAMIC);
+    if (ndiGetError(device) != NDI_OKAY)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,23 @@
+// Helpers that the example and benchmark programs have in common.
+//
+// A device is named either by a serial port, or by "host:port" for a
+// network connection.  Names starting with "COM" or "capture:" are always
+// passed to ndiOpenSerial(), the latter to replay a capture file.
+#ifndef NDI_APPLICATION_HELPERS_H
+#define NDI_APPLICATION_HELPERS_H
+
+#include <ndicapi.h>
+
+// Check whether the name is a network address rather than a serial port.
+bool IsNetworkName(const char* name);
+
+// Open a serial port or a network connection, returns NULL on failure.
+ndicapi* OpenDevice(const char* name);
+
+// Close a device that was opened with OpenDevice().
+void CloseDevice(ndicapi* device);
+
+// Initialize all the ports that need it, and then enable them all.
+bool EnableTools(ndicapi* device);
+
+#endif
@@ -0,0 +1,215 @@
+// Record the traffic with a device, replay it, and parse it offline.
+//
+// Usage: ndiCaptureBenchmark record [-n count] [-c command] <serial device | host:port> <file>
+//        ndiCaptureBenchmark replay [-n count] [-c command] [-s speed] <file>
+//        ndiCaptureBenchmark parse [-r repeat] <file>
+//
+// "record" initializes the device, enables its tools, starts tracking,
+// and sends the command ("BX:0801" by default) the given number of times
+// (1000 by default) while all traffic is written to the capture file.
+// "replay" does the same against the capture file instead of a device,
+// at the given speed (1 by default, 0 for as fast as possible), so the
+// count and command must match the recording.  "parse" reads the capture
+// file and gives every GX, TX and BX reply to ndiParseReply() without
+// any I/O, the given number of times, and reports the parsing rate.  Use
+// ndiSimulator to make a capture without a tracker.
+#include "ndiApplicationHelpers.h"
+#include <ndicapi.h>
+#include <ndicapi_capture.h>
+#include <ndicapi_thread.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <iostream>
+
+//----------------------------------------------------------------------------
+// Initialize the device, then send the command 'count' times.  This is
+// used both for recording and for replaying, so that the commands match.
+int RunCommands(ndicapi* device, const char* command, int count)
+{
+  ndiCommand(device, "INIT:");
+  if (ndiGetError(device) != NDI_OKAY || !EnableTools(device))
+  {
+    std::cerr << "Error when initializing: " << ndiErrorString(ndiGetError(device)) << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ndiCommand(device, "TSTART:");
+  if (ndiGetError(device) != NDI_OKAY)
+  {
+    std::cerr << "Error when sending TSTART: " << ndiErrorString(ndiGetError(device)) << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  int errors = 0;
+  unsigned long long start = ndiTimeNanoseconds();
+  for (int i = 0; i < count; i++)
+  {
+    ndiCommand(device, "%s", command);
+    if (ndiGetError(device) != NDI_OKAY)
+    {
+      errors++;
+    }
+  }
+  unsigned long long elapsed = ndiTimeNanoseconds() - start;
+
+  ndiCommand(device, "TSTOP:");
+
+  printf("%d x %s in %.3f s (%.1f per second), %d errors\n", count, command, elapsed * 1e-9,
+         count * 1e9 / elapsed, errors);
+
+  return (errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+//----------------------------------------------------------------------------
+// Parse the GX, TX and BX replies in a capture file 'repeat' times.
+int ParseCapture(const char* filename, int repeat)
+{
+  ndiCaptureReader* reader = ndiCaptureOpen(filename);
+  if (reader == nullptr)
+  {
+    std::cerr << "Could not open " << filename << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // collect the replies along with the commands that they belong to
+  std::vector<ndiCaptureRecord> commands;
+  std::vector<ndiCaptureRecord> replies;
+  ndiCaptureRecord command;
+  ndiCaptureRecord record;
+  bool haveCommand = false;
+  long long n = ndiCaptureGetNumberOfRecords(reader);
+  for (long long i = 0; i < n; i++)
+  {
+    ndiCaptureGetRecord(reader, i, &record);
+    if (record.Direction == NDI_CAPTURE_COMMAND)
+    {
+      command = record;
+      haveCommand = true;
+    }
+    else if (haveCommand && command.Length > 2 && (command.Data[2] == ':' || command.Data[2] == ' ') &&
+             (strncmp(command.Data, "BX", 2) == 0 || strncmp(command.Data, "TX", 2) == 0 ||
+              strncmp(command.Data, "GX", 2) == 0))
+    {
+      commands.push_back(command);
+      replies.push_back(record);
+    }
+  }
+  printf("%lld records, %d GX/TX/BX replies\n", n, (int)replies.size());
+  if (replies.empty())
+  {
+    ndiCaptureClose(reader);
+    return EXIT_FAILURE;
+  }
+
+  ndicapi* parser = ndiOpenOffline();
+
+  unsigned long long errors = 0;
+  unsigned long long bytes = 0;
+  std::string text;
+  unsigned long long start = ndiTimeNanoseconds();
+  for (int r = 0; r < repeat; r++)
+  {
+    for (size_t i = 0; i < replies.size(); i++)
+    {
+      text.assign(commands[i].Data, commands[i].Length);
+      ndiParseReply(parser, text.c_str(), replies[i].Data, replies[i].Length);
+      if (ndiGetError(parser) != NDI_OKAY)
+      {
+        errors++;
+      }
+      bytes += replies[i].Length;
+    }
+  }
+  unsigned long long elapsed = ndiTimeNanoseconds() - start;
+  unsigned long long frames = (unsigned long long)replies.size() * repeat;
+
+  printf("parsed %llu replies in %.3f s: %.2f million replies per second, %.1f ns per reply, %.1f MB/s, %llu errors\n",
+         frames, elapsed * 1e-9, frames * 1e3 / elapsed, (double)elapsed / frames, bytes * 1e3 / elapsed, errors);
+
+  ndiCloseNetwork(parser);
+  ndiCaptureClose(reader);
+
+  return (errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  int count = 1000;
+  int repeat = 100;
+  double speed = 1.0;
+  const char* command = "BX:0801";
+  std::vector<const char*> names;
+
+  for (int i = 2; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+    {
+      count = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+    {
+      command = argv[++i];
+    }
+    else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+    {
+      speed = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+    {
+      repeat = atoi(argv[++i]);
+    }
+    else
+    {
+      names.push_back(argv[i]);
+    }
+  }
+
+  std::string mode = (argc > 1 ? argv[1] : "");
+  if (mode == "record" && names.size() == 2)
+  {
+    ndicapi* device = OpenDevice(names[0]);
+    if (device == nullptr)
+    {
+      std::cerr << "Could not open " << names[0] << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (ndiStartCapture(device, names[1]) != NDI_OKAY)
+    {
+      std::cerr << "Could not create " << names[1] << std::endl;
+      CloseDevice(device);
+      return EXIT_FAILURE;
+    }
+    int result = RunCommands(device, command, count);
+    CloseDevice(device);
+    return result;
+  }
+  else if (mode == "replay" && names.size() == 1)
+  {
+    char speedText[32];
+    snprintf(speedText, sizeof(speedText), "%g", speed);
+    std::string name = std::string("capture:") + names[0] + "?speed=" + speedText;
+    ndicapi* device = ndiOpenSerial(name.c_str());
+    if (device == nullptr)
+    {
+      std::cerr << "Could not replay " << names[0] << std::endl;
+      return EXIT_FAILURE;
+    }
+    int result = RunCommands(device, command, count);
+    CloseDevice(device);
+    return result;
+  }
+  else if (mode == "parse" && names.size() == 1)
+  {
+    return ParseCapture(names[0], repeat);
+  }
+
+  std::cerr << "Usage: " << argv[0] << " record [-n count] [-c command] <serial device | host:port> <file>\n"
+            << "       " << argv[0] << " replay [-n count] [-c command] [-s speed] <file>\n"
+            << "       " << argv[0] << " parse [-r repeat] <file>" << std::endl;
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,64 @@
+"""Check that closing a device and then freeing it does not crash.
+
+Run ndiSimulator first, then:
+
+    python ndiCloseRegression.py [host:port]
+
+Each device is opened, closed twice, and then deleted and collected, both
+with ndicapy and with ndicapy_async.Tracker.  A device that is freed twice
+makes the interpreter abort rather than raise, so the script passes if it
+prints "OK" and exits with status 0.
+"""
+
+import asyncio
+import gc
+import sys
+
+from ndicapy import (
+    ndiOpenNetwork, ndiClose, ndiCloseNetwork, ndiCommand,
+)
+from ndicapy_async import Tracker
+
+
+def check_closed(device):
+    try:
+        ndiCommand(device, 'INIT:')
+    except ValueError:
+        return
+    raise AssertionError('a closed device accepted a command')
+
+
+def check_ndicapy(host, port):
+    for close in (ndiClose, ndiCloseNetwork):
+        device = ndiOpenNetwork(host, port)
+        if not device:
+            raise IOError('Could not connect to {}:{}'.format(host, port))
+        ndiCommand(device, 'INIT:')
+        close(device)
+        close(device)
+        check_closed(device)
+        del device
+        gc.collect()
+
+    # a device that is never closed is closed when it is collected
+    device = ndiOpenNetwork(host, port)
+    del device
+    gc.collect()
+
+
+async def check_tracker(name):
+    tracker = await Tracker.open(name)
+    await tracker.command('INIT:')
+    await tracker.close()
+    await tracker.close()
+    check_closed(tracker.device)
+    del tracker
+    gc.collect()
+
+
+if __name__ == '__main__':
+    name = sys.argv[1] if len(sys.argv) > 1 else 'localhost:8765'
+    host, _, port = name.rpartition(':')
+    check_ndicapy(host, int(port))
+    asyncio.run(check_tracker(name))
+    print('OK')
@@ -0,0 +1,167 @@
+// Measure the cost of computing CRCs and of formatting commands.
+//
+// Usage: ndiCommandBenchmark [serial device | host:port] [count]
+//
+// The table-driven ndiCRC16() is compared with the character-at-a-time
+// routine from the NDI documentation for several buffer sizes, and the
+// two are checked to give the same result.  If a device is given, it is
+// put into tracking mode and BX is sent the given number of times (10000
+// by default) with ndiCommand() and then with ndiCommandPrepared().
+#include "ndiApplicationHelpers.h"
+#include <ndicapi.h>
+#include <ndicapi_thread.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <iostream>
+
+//----------------------------------------------------------------------------
+// The CRC routine from the NDI documentation, as ndicapi used to do it.
+static const int oddparity[16] = { 0, 1, 1, 0, 1, 0, 0, 1,
+                                   1, 0, 0, 1, 0, 1, 1, 0
+                                 };
+
+#define CalcCRC16(nextchar, puCRC16) \
+{ \
+    int data; \
+    data = nextchar; \
+    data = (data ^ (*(puCRC16) & 0xff)) & 0xff; \
+    *puCRC16 >>= 8; \
+    if ( oddparity[data & 0x0f] ^ oddparity[data >> 4] ) { \
+      *(puCRC16) ^= 0xc001; \
+    } \
+    data <<= 6; \
+    *puCRC16 ^= data; \
+    data <<= 1; \
+    *puCRC16 ^= data; \
+}
+
+//----------------------------------------------------------------------------
+unsigned short ReferenceCRC16(const char* buffer, int n)
+{
+  unsigned short crc = 0;
+  for (int i = 0; i < n; i++)
+  {
+    CalcCRC16(buffer[i], &crc);
+  }
+  return crc;
+}
+
+//----------------------------------------------------------------------------
+bool BenchmarkCRC()
+{
+  static const int sizes[] = { 8, 64, 512, 2048 };
+  std::vector<char> data(2048);
+  bool okay = true;
+
+  srand(1);
+  for (size_t i = 0; i < data.size(); i++)
+  {
+    data[i] = (char)(rand() & 0xff);
+  }
+
+  printf("%-8s %14s %14s %8s\n", "bytes", "reference MB/s", "table MB/s", "speedup");
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+  {
+    int n = sizes[s];
+    int iterations = (64 * 1024 * 1024) / n;
+    unsigned int check = 0;
+
+    unsigned long long start = ndiTimeNanoseconds();
+    for (int i = 0; i < iterations; i++)
+    {
+      data[0] = (char)i;
+      check += ReferenceCRC16(&data[0], n);
+    }
+    double referenceSeconds = (ndiTimeNanoseconds() - start) * 1e-9;
+
+    start = ndiTimeNanoseconds();
+    for (int i = 0; i < iterations; i++)
+    {
+      data[0] = (char)i;
+      check -= ndiCRC16(0, &data[0], n);
+    }
+    double tableSeconds = (ndiTimeNanoseconds() - start) * 1e-9;
+
+    if (check != 0)
+    {
+      std::cerr << "CRC mismatch for " << n << " bytes" << std::endl;
+      okay = false;
+    }
+
+    double megabytes = (double)iterations * n / (1024 * 1024);
+    printf("%-8d %14.1f %14.1f %7.1fx\n", n, megabytes / referenceSeconds,
+           megabytes / tableSeconds, referenceSeconds / tableSeconds);
+  }
+
+  return okay;
+}
+
+//----------------------------------------------------------------------------
+bool BenchmarkCommands(const char* name, int count)
+{
+  ndicapi* device = OpenDevice(name);
+  if (device == nullptr)
+  {
+    std::cerr << "Could not open " << name << std::endl;
+    return false;
+  }
+
+  ndiCommand(device, "INIT:");
+  ndiCommand(device, "TSTART:");
+  if (ndiGetError(device) != NDI_OKAY)
+  {
+    std::cerr << "Error when starting tracking: " << ndiErrorString(ndiGetError(device)) << std::endl;
+    CloseDevice(device);
+    return false;
+  }
+
+  int errors = 0;
+  unsigned long long start = ndiTimeNanoseconds();
+  for (int i = 0; i < count; i++)
+  {
+    ndiCommand(device, "BX:%04X", NDI_XFORMS_AND_STATUS);
+    errors += (ndiGetError(device) != NDI_OKAY);
+  }
+  double formattedSeconds = (ndiTimeNanoseconds() - start) * 1e-9;
+
+  ndiPreparedCommand* bx = ndiPrepareCommand("BX:%04X", NDI_XFORMS_AND_STATUS);
+  start = ndiTimeNanoseconds();
+  for (int i = 0; i < count; i++)
+  {
+    ndiCommandPrepared(device, bx);
+    errors += (ndiGetError(device) != NDI_OKAY);
+  }
+  double preparedSeconds = (ndiTimeNanoseconds() - start) * 1e-9;
+  ndiFreePreparedCommand(bx);
+
+  printf("\n%-12s %10s %10s\n", "BX", "us/command", "commands/s");
+  printf("%-12s %10.2f %10.0f\n", "ndiCommand", formattedSeconds * 1e6 / count, count / formattedSeconds);
+  printf("%-12s %10.2f %10.0f\n", "prepared", preparedSeconds * 1e6 / count, count / preparedSeconds);
+  if (errors > 0)
+  {
+    std::cerr << errors << " commands failed" << std::endl;
+  }
+
+  ndiCommand(device, "TSTOP:");
+  CloseDevice(device);
+
+  return (errors == 0);
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  bool okay = BenchmarkCRC();
+
+  if (argc > 1)
+  {
+    int count = (argc > 2 ? atoi(argv[2]) : 10000);
+    okay = BenchmarkCommands(argv[1], count) && okay;
+  }
+
+  return (okay ? EXIT_SUCCESS : EXIT_FAILURE);
+}
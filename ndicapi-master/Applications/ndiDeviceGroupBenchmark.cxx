@@ -0,0 +1,129 @@
+// Track with several devices from one thread using a device group.
+//
+// Usage: ndiDeviceGroupBenchmark [-t seconds] [-c command] <serial device | host:port> ...
+//
+// Every device is initialized, its tools are enabled, and tracking is
+// started.  The devices are then added to one ndiDeviceGroup, which sends
+// the command ("BX:0801" by default) to all of them from a single thread
+// for the given number of seconds (5 by default).  The reply rate and
+// latency are printed for each device and for the whole group.  To try
+// it without trackers, start several ndiSimulator instances on
+// different ports.
+#include "ndiApplicationHelpers.h"
+#include <ndicapi.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <iostream>
+
+//----------------------------------------------------------------------------
+void PrintStats(const char* label, const ndiDeviceGroupStats& stats, double seconds)
+{
+  double meanLatency = (stats.Replies + stats.Errors > 0 ?
+                        stats.TotalLatency * 1e-6 / (stats.Replies + stats.Errors) : 0.0);
+  printf("%-24s %10llu %10.1f %8llu %8llu %10.3f %10.3f\n", label, stats.Replies,
+         stats.Replies / seconds, stats.Errors, stats.DroppedFrames, meanLatency,
+         stats.MaxLatency * 1e-6);
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  double seconds = 5.0;
+  const char* command = "BX:0801";
+  std::vector<const char*> names;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+    {
+      seconds = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+    {
+      command = argv[++i];
+    }
+    else
+    {
+      names.push_back(argv[i]);
+    }
+  }
+  if (names.empty())
+  {
+    std::cerr << "Usage: " << argv[0] << " [-t seconds] [-c command] <serial device | host:port> ..." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<ndicapi*> devices;
+  ndiDeviceGroup* group = ndiDeviceGroupCreate();
+  int result = EXIT_SUCCESS;
+
+  for (size_t i = 0; i < names.size(); i++)
+  {
+    ndicapi* device = OpenDevice(names[i]);
+    if (device == nullptr)
+    {
+      std::cerr << "Could not open " << names[i] << std::endl;
+      result = EXIT_FAILURE;
+      break;
+    }
+    devices.push_back(device);
+
+    ndiCommand(device, "INIT:");
+    if (ndiGetError(device) != NDI_OKAY || !EnableTools(device))
+    {
+      std::cerr << names[i] << ": error when initializing: " << ndiErrorString(ndiGetError(device)) << std::endl;
+      result = EXIT_FAILURE;
+      break;
+    }
+    ndiCommand(device, "TSTART:");
+    if (ndiGetError(device) != NDI_OKAY)
+    {
+      std::cerr << names[i] << ": error when sending TSTART: " << ndiErrorString(ndiGetError(device)) << std::endl;
+      result = EXIT_FAILURE;
+      break;
+    }
+    if (ndiDeviceGroupAdd(group, device, command) < 0)
+    {
+      std::cerr << names[i] << ": could not add the device to the group" << std::endl;
+      result = EXIT_FAILURE;
+      break;
+    }
+  }
+
+  if (result == EXIT_SUCCESS)
+  {
+    ndiDeviceGroupStart(group);
+    std::this_thread::sleep_for(std::chrono::milliseconds((int)(seconds * 1000)));
+    ndiDeviceGroupStop(group);
+
+    printf("%-24s %10s %10s %8s %8s %10s %10s\n", "device", "replies", "replies/s",
+           "errors", "dropped", "mean ms", "max ms");
+    ndiDeviceGroupStats stats;
+    for (int i = 0; i < ndiDeviceGroupGetNumberOfDevices(group); i++)
+    {
+      ndiDeviceGroupGetStats(group, i, &stats);
+      PrintStats(names[i], stats, seconds);
+    }
+    ndiDeviceGroupGetStats(group, -1, &stats);
+    PrintStats("all", stats, seconds);
+    if (stats.Errors > 0)
+    {
+      result = EXIT_FAILURE;
+    }
+  }
+
+  ndiDeviceGroupDestroy(group);
+  for (size_t i = 0; i < devices.size(); i++)
+  {
+    ndiCommand(devices[i], "TSTOP:");
+    CloseDevice(devices[i]);
+  }
+
+  return result;
+}
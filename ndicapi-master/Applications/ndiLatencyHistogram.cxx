@@ -0,0 +1,203 @@
+// Measure the round-trip time of commands and print a latency histogram.
+//
+// Usage: ndiLatencyHistogram [-n count] [-l] [-t microseconds]
+//                            <serial device | host:port> [command ...]
+//
+// The device is initialized, its tools are enabled, and tracking is
+// started.  Each command ("BX:0801" and "TX:0801" by default) is then
+// sent the given number of times (1000 by default), and the time from
+// sending the command to receiving the complete reply is recorded.
+// For serial devices, -l turns on the low-latency mode of the serial
+// driver and -t sets the read timeout in microseconds.  The round-trip
+// time is then broken down with the metrics that ndicapi keeps.
+#include "ndiApplicationHelpers.h"
+#include <ndicapi.h>
+#include <ndicapi_thread.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <iostream>
+
+//----------------------------------------------------------------------------
+// Print the percentiles and a histogram with power-of-two buckets in
+// microseconds.
+void PrintHistogram(const char* command, std::vector<double>& times, int errors)
+{
+  std::sort(times.begin(), times.end());
+  printf("\n%s: %d replies, %d errors\n", command, (int)times.size(), errors);
+  if (times.empty())
+  {
+    return;
+  }
+
+  size_t n = times.size();
+  printf("  min %.1f us, p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us\n",
+         times[0], times[n / 2], times[(n * 9) / 10], times[(n * 99) / 100], times[n - 1]);
+
+  const int numberOfBuckets = 24;
+  int counts[numberOfBuckets] = { 0 };
+  for (size_t i = 0; i < n; i++)
+  {
+    int bucket = 0;
+    while (bucket < numberOfBuckets - 1 && times[i] >= (double)(2 << bucket))
+    {
+      bucket++;
+    }
+    counts[bucket]++;
+  }
+
+  int maxCount = *std::max_element(counts, counts + numberOfBuckets);
+  for (int bucket = 0; bucket < numberOfBuckets; bucket++)
+  {
+    if (counts[bucket] == 0)
+    {
+      continue;
+    }
+    int width = (counts[bucket] * 50 + maxCount - 1) / maxCount;
+    printf("  < %9d us %8d %s\n", 2 << bucket, counts[bucket], std::string(width, '#').c_str());
+  }
+}
+
+//----------------------------------------------------------------------------
+// Print the percentiles of one of the histograms from ndiGetMetrics().
+void PrintMetricsHistogram(const char* label, const ndiLatencyHistogram& histogram)
+{
+  if (histogram.Count == 0)
+  {
+    return;
+  }
+  printf("  %-14s p50 %.1f us, p99 %.1f us, max %.1f us\n", label,
+         ndiGetHistogramPercentile(&histogram, 0.5) * 1e-3,
+         ndiGetHistogramPercentile(&histogram, 0.99) * 1e-3,
+         histogram.Max * 1e-3);
+}
+
+//----------------------------------------------------------------------------
+// Print the breakdown of the round-trip time that ndicapi measured.
+void PrintMetrics(ndicapi* device)
+{
+  ndiMetricsInfo info;
+  ndiGetMetrics(device, &info);
+  printf("  %llu bytes sent, %llu bytes received, %llu CRC errors, %llu timeouts\n",
+         info.BytesSent, info.BytesReceived, info.CrcErrors, info.Timeouts);
+  PrintMetricsHistogram("first byte", info.ReplyLatency);
+  PrintMetricsHistogram("transfer", info.TransferTime);
+  PrintMetricsHistogram("parse", info.ParseTime);
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  int count = 1000;
+  bool lowLatency = false;
+  long timeout = 0;
+  const char* name = nullptr;
+  std::vector<const char*> commands;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+    {
+      count = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-l") == 0)
+    {
+      lowLatency = true;
+    }
+    else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+    {
+      timeout = atol(argv[++i]);
+    }
+    else if (name == nullptr)
+    {
+      name = argv[i];
+    }
+    else
+    {
+      commands.push_back(argv[i]);
+    }
+  }
+  if (name == nullptr)
+  {
+    std::cerr << "Usage: " << argv[0] << " [-n count] [-l] [-t microseconds] <serial device | host:port> [command ...]" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (commands.empty())
+  {
+    commands.push_back("BX:0801");
+    commands.push_back("TX:0801");
+  }
+
+  ndicapi* device = OpenDevice(name);
+  if (device == nullptr)
+  {
+    std::cerr << "Could not open " << name << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  NDIFileHandle serialPort = ndiGetDeviceHandle(device);
+  if (serialPort != NDI_INVALID_HANDLE)
+  {
+    if (lowLatency && ndiSerialSetLowLatency(serialPort, 1) != 0)
+    {
+      std::cerr << "Low-latency mode is not supported for " << name << std::endl;
+    }
+    if (timeout > 0 && ndiSerialTimeoutMicroseconds(serialPort, timeout) != 0)
+    {
+      std::cerr << "Could not set the timeout for " << name << std::endl;
+    }
+  }
+
+  ndiCommand(device, "INIT:");
+  if (ndiGetError(device) != NDI_OKAY || !EnableTools(device))
+  {
+    std::cerr << "Error when initializing: " << ndiErrorString(ndiGetError(device)) << std::endl;
+    CloseDevice(device);
+    return EXIT_FAILURE;
+  }
+
+  ndiCommand(device, "TSTART:");
+  if (ndiGetError(device) != NDI_OKAY)
+  {
+    std::cerr << "Error when sending TSTART: " << ndiErrorString(ndiGetError(device)) << std::endl;
+    CloseDevice(device);
+    return EXIT_FAILURE;
+  }
+
+  int totalErrors = 0;
+  for (size_t c = 0; c < commands.size(); c++)
+  {
+    std::vector<double> times;
+    times.reserve(count);
+    int errors = 0;
+    ndiResetMetrics(device);
+    for (int i = 0; i < count; i++)
+    {
+      unsigned long long start = ndiTimeNanoseconds();
+      ndiCommand(device, "%s", commands[c]);
+      unsigned long long stop = ndiTimeNanoseconds();
+      if (ndiGetError(device) != NDI_OKAY)
+      {
+        errors++;
+        continue;
+      }
+      times.push_back((stop - start) * 1e-3);
+    }
+    PrintHistogram(commands[c], times, errors);
+    PrintMetrics(device);
+    totalErrors += errors;
+  }
+
+  ndiCommand(device, "TSTOP:");
+  if (serialPort != NDI_INVALID_HANDLE && lowLatency)
+  {
+    ndiSerialSetLowLatency(serialPort, 0);
+  }
+  CloseDevice(device);
+
+  return (totalErrors == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
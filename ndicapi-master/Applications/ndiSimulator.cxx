@@ -0,0 +1,1038 @@
+// A simulated NDI measurement system, for running ndicapi without hardware.
+//
+// Usage: ndiSimulator [-p port] [-s link] [-t tools] [-m markers] [-r rate]
+//                     [-l microseconds] [-e bit error rate] [-b baud] [-v]
+//
+// The simulator listens on a TCP port (8765 by default, or none if the
+// port is 0) and serves one client at a time.  With -s it also creates a
+// pseudo-terminal, and makes 'link' a symbolic link to it so that it can
+// be opened with ndiOpenSerial().  Each endpoint is a separate device.
+//
+// Each device has the given number of wired tools (2 by default, at most
+// 16) that circle slowly, each with the given number of markers (4 by
+// default).  The tools must be initialized with PINIT and enabled with
+// PENA as usual, and PHRQ adds more tools.  Tracking runs at the given
+// frame rate (60 Hz by default), and TX, BX and GX report the most recent
+// frame with the usual reply options, including marker positions for
+// BX:0008.  INIT, COMM, PHSR, PHINF, PINIT, PENA, PDIS, PHF, TSTART, TSTOP,
+// VER, GETINFO and ECHO are answered as a real device would, and every other
+// command is answered with OKAY.  STREAM --cmd="..." and USTREAM are also
+// understood, and streamed BX replies start with 0xB5D4 instead of 0xA5C4.
+//
+// The -l option delays every reply by the given number of microseconds,
+// and -e flips bits in the replies with the given probability per bit,
+// to exercise the error handling of the client.  With -b, every reply is
+// corrupted while COMM has selected a rate above the given baud rate, as
+// if the cable could not carry it, to exercise ndiNegotiateBaudRate().  A
+// serial break cannot be sent through a pseudo-terminal, so the device
+// cannot be reset that way.
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <iostream>
+
+//----------------------------------------------------------------------------
+struct SimulatorOptions
+{
+  int Port = 8765;
+  const char* Link = nullptr;
+  int Tools = 2;
+  int Markers = 4;
+  double FrameRate = 60.0;
+  unsigned long long Latency = 0;         // nanoseconds
+  double BitErrorRate = 0.0;
+  int MaxBaudRate = 0;                    // zero for no limit
+  bool Verbose = false;
+};
+
+//----------------------------------------------------------------------------
+unsigned short CalculateCRC(const char* data, size_t n)
+{
+  unsigned short crc = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    crc ^= (unsigned char)data[i];
+    for (int bit = 0; bit < 8; bit++)
+    {
+      crc = ((crc & 1) ? ((crc >> 1) ^ 0xA001) : (crc >> 1));
+    }
+  }
+  return crc;
+}
+
+//----------------------------------------------------------------------------
+unsigned long long MonotonicNanoseconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//----------------------------------------------------------------------------
+// Append the CRC and carriage return to an ASCII reply.
+std::string AsciiReply(const std::string& text)
+{
+  char crc[8];
+  snprintf(crc, sizeof(crc), "%04X\r", CalculateCRC(text.data(), text.size()));
+  return text + crc;
+}
+
+//----------------------------------------------------------------------------
+std::string ErrorReply(int errnum)
+{
+  char text[16];
+  snprintf(text, sizeof(text), "ERROR%02X", errnum & 0xff);
+  return AsciiReply(text);
+}
+
+//----------------------------------------------------------------------------
+void AppendShort(std::string& data, unsigned short value)
+{
+  data.push_back((char)(value & 0xff));
+  data.push_back((char)(value >> 8));
+}
+
+//----------------------------------------------------------------------------
+void AppendLong(std::string& data, unsigned int value)
+{
+  AppendShort(data, (unsigned short)(value & 0xffff));
+  AppendShort(data, (unsigned short)(value >> 16));
+}
+
+//----------------------------------------------------------------------------
+void AppendFloat(std::string& data, float value)
+{
+  unsigned int bits;
+  memcpy(&bits, &value, sizeof(bits));
+  AppendLong(data, bits);
+}
+
+//----------------------------------------------------------------------------
+struct SimulatedTool
+{
+  int Handle;
+  bool Initialized;
+  bool Enabled;
+};
+
+//----------------------------------------------------------------------------
+class SimulatedDevice
+{
+public:
+  SimulatedDevice(const SimulatorOptions& options);
+
+  // Get the reply to a command, which must not include the final '\r'.
+  // A streamed command is one that was given with STREAM --cmd.
+  std::string Reply(const std::string& command, bool streamed);
+
+  // The rate that was selected with COMM, which INIT does not change.
+  int GetBaudRate() { return this->BaudRate; }
+
+protected:
+  void Reset();
+  unsigned int CurrentFrame();
+  SimulatedTool* FindTool(const std::string& hex);
+  void Pose(int handle, unsigned int frame, double pose[8]);
+  void Marker(const double pose[8], int i, double position[3]);
+  unsigned int PortStatus(const SimulatedTool& tool);
+
+  std::string PHSRReply(int mode);
+  std::string PHINFReply(SimulatedTool* tool, int mode);
+  std::string TXReply(int mode);
+  std::string BXReply(int mode, bool streamed);
+  std::string GXReply(int mode);
+
+  const SimulatorOptions& Options;
+  std::vector<SimulatedTool> Tools;
+  bool IsTracking;
+  unsigned long long TrackingStartTime;
+  int NextHandle;
+  int BaudRate;
+};
+
+//----------------------------------------------------------------------------
+SimulatedDevice::SimulatedDevice(const SimulatorOptions& options)
+  : Options(options), BaudRate(9600)
+{
+  this->Reset();
+}
+
+//----------------------------------------------------------------------------
+// The state after power-up or INIT: wired tools are plugged in, but not
+// initialized, and tracking is off.
+void SimulatedDevice::Reset()
+{
+  this->Tools.clear();
+  for (int i = 0; i < this->Options.Tools; i++)
+  {
+    SimulatedTool tool = { i + 1, false, false };
+    this->Tools.push_back(tool);
+  }
+  this->NextHandle = this->Options.Tools + 1;
+  this->IsTracking = false;
+  this->TrackingStartTime = 0;
+}
+
+//----------------------------------------------------------------------------
+// The device keeps measuring while tracking, so the frame number follows
+// the clock rather than the number of requests.
+unsigned int SimulatedDevice::CurrentFrame()
+{
+  double seconds = (MonotonicNanoseconds() - this->TrackingStartTime) * 1e-9;
+  return 1 + (unsigned int)(seconds * this->Options.FrameRate);
+}
+
+//----------------------------------------------------------------------------
+SimulatedTool* SimulatedDevice::FindTool(const std::string& hex)
+{
+  int handle = (int)strtol(hex.substr(0, 2).c_str(), nullptr, 16);
+  for (size_t i = 0; i < this->Tools.size(); i++)
+  {
+    if (this->Tools[i].Handle == handle)
+    {
+      return &this->Tools[i];
+    }
+  }
+  return nullptr;
+}
+
+//----------------------------------------------------------------------------
+// Quaternion, position and error for a tool that circles slowly.
+void SimulatedDevice::Pose(int handle, unsigned int frame, double pose[8])
+{
+  double angle = 0.6 * frame / this->Options.FrameRate + handle;
+  pose[0] = cos(angle / 2);
+  pose[1] = 0.0;
+  pose[2] = 0.0;
+  pose[3] = sin(angle / 2);
+  pose[4] = 100.0 * cos(angle);
+  pose[5] = 100.0 * sin(angle);
+  pose[6] = -1500.0 + 10.0 * handle;
+  pose[7] = 0.1;
+}
+
+//----------------------------------------------------------------------------
+// The markers are spread around a 50 mm circle in the tool's XY plane.
+void SimulatedDevice::Marker(const double pose[8], int i, double position[3])
+{
+  double a = 2 * M_PI * i / this->Options.Markers;
+  double x = 50.0 * cos(a);
+  double y = 50.0 * sin(a);
+  // the rotation is about the z axis, so cos and sin of the full angle are
+  // found from the half-angle quaternion
+  double c = pose[0] * pose[0] - pose[3] * pose[3];
+  double s = 2 * pose[0] * pose[3];
+  position[0] = pose[4] + c * x - s * y;
+  position[1] = pose[5] + s * x + c * y;
+  position[2] = pose[6];
+}
+
+//----------------------------------------------------------------------------
+unsigned int SimulatedDevice::PortStatus(const SimulatedTool& tool)
+{
+  // occupied, initialized, enabled
+  return 0x01 | (tool.Initialized ? 0x10 : 0) | (tool.Enabled ? 0x20 : 0);
+}
+
+//----------------------------------------------------------------------------
+std::string SimulatedDevice::PHSRReply(int mode)
+{
+  char text[16];
+  std::string reply;
+  int count = 0;
+
+  for (size_t i = 0; i < this->Tools.size(); i++)
+  {
+    const SimulatedTool& tool = this->Tools[i];
+    bool include = (mode == 0x00 ||
+                    (mode == 0x02 && !tool.Initialized) ||
+                    (mode == 0x03 && tool.Initialized && !tool.Enabled) ||
+                    (mode == 0x04 && tool.Enabled));
+    if (include)
+    {
+      snprintf(text, sizeof(text), "%02X%03X", tool.Handle, this->PortStatus(tool));
+      reply += text;
+      count++;
+    }
+  }
+
+  snprintf(text, sizeof(text), "%02X", count);
+  return AsciiReply(text + reply);
+}
+
+//----------------------------------------------------------------------------
+std::string SimulatedDevice::PHINFReply(SimulatedTool* tool, int mode)
+{
+  char text[64];
+  std::string reply;
+
+  if (mode & 0x0001)
+  {
+    // tool type, manufacturer, revision, serial number, port status
+    snprintf(text, sizeof(text), "%-8s%-12s%-3s%08X%02X", "01000000", "NDI", "000",
+             0x5100 + tool->Handle, this->PortStatus(*tool) & 0xff);
+    reply += text;
+  }
+  if (mode & 0x0002)
+  {
+    reply += "00000000";                  // current test
+  }
+  if (mode & 0x0004)
+  {
+    snprintf(text, sizeof(text), "%-20s", "8700339");
+    reply += text;                        // part number
+  }
+  if (mode & 0x0008)
+  {
+    reply += "00";                        // accessories
+  }
+  if (mode & 0x0010)
+  {
+    reply += "28";                        // passive spheres
+  }
+  if (mode & 0x0020)
+  {
+    snprintf(text, sizeof(text), "%010X%02X%02X", 0, tool->Handle, 0);
+    reply += text;                        // port location
+  }
+  if (mode & 0x0040)
+  {
+    reply += "00";                        // GPIO status
+  }
+
+  return AsciiReply(reply);
+}
+
+//----------------------------------------------------------------------------
+std::string SimulatedDevice::TXReply(int mode)
+{
+  char text[128];
+  std::string reply;
+  unsigned int frame = this->CurrentFrame();
+  int count = 0;
+
+  for (size_t i = 0; i < this->Tools.size(); i++)
+  {
+    const SimulatedTool& tool = this->Tools[i];
+    if (!tool.Enabled)
+    {
+      continue;
+    }
+    count++;
+
+    snprintf(text, sizeof(text), "%02X", tool.Handle);
+    reply += text;
+    if (mode & 0x0001)
+    {
+      double pose[8];
+      this->Pose(tool.Handle, frame, pose);
+      snprintf(text, sizeof(text), "%+06d%+06d%+06d%+06d%+07d%+07d%+07d%+06d%08X%08X",
+               (int)(pose[0] * 10000), (int)(pose[1] * 10000), (int)(pose[2] * 10000),
+               (int)(pose[3] * 10000), (int)(pose[4] * 100), (int)(pose[5] * 100),
+               (int)(pose[6] * 100), (int)(pose[7] * 10000), this->PortStatus(tool), frame);
+      reply += text;
+    }
+    if (mode & 0x0002)
+    {
+      reply += "00000000000000000000";    // tool and marker information
+    }
+    if (mode & 0x0004)
+    {
+      reply += "MISSING";                 // no active stray marker
+    }
+    reply += "\n";
+  }
+  if (mode & 0x1000)
+  {
+    reply += "00";                        // no passive stray markers
+  }
+  reply += "0000";                        // system status
+
+  snprintf(text, sizeof(text), "%02X", count);
+  return AsciiReply(text + reply);
+}
+
+//----------------------------------------------------------------------------
+std::string SimulatedDevice::BXReply(int mode, bool streamed)
+{
+  std::string payload;
+  unsigned int frame = this->CurrentFrame();
+  int count = 0;
+
+  payload.push_back((char)0);
+  for (size_t i = 0; i < this->Tools.size(); i++)
+  {
+    const SimulatedTool& tool = this->Tools[i];
+    if (!tool.Enabled)
+    {
+      continue;
+    }
+    count++;
+
+    double pose[8];
+    this->Pose(tool.Handle, frame, pose);
+    payload.push_back((char)tool.Handle);
+    payload.push_back((char)0x01);        // valid
+    if (mode & 0x0001)
+    {
+      for (int j = 0; j < 8; j++)
+      {
+        AppendFloat(payload, (float)pose[j]);
+      }
+      AppendLong(payload, this->PortStatus(tool));
+      AppendLong(payload, frame);
+    }
+    if (mode & 0x0002)
+    {
+      payload.append(11, (char)0);        // tool and marker information
+    }
+    if (mode & 0x0004)
+    {
+      payload.push_back((char)0);         // no active stray marker
+    }
+    if (mode & 0x0008)
+    {
+      payload.push_back((char)this->Options.Markers);
+      payload.append((this->Options.Markers + 7) / 8, (char)0);  // none out of volume
+      for (int j = 0; j < this->Options.Markers; j++)
+      {
+        double position[3];
+        this->Marker(pose, j, position);
+        AppendFloat(payload, (float)position[0]);
+        AppendFloat(payload, (float)position[1]);
+        AppendFloat(payload, (float)position[2]);
+      }
+    }
+  }
+  payload[0] = (char)count;
+  if (mode & 0x1000)
+  {
+    payload.push_back((char)0);           // no passive stray markers
+  }
+  AppendShort(payload, 0);                // system status
+
+  std::string reply;
+  AppendShort(reply, (streamed ? 0xB5D4 : 0xA5C4));
+  AppendShort(reply, (unsigned short)payload.size());
+  AppendShort(reply, CalculateCRC(reply.data(), reply.size()));
+  reply += payload;
+  AppendShort(reply, CalculateCRC(payload.data(), payload.size()));
+
+  return reply;
+}
+
+//----------------------------------------------------------------------------
+// GX reports the three active ports, which are the tools with handles
+// 1 to 3, and optionally three passive ports, which are never occupied.
+std::string SimulatedDevice::GXReply(int mode)
+{
+  char text[128];
+  std::string reply;
+  unsigned int frame = this->CurrentFrame();
+  unsigned int status[3] = { 0, 0, 0 };
+
+  for (int port = 0; port < 3; port++)
+  {
+    const SimulatedTool* tool = (port < (int)this->Tools.size() ? &this->Tools[port] : nullptr);
+    if (mode & 0x0001)
+    {
+      if (tool == nullptr)
+      {
+        reply += "UNOCCUPIED";
+      }
+      else if (!tool->Enabled)
+      {
+        reply += "DISABLED";
+      }
+      else
+      {
+        double pose[8];
+        this->Pose(tool->Handle, frame, pose);
+        snprintf(text, sizeof(text), "%+06d%+06d%+06d%+06d%+07d%+07d%+07d%+06d",
+                 (int)(pose[0] * 10000), (int)(pose[1] * 10000), (int)(pose[2] * 10000),
+                 (int)(pose[3] * 10000), (int)(pose[4] * 100), (int)(pose[5] * 100),
+                 (int)(pose[6] * 100), (int)(pose[7] * 10000));
+        reply += text;
+      }
+      reply += "\n";
+    }
+    status[port] = (tool ? this->PortStatus(*tool) : 0);
+  }
+  if (mode & 0x0001)
+  {
+    // system status, then the ports in reverse order
+    snprintf(text, sizeof(text), "%02X%02X%02X%02X\n", 0, status[2], status[1], status[0]);
+    reply += text;
+  }
+  if (mode & 0x0002)
+  {
+    reply += std::string(36, '0') + "\n"; // tool and marker information
+  }
+  if (mode & 0x0004)
+  {
+    reply += "MISSING\nMISSING\nMISSING\n";
+  }
+  if (mode & 0x0008)
+  {
+    snprintf(text, sizeof(text), "%08X%08X%08X\n", frame, frame, frame);
+    reply += text;
+  }
+  if (mode & 0x8000)
+  {
+    if (mode & 0x0001)
+    {
+      reply += "UNOCCUPIED\nUNOCCUPIED\nUNOCCUPIED\n00000000\n";
+    }
+    if (mode & 0x0002)
+    {
+      reply += std::string(36, '0') + "\n";
+    }
+    if (mode & 0x0008)
+    {
+      snprintf(text, sizeof(text), "%08X%08X%08X\n", frame, frame, frame);
+      reply += text;
+    }
+  }
+
+  return AsciiReply(reply);
+}
+
+//----------------------------------------------------------------------------
+std::string SimulatedDevice::Reply(const std::string& command, bool streamed)
+{
+  char text[128];
+
+  // split into the name and the arguments, and check the CRC if there is
+  // one (streamed commands never have one)
+  size_t separator = command.find_first_of(": ");
+  std::string name = command.substr(0, separator);
+  std::string arguments;
+  if (separator != std::string::npos)
+  {
+    arguments = command.substr(separator + 1);
+    if (command[separator] == ':' && !streamed)
+    {
+      if (arguments.size() < 4)
+      {
+        return ErrorReply(0x03);
+      }
+      std::string crc = arguments.substr(arguments.size() - 4);
+      arguments.erase(arguments.size() - 4);
+      snprintf(text, sizeof(text), "%04X", CalculateCRC(command.data(), separator + 1 + arguments.size()));
+      if (strcasecmp(crc.c_str(), text) != 0)
+      {
+        return ErrorReply(0x04);
+      }
+    }
+  }
+  int mode = (arguments.empty() ? -1 : (int)strtol(arguments.c_str(), nullptr, 16));
+
+  if (name == "TX" || name == "BX" || name == "GX")
+  {
+    if (!this->IsTracking)
+    {
+      return ErrorReply(0x0c);
+    }
+    if (name == "TX")
+    {
+      return this->TXReply(mode < 0 ? 0x0001 : mode);
+    }
+    else if (name == "BX")
+    {
+      return this->BXReply(mode < 0 ? 0x0001 : mode, streamed);
+    }
+    return this->GXReply(mode < 0 ? 0x0001 : mode);
+  }
+  else if (name == "INIT")
+  {
+    this->Reset();
+  }
+  else if (name == "TSTART")
+  {
+    if (!this->IsTracking)
+    {
+      this->IsTracking = true;
+      this->TrackingStartTime = MonotonicNanoseconds();
+    }
+  }
+  else if (name == "TSTOP")
+  {
+    this->IsTracking = false;
+  }
+  else if (name == "PHSR")
+  {
+    return this->PHSRReply(mode < 0 ? 0 : mode);
+  }
+  else if (name == "PHRQ")
+  {
+    if (this->Tools.size() >= 255)
+    {
+      return ErrorReply(0x0d);
+    }
+    SimulatedTool tool = { this->NextHandle++ & 0xff, false, false };
+    this->Tools.push_back(tool);
+    snprintf(text, sizeof(text), "%02X", tool.Handle);
+    return AsciiReply(text);
+  }
+  else if (name == "PHINF" || name == "PINIT" || name == "PENA" || name == "PDIS" || name == "PHF")
+  {
+    SimulatedTool* tool = this->FindTool(arguments);
+    if (tool == nullptr)
+    {
+      return ErrorReply(0x08);
+    }
+    if (name == "PHINF")
+    {
+      return this->PHINFReply(tool, (arguments.size() >= 6 ? (int)strtol(arguments.substr(2, 4).c_str(), nullptr, 16) : 0x0001));
+    }
+    else if (name == "PINIT")
+    {
+      tool->Initialized = true;
+    }
+    else if (name == "PENA")
+    {
+      if (!tool->Initialized)
+      {
+        return ErrorReply(0x0e);
+      }
+      tool->Enabled = true;
+    }
+    else if (name == "PDIS")
+    {
+      tool->Enabled = false;
+    }
+    else
+    {
+      this->Tools.erase(this->Tools.begin() + (tool - &this->Tools[0]));
+    }
+  }
+  else if (name == "COMM")
+  {
+    static const int rates[] = { 9600, 14400, 19200, 38400, 57600, 115200, 921600, 1228739 };
+    if (arguments.size() < 5)
+    {
+      return ErrorReply(0x07);
+    }
+    if (arguments[0] >= '0' && arguments[0] <= '7')
+    {
+      this->BaudRate = rates[arguments[0] - '0'];
+    }
+    else if (arguments[0] == 'A')
+    {
+      this->BaudRate = 230400;
+    }
+    else
+    {
+      return ErrorReply(0x06);
+    }
+  }
+  else if (name == "ECHO")
+  {
+    return AsciiReply(arguments);
+  }
+  else if (name == "VER")
+  {
+    return AsciiReply("ndiSimulator\nNDI S/N: SIM00001\nFreq: 60Hz\n");
+  }
+  else if (name == "GETINFO")
+  {
+    if (arguments.compare(0, 25, "Features.Firmware.Version") == 0)
+    {
+      return AsciiReply("Features.Firmware.Version=001.000.000;0;0;0;0;0;Simulated firmware");
+    }
+    return ErrorReply(0x01);
+  }
+
+  return AsciiReply("OKAY");
+}
+
+//----------------------------------------------------------------------------
+// One endpoint, i.e. a TCP client or the pseudo-terminal, with its own
+// simulated device.
+class SimulatorSession
+{
+public:
+  SimulatorSession(const SimulatorOptions& options, int fd);
+
+  int GetFD() { return this->FD; }
+  // When the next frame or delayed reply is due, or zero if never.
+  unsigned long long GetNextEventTime();
+  // Read and handle commands, return false if the endpoint was closed.
+  bool Read();
+  // Send the replies that are due, return false if the endpoint was closed.
+  bool Write();
+
+protected:
+  void Queue(const std::string& reply, int baudRate);
+
+  const SimulatorOptions& Options;
+  int FD;
+  SimulatedDevice Device;
+  std::string Input;
+  std::string StreamCommand;
+  unsigned long long NextFrameTime;
+  std::deque<std::pair<unsigned long long, std::string> > Output;
+  std::mt19937 Random;
+};
+
+//----------------------------------------------------------------------------
+SimulatorSession::SimulatorSession(const SimulatorOptions& options, int fd)
+  : Options(options), FD(fd), Device(options), NextFrameTime(0), Random(12345)
+{
+}
+
+//----------------------------------------------------------------------------
+unsigned long long SimulatorSession::GetNextEventTime()
+{
+  unsigned long long next = 0;
+  if (!this->StreamCommand.empty())
+  {
+    next = this->NextFrameTime;
+  }
+  if (!this->Output.empty() && (next == 0 || this->Output.front().first < next))
+  {
+    next = this->Output.front().first;
+  }
+  return next;
+}
+
+//----------------------------------------------------------------------------
+// Add a reply to the queue, after adding the latency and the bit errors.
+// The baud rate is the one that the reply is sent at.
+void SimulatorSession::Queue(const std::string& reply, int baudRate)
+{
+  std::string data = reply;
+  if (this->Options.MaxBaudRate > 0 && baudRate > this->Options.MaxBaudRate)
+  {
+    for (size_t i = 0; i < data.size(); i += 7)
+    {
+      data[i] ^= 0x10;
+    }
+  }
+  if (this->Options.BitErrorRate > 0)
+  {
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for (size_t i = 0; i < data.size(); i++)
+    {
+      for (int bit = 0; bit < 8; bit++)
+      {
+        if (uniform(this->Random) < this->Options.BitErrorRate)
+        {
+          data[i] ^= (char)(1 << bit);
+        }
+      }
+    }
+  }
+  this->Output.push_back(std::make_pair(MonotonicNanoseconds() + this->Options.Latency, data));
+}
+
+//----------------------------------------------------------------------------
+bool SimulatorSession::Read()
+{
+  char buffer[2048];
+  ssize_t m = read(this->FD, buffer, sizeof(buffer));
+  if (m <= 0)
+  {
+    return false;
+  }
+  this->Input.append(buffer, m);
+
+  size_t end;
+  while ((end = this->Input.find('\r')) != std::string::npos)
+  {
+    std::string command = this->Input.substr(0, end);
+    this->Input.erase(0, end + 1);
+    if (this->Options.Verbose)
+    {
+      std::cout << "fd " << this->FD << ": " << command << std::endl;
+    }
+
+    if (command.compare(0, 7, "STREAM ") == 0)
+    {
+      size_t first = command.find("--cmd=\"");
+      size_t last = (first == std::string::npos ? first : command.find('"', first + 7));
+      if (last == std::string::npos)
+      {
+        this->Queue(ErrorReply(0x01), this->Device.GetBaudRate());
+        continue;
+      }
+      this->StreamCommand = command.substr(first + 7, last - first - 7);
+      this->NextFrameTime = MonotonicNanoseconds();
+      this->Queue(AsciiReply("OKAY"), this->Device.GetBaudRate());
+    }
+    else if (command.compare(0, 8, "USTREAM ") == 0)
+    {
+      this->StreamCommand.clear();
+      this->Queue(AsciiReply("OKAY"), this->Device.GetBaudRate());
+    }
+    else
+    {
+      // the reply to COMM is sent before the rate changes
+      int baudRate = this->Device.GetBaudRate();
+      this->Queue(this->Device.Reply(command, false), baudRate);
+    }
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool SimulatorSession::Write()
+{
+  unsigned long long now = MonotonicNanoseconds();
+  if (!this->StreamCommand.empty() && now >= this->NextFrameTime)
+  {
+    this->Queue(this->Device.Reply(this->StreamCommand, true), this->Device.GetBaudRate());
+    this->NextFrameTime += (unsigned long long)(1e9 / this->Options.FrameRate);
+  }
+
+  std::string data;
+  while (!this->Output.empty() && this->Output.front().first <= now)
+  {
+    data += this->Output.front().second;
+    this->Output.pop_front();
+  }
+
+  size_t sent = 0;
+  while (sent < data.size())
+  {
+    ssize_t m = write(this->FD, data.data() + sent, data.size() - sent);
+    if (m < 0)
+    {
+      return false;
+    }
+    sent += m;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+int OpenServer(int port)
+{
+  int server = socket(AF_INET, SOCK_STREAM, 0);
+  int on = 1;
+  setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  if (bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(server, 1) < 0)
+  {
+    close(server);
+    return -1;
+  }
+  return server;
+}
+
+//----------------------------------------------------------------------------
+// Create a pseudo-terminal and link to it.  The slave side is kept open,
+// so that the master does not see a hangup each time a client closes it.
+int OpenTerminal(const char* link, int& slave)
+{
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0)
+  {
+    return -1;
+  }
+  const char* name = ptsname(master);
+  slave = open(name, O_RDWR | O_NOCTTY);
+  if (slave < 0)
+  {
+    close(master);
+    return -1;
+  }
+
+  // the replies must not be echoed back before a client sets raw mode
+  struct termios t;
+  tcgetattr(slave, &t);
+  cfmakeraw(&t);
+  tcsetattr(slave, TCSANOW, &t);
+
+  unlink(link);
+  if (symlink(name, link) < 0)
+  {
+    close(slave);
+    close(master);
+    return -1;
+  }
+  return master;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  SimulatorOptions options;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+    {
+      options.Port = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+    {
+      options.Link = argv[++i];
+    }
+    else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+    {
+      options.Tools = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+    {
+      options.Markers = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+    {
+      options.FrameRate = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+    {
+      options.Latency = strtoull(argv[++i], nullptr, 10) * 1000;
+    }
+    else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+    {
+      options.BitErrorRate = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+    {
+      options.MaxBaudRate = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-v") == 0)
+    {
+      options.Verbose = true;
+    }
+    else
+    {
+      std::cerr << "Usage: " << argv[0] << " [-p port] [-s link] [-t tools] [-m markers] [-r rate]"
+                << " [-l microseconds] [-e bit error rate] [-b baud] [-v]" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (options.Tools < 0 || options.Tools > 16 || options.Markers < 0 || options.Markers > 20 ||
+      options.FrameRate <= 0 || (options.Port == 0 && options.Link == nullptr))
+  {
+    std::cerr << "Invalid options" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  int server = -1;
+  if (options.Port != 0)
+  {
+    server = OpenServer(options.Port);
+    if (server < 0)
+    {
+      std::cerr << "Could not listen on port " << options.Port << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::cout << "Listening on localhost:" << options.Port << std::endl;
+  }
+
+  SimulatorSession* terminal = nullptr;
+  int slave = -1;
+  if (options.Link != nullptr)
+  {
+    int master = OpenTerminal(options.Link, slave);
+    if (master < 0)
+    {
+      std::cerr << "Could not create a pseudo-terminal at " << options.Link << std::endl;
+      return EXIT_FAILURE;
+    }
+    terminal = new SimulatorSession(options, master);
+    std::cout << "Serial device at " << options.Link << std::endl;
+  }
+
+  SimulatorSession* client = nullptr;
+  for (;;)
+  {
+    struct pollfd fds[3];
+    SimulatorSession* sessions[3] = { nullptr, nullptr, nullptr };
+    int n = 0;
+    if (server >= 0 && client == nullptr)
+    {
+      fds[n].fd = server;
+      fds[n].events = POLLIN;
+      n++;
+    }
+    if (client != nullptr)
+    {
+      sessions[n] = client;
+      fds[n].fd = client->GetFD();
+      fds[n].events = POLLIN;
+      n++;
+    }
+    if (terminal != nullptr)
+    {
+      sessions[n] = terminal;
+      fds[n].fd = terminal->GetFD();
+      fds[n].events = POLLIN;
+      n++;
+    }
+
+    // wake up for the next streamed frame or delayed reply
+    int timeout = -1;
+    unsigned long long now = MonotonicNanoseconds();
+    for (int i = 0; i < n; i++)
+    {
+      unsigned long long next = (sessions[i] ? sessions[i]->GetNextEventTime() : 0);
+      if (next != 0)
+      {
+        int t = (next > now ? (int)((next - now + 999999) / 1000000) : 0);
+        timeout = (timeout < 0 || t < timeout ? t : timeout);
+      }
+    }
+    if (poll(fds, n, timeout) < 0)
+    {
+      continue;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+      SimulatorSession* session = sessions[i];
+      if (session == nullptr)
+      {
+        if (fds[i].revents & POLLIN)
+        {
+          int fd = accept(server, nullptr, nullptr);
+          if (fd >= 0)
+          {
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            client = new SimulatorSession(options, fd);
+          }
+        }
+        continue;
+      }
+
+      bool okay = true;
+      if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+      {
+        okay = session->Read();
+      }
+      okay = okay && session->Write();
+      if (!okay && session == client)
+      {
+        close(client->GetFD());
+        delete client;
+        client = nullptr;
+      }
+    }
+  }
+}
@@ -0,0 +1,155 @@
+// Stream BX frames from a device and report the frame rate and latency.
+//
+// Usage: ndiStreamingExample <serial device | host:port> [seconds] [command]
+//
+// The program initializes and enables all tools, starts tracking, and
+// asks the device to stream the given command ("BX:0801" by default).
+// Frames are counted in the callback, and the time between frames is
+// measured from the timestamps that the streaming thread records.  The
+// device clock, as estimated from the frame numbers, is printed at the
+// end.  Run it against ndiSimulator to try streaming without a tracker.
+#include "ndiApplicationHelpers.h"
+#include <ndicapi.h>
+#include <ndicapi_thread.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <iostream>
+
+//----------------------------------------------------------------------------
+struct StreamStatistics
+{
+  std::atomic<unsigned long long> Frames;
+  std::atomic<unsigned long long> Errors;
+  std::atomic<int> LastError;
+  unsigned long long LastTimestamp;
+  unsigned long long MaxInterval;
+};
+
+//----------------------------------------------------------------------------
+// Called from the streaming thread for every frame.
+void FrameCallback(ndicapi*, const ndiFrame* frame, void* userdata)
+{
+  StreamStatistics* stats = static_cast<StreamStatistics*>(userdata);
+
+  if (frame->ErrorCode != NDI_OKAY)
+  {
+    stats->Errors++;
+    stats->LastError = frame->ErrorCode;
+    return;
+  }
+
+  if (stats->LastTimestamp != 0 && frame->Timestamp - stats->LastTimestamp > stats->MaxInterval)
+  {
+    stats->MaxInterval = frame->Timestamp - stats->LastTimestamp;
+  }
+  stats->LastTimestamp = frame->Timestamp;
+  stats->Frames++;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " <serial device | host:port> [seconds] [command]" << std::endl;
+    return EXIT_FAILURE;
+  }
+  double seconds = (argc > 2 ? atof(argv[2]) : 5.0);
+  const char* command = (argc > 3 ? argv[3] : "BX:0801");
+
+  ndicapi* device = OpenDevice(argv[1]);
+  if (device == nullptr)
+  {
+    std::cerr << "Could not open " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ndiCommand(device, "INIT:");
+  if (ndiGetError(device) != NDI_OKAY || !EnableTools(device))
+  {
+    std::cerr << "Error when initializing: " << ndiErrorString(ndiGetError(device)) << std::endl;
+    CloseDevice(device);
+    return EXIT_FAILURE;
+  }
+
+  ndiCommand(device, "TSTART:");
+  if (ndiGetError(device) != NDI_OKAY)
+  {
+    std::cerr << "Error when sending TSTART: " << ndiErrorString(ndiGetError(device)) << std::endl;
+    CloseDevice(device);
+    return EXIT_FAILURE;
+  }
+
+  StreamStatistics stats;
+  stats.Frames = 0;
+  stats.Errors = 0;
+  stats.LastError = NDI_OKAY;
+  stats.LastTimestamp = 0;
+  stats.MaxInterval = 0;
+
+  int errnum = ndiStartStreaming(device, command, FrameCallback, &stats);
+  if (errnum != NDI_OKAY)
+  {
+    std::cerr << "Could not start streaming: " << ndiErrorString(errnum) << std::endl;
+    CloseDevice(device);
+    return EXIT_FAILURE;
+  }
+
+  unsigned long long start = ndiTimeNanoseconds();
+  std::this_thread::sleep_for(std::chrono::milliseconds((int)(seconds * 1000)));
+  unsigned long long elapsed = ndiTimeNanoseconds() - start;
+
+  ndiFrame latest;
+  bool haveLatest = (ndiGetLatestFrame(device, &latest) == NDI_OKAY);
+
+  errnum = ndiStopStreaming(device);
+  if (errnum != NDI_OKAY)
+  {
+    std::cerr << "Error when stopping the stream: " << ndiErrorString(errnum) << std::endl;
+  }
+
+  printf("%llu frames in %.2f s (%.1f Hz), %llu errors, longest gap %.2f ms\n",
+         stats.Frames.load(), elapsed * 1e-9, stats.Frames * 1e9 / elapsed,
+         stats.Errors.load(), stats.MaxInterval * 1e-6);
+  if (stats.Errors > 0)
+  {
+    printf("last error: %s\n", ndiErrorString(stats.LastError));
+  }
+  if (haveLatest && latest.ErrorCode == NDI_OKAY)
+  {
+    printf("latest frame: %d handles", latest.HandleCount);
+    for (int i = 0; i < latest.HandleCount; i++)
+    {
+      printf(", handle %d at (%.1f, %.1f, %.1f)", latest.Handles[i], latest.Transforms[i][4],
+             latest.Transforms[i][5], latest.Transforms[i][6]);
+    }
+    printf("\n");
+  }
+
+  ndiClockModelInfo clock;
+  if (ndiGetClockModel(device, &clock) == NDI_OKAY)
+  {
+    printf("device clock: %.3f Hz, drift %.1f ppm, jitter %.1f us over %llu frames\n",
+           clock.FrameRate, clock.DriftPpm, clock.Jitter * 1e-3, clock.Samples);
+    if (haveLatest && latest.ErrorCode == NDI_OKAY && latest.HandleCount > 0)
+    {
+      unsigned long long sent;
+      if (ndiGetFrameHostTime(device, latest.FrameNumber[0], &sent) == NDI_OKAY)
+      {
+        printf("latest frame %lu was sent %.1f us before its first byte was received\n",
+               latest.FrameNumber[0], ((long long)latest.FirstByteTime - (long long)sent) * 1e-3);
+      }
+    }
+  }
+
+  ndiCommand(device, "TSTOP:");
+  CloseDevice(device);
+
+  return (stats.Frames > 0 && stats.Errors == 0 && errnum == NDI_OKAY ? EXIT_SUCCESS : EXIT_FAILURE);
+}
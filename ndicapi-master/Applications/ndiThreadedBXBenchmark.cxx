@@ -0,0 +1,135 @@
+// Compare BX throughput with and without the tracking thread.
+//
+// Usage: ndiThreadedBXBenchmark <serial device | host:port> [seconds]
+//
+// The program initializes and enables all tools, starts tracking, and
+// then sends BX commands for the given number of seconds, first directly
+// and then through the tracking thread.  Every BX reply contains binary
+// floats, so any reply that is truncated by the thread shows up as an
+// error.  The exit code is non-zero if the threaded run had errors.
+#include "ndiApplicationHelpers.h"
+#include <ndicapi.h>
+#include <ndicapi_thread.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <iostream>
+
+//----------------------------------------------------------------------------
+struct BenchmarkResult
+{
+  int Replies;
+  int Errors;
+  int LastError;
+  unsigned long long ThreadFrames;
+  double Seconds;
+};
+
+//----------------------------------------------------------------------------
+BenchmarkResult RunBX(ndicapi* device, double seconds)
+{
+  BenchmarkResult result = { 0, 0, NDI_OKAY, 0, 0.0 };
+  ndiFrame frame;
+  unsigned long long firstFrame = 0;
+
+  if (ndiGetLatestFrame(device, &frame) == NDI_OKAY)
+  {
+    firstFrame = frame.Sequence;
+  }
+
+  unsigned long long start = ndiTimeNanoseconds();
+  unsigned long long stop = start + (unsigned long long)(seconds * 1e9);
+  unsigned long long now = start;
+  while (now < stop)
+  {
+    ndiCommand(device, "BX:%04X", NDI_XFORMS_AND_STATUS);
+    int errnum = ndiGetError(device);
+    if (errnum != NDI_OKAY)
+    {
+      result.Errors++;
+      result.LastError = errnum;
+    }
+    result.Replies++;
+    now = ndiTimeNanoseconds();
+  }
+  result.Seconds = (now - start) * 1e-9;
+
+  if (ndiGetLatestFrame(device, &frame) == NDI_OKAY)
+  {
+    result.ThreadFrames = frame.Sequence - firstFrame;
+  }
+
+  return result;
+}
+
+//----------------------------------------------------------------------------
+void PrintResult(const char* label, const BenchmarkResult& result)
+{
+  printf("%-12s %8d replies %8.1f replies/s %6d errors", label, result.Replies,
+         result.Replies / result.Seconds, result.Errors);
+  if (result.ThreadFrames > 0)
+  {
+    printf(" %8.1f thread frames/s", result.ThreadFrames / result.Seconds);
+  }
+  if (result.Errors > 0)
+  {
+    printf(" (last error: %s)", ndiErrorString(result.LastError));
+  }
+  printf("\n");
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " <serial device | host:port> [seconds]" << std::endl;
+    return EXIT_FAILURE;
+  }
+  double seconds = (argc > 2 ? atof(argv[2]) : 5.0);
+
+  ndicapi* device = OpenDevice(argv[1]);
+  if (device == nullptr)
+  {
+    std::cerr << "Could not open " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ndiCommand(device, "INIT:");
+  if (ndiGetError(device) != NDI_OKAY)
+  {
+    std::cerr << "Error when sending INIT: " << ndiErrorString(ndiGetError(device)) << std::endl;
+    CloseDevice(device);
+    return EXIT_FAILURE;
+  }
+
+  if (!EnableTools(device))
+  {
+    std::cerr << "Error when enabling tools: " << ndiErrorString(ndiGetError(device)) << std::endl;
+    CloseDevice(device);
+    return EXIT_FAILURE;
+  }
+
+  ndiCommand(device, "TSTART:");
+  if (ndiGetError(device) != NDI_OKAY)
+  {
+    std::cerr << "Error when sending TSTART: " << ndiErrorString(ndiGetError(device)) << std::endl;
+    CloseDevice(device);
+    return EXIT_FAILURE;
+  }
+
+  BenchmarkResult direct = RunBX(device, seconds);
+  PrintResult("direct", direct);
+
+  ndiSetThreadMode(device, true);
+  BenchmarkResult threaded = RunBX(device, seconds);
+  ndiSetThreadMode(device, false);
+  PrintResult("threaded", threaded);
+
+  ndiCommand(device, "TSTOP:");
+  CloseDevice(device);
+
+  return (threaded.Errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
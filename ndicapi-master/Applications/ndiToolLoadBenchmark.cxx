@@ -0,0 +1,227 @@
+// Measure how long it takes to load tool definition files at each baud rate.
+//
+// Usage: ndiToolLoadBenchmark <serial device | host:port> <file.rom> [file.rom ...]
+//
+// For each baud rate, every ROM file is loaded with PHRQ, PVWR, PINIT
+// and PENA, first with blocking ndiCommand() calls and then through the
+// ndiCommandAsync() queue.  The handles are freed again with PHF after
+// each run.  For a network connection there is only one run, since the
+// baud rate does not apply.
+#include "ndiApplicationHelpers.h"
+#include <ndicapi.h>
+#include <ndicapi_thread.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <iostream>
+
+//----------------------------------------------------------------------------
+struct RomFile
+{
+  std::string Name;
+  unsigned char Data[1024];
+};
+
+//----------------------------------------------------------------------------
+bool ReadRomFile(const char* filename, RomFile& rom)
+{
+  FILE* file = fopen(filename, "rb");
+  if (file == nullptr)
+  {
+    return false;
+  }
+  memset(rom.Data, 0, sizeof(rom.Data));
+  fread(rom.Data, 1, sizeof(rom.Data), file);
+  bool okay = !ferror(file);
+  fclose(file);
+  rom.Name = filename;
+  return okay;
+}
+
+//----------------------------------------------------------------------------
+// Request a wireless port handle, returns zero on failure.
+int RequestHandle(ndicapi* device)
+{
+  ndiPHRQ(device, "********", "*", "1", "**", "**");
+  if (ndiGetError(device) != NDI_OKAY)
+  {
+    return 0;
+  }
+  return ndiGetPHRQHandle(device);
+}
+
+//----------------------------------------------------------------------------
+// The error to report when RequestHandle() fails.
+int RequestHandleError(ndicapi* device)
+{
+  return (ndiGetError(device) != NDI_OKAY ? ndiGetError(device) : NDI_INVALID_PORT);
+}
+
+//----------------------------------------------------------------------------
+// Load the ROM files one command at a time.
+int LoadBlocking(ndicapi* device, const std::vector<RomFile>& roms, std::vector<int>& handles)
+{
+  char hexdata[129];
+
+  for (size_t i = 0; i < roms.size(); i++)
+  {
+    int ph = RequestHandle(device);
+    if (ph == 0)
+    {
+      return RequestHandleError(device);
+    }
+    handles.push_back(ph);
+    for (int addr = 0; addr < 1024; addr += 64)
+    {
+      ndiPVWR(device, ph, addr, ndiHexEncode(hexdata, &roms[i].Data[addr], 64));
+      if (ndiGetError(device) != NDI_OKAY)
+      {
+        return ndiGetError(device);
+      }
+    }
+    ndiPINIT(device, ph);
+    ndiPENA(device, ph, NDI_DYNAMIC);
+    if (ndiGetError(device) != NDI_OKAY)
+    {
+      return ndiGetError(device);
+    }
+  }
+
+  return NDI_OKAY;
+}
+
+//----------------------------------------------------------------------------
+// Load the ROM files through the command queue, only PHRQ is waited for
+// because its reply is needed for the following commands.
+int LoadQueued(ndicapi* device, const std::vector<RomFile>& roms, std::vector<int>& handles)
+{
+  char hexdata[129];
+
+  for (size_t i = 0; i < roms.size(); i++)
+  {
+    int errnum = ndiWaitForCommands(device, 10000);
+    if (errnum != NDI_OKAY)
+    {
+      return errnum;
+    }
+    int ph = RequestHandle(device);
+    if (ph == 0)
+    {
+      return RequestHandleError(device);
+    }
+    handles.push_back(ph);
+    for (int addr = 0; addr < 1024; addr += 64)
+    {
+      ndiCommandAsync(device, nullptr, nullptr, "PVWR:%02X%04X%.128s", ph, addr,
+                      ndiHexEncode(hexdata, &roms[i].Data[addr], 64));
+    }
+    ndiCommandAsync(device, nullptr, nullptr, "PINIT:%02X", ph);
+    ndiCommandAsync(device, nullptr, nullptr, "PENA:%02X%c", ph, NDI_DYNAMIC);
+  }
+
+  return ndiWaitForCommands(device, 10000);
+}
+
+//----------------------------------------------------------------------------
+void FreeHandles(ndicapi* device, std::vector<int>& handles)
+{
+  for (size_t i = 0; i < handles.size(); i++)
+  {
+    ndiPHF(device, handles[i]);
+  }
+  handles.clear();
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  if (argc < 3)
+  {
+    std::cerr << "Usage: " << argv[0] << " <serial device | host:port> <file.rom> [file.rom ...]" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<RomFile> roms(argc - 2);
+  for (int i = 2; i < argc; i++)
+  {
+    if (!ReadRomFile(argv[i], roms[i - 2]))
+    {
+      std::cerr << "Could not read " << argv[i] << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  bool isNetwork = IsNetworkName(argv[1]);
+  ndicapi* device = OpenDevice(argv[1]);
+  if (device == nullptr)
+  {
+    std::cerr << "Could not open " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ndiCommand(device, "INIT:");
+  if (ndiGetError(device) != NDI_OKAY)
+  {
+    std::cerr << "Error when sending INIT: " << ndiErrorString(ndiGetError(device)) << std::endl;
+    CloseDevice(device);
+    return EXIT_FAILURE;
+  }
+
+  // the COMM baud rate codes, in the order that they are tested
+  static const char baudCodes[] = { '0', '1', '2', '3', '4', '5', 'A', '6', '7' };
+  static const char* baudNames[] = { "9600", "14400", "19200", "38400", "57600",
+                                     "115200", "230400", "921600", "1228739" };
+  int numberOfRates = (isNetwork ? 1 : (int)sizeof(baudCodes));
+  int result = EXIT_SUCCESS;
+
+  printf("%-10s %12s %12s\n", "baud", "blocking ms", "queued ms");
+  for (int i = 0; i < numberOfRates; i++)
+  {
+    const char* label = (isNetwork ? "network" : baudNames[i]);
+    if (!isNetwork)
+    {
+      ndiCommand(device, "COMM:%c0000", baudCodes[i]);
+      if (ndiGetError(device) != NDI_OKAY)
+      {
+        printf("%-10s %12s %12s\n", label, "n/a", "n/a");
+        continue;
+      }
+    }
+
+    std::vector<int> handles;
+    unsigned long long start = ndiTimeNanoseconds();
+    int errnum = LoadBlocking(device, roms, handles);
+    double blockingMs = (ndiTimeNanoseconds() - start) * 1e-6;
+    FreeHandles(device, handles);
+    if (errnum != NDI_OKAY)
+    {
+      std::cerr << label << ": " << ndiErrorString(errnum) << std::endl;
+      result = EXIT_FAILURE;
+      continue;
+    }
+
+    start = ndiTimeNanoseconds();
+    errnum = LoadQueued(device, roms, handles);
+    double queuedMs = (ndiTimeNanoseconds() - start) * 1e-6;
+    FreeHandles(device, handles);
+    if (errnum != NDI_OKAY)
+    {
+      std::cerr << label << ": " << ndiErrorString(errnum) << std::endl;
+      result = EXIT_FAILURE;
+      continue;
+    }
+
+    printf("%-10s %12.1f %12.1f\n", label, blockingMs, queuedMs);
+  }
+
+  if (!isNetwork)
+  {
+    ndiCommand(device, "COMM:00000");
+  }
+  CloseDevice(device);
+
+  return result;
+}
@@ -0,0 +1,1216 @@
+// Microbenchmarks for the ndicapi parsers and conversions.
+//
+// Usage: ndicapi_bench [-t seconds] [-f filter] [capture file ...]
+//
+// Each benchmark is run for the given time (0.2 seconds by default) and
+// reported as nanoseconds per operation, the throughput in bytes of input
+// per second, the number of heap allocations per operation, and the number
+// of cache misses per operation if the hardware counters can be read (on
+// Linux, through perf_event_open(), otherwise "-" is shown).  For the
+// reply helpers, one operation is one complete frame that is parsed with
+// ndiParseReply(), so the time is the time per frame.  The PHSR, TX and
+// BX replies are generated for 1, 8 and 64 handles, and GX for its 1, 3
+// and 12 ports.  The "stored" column shows how many handles the helper
+// kept, and a reply that is rejected is reported with its error.  The GX,
+// TX and BX replies in any capture files that are given on the command
+// line (see ndiStartCapture()) are benchmarked as well, and each capture
+// file is also replayed once through ndiCommand(), as for a device name of
+// the form "capture:<file>?speed=0".  Only benchmarks whose names contain
+// the filter are run.
+//
+// The vectorized decoders (see ndiSetDecoder()) are compared with the
+// scalar decoder: each one is first checked against ndiSignedToLong()
+// and ndiHexToUnsignedLong() on random fields, some of them malformed,
+// and then benchmarked on transforms, strays and complete replies.
+//
+// The batch math methods (see ndiSetMathKernel()) are checked against
+// ndiTransformToMatrixd(), ndiTransformToMatrixf() and ndiRelativeTransform()
+// on random transforms, and then compared with calling those functions in
+// a loop, for 8, 64 and 512 transforms.
+//
+// The memory that a parser uses is shown after it parsed each kind of
+// reply, and the parsers are benchmarked as a group of 1024 that are
+// used in turn, as for many devices or many streams, so that their reply
+// data does not stay in the cache.
+#include <ndicapi.h>
+#include <ndicapi_capture.h>
+#include <ndicapi_decode.h>
+#include <ndicapi_math.h>
+#include <ndicapi_thread.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <iostream>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//----------------------------------------------------------------------------
+// Count the heap allocations.  With glibc, malloc() itself is replaced so
+// that the allocations within ndicapi are counted too, along with the
+// number of bytes that are in use, otherwise only operator new is counted.
+static std::atomic<unsigned long long> AllocationCount(0);
+static std::atomic<long long> HeapBytes(0);
+
+#if defined(__GLIBC__)
+extern "C"
+{
+  extern void* __libc_malloc(size_t size);
+  extern void* __libc_calloc(size_t count, size_t size);
+  extern void* __libc_realloc(void* pointer, size_t size);
+  extern void __libc_free(void* pointer);
+
+  void* malloc(size_t size)
+  {
+    AllocationCount++;
+    void* pointer = __libc_malloc(size);
+    HeapBytes += (long long)malloc_usable_size(pointer);
+    return pointer;
+  }
+
+  void* calloc(size_t count, size_t size)
+  {
+    AllocationCount++;
+    void* pointer = __libc_calloc(count, size);
+    HeapBytes += (long long)malloc_usable_size(pointer);
+    return pointer;
+  }
+
+  void* realloc(void* pointer, size_t size)
+  {
+    AllocationCount++;
+    long long oldSize = (long long)malloc_usable_size(pointer);
+    void* resized = __libc_realloc(pointer, size);
+    if (resized != nullptr || size == 0)
+    {
+      HeapBytes += (long long)malloc_usable_size(resized) - oldSize;
+    }
+    return resized;
+  }
+
+  void free(void* pointer)
+  {
+    HeapBytes -= (long long)malloc_usable_size(pointer);
+    __libc_free(pointer);
+  }
+}
+#else
+void* operator new(size_t size)
+{
+  AllocationCount++;
+  void* pointer = malloc(size ? size : 1);
+  if (pointer == nullptr)
+  {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void operator delete(void* pointer) noexcept
+{
+  free(pointer);
+}
+#endif
+
+//----------------------------------------------------------------------------
+// Keep the compiler from optimizing away a result.
+static volatile unsigned long long Sink;
+
+//----------------------------------------------------------------------------
+// A hardware counter for the cache misses of this thread, or -1 if the
+// counters are not available (e.g. in most virtual machines).
+static int CacheMissCounter = -1;
+
+void OpenCacheMissCounter()
+{
+#if defined(__linux__)
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_CACHE_MISSES;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  CacheMissCounter = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+unsigned long long ReadCacheMissCounter()
+{
+  unsigned long long count = 0;
+#if defined(__linux__)
+  if (CacheMissCounter >= 0 && read(CacheMissCounter, &count, sizeof(count)) != sizeof(count))
+  {
+    count = 0;
+  }
+#endif
+  return count;
+}
+
+//----------------------------------------------------------------------------
+struct BenchmarkOptions
+{
+  double Seconds;
+  const char* Filter;
+};
+
+//----------------------------------------------------------------------------
+// Run 'function' repeatedly for the requested time and print the results.
+// The function is called with the number of operations to do.
+template <typename Function>
+void Run(const BenchmarkOptions& options, const std::string& name, size_t bytesPerOperation,
+         const char* note, Function function)
+{
+  if (options.Filter != nullptr && name.find(options.Filter) == std::string::npos)
+  {
+    return;
+  }
+
+  // warm up, and find a batch size that takes about a millisecond
+  unsigned long long batch = 1;
+  for (;;)
+  {
+    unsigned long long start = ndiTimeNanoseconds();
+    function(batch);
+    if (ndiTimeNanoseconds() - start > 1000000 || batch >= (1ULL << 30))
+    {
+      break;
+    }
+    batch *= 2;
+  }
+
+  unsigned long long operations = 0;
+  unsigned long long allocations = AllocationCount;
+  unsigned long long misses = ReadCacheMissCounter();
+  unsigned long long limit = (unsigned long long)(options.Seconds * 1e9);
+  unsigned long long start = ndiTimeNanoseconds();
+  unsigned long long elapsed;
+  do
+  {
+    function(batch);
+    operations += batch;
+    elapsed = ndiTimeNanoseconds() - start;
+  }
+  while (elapsed < limit);
+  allocations = AllocationCount - allocations;
+  misses = ReadCacheMissCounter() - misses;
+
+  char missText[32] = "-";
+  if (CacheMissCounter >= 0)
+  {
+    snprintf(missText, sizeof(missText), "%.2f", (double)misses / operations);
+  }
+
+  double nanoseconds = (double)elapsed / operations;
+  printf("%-36s %12.1f %10.1f %10.3f %10s  %s\n", name.c_str(), nanoseconds,
+         bytesPerOperation * 1e3 / nanoseconds, (double)allocations / operations, missText, note);
+}
+
+//----------------------------------------------------------------------------
+// Generators for replies in the format that the device sends.
+std::string AsciiReply(const std::string& text)
+{
+  char crc[8];
+  snprintf(crc, sizeof(crc), "%04X\r", ndiCRC16(0, text.data(), (int)text.size()));
+  return text + crc;
+}
+
+//----------------------------------------------------------------------------
+void AppendShort(std::string& data, unsigned short value)
+{
+  data.push_back((char)(value & 0xff));
+  data.push_back((char)(value >> 8));
+}
+
+//----------------------------------------------------------------------------
+void AppendLong(std::string& data, unsigned int value)
+{
+  AppendShort(data, (unsigned short)(value & 0xffff));
+  AppendShort(data, (unsigned short)(value >> 16));
+}
+
+//----------------------------------------------------------------------------
+void AppendFloat(std::string& data, float value)
+{
+  unsigned int bits;
+  memcpy(&bits, &value, sizeof(bits));
+  AppendLong(data, bits);
+}
+
+//----------------------------------------------------------------------------
+// A TX reply for mode 0x0001 or 0x1001, with the given number of handles
+// and of passive stray markers.
+std::string TXReply(int handles, int strays)
+{
+  char text[128];
+  snprintf(text, sizeof(text), "%02X", handles);
+  std::string reply = text;
+  for (int i = 0; i < handles; i++)
+  {
+    snprintf(text, sizeof(text), "%02X%+06d%+06d%+06d%+06d%+07d%+07d%+07d%+06d%08X%08X\n",
+             i + 1, 10000 - i, -123 * i, 456, -789, 12345 + i, -23456, 345678 - i, 123,
+             0x31, 0x1000 + i);
+    reply += text;
+  }
+  if (strays >= 0)
+  {
+    snprintf(text, sizeof(text), "%02X", strays);
+    reply += text;
+    reply += std::string((strays + 3) / 4, '0');
+    for (int i = 0; i < strays; i++)
+    {
+      snprintf(text, sizeof(text), "%+07d%+07d%+07d", 1000 * i, -2000 - i, 300000 + 7 * i);
+      reply += text;
+    }
+  }
+  reply += "0000";
+  return AsciiReply(reply);
+}
+
+//----------------------------------------------------------------------------
+// A BX reply for mode 0x0001, or for mode 0x1009 if 'markers' is not
+// negative, with the given number of handles, markers per tool and
+// passive stray markers.
+std::string BXReply(int handles, int markers, int strays)
+{
+  std::string payload;
+  payload.push_back((char)handles);
+  for (int i = 0; i < handles; i++)
+  {
+    payload.push_back((char)(i + 1));
+    payload.push_back((char)0x01);        // valid
+    float pose[8] = { 1.0f, 0.0f, 0.0f, 0.0f, 12.5f + i, -23.25f, -1500.0f, 0.125f };
+    for (int j = 0; j < 8; j++)
+    {
+      AppendFloat(payload, pose[j]);
+    }
+    AppendLong(payload, 0x31);
+    AppendLong(payload, 0x1000 + i);
+    if (markers >= 0)
+    {
+      payload.push_back((char)markers);
+      payload.append((markers + 7) / 8, (char)0);
+      for (int j = 0; j < 3 * markers; j++)
+      {
+        AppendFloat(payload, 10.0f * j);
+      }
+    }
+  }
+  if (markers >= 0)
+  {
+    payload.push_back((char)strays);
+    payload.append((strays + 7) / 8, (char)0);
+    for (int j = 0; j < 3 * strays; j++)
+    {
+      AppendFloat(payload, -5.0f * j);
+    }
+  }
+  AppendShort(payload, 0);                // system status
+
+  std::string reply;
+  AppendShort(reply, 0xA5C4);
+  AppendShort(reply, (unsigned short)payload.size());
+  AppendShort(reply, ndiCRC16(0, reply.data(), (int)reply.size()));
+  reply += payload;
+  AppendShort(reply, ndiCRC16(0, payload.data(), (int)payload.size()));
+  return reply;
+}
+
+//----------------------------------------------------------------------------
+// A GX reply for mode 0x0009 (three active ports) or 0xA009 (plus nine
+// passive ports), with the given number of occupied ports.
+std::string GXReply(int ports)
+{
+  char text[128];
+  std::string reply;
+  int groups = (ports > 3 ? 4 : 1);
+  for (int k = 0; k < groups; k++)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      if (3 * k + i < ports)
+      {
+        snprintf(text, sizeof(text), "%+06d%+06d%+06d%+06d%+07d%+07d%+07d%+06d\n",
+                 10000, -123 * i, 456, -789, 12345 + i, -23456, 345678 - i, 123);
+        reply += text;
+      }
+      else
+      {
+        reply += "UNOCCUPIED\n";
+      }
+    }
+    reply += "00313131\n";
+    if (k == 0)
+    {
+      reply += "000010000000100000001000\n";   // frame numbers of the active ports
+    }
+  }
+  if (groups > 1)
+  {
+    for (int i = 0; i < 9; i++)
+    {
+      reply += "00001000";
+    }
+    reply += "\n";
+  }
+  return AsciiReply(reply);
+}
+
+//----------------------------------------------------------------------------
+// A PHSR reply with the given number of handles.
+std::string PHSRReply(int handles)
+{
+  char text[16];
+  snprintf(text, sizeof(text), "%02X", handles);
+  std::string reply = text;
+  for (int i = 0; i < handles; i++)
+  {
+    snprintf(text, sizeof(text), "%02X%03X", i + 1, 0x031);
+    reply += text;
+  }
+  return AsciiReply(reply);
+}
+
+//----------------------------------------------------------------------------
+// Parse a reply over and over.
+void RunReply(const BenchmarkOptions& options, ndicapi* parser, const std::string& name,
+              const char* command, const std::string& reply, int (*getCount)(ndicapi*))
+{
+  // check the reply once, so that the benchmark doesn't measure errors
+  ndiParseReply(parser, command, reply.data(), (int)reply.size());
+  if (ndiGetError(parser) != NDI_OKAY)
+  {
+    printf("%-36s %s (%d byte reply)\n", name.c_str(), ndiErrorString(ndiGetError(parser)),
+           (int)reply.size());
+    return;
+  }
+  char note[64] = "";
+  if (getCount)
+  {
+    snprintf(note, sizeof(note), "stored %d", getCount(parser));
+  }
+
+  Run(options, name, reply.size(), note, [&](unsigned long long n)
+  {
+    for (unsigned long long i = 0; i < n; i++)
+    {
+      ndiParseReply(parser, command, reply.data(), (int)reply.size());
+    }
+  });
+}
+
+//----------------------------------------------------------------------------
+// Check a decoder against ndiSignedToLong() and ndiHexToUnsignedLong() on
+// random signed fields and random hex fields, where one character in 64 is
+// replaced by a random character.  Returns the number of fields that were
+// decoded differently.
+int CheckDecoder(int decoder)
+{
+  const char hexDigits[] = "0123456789abcdefABCDEF";
+  const char junk[] = "+-09afAFgG :\0\n";
+  std::vector<char> text(8 * 150);
+  std::vector<long> values(150);
+  std::vector<unsigned long> hexValues(150);
+  double transform[8];
+  int mismatches = 0;
+  unsigned int seed = 12345;
+
+  ndiSetDecoder(decoder);
+  for (int trial = 0; trial < 2000; trial++)
+  {
+    int width = 2 + trial % 7;
+    int count = 1 + (trial * 7) % 150;
+    for (int i = 0; i < count * width; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      if (trial % 2 != 0)
+      {
+        text[i] = hexDigits[(seed >> 16) % (sizeof(hexDigits) - 1)];
+      }
+      else if (i % width == 0)
+      {
+        text[i] = ((seed >> 16) & 1) ? '-' : '+';
+      }
+      else
+      {
+        text[i] = (char)('0' + (seed >> 16) % 10);
+      }
+      if (((seed >> 8) & 63) == 0)
+      {
+        text[i] = junk[(seed >> 20) % (sizeof(junk) - 1)];
+      }
+    }
+
+    ndiSignedToLongArray(text.data(), width, count, values.data());
+    for (int i = 0; i < count; i++)
+    {
+      mismatches += (values[i] != ndiSignedToLong(&text[i * width], width));
+    }
+
+    ndiHexToUnsignedLongArray(text.data(), width, count, hexValues.data());
+    for (int i = 0; i < count; i++)
+    {
+      mismatches += (hexValues[i] != ndiHexToUnsignedLong(&text[i * width], width));
+    }
+
+    if (count * width >= 51)
+    {
+      static const int fieldOffset[9] = { 0, 6, 12, 18, 24, 31, 38, 45, 51 };
+      ndiTransformToDouble(text.data(), transform);
+      for (int i = 0; i < 8; i++)
+      {
+        long value = ndiSignedToLong(&text[fieldOffset[i]], fieldOffset[i + 1] - fieldOffset[i]);
+        mismatches += (transform[i] != value * (i < 4 || i == 7 ? 0.0001 : 0.01));
+      }
+    }
+  }
+
+  return mismatches;
+}
+
+//----------------------------------------------------------------------------
+// Benchmark the decoding with the given decoder.
+void RunDecoder(const BenchmarkOptions& options, ndicapi* parser, int decoder)
+{
+  std::string suffix = std::string("/") + ndiDecoderName(decoder);
+  ndiSetDecoder(decoder);
+
+  const char* transformText = "+05000-05000+05000-05000+012345-023456+345678+00123";
+  Run(options, "ndiTransformToDouble" + suffix, 51, "", [&](unsigned long long n)
+  {
+    double transform[8];
+    double sum = 0;
+    for (unsigned long long i = 0; i < n; i++)
+    {
+      ndiTransformToDouble(transformText, transform);
+      sum += transform[6];
+    }
+    Sink = (unsigned long long)sum;
+  });
+
+  // the passive strays of a TX reply, 50 markers of 3 fields each
+  std::string strays;
+  char field[32];
+  for (int i = 0; i < 50; i++)
+  {
+    snprintf(field, sizeof(field), "%+07d%+07d%+07d", 1000 * i, -2000 - i, 300000 + 7 * i);
+    strays += field;
+  }
+  Run(options, "ndiSignedToLongArray/7x150" + suffix, strays.size(), "", [&](unsigned long long n)
+  {
+    long values[150];
+    long long sum = 0;
+    for (unsigned long long i = 0; i < n; i++)
+    {
+      ndiSignedToLongArray(strays.data(), 7, 150, values);
+      sum += values[149];
+    }
+    Sink = sum;
+  });
+
+  const char* hex = "0001A5C4";
+  Run(options, "ndiHexToUnsignedLongArray/8" + suffix, 8, "", [&](unsigned long long n)
+  {
+    unsigned long value;
+    unsigned long long sum = 0;
+    for (unsigned long long i = 0; i < n; i++)
+    {
+      ndiHexToUnsignedLongArray(hex, 8, 1, &value);
+      sum += value;
+    }
+    Sink = sum;
+  });
+
+  RunReply(options, parser, "ndiTXHelper/8" + suffix, "TX:0001", TXReply(8, -1), nullptr);
+  RunReply(options, parser, "ndiGXHelper/12" + suffix, "GX:A009", GXReply(12), nullptr);
+
+  std::string reply = TXReply(8, 50);
+  ndiParseReply(parser, "TX:1001", reply.data(), (int)reply.size());
+  Run(options, "ndiGetTXPassiveStrays/50" + suffix, 50 * 21, "", [&](unsigned long long n)
+  {
+    double coords[50][3];
+    double sum = 0;
+    for (unsigned long long i = 0; i < n; i++)
+    {
+      sum += ndiGetTXPassiveStrays(parser, coords, 50);
+      sum += coords[49][2];
+    }
+    Sink = (unsigned long long)sum;
+  });
+}
+
+//----------------------------------------------------------------------------
+// Make 'n' random transforms with unit quaternions, as a tracker reports them.
+std::vector<double> RandomTransforms(int n)
+{
+  std::vector<double> transforms(8 * n);
+  unsigned int seed = 54321;
+  for (int i = 0; i < n; i++)
+  {
+    double* t = &transforms[8 * i];
+    double norm = 0;
+    for (int j = 0; j < 7; j++)
+    {
+      seed = seed * 1103515245 + 12345;
+      t[j] = ((seed >> 8) & 0xFFFF) / 32768.0 - 1.0;
+      norm += (j < 4 ? t[j] * t[j] : 0.0);
+    }
+    norm = sqrt(norm);
+    for (int j = 0; j < 4; j++)
+    {
+      t[j] /= norm;
+    }
+    for (int j = 4; j < 7; j++)
+    {
+      t[j] *= 1000.0;
+    }
+    t[7] = 0.1;
+  }
+  return transforms;
+}
+
+//----------------------------------------------------------------------------
+// Count the values that differ by more than the tolerance.
+template <typename T, typename U>
+int CountMismatches(const T* a, const U* b, size_t n, double tolerance)
+{
+  int mismatches = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    mismatches += (fabs((double)a[i] - (double)b[i]) > tolerance * (1.0 + fabs((double)b[i])));
+  }
+  return mismatches;
+}
+
+//----------------------------------------------------------------------------
+// Check the batch math methods against the scalar functions, for every
+// count of transforms up to 40 so that every tail length is covered.
+// Returns the number of values that differ.  The results are expected to
+// be identical, but a compiler may fuse the multiplies and adds of the
+// scalar functions, so a small tolerance is allowed.
+int CheckMathKernel(int kernel)
+{
+  int mismatches = 0;
+
+  ndiSetMathKernel(kernel);
+  for (int n = 1; n <= 40; n++)
+  {
+    std::vector<double> transforms = RandomTransforms(n + 1);
+    const double (*aos)[8] = reinterpret_cast<const double (*)[8]>(transforms.data());
+    const double* ref = &transforms[8 * n];
+    std::vector<double> array(8 * n);
+    std::vector<float> arrayf(8 * n);
+    std::vector<double> matrices(16 * n);
+    std::vector<float> matricesf(16 * n);
+    std::vector<double> relative(8 * n);
+    std::vector<float> relativef(8 * n);
+    double (*back)[8] = reinterpret_cast<double (*)[8]>(relative.data());
+    float reff[8];
+    for (int j = 0; j < 8; j++)
+    {
+      reff[j] = (float)ref[j];
+    }
+
+    ndiTransformsToArrayd(aos, n, array.data());
+    ndiTransformsToArrayf(aos, n, arrayf.data());
+    ndiTransformArrayToMatrixd(array.data(), n, reinterpret_cast<double (*)[16]>(matrices.data()));
+    ndiTransformArrayToMatrixf(arrayf.data(), n, reinterpret_cast<float (*)[16]>(matricesf.data()));
+    ndiRelativeTransformArrayf(arrayf.data(), n, reff, relativef.data());
+    ndiRelativeTransformArrayd(array.data(), n, ref, array.data());
+    ndiArrayToTransformsd(array.data(), n, back);
+
+    for (int i = 0; i < n; i++)
+    {
+      double matrix[16];
+      float matrixf[16];
+      float transf[8];
+      double trans[8];
+      for (int j = 0; j < 8; j++)
+      {
+        transf[j] = (float)aos[i][j];
+      }
+      ndiTransformToMatrixd(aos[i], matrix);
+      ndiTransformToMatrixf(transf, matrixf);
+      ndiRelativeTransform(aos[i], ref, trans);
+      mismatches += CountMismatches(&matrices[16 * i], matrix, 16, 1e-12);
+      mismatches += CountMismatches(&matricesf[16 * i], matrixf, 16, 1e-5);
+      mismatches += CountMismatches(back[i], trans, 8, 1e-12);
+      for (int j = 0; j < 8; j++)
+      {
+        mismatches += CountMismatches(&relativef[j * n + i], &trans[j], 1, 1e-4);
+      }
+    }
+  }
+
+  return mismatches;
+}
+
+//----------------------------------------------------------------------------
+// Benchmark the scalar functions in a loop, and the batch methods with
+// the given kernel.
+void RunMathKernel(const BenchmarkOptions& options, int kernel, bool scalarLoops)
+{
+  std::string suffix = std::string("/") + ndiMathKernelName(kernel);
+  ndiSetMathKernel(kernel);
+
+  const int counts[3] = { 8, 64, 512 };
+  for (int k = 0; k < 3; k++)
+  {
+    int n = counts[k];
+    std::string size = "/" + std::to_string(n);
+    std::vector<double> transforms = RandomTransforms(n + 1);
+    const double (*aos)[8] = reinterpret_cast<const double (*)[8]>(transforms.data());
+    const double* ref = &transforms[8 * n];
+    std::vector<float> aosf(transforms.begin(), transforms.end());
+    const float (*aosFloat)[8] = reinterpret_cast<const float (*)[8]>(aosf.data());
+    std::vector<double> array(8 * n);
+    std::vector<float> arrayf(8 * n);
+    std::vector<double> result(8 * n);
+    std::vector<float> resultf(8 * n);
+    std::vector<double> matrices(16 * n);
+    std::vector<float> matricesf(16 * n);
+    double (*m)[16] = reinterpret_cast<double (*)[16]>(matrices.data());
+    float (*mf)[16] = reinterpret_cast<float (*)[16]>(matricesf.data());
+    float reff[8];
+    for (int j = 0; j < 8; j++)
+    {
+      reff[j] = (float)ref[j];
+    }
+    ndiTransformsToArrayd(aos, n, array.data());
+    ndiTransformsToArrayf(aos, n, arrayf.data());
+
+    if (scalarLoops)
+    {
+      Run(options, "ndiTransformToMatrixd/loop" + size, n * 64, "", [&](unsigned long long count)
+      {
+        for (unsigned long long i = 0; i < count; i++)
+        {
+          for (int j = 0; j < n; j++)
+          {
+            ndiTransformToMatrixd(aos[j], m[j]);
+          }
+        }
+        Sink = (unsigned long long)m[n - 1][12];
+      });
+      Run(options, "ndiTransformToMatrixf/loop" + size, n * 32, "", [&](unsigned long long count)
+      {
+        for (unsigned long long i = 0; i < count; i++)
+        {
+          for (int j = 0; j < n; j++)
+          {
+            ndiTransformToMatrixf(aosFloat[j], mf[j]);
+          }
+        }
+        Sink = (unsigned long long)mf[n - 1][12];
+      });
+      Run(options, "ndiRelativeTransform/loop" + size, n * 64, "", [&](unsigned long long count)
+      {
+        double (*out)[8] = reinterpret_cast<double (*)[8]>(result.data());
+        for (unsigned long long i = 0; i < count; i++)
+        {
+          for (int j = 0; j < n; j++)
+          {
+            ndiRelativeTransform(aos[j], ref, out[j]);
+          }
+        }
+        Sink = (unsigned long long)out[n - 1][4];
+      });
+    }
+
+    Run(options, "ndiTransformArrayToMatrixd" + size + suffix, n * 64, "", [&](unsigned long long count)
+    {
+      for (unsigned long long i = 0; i < count; i++)
+      {
+        ndiTransformArrayToMatrixd(array.data(), n, m);
+      }
+      Sink = (unsigned long long)m[n - 1][12];
+    });
+    Run(options, "ndiTransformArrayToMatrixf" + size + suffix, n * 32, "", [&](unsigned long long count)
+    {
+      for (unsigned long long i = 0; i < count; i++)
+      {
+        ndiTransformArrayToMatrixf(arrayf.data(), n, mf);
+      }
+      Sink = (unsigned long long)mf[n - 1][12];
+    });
+    Run(options, "ndiRelativeTransformArrayd" + size + suffix, n * 64, "", [&](unsigned long long count)
+    {
+      for (unsigned long long i = 0; i < count; i++)
+      {
+        ndiRelativeTransformArrayd(array.data(), n, ref, result.data());
+      }
+      Sink = (unsigned long long)result[4 * n];
+    });
+    Run(options, "ndiRelativeTransformArrayf" + size + suffix, n * 32, "", [&](unsigned long long count)
+    {
+      for (unsigned long long i = 0; i < count; i++)
+      {
+        ndiRelativeTransformArrayf(arrayf.data(), n, reff, resultf.data());
+      }
+      Sink = (unsigned long long)resultf[4 * n];
+    });
+  }
+}
+
+//----------------------------------------------------------------------------
+int GetTXCount(ndicapi* pol)
+{
+  return pol->TxHandleCount;
+}
+
+int GetBXCount(ndicapi* pol)
+{
+  return pol->BxHandleCount;
+}
+
+int GetPHSRCount(ndicapi* pol)
+{
+  return ndiGetPHSRNumberOfHandles(pol);
+}
+
+//----------------------------------------------------------------------------
+// Benchmark the GX, TX and BX replies in a capture file, grouped by
+// the command that they were a reply to (including its CRC).
+void RunCapture(const BenchmarkOptions& options, ndicapi* parser, const char* filename)
+{
+  ndiCaptureReader* reader = ndiCaptureOpen(filename);
+  if (reader == nullptr)
+  {
+    std::cerr << "Could not open " << filename << std::endl;
+    return;
+  }
+
+  std::vector<std::string> commands;
+  std::vector<std::vector<ndiCaptureRecord> > replies;
+  std::string command;
+  ndiCaptureRecord record;
+  long long n = ndiCaptureGetNumberOfRecords(reader);
+  for (long long i = 0; i < n; i++)
+  {
+    ndiCaptureGetRecord(reader, i, &record);
+    if (record.Direction == NDI_CAPTURE_COMMAND)
+    {
+      command.assign(record.Data, record.Length);
+      continue;
+    }
+    if (command.size() < 3 || (command[2] != ':' && command[2] != ' ') ||
+        (command.compare(0, 2, "GX") != 0 && command.compare(0, 2, "TX") != 0 &&
+         command.compare(0, 2, "BX") != 0))
+    {
+      continue;
+    }
+    size_t j = 0;
+    while (j < commands.size() && commands[j] != command)
+    {
+      j++;
+    }
+    if (j == commands.size())
+    {
+      commands.push_back(command);
+      replies.push_back(std::vector<ndiCaptureRecord>());
+    }
+    replies[j].push_back(record);
+  }
+
+  for (size_t j = 0; j < commands.size(); j++)
+  {
+    const std::vector<ndiCaptureRecord>& records = replies[j];
+    const char* text = commands[j].c_str();
+    size_t bytes = 0;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+      bytes += records[i].Length;
+    }
+    std::string name = "capture " + commands[j].substr(0, commands[j].size() - 1);
+    char note[64];
+    snprintf(note, sizeof(note), "%d replies", (int)records.size());
+    size_t next = 0;
+    Run(options, name, bytes / records.size(), note, [&](unsigned long long count)
+    {
+      for (unsigned long long i = 0; i < count; i++)
+      {
+        const ndiCaptureRecord& r = records[next];
+        ndiParseReply(parser, text, r.Data, r.Length);
+        next = (next + 1 < records.size() ? next + 1 : 0);
+      }
+    });
+  }
+
+  ndiCaptureClose(reader);
+}
+
+//----------------------------------------------------------------------------
+// Replay a capture file as fast as possible (see ndiReplayCreate()), and
+// send it the recorded commands with ndiCommand().  This measures the
+// whole round trip through the socket and the parser, but it can only be
+// done once per file, so it is timed as a single run.
+void RunReplay(const BenchmarkOptions& options, const char* filename)
+{
+  std::string name = std::string("replay ") + filename;
+  if (options.Filter != nullptr && name.find(options.Filter) == std::string::npos)
+  {
+    return;
+  }
+
+  ndiCaptureReader* reader = ndiCaptureOpen(filename);
+  if (reader == nullptr)
+  {
+    std::cerr << "Could not open " << filename << std::endl;
+    return;
+  }
+
+  // the commands without their CRC and carriage return, which ndiCommand()
+  // adds again
+  std::vector<std::string> commands;
+  size_t bytes = 0;
+  ndiCaptureRecord record;
+  long long n = ndiCaptureGetNumberOfRecords(reader);
+  for (long long i = 0; i < n; i++)
+  {
+    ndiCaptureGetRecord(reader, i, &record);
+    if (record.Direction == NDI_CAPTURE_COMMAND && record.Length > 5)
+    {
+      commands.push_back(std::string(record.Data, record.Length - 5));
+    }
+    else if (record.Direction != NDI_CAPTURE_COMMAND)
+    {
+      bytes += record.Length;
+    }
+  }
+  ndiCaptureClose(reader);
+
+  std::string device = std::string("capture:") + filename + "?speed=0";
+  ndicapi* pol = ndiOpenSerial(device.c_str());
+  if (pol == nullptr || commands.empty())
+  {
+    std::cerr << "Could not replay " << filename << std::endl;
+    if (pol != nullptr)
+    {
+      ndiCloseSerial(pol);
+    }
+    return;
+  }
+
+  int errors = 0;
+  unsigned long long allocations = AllocationCount;
+  unsigned long long start = ndiTimeNanoseconds();
+  for (size_t i = 0; i < commands.size(); i++)
+  {
+    ndiCommand(pol, "%s", commands[i].c_str());
+    if (ndiGetError(pol) != NDI_OKAY)
+    {
+      errors++;
+    }
+  }
+  unsigned long long elapsed = ndiTimeNanoseconds() - start;
+  allocations = AllocationCount - allocations;
+  ndiCloseSerial(pol);
+
+  double nanoseconds = (double)elapsed / commands.size();
+  printf("%-36s %12.1f %10.1f %10.3f %10s  %d commands, %d errors\n", name.c_str(), nanoseconds,
+         bytes * 1e3 / elapsed, (double)allocations / commands.size(), "-", (int)commands.size(), errors);
+}
+
+//----------------------------------------------------------------------------
+// Show how much memory a parser uses: the ndicapi structure, the buffers
+// that ndiOpenOffline() allocates, and the reply data that is allocated
+// when the reply is parsed.
+void ShowMemory(const std::string& name, const char* command, const std::string& reply)
+{
+  long long start = HeapBytes;
+  ndicapi* parser = ndiOpenOffline();
+  long long opened = HeapBytes;
+  ndiParseReply(parser, command, reply.data(), (int)reply.size());
+  long long parsed = HeapBytes;
+  ndiCloseNetwork(parser);
+
+  printf("%-36s %10d %10lld %10lld\n", name.c_str(), (int)sizeof(ndicapi), opened - start, parsed - opened);
+}
+
+//----------------------------------------------------------------------------
+// Parse a reply with each of 'count' parsers in turn, and then read the
+// transforms back from each of them in turn.
+void RunRotation(const BenchmarkOptions& options, const std::string& name, const char* command,
+                 const std::string& reply, int handles, int count)
+{
+  std::vector<ndicapi*> parsers(count);
+  for (int i = 0; i < count; i++)
+  {
+    parsers[i] = ndiOpenOffline();
+    ndiParseReply(parsers[i], command, reply.data(), (int)reply.size());
+  }
+  bool isBinary = (command[0] == 'B');
+  std::string suffix = " x" + std::to_string(count);
+
+  int next = 0;
+  Run(options, name + suffix, reply.size(), "", [&](unsigned long long n)
+  {
+    for (unsigned long long i = 0; i < n; i++)
+    {
+      ndiParseReply(parsers[next], command, reply.data(), (int)reply.size());
+      next = (next + 1 < count ? next + 1 : 0);
+    }
+  });
+
+  std::string getter = (isBinary ? "ndiGetBXTransform/" : "ndiGetTXTransform/");
+  Run(options, getter + std::to_string(handles) + suffix, 0, "", [&](unsigned long long n)
+  {
+    double sum = 0;
+    for (unsigned long long i = 0; i < n; i++)
+    {
+      ndicapi* parser = parsers[next];
+      for (int ph = 1; ph <= handles; ph++)
+      {
+        if (isBinary)
+        {
+          float transform[8];
+          ndiGetBXTransform(parser, ph, transform);
+          sum += transform[4];
+        }
+        else
+        {
+          double transform[8];
+          ndiGetTXTransform(parser, ph, transform);
+          sum += transform[4];
+        }
+      }
+      next = (next + 1 < count ? next + 1 : 0);
+    }
+    Sink = (unsigned long long)sum;
+  });
+
+  for (int i = 0; i < count; i++)
+  {
+    ndiCloseNetwork(parsers[i]);
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  BenchmarkOptions options;
+  options.Seconds = 0.2;
+  options.Filter = nullptr;
+  std::vector<const char*> captures;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+    {
+      options.Seconds = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+    {
+      options.Filter = argv[++i];
+    }
+    else if (argv[i][0] == '-')
+    {
+      std::cerr << "Usage: " << argv[0] << " [-t seconds] [-f filter] [capture file ...]" << std::endl;
+      return EXIT_FAILURE;
+    }
+    else
+    {
+      captures.push_back(argv[i]);
+    }
+  }
+
+  OpenCacheMissCounter();
+  printf("%-36s %12s %10s %10s %10s\n", "benchmark", "ns/op", "MB/s", "allocs/op", "misses/op");
+
+  // the conversions, on fields of the sizes that are found in replies
+  const char* hex = "0001A5C4";
+  Run(options, "ndiHexToUnsignedLong/8", 8, "", [&](unsigned long long n)
+  {
+    unsigned long long sum = 0;
+    for (unsigned long long i = 0; i < n; i++)
+    {
+      sum += ndiHexToUnsignedLong(hex, 8);
+    }
+    Sink = sum;
+  });
+  Run(options, "ndiHexToUnsignedLong/2", 2, "", [&](unsigned long long n)
+  {
+    unsigned long long sum = 0;
+    for (unsigned long long i = 0; i < n; i++)
+    {
+      sum += ndiHexToUnsignedLong(hex + 6, 2);
+    }
+    Sink = sum;
+  });
+  const char* decimal = "-0123456";
+  Run(options, "ndiSignedToLong/6", 6, "", [&](unsigned long long n)
+  {
+    long long sum = 0;
+    for (unsigned long long i = 0; i < n; i++)
+    {
+      sum += ndiSignedToLong(decimal, 6);
+    }
+    Sink = sum;
+  });
+  Run(options, "ndiSignedToLong/7", 7, "", [&](unsigned long long n)
+  {
+    long long sum = 0;
+    for (unsigned long long i = 0; i < n; i++)
+    {
+      sum += ndiSignedToLong(decimal, 7);
+    }
+    Sink = sum;
+  });
+
+  unsigned char binary[64];
+  char encoded[129];
+  for (int i = 0; i < 64; i++)
+  {
+    binary[i] = (unsigned char)(i * 37);
+  }
+  Run(options, "ndiHexEncode/64", 64, "", [&](unsigned long long n)
+  {
+    for (unsigned long long i = 0; i < n; i++)
+    {
+      ndiHexEncode(encoded, binary, 64);
+    }
+    Sink = encoded[5];
+  });
+  ndiHexEncode(encoded, binary, 64);
+  Run(options, "ndiHexDecode/64", 128, "", [&](unsigned long long n)
+  {
+    for (unsigned long long i = 0; i < n; i++)
+    {
+      ndiHexDecode(binary, encoded, 64);
+    }
+    Sink = binary[5];
+  });
+
+  // CalcCRC16 is applied one character at a time by ndiCRC16(1), the
+  // table-driven ndiCRC16() handles whole replies
+  std::string crcData = TXReply(8, -1);
+  Run(options, "CalcCRC16/bytewise", crcData.size(), "", [&](unsigned long long n)
+  {
+    unsigned short crc = 0;
+    for (unsigned long long i = 0; i < n; i++)
+    {
+      for (size_t j = 0; j < crcData.size(); j++)
+      {
+        crc = ndiCRC16(crc, &crcData[j], 1);
+      }
+    }
+    Sink = crc;
+  });
+  const int crcSizes[3] = { 32, 256, 1024 };
+  std::string crcBuffer(1024, 'A');
+  for (int k = 0; k < 3; k++)
+  {
+    std::string name = "ndiCRC16/" + std::to_string(crcSizes[k]);
+    Run(options, name, crcSizes[k], "", [&](unsigned long long n)
+    {
+      unsigned short crc = 0;
+      for (unsigned long long i = 0; i < n; i++)
+      {
+        crc = ndiCRC16(crc, crcBuffer.data(), crcSizes[k]);
+      }
+      Sink = crc;
+    });
+  }
+
+  // the reply helpers, through ndiParseReply()
+  ndicapi* parser = ndiOpenOffline();
+  const int handleCounts[3] = { 1, 8, 64 };
+  for (int k = 0; k < 3; k++)
+  {
+    int handles = handleCounts[k];
+    std::string suffix = "/" + std::to_string(handles);
+    RunReply(options, parser, "ndiPHSRHelper" + suffix, "PHSR:00", PHSRReply(handles), GetPHSRCount);
+    RunReply(options, parser, "ndiTXHelper" + suffix, "TX:0001", TXReply(handles, -1), GetTXCount);
+    RunReply(options, parser, "ndiTXHelper+strays" + suffix, "TX:1001", TXReply(handles, 50), GetTXCount);
+    RunReply(options, parser, "ndiBXHelper" + suffix, "BX:0001", BXReply(handles, -1, 0), GetBXCount);
+    RunReply(options, parser, "ndiBXHelper+markers" + suffix, "BX:1009", BXReply(handles, 4, 20), GetBXCount);
+  }
+  const int portCounts[3] = { 1, 3, 12 };
+  for (int k = 0; k < 3; k++)
+  {
+    int ports = portCounts[k];
+    std::string name = "ndiGXHelper/" + std::to_string(ports);
+    RunReply(options, parser, name, (ports > 3 ? "GX:A009" : "GX:0009"), GXReply(ports), nullptr);
+  }
+
+  for (size_t i = 0; i < captures.size(); i++)
+  {
+    RunCapture(options, parser, captures[i]);
+    RunReplay(options, captures[i]);
+  }
+
+  // many parsers that are used in turn, with 8 tools each
+  RunRotation(options, "ndiTXHelper/8", "TX:0001", TXReply(8, -1), 8, 1024);
+  RunRotation(options, "ndiBXHelper/8", "BX:0001", BXReply(8, -1, 0), 8, 1024);
+
+  // the scalar decoder and every vectorized decoder that the CPU supports,
+  // and then go back to the one that ndicapi would use by default
+  int defaultDecoder = ndiGetDecoder();
+  int mismatches = 0;
+  const int decoders[4] = { NDI_DECODER_SCALAR, NDI_DECODER_SSSE3, NDI_DECODER_AVX2, NDI_DECODER_NEON };
+  for (int k = 0; k < 4; k++)
+  {
+    if (ndiSetDecoder(decoders[k]) != decoders[k])
+    {
+      continue;
+    }
+    int errors = CheckDecoder(decoders[k]);
+    if (errors != 0)
+    {
+      printf("%-36s %d fields were decoded differently than by the scalar functions\n",
+             ndiDecoderName(decoders[k]), errors);
+      mismatches += errors;
+    }
+    RunDecoder(options, parser, decoders[k]);
+  }
+  ndiSetDecoder(defaultDecoder);
+
+  // the math functions in a loop, then the batch methods with the scalar
+  // kernel and with the vectorized kernel, if the CPU supports one
+  int defaultKernel = ndiGetMathKernel();
+  const int kernels[3] = { NDI_MATH_SCALAR, NDI_MATH_AVX2, NDI_MATH_NEON };
+  for (int k = 0; k < 3; k++)
+  {
+    if (ndiSetMathKernel(kernels[k]) != kernels[k])
+    {
+      continue;
+    }
+    int errors = CheckMathKernel(kernels[k]);
+    if (errors != 0)
+    {
+      printf("%-36s %d values differ from the scalar math functions\n",
+             ndiMathKernelName(kernels[k]), errors);
+      mismatches += errors;
+    }
+    RunMathKernel(options, kernels[k], (k == 0));
+  }
+  ndiSetMathKernel(defaultKernel);
+
+  ndiCloseNetwork(parser);
+
+  // the size of the ndicapi structure, and what it allocates for the replies
+  if (options.Filter == nullptr)
+  {
+    printf("\n%-36s %10s %10s %10s\n", "bytes used after", "ndicapi", "buffers", "replies");
+    ShowMemory("ndiTXHelper/8", "TX:0001", TXReply(8, -1));
+    ShowMemory("ndiTXHelper+strays/64", "TX:1001", TXReply(64, 50));
+    ShowMemory("ndiBXHelper/8", "BX:0001", BXReply(8, -1, 0));
+    ShowMemory("ndiBXHelper+markers/64", "BX:1009", BXReply(64, 4, 20));
+    ShowMemory("ndiPHSRHelper/8", "PHSR:00", PHSRReply(8));
+  }
+
+  return (mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
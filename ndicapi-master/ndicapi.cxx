@@ -37,9 +37,17 @@ POSSIBILITY OF SUCH DAMAGES.
 #endif
 
 #include "ndicapi.h"
+#include "ndicapi_capture.h"
+#include "ndicapi_decode.h"
 #include "ndicapi_socket.h"
 #include "ndicapi_thread.h"
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
 #include <string.h>
 #include <stdlib.h>
 #include <iostream>
@@ -47,8 +55,31 @@ POSSIBILITY OF SUCH DAMAGES.
 #include <stdio.h>
 #include <math.h>
 
-#if defined(__APPLE__)
+#if defined(_WIN32)
+  #include <direct.h>
+#else
   #include <dirent.h>
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+#include <errno.h>
+
+#if defined(__linux__)
+  #include <sys/epoll.h>
+#endif
+#if defined(__has_include)
+  #if __has_include(<sys/sdt.h>)
+    #include <sys/sdt.h>
+    #define NDI_HAVE_SDT 1
+  #endif
+#endif
+#if defined(_WIN32)
+  #include <chrono>
+  #include <thread>
+#else
+  #include <poll.h>
+  #include <unistd.h>
 #endif
 
 #ifdef __cplusplus
@@ -77,6 +108,255 @@ namespace
   }
 }
 
+//----------------------------------------------------------------------------
+// The decoded TX reply data for one handle, which is everything that the
+// tracking getters need.
+struct ndiTXHandle
+{
+  double Transform[8];                    // quaternion, translation, error
+  int TransformStatus;                    // NDI_OKAY, NDI_MISSING or NDI_DISABLED
+  int PortStatus;                         // port status bits
+  unsigned long Frame;                    // frame number
+  int Handle;                             // port handle
+};
+
+//----------------------------------------------------------------------------
+// The TX reply text for one handle.
+struct ndiTXHandleText
+{
+  char Transform[52];                     // transform, "MISSING" or "DISABLED"
+  char Status[9];                         // port status
+  char Frame[9];                          // frame number
+  char Information[24];                   // tool information and marker information
+  char SingleStray[24];                   // active stray marker
+};
+
+//----------------------------------------------------------------------------
+// The BX reply data for one handle that is needed for tracking.
+struct ndiBXHandle
+{
+  float Transform[8];                     // quaternion, translation, error
+  int PortStatus;                         // port status bits
+  unsigned int FrameNumber;               // frame number
+  unsigned char Handle;                   // port handle
+  char Status;                            // NDI_HANDLE_MISSING, NDI_HANDLE_DISABLED or zero
+};
+
+//----------------------------------------------------------------------------
+// The rest of the BX reply data for one handle.
+struct ndiBXHandleExtra
+{
+  char ToolMarkerInformation[11];         // tool information, then marker information
+  char SingleStrayStatus;                 // active stray status
+  float SingleStray[3];                   // active stray position
+  int MarkerCount;                        // number of 3D markers
+  int MarkerOffset;                       // index of the first marker in BxMarkerPositions
+  unsigned char MarkerOutOfVolume[32];    // 1 bit per marker, up to 255 markers
+};
+
+//----------------------------------------------------------------------------
+// The replies to the commands that are used when setting up the device.
+struct ndiStatusReplies
+{
+  // PSTAT command reply data
+  char PstatBasic[3][32];                 // basic pstat info
+  char PstatTesting[3][8];                // testing results
+  char PstatPartNumber[3][20];            // part number
+  char PstatAccessories[3][2];            // accessory information
+  char PstatMarkerType[3][2];             // marker information
+
+  char PstatPassiveBasic[9][32];          // basic passive pstat info
+  char PstatPassiveTesting[9][8];         // meaningless info
+  char PstatPassivePartNumber[9][20];     // virtual srom part number
+  char PstatPassiveAccessories[9][2];     // virtual srom accessories
+  char PstatPassiveMarkerType[9][2];      // meaningless for passive
+
+  // SSTAT command reply data
+  char SstatControl[2];                   // control processor status
+  char SstatSensor[2];                    // sensor processors status
+  char SstatTiu[2];                       // tiu processor status
+
+  // IRCHK command reply data
+  int IrchkDetected;                      // irchk detected infrared
+  char IrchkSources[128];                 // coordinates of sources
+
+  // PHRQ command reply data
+  char PhrqReply[2];
+
+  // PHSR command reply data
+  char PhsrReply[1284];
+
+  // PHINF command reply data
+  int PhinfUnoccupied;
+  char PhinfBasic[34];
+  char PhinfTesting[8];
+  char PhinfPartNumber[20];
+  char PhinfAccessories[2];
+  char PhinfMarkerType[2];
+  char PhinfPortLocation[14];
+  char PhinfGpioStatus[2];
+};
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Get the status reply data, and allocate it if this is the first time.
+  ndiStatusReplies* ndiGetStatusReplies(ndicapi* pol)
+  {
+    if (pol->StatusReplies == NULL)
+    {
+      pol->StatusReplies = (ndiStatusReplies*)calloc(1, sizeof(ndiStatusReplies));
+    }
+    return pol->StatusReplies;
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the capacity that an array must grow to so that it can hold n
+  // elements.  Arrays grow by at least half, so that a reply with a few
+  // more handles than the last one does not cause a reallocation.
+  int ndiGrowCapacity(int capacity, int n)
+  {
+    int grown = capacity + capacity / 2;
+    return (grown > n ? grown : n);
+  }
+
+  //----------------------------------------------------------------------------
+  // Resize an array that was allocated with malloc(), clearing any new
+  // elements.  Returns false if there is not enough memory, in which case
+  // the array is unchanged.
+  template <typename T>
+  bool ndiResizeArray(T*& array, int oldCapacity, int newCapacity)
+  {
+    T* resized = (T*)realloc(array, newCapacity * sizeof(T));
+    if (resized == NULL)
+    {
+      return false;
+    }
+    if (newCapacity > oldCapacity)
+    {
+      memset(resized + oldCapacity, 0, (newCapacity - oldCapacity) * sizeof(T));
+    }
+    array = resized;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Make room for the TX data for n handles.
+  bool ndiReserveTXHandles(ndicapi* pol, int n)
+  {
+    if (n <= pol->TxHandleCapacity)
+    {
+      return true;
+    }
+    int capacity = ndiGrowCapacity(pol->TxHandleCapacity, n);
+    if (!ndiResizeArray(pol->TxHandleValues, pol->TxHandleCapacity, capacity) ||
+        !ndiResizeArray(pol->TxHandleText, pol->TxHandleCapacity, capacity))
+    {
+      return false;
+    }
+    pol->TxHandleCapacity = capacity;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Make room for the BX data for n handles.
+  bool ndiReserveBXHandles(ndicapi* pol, int n)
+  {
+    if (n <= pol->BxHandleCapacity)
+    {
+      return true;
+    }
+    int capacity = ndiGrowCapacity(pol->BxHandleCapacity, n);
+    if (!ndiResizeArray(pol->BxHandleValues, pol->BxHandleCapacity, capacity) ||
+        !ndiResizeArray(pol->BxHandleExtra, pol->BxHandleCapacity, capacity))
+    {
+      return false;
+    }
+    pol->BxHandleCapacity = capacity;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Make room for n elements in one of the other reply arrays.
+  template <typename T>
+  bool ndiReserveArray(T*& array, int& capacity, int n)
+  {
+    if (n <= capacity)
+    {
+      return true;
+    }
+    int newCapacity = ndiGrowCapacity(capacity, n);
+    if (!ndiResizeArray(array, capacity, newCapacity))
+    {
+      return false;
+    }
+    capacity = newCapacity;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Make room for a reply of n bytes and its terminator in both Reply and
+  // ReplyNoCRC.
+  bool ndiReserveReply(ndicapi* pol, int n)
+  {
+    int size = pol->ReplySize;
+    if (!ndiReserveArray(pol->Reply, size, n + 1))
+    {
+      return false;
+    }
+    size = pol->ReplySize;
+    if (!ndiReserveArray(pol->ReplyNoCRC, size, n + 1))
+    {
+      return false;
+    }
+    pol->ReplySize = size;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Make room to read more into a buffer of replies that have not been
+  // parsed yet.  The buffer only grows when a partial reply fills it, and
+  // never past the size of the largest reply.
+  bool ndiReserveReadBuffer(char*& buffer, int& size, int length)
+  {
+    if (length < size || size >= NDI_REPLY_BUFFER_SIZE)
+    {
+      return true;
+    }
+    int n = (2 * size < NDI_REPLY_BUFFER_SIZE ? 2 * size : NDI_REPLY_BUFFER_SIZE);
+    return ndiReserveArray(buffer, size, n);
+  }
+
+  //----------------------------------------------------------------------------
+  // Free the reply data that is allocated as it is needed.
+  void ndiFreeReplyData(ndicapi* pol)
+  {
+    free(pol->StatusReplies);
+    free(pol->TxHandleValues);
+    free(pol->TxHandleText);
+    free(pol->TxPassiveStray);
+    free(pol->BxHandleValues);
+    free(pol->BxHandleExtra);
+    free(pol->BxMarkerPositions);
+    free(pol->BxPassiveStrayPosition);
+    pol->StatusReplies = NULL;
+    pol->TxHandleValues = NULL;
+    pol->TxHandleText = NULL;
+    pol->TxPassiveStray = NULL;
+    pol->BxHandleValues = NULL;
+    pol->BxHandleExtra = NULL;
+    pol->BxMarkerPositions = NULL;
+    pol->BxPassiveStrayPosition = NULL;
+    pol->TxHandleCount = 0;
+    pol->TxHandleCapacity = 0;
+    pol->TxPassiveStrayCapacity = 0;
+    pol->BxHandleCount = 0;
+    pol->BxHandleCapacity = 0;
+    pol->BxMarkerCapacity = 0;
+    pol->BxPassiveStrayCapacity = 0;
+  }
+}
+
 //----------------------------------------------------------------------------
 ndicapiExport void ndiSetErrorCallback(ndicapi* pol, NDIErrorCallback callback, void* userdata)
 {
@@ -87,6 +367,7 @@ ndicapiExport void ndiSetErrorCallback(ndicapi* pol, NDIErrorCallback callback,
 //----------------------------------------------------------------------------
 ndicapiExport void ndiLogState(ndicapi* pol, char outInformation[USHRT_MAX])
 {
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
 #ifdef __cplusplus
   std::stringstream ss;
   for (int i = 0; i < 3; ++i)
@@ -122,120 +403,103 @@ ndicapiExport void ndiLogState(ndicapi* pol, char outInformation[USHRT_MAX])
   ss << "GxPassiveStray[424]: " << pol->GxPassiveStray;
   for (int i = 0; i < 3; ++i)
   {
-    ss << "PstatBasic[" << i << "][32]: " << pol->PstatBasic[i] << std::endl;
+    ss << "PstatBasic[" << i << "][32]: " << replies->PstatBasic[i] << std::endl;
   }
   for (int i = 0; i < 3; ++i)
   {
-    ss << "PstatTesting[" << i << "][8]: " << pol->PstatTesting[i] << std::endl;
+    ss << "PstatTesting[" << i << "][8]: " << replies->PstatTesting[i] << std::endl;
   }
   for (int i = 0; i < 3; ++i)
   {
-    ss << "PstatPartNumber[" << i << "][20]: " << pol->PstatPartNumber[i] << std::endl;
+    ss << "PstatPartNumber[" << i << "][20]: " << replies->PstatPartNumber[i] << std::endl;
   }
   for (int i = 0; i < 3; ++i)
   {
-    ss << "PstatAccessories[" << i << "][2]: " << pol->PstatAccessories[i] << std::endl;
+    ss << "PstatAccessories[" << i << "][2]: " << replies->PstatAccessories[i] << std::endl;
   }
   for (int i = 0; i < 3; ++i)
   {
-    ss << "PstatMarkerType[" << i << "][2]: " << pol->PstatMarkerType[i] << std::endl;
+    ss << "PstatMarkerType[" << i << "][2]: " << replies->PstatMarkerType[i] << std::endl;
   }
   for (int i = 0; i < 9; ++i)
   {
-    ss << "PstatPassiveBasic[" << i << "][32]: " << pol->PstatPassiveBasic[i] << std::endl;
+    ss << "PstatPassiveBasic[" << i << "][32]: " << replies->PstatPassiveBasic[i] << std::endl;
   }
   for (int i = 0; i < 9; ++i)
   {
-    ss << "PstatPassiveTesting[" << i << "][8]: " << pol->PstatPassiveTesting[i] << std::endl;
+    ss << "PstatPassiveTesting[" << i << "][8]: " << replies->PstatPassiveTesting[i] << std::endl;
   }
   for (int i = 0; i < 9; ++i)
   {
-    ss << "PstatPassivePartNumber[" << i << "][20]: " << pol->PstatPassivePartNumber[i] << std::endl;
+    ss << "PstatPassivePartNumber[" << i << "][20]: " << replies->PstatPassivePartNumber[i] << std::endl;
   }
   for (int i = 0; i < 9; ++i)
   {
-    ss << "PstatPassiveAccessories[" << i << "][2]: " << pol->PstatPassiveAccessories[i] << std::endl;
+    ss << "PstatPassiveAccessories[" << i << "][2]: " << replies->PstatPassiveAccessories[i] << std::endl;
   }
   for (int i = 0; i < 9; ++i)
   {
-    ss << "PstatPassiveMarkerType[" << i << "][2]: " << pol->PstatPassiveMarkerType[i] << std::endl;
-  }
-  ss << "SstatControl[2]: " << pol->SstatControl << std::endl;
-  ss << "SstatSensor[2]: " << pol->SstatSensor << std::endl;
-  ss << "SstatTiu[2]: " << pol->SstatTiu << std::endl;
-  ss << "IrchkDetected: " << pol->IrchkDetected << std::endl;
-  ss << "IrchkSources[128]: " << pol->IrchkSources << std::endl;
-  ss << "PhrqReply[2]: " << pol->PhrqReply << std::endl;
-  ss << "PhsrReply[1284]: " << pol->PhsrReply << std::endl;
-  ss << "PhinfUnoccupied: " << pol->PhinfUnoccupied << std::endl;
-  ss << "PhinfBasic[34]: " << pol->PhinfBasic << std::endl;
-  ss << "PhinfTesting[8]: " << pol->PhinfTesting << std::endl;
-  ss << "PhinfPartNumber[20]: " << pol->PhinfPartNumber << std::endl;
-  ss << "PhinfAccessories[2]: " << pol->PhinfAccessories << std::endl;
-  ss << "PhinfMarkerType[2]: " << pol->PhinfMarkerType << std::endl;
-  ss << "PhinfPortLocation[14]: " << pol->PhinfPortLocation << std::endl;
-  ss << "PhinfGpioStatus[2]: " << pol->PhinfGpioStatus << std::endl;
+    ss << "PstatPassiveMarkerType[" << i << "][2]: " << replies->PstatPassiveMarkerType[i] << std::endl;
+  }
+  ss << "SstatControl[2]: " << replies->SstatControl << std::endl;
+  ss << "SstatSensor[2]: " << replies->SstatSensor << std::endl;
+  ss << "SstatTiu[2]: " << replies->SstatTiu << std::endl;
+  ss << "IrchkDetected: " << replies->IrchkDetected << std::endl;
+  ss << "IrchkSources[128]: " << replies->IrchkSources << std::endl;
+  ss << "PhrqReply[2]: " << replies->PhrqReply << std::endl;
+  ss << "PhsrReply[1284]: " << replies->PhsrReply << std::endl;
+  ss << "PhinfUnoccupied: " << replies->PhinfUnoccupied << std::endl;
+  ss << "PhinfBasic[34]: " << replies->PhinfBasic << std::endl;
+  ss << "PhinfTesting[8]: " << replies->PhinfTesting << std::endl;
+  ss << "PhinfPartNumber[20]: " << replies->PhinfPartNumber << std::endl;
+  ss << "PhinfAccessories[2]: " << replies->PhinfAccessories << std::endl;
+  ss << "PhinfMarkerType[2]: " << replies->PhinfMarkerType << std::endl;
+  ss << "PhinfPortLocation[14]: " << replies->PhinfPortLocation << std::endl;
+  ss << "PhinfGpioStatus[2]: " << replies->PhinfGpioStatus << std::endl;
   ss << "TxHandleCount: " << pol->TxHandleCount << std::endl;
-  ss << "TxHandles[NDI_MAX_HANDLES]: " << pol->TxHandles << std::endl;
-  for (int i = 0; i < pol->TxHandleCount; ++i)
-  {
-    ss << "TxTransforms[" << i << "][52]: " << pol->TxTransforms[i] << std::endl;
-  }
-  for (int i = 0; i < pol->TxHandleCount; ++i)
-  {
-    ss << "TxStatus[" << i << "][8]: " << pol->TxStatus[i] << std::endl;
-  }
-  for (int i = 0; i < pol->TxHandleCount; ++i)
-  {
-    ss << "TxFrame[" << i << "][8]: " << pol->TxFrame[i] << std::endl;
-  }
-  for (int i = 0; i < pol->TxHandleCount; ++i)
-  {
-    ss << "TxInformation[" << i << "][12]: " << pol->TxInformation[i] << std::endl;
-  }
   for (int i = 0; i < pol->TxHandleCount; ++i)
   {
-    ss << "TxSingleStray[" << i << "][24]: " << pol->TxSingleStray[i] << std::endl;
+    const ndiTXHandleText* text = &pol->TxHandleText[i];
+    ss << "TxHandle[" << i << "]: " << pol->TxHandleValues[i].Handle << std::endl;
+    ss << "TxTransform[" << i << "][52]: " << text->Transform << std::endl;
+    ss << "TxStatus[" << i << "][8]: " << text->Status << std::endl;
+    ss << "TxFrame[" << i << "][8]: " << text->Frame << std::endl;
+    ss << "TxInformation[" << i << "][20]: " << text->Information << std::endl;
+    ss << "TxSingleStray[" << i << "][24]: " << text->SingleStray << std::endl;
   }
   ss << "TxSystemStatus[4]: " << pol->TxSystemStatus << std::endl;
   ss << "TxPassiveStrayCount: " << pol->TxPassiveStrayCount << std::endl;
   ss << "TxPassiveStrayOov[14]: " << pol->TxPassiveStrayOov << std::endl;
-  ss << "TxPassiveStray[1052]: " << pol->TxPassiveStray << std::endl;
+  ss << "TxPassiveStray: " << (pol->TxPassiveStray ? pol->TxPassiveStray : "") << std::endl;
   ss << "BxHandleCount: " << pol->BxHandleCount << std::endl;
-  ss << "BxHandles[NDI_MAX_HANDLES]: " << pol->BxHandles << std::endl;
-  ss << "BxHandlesStatus[NDI_MAX_HANDLES]: " << pol->BxHandlesStatus << std::endl;
-  ss << "BxFrameNumber[NDI_MAX_HANDLES]: " << pol->BxFrameNumber << std::endl;
-  for (int i = 0; i < pol->BxHandleCount; ++i)
-  {
-    ss << "BxTransforms[" << i << "][8]: " << pol->BxTransforms[i] << std::endl;
-  }
-  ss << "BxPortStatus[NDI_MAX_HANDLES]: " << pol->BxPortStatus << std::endl;
-  for (int i = 0; i < pol->BxHandleCount; ++i)
-  {
-    ss << "BxToolMarkerInformation[" << i << "][11]: " << pol->BxToolMarkerInformation[i] << std::endl;
-  }
-  ss << "BxActiveSingleStrayMarkerStatus[NDI_MAX_HANDLES]: " << pol->BxActiveSingleStrayMarkerStatus << std::endl;
-  for (int i = 0; i < pol->BxHandleCount; ++i)
-  {
-    ss << "BxActiveSingleStrayMarkerPosition[" << i << "][3]: " << pol->BxActiveSingleStrayMarkerPosition[i] << std::endl;
-  }
-  ss << "Bx3DMarkerCount[NDI_MAX_HANDLES]: " << pol->Bx3DMarkerCount << std::endl;
-  for (int i = 0; i < pol->BxHandleCount; ++i)
-  {
-    ss << "Bx3DMarkerOutOfVolume[" << i << "][3]: " << pol->Bx3DMarkerOutOfVolume[i] << std::endl;
-  }
   for (int i = 0; i < pol->BxHandleCount; ++i)
   {
-    for (int j = 0; j < pol->Bx3DMarkerCount[i]; j++)
+    const ndiBXHandle* values = &pol->BxHandleValues[i];
+    const ndiBXHandleExtra* extra = &pol->BxHandleExtra[i];
+    ss << "BxHandle[" << i << "]: " << (int)values->Handle << std::endl;
+    ss << "BxHandleStatus[" << i << "]: " << (int)values->Status << std::endl;
+    ss << "BxFrameNumber[" << i << "]: " << values->FrameNumber << std::endl;
+    ss << "BxTransform[" << i << "][8]:";
+    for (int j = 0; j < 8; j++)
+    {
+      ss << " " << values->Transform[j];
+    }
+    ss << std::endl;
+    ss << "BxPortStatus[" << i << "]: " << values->PortStatus << std::endl;
+    ss << "BxSingleStrayStatus[" << i << "]: " << (int)extra->SingleStrayStatus << std::endl;
+    ss << "BxSingleStray[" << i << "][3]: " << extra->SingleStray[0] << " " << extra->SingleStray[1] << " " << extra->SingleStray[2] << std::endl;
+    ss << "Bx3DMarkerCount[" << i << "]: " << extra->MarkerCount << std::endl;
+    for (int j = 0; j < extra->MarkerCount; j++)
     {
-      ss << "Bx3DMarkerPosition[" << i << "][" << j << "][3]: " << pol->Bx3DMarkerPosition[i][j] << std::endl;
+      const float* position = pol->BxMarkerPositions[extra->MarkerOffset + j];
+      ss << "Bx3DMarkerPosition[" << i << "][" << j << "][3]: " << position[0] << " " << position[1] << " " << position[2] << std::endl;
     }
   }
   ss << "BxPassiveStrayCount: " << pol->BxPassiveStrayCount << std::endl;
-  ss << "BxPassiveStrayOutOfVolume[30]: " << pol->BxPassiveStrayOutOfVolume << std::endl;
   for (int i = 0; i < pol->BxPassiveStrayCount; ++i)
   {
-    ss << "BxPassiveStrayPosition[" << i << "][3]: " << pol->BxPassiveStrayPosition[i] << std::endl;
+    const float* position = pol->BxPassiveStrayPosition[i];
+    ss << "BxPassiveStrayPosition[" << i << "][3]: " << position[0] << " " << position[1] << " " << position[2] << std::endl;
   }
 
   assert(ss.str().size() < USHRT_MAX);
@@ -443,43 +707,6 @@ ndicapiExport void* ndiHexDecode(void* data, const char* cp, int n)
   return data;
 }
 
-//----------------------------------------------------------------------------
-ndicapiExport int ndiPVWRFromFile(ndicapi* pol, int port, char* filename)
-{
-  unsigned char buffer[1024];
-  char hexdata[128];
-  FILE* file;
-  int addr;
-
-  pol->ErrorCode = 0;
-
-  file = fopen(filename, "rb");
-  if (file == NULL)
-  {
-    return -1;
-  }
-
-  memset(buffer, 0, 1024);      // clear buffer to zero
-  fread(buffer, 1, 1024, file); // read at most 1k from file
-  if (ferror(file))
-  {
-    fclose(file);
-    return -1;
-  }
-  fclose(file);
-
-  for (addr = 0; addr < 1024; addr += 64)   // write in chunks of 64 bytes
-  {
-    ndiPVWR(pol, port, addr, ndiHexEncode(hexdata, &buffer[addr], 64));
-    if (ndiGetError(pol) != NDI_OKAY)
-    {
-      return -1;
-    }
-  }
-
-  return 0;
-}
-
 //----------------------------------------------------------------------------
 ndicapiExport int ndiGetError(ndicapi* pol)
 {
@@ -720,144 +947,448 @@ ndicapiExport const char* ndiSerialDeviceName(int i)
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiSerialProbe(const char* device, bool checkDSR)
+// Probe for a device as described for ndiSerialProbe(), waiting at most
+// resetTimeout milliseconds for the reply to the serial break.  If version
+// is not NULL, the reply to "VER:0" is stored there without the CRC.
+namespace
 {
-  char reply[1024];
-  char init_reply[16];
-  NDIFileHandle serial_port;
-  int n;
-
-  serial_port = ndiSerialOpen(device);
-  if (serial_port == NDI_INVALID_HANDLE)
-  {
-    return NDI_OPEN_ERROR;
-  }
-
-  // check DSR line to see whether any device is connected
-  if (checkDSR && !ndiSerialCheckDSR(serial_port))
-  {
-    ndiSerialClose(serial_port);
-    return NDI_DSR_FAILURE;
-  }
-
-  // set comm parameters to default, but decrease timeout to 0.1s
-  if (ndiSerialComm(serial_port, 9600, "8N1", 0) < 0 || ndiSerialTimeout(serial_port, 100) < 0)
-  {
-    ndiSerialClose(serial_port);
-    return NDI_BAD_COMM;
-  }
-  // flush the buffers (which are unlikely to contain anything)
-  ndiSerialFlush(serial_port, NDI_IOFLUSH);
-
-  // try to initialize ndicapi
-  int errorCode;
-  if (ndiSerialWrite(serial_port, "INIT:E3A5\r", 10) < 10 || ndiSerialSleep(serial_port, 100) < 0 ||
-      ndiSerialRead(serial_port, init_reply, 16, false, &errorCode) <= 0 || strncmp(init_reply, "OKAYA896\r", 9) != 0)
+  int ndiSerialProbeDevice(const char* device, bool checkDSR, int resetTimeout, char* version, int versionSize)
   {
-    // increase timeout to 7 seconds for reset
-    ndiSerialTimeout(serial_port, 7000);
+    char reply[1024];
+    char init_reply[16];
+    NDIFileHandle serial_port;
+    int n;
+    bool haveVersion = false;
 
-    // init failed: flush, reset, and try again
-    ndiSerialFlush(serial_port, NDI_IOFLUSH);
-    if (ndiSerialFlush(serial_port, NDI_IOFLUSH) < 0 ||
-        ndiSerialBreak(serial_port))
+    serial_port = ndiSerialOpen(device);
+    if (serial_port == NDI_INVALID_HANDLE)
     {
-      ndiSerialClose(serial_port);
-      return NDI_BAD_COMM;
+      return NDI_OPEN_ERROR;
     }
 
-    n = ndiSerialRead(serial_port, init_reply, 16, false, &errorCode);
-    if (n < 0)
+    // check DSR line to see whether any device is connected
+    if (checkDSR && !ndiSerialCheckDSR(serial_port))
     {
       ndiSerialClose(serial_port);
-      return errorCode;
+      return NDI_DSR_FAILURE;
     }
-    else if (n == 0)
+
+    // set comm parameters to default, but decrease timeout to 0.1s
+    if (ndiSerialComm(serial_port, 9600, "8N1", 0) < 0 || ndiSerialTimeout(serial_port, 100) < 0)
     {
       ndiSerialClose(serial_port);
-      return NDI_TIMEOUT;
+      return NDI_BAD_COMM;
     }
+    // flush the buffers (which are unlikely to contain anything)
+    ndiSerialFlush(serial_port, NDI_IOFLUSH);
 
-    // check reply from reset
-    if (strncmp(init_reply, "RESETBE6F\r", 10) != 0)
+    // try to initialize ndicapi
+    int errorCode;
+    if (ndiSerialWrite(serial_port, "INIT:E3A5\r", 10) < 10 || ndiSerialSleep(serial_port, 100) < 0 ||
+        ndiSerialRead(serial_port, init_reply, 16, false, &errorCode) <= 0 || strncmp(init_reply, "OKAYA896\r", 9) != 0)
     {
-      ndiSerialClose(serial_port);
-      return NDI_BAD_REPLY;
+      // increase timeout for reset
+      ndiSerialTimeout(serial_port, resetTimeout);
+
+      // init failed: flush, reset, and try again
+      ndiSerialFlush(serial_port, NDI_IOFLUSH);
+      if (ndiSerialFlush(serial_port, NDI_IOFLUSH) < 0 ||
+          ndiSerialBreak(serial_port))
+      {
+        ndiSerialClose(serial_port);
+        return NDI_BAD_COMM;
+      }
+
+      n = ndiSerialRead(serial_port, init_reply, 16, false, &errorCode);
+      if (n < 0)
+      {
+        ndiSerialClose(serial_port);
+        return errorCode;
+      }
+      else if (n == 0)
+      {
+        ndiSerialClose(serial_port);
+        return NDI_TIMEOUT;
+      }
+
+      // check reply from reset
+      if (strncmp(init_reply, "RESETBE6F\r", 10) != 0)
+      {
+        ndiSerialClose(serial_port);
+        return NDI_BAD_REPLY;
+      }
+      // try to initialize a second time
+      ndiSerialSleep(serial_port, 100);
+      n = ndiSerialWrite(serial_port, "INIT:E3A5\r", 10);
+      if (n < 0)
+      {
+        ndiSerialClose(serial_port);
+        return NDI_WRITE_ERROR;
+      }
+      else if (n < 10)
+      {
+        ndiSerialClose(serial_port);
+        return NDI_TIMEOUT;
+      }
+
+      ndiSerialSleep(serial_port, 100);
+      n = ndiSerialRead(serial_port, init_reply, 16, false, &errorCode);
+      if (n < 0)
+      {
+        ndiSerialClose(serial_port);
+        return NDI_READ_ERROR;
+      }
+      else if (n == 0)
+      {
+        ndiSerialClose(serial_port);
+        return NDI_TIMEOUT;
+      }
+
+      if (strncmp(init_reply, "OKAYA896\r", 9) != 0)
+      {
+        ndiSerialClose(serial_port);
+        return NDI_PROBE_FAIL;
+      }
     }
-    // try to initialize a second time
+
     ndiSerialSleep(serial_port, 100);
-    n = ndiSerialWrite(serial_port, "INIT:E3A5\r", 10);
-    if (n < 0)
+    if (ndiSerialWrite(serial_port, "GETINFO:Features.Firmware.Version0492\r", strlen("GETINFO:Features.Firmware.Version0492\r")) != strlen("GETINFO:Features.Firmware.Version0492\r"))
     {
       ndiSerialClose(serial_port);
-      return NDI_WRITE_ERROR;
+      return NDI_NO_FEATURES_FIRMWARE;
     }
-    else if (n < 10)
+
+    n = ndiSerialRead(serial_port, reply, 1023, false, &errorCode);
+    if (n == 0)
     {
       ndiSerialClose(serial_port);
       return NDI_TIMEOUT;
     }
-
-    ndiSerialSleep(serial_port, 100);
-    n = ndiSerialRead(serial_port, init_reply, 16, false, &errorCode);
-    if (n < 0)
+    else if (n < 0)
     {
       ndiSerialClose(serial_port);
-      return NDI_READ_ERROR;
+      return errorCode;
     }
-    else if (n == 0)
+    else
     {
-      ndiSerialClose(serial_port);
-      return NDI_TIMEOUT;
+      if (strncmp(reply, "ERROR", 5) == 0)
+      {
+        if (ndiSerialWrite(serial_port, "VER:065EE\r", 10) < 10 ||
+            (n = ndiSerialRead(serial_port, reply, 1023, false, &errorCode)) < 7)
+        {
+          ndiSerialClose(serial_port);
+          return NDI_COMMAND_VER_FAILED;
+        }
+        haveVersion = true;
+      }
+      else if (strncmp(reply, "Features", strlen("Features")) != 0)
+      {
+        ndiSerialClose(serial_port);
+        return NDI_BAD_REPLY;
+      }
     }
 
-    if (strncmp(init_reply, "OKAYA896\r", 9) != 0)
+    if (version != NULL && versionSize > 0)
     {
-      ndiSerialClose(serial_port);
-      return NDI_PROBE_FAIL;
+      if (!haveVersion)
+      {
+        if (ndiSerialWrite(serial_port, "VER:065EE\r", 10) < 10 ||
+            (n = ndiSerialRead(serial_port, reply, 1023, false, &errorCode)) < 7)
+        {
+          ndiSerialClose(serial_port);
+          return NDI_COMMAND_VER_FAILED;
+        }
+      }
+      // strip the CRC and the carriage return
+      n -= 5;
+      if (n > versionSize - 1)
+      {
+        n = versionSize - 1;
+      }
+      memcpy(version, reply, n);
+      version[n] = '\0';
     }
-  }
 
-  ndiSerialSleep(serial_port, 100);
-  if (ndiSerialWrite(serial_port, "GETINFO:Features.Firmware.Version0492\r", strlen("GETINFO:Features.Firmware.Version0492\r")) != strlen("GETINFO:Features.Firmware.Version0492\r"))
-  {
+    // restore things back to the way they were
     ndiSerialClose(serial_port);
-    return NDI_NO_FEATURES_FIRMWARE;
-  }
 
-  n = ndiSerialRead(serial_port, reply, 1023, false, &errorCode);
-  if (n == 0)
-  {
-    ndiSerialClose(serial_port);
-    return NDI_TIMEOUT;
+    return NDI_OKAY;
   }
-  else if (n < 0)
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiSerialProbe(const char* device, bool checkDSR)
+{
+  return ndiSerialProbeDevice(device, checkDSR, 7000, NULL, 0);
+}
+
+//----------------------------------------------------------------------------
+// Find the serial ports that might have an NDI device attached.
+namespace
+{
+#if !defined(_WIN32)
+  // Sort "ttyUSB2" before "ttyUSB10".
+  bool ndiDeviceNameLess(const std::string& a, const std::string& b)
   {
-    ndiSerialClose(serial_port);
-    return errorCode;
+    return (a.size() < b.size() || (a.size() == b.size() && a < b));
   }
-  else
+
+  // Add the entries of a directory that start with the prefix, skipping
+  // any that are links to a device that is already in the list.
+  void ndiAddSerialDevices(const char* dirname, const char* prefix, std::vector<std::string>& names,
+                           std::vector<std::string>& targets)
   {
-    if (strncmp(reply, "ERROR", 5) == 0)
+    DIR* dirp = opendir(dirname);
+    if (dirp == NULL)
+    {
+      return;
+    }
+
+    std::vector<std::string> found;
+    struct dirent* ep;
+    while ((ep = readdir(dirp)) != NULL)
     {
-      if (ndiSerialWrite(serial_port, "VER:065EE\r", 10) < 10 ||
-          (n = ndiSerialRead(serial_port, reply, 1023, false, &errorCode)) < 7)
+      if (ep->d_name[0] != '.' && strncmp(ep->d_name, prefix, strlen(prefix)) == 0)
       {
-        ndiSerialClose(serial_port);
-        return NDI_COMMAND_VER_FAILED;
+        found.push_back(std::string(dirname) + "/" + ep->d_name);
       }
     }
-    else if (strncmp(reply, "Features", strlen("Features")) != 0)
+    closedir(dirp);
+
+    std::sort(found.begin(), found.end(), ndiDeviceNameLess);
+    for (size_t i = 0; i < found.size(); i++)
     {
-      ndiSerialClose(serial_port);
-      return NDI_BAD_REPLY;
+      char* target = realpath(found[i].c_str(), NULL);
+      if (target == NULL)
+      {
+        continue;
+      }
+      if (std::find(targets.begin(), targets.end(), target) == targets.end())
+      {
+        names.push_back(found[i]);
+        targets.push_back(target);
+      }
+      free(target);
     }
   }
+#endif
 
-  // restore things back to the way they were
-  ndiSerialClose(serial_port);
-
-  return NDI_OKAY;
+  void ndiSerialCandidates(std::vector<std::string>& names)
+  {
+#if defined(_WIN32)
+    // only the COM ports that exist
+    char target[1024];
+    for (int i = 0; i < 256; i++)
+    {
+      char comName[16];
+      sprintf_s(comName, sizeof(comName), "COM%d", i + 1);
+      if (QueryDosDeviceA(comName, target, sizeof(target)) != 0)
+      {
+        names.push_back(ndiSerialDeviceName(i));
+      }
+    }
+#elif defined(__APPLE__)
+    std::vector<std::string> targets;
+    ndiAddSerialDevices("/dev", "cu.", names, targets);
+#else
+    // the stable names from udev come first, so that they are the ones
+    // that are reported for USB adapters
+    std::vector<std::string> targets;
+    ndiAddSerialDevices("/dev/serial/by-id", "", names, targets);
+    ndiAddSerialDevices("/dev", "ttyUSB", names, targets);
+    ndiAddSerialDevices("/dev", "ttyACM", names, targets);
+    for (int i = 0; ndiSerialDeviceName(i) != NULL; i++)
+    {
+      const char* name = ndiSerialDeviceName(i);
+      char* target = realpath(name, NULL);
+      if (target != NULL && std::find(targets.begin(), targets.end(), target) == targets.end())
+      {
+        names.push_back(name);
+        targets.push_back(target);
+      }
+      free(target);
+    }
+#endif
+  }
+
+  struct ndiProbeJob
+  {
+    std::string DeviceName;
+    bool CheckDSR;
+    int ResetTimeout;
+    int Result;
+    char Version[1024];
+    NDIThread Thread;
+  };
+
+  void* ndiProbeFunc(void* userdata)
+  {
+    ndiProbeJob* job = (ndiProbeJob*)userdata;
+    job->Result = ndiSerialProbeDevice(job->DeviceName.c_str(), job->CheckDSR, job->ResetTimeout,
+                                       job->Version, sizeof(job->Version));
+    return NULL;
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiProbeAll(ndiProbeResult* results, int maxResults, int resetTimeout, bool checkDSR)
+{
+  std::vector<std::string> names;
+  ndiSerialCandidates(names);
+
+  // every port gets its own thread, so the whole probe takes only as
+  // long as the slowest port
+  std::vector<ndiProbeJob> jobs(names.size());
+  for (size_t i = 0; i < jobs.size(); i++)
+  {
+    jobs[i].DeviceName = names[i];
+    jobs[i].CheckDSR = checkDSR;
+    jobs[i].ResetTimeout = resetTimeout;
+    jobs[i].Result = NDI_PROBE_FAIL;
+    jobs[i].Version[0] = '\0';
+    jobs[i].Thread = ndiThreadSplit(&ndiProbeFunc, &jobs[i]);
+    if (jobs[i].Thread == 0)
+    {
+      // out of threads, so probe this port right away
+      ndiProbeFunc(&jobs[i]);
+    }
+  }
+
+  int count = 0;
+  for (size_t i = 0; i < jobs.size(); i++)
+  {
+    if (jobs[i].Thread != 0)
+    {
+      ndiThreadJoin(jobs[i].Thread);
+    }
+    if (jobs[i].Result == NDI_OKAY && count < maxResults)
+    {
+      ndiProbeResult* result = &results[count++];
+      strncpy(result->DeviceName, jobs[i].DeviceName.c_str(), sizeof(result->DeviceName) - 1);
+      result->DeviceName[sizeof(result->DeviceName) - 1] = '\0';
+      strncpy(result->Version, jobs[i].Version, sizeof(result->Version) - 1);
+      result->Version[sizeof(result->Version) - 1] = '\0';
+    }
+  }
+
+  return count;
+}
+
+//----------------------------------------------------------------------------
+// Defined with ndiGetFrameHostTime(), at the end of this file
+static ndiClockModel* ndiClockModelCreate();
+static void ndiClockModelDestroy(ndiClockModel* model);
+static void ndiClockModelAddFrame(ndiClockModel* model, const ndiFrame* frame);
+static void ndiClockModelAddReply(ndicapi* pol, char command);
+
+//----------------------------------------------------------------------------
+// Defined with ndiDeviceGroupAdd()
+static void ndiDeviceGroupRemove(ndicapi* pol);
+
+//----------------------------------------------------------------------------
+// Defined with ndiReconnect()
+static ndiSession* ndiSessionCreate();
+static void ndiSessionDestroy(ndiSession* session);
+
+//----------------------------------------------------------------------------
+// Defined with ndiGetMetrics(), at the end of this file
+static ndiMetrics* ndiMetricsCreate();
+static void ndiMetricsDestroy(ndiMetrics* metrics);
+static void ndiMetricsCommand(ndicapi* pol, int bytes, unsigned long long sendTime);
+static void ndiMetricsReply(ndicapi* pol, int bytes, unsigned long long sendTime,
+                            unsigned long long firstByteTime, unsigned long long lastByteTime);
+static void ndiMetricsParse(ndicapi* pol, unsigned long long startTime);
+static void ndiMetricsError(ndicapi* pol, int errnum);
+static void ndiMetricsWakeup(ndicapi* pol, unsigned long long arrivalTime);
+static void ndiMetricsDroppedFrame(ndicapi* pol);
+
+//----------------------------------------------------------------------------
+// Defined with ndiGetLatestFrame()
+static ndiFrameRing* ndiFrameRingCreate();
+static void ndiFrameRingReset(ndiFrameRing* ring);
+static void ndiFrameRingDestroy(ndiFrameRing* ring);
+
+//----------------------------------------------------------------------------
+// Allocate a device that communicates through the given socket, or that
+// does not communicate at all if the hostname is NULL.
+static ndicapi* ndiNewNetworkDevice(const char* hostname, int port, NDISocketHandle socket)
+{
+  ndicapi* device = (ndicapi*)malloc(sizeof(ndicapi));
+
+  if (device == 0)
+  {
+    return NULL;
+  }
+
+  memset(device, 0, sizeof(ndicapi));
+  if (hostname)
+  {
+    device->Hostname = (char*)malloc(strlen(hostname) + 1);
+    strcpy(device->Hostname, hostname);
+  }
+  device->Port = port;
+  device->Socket = socket;
+  device->SerialDevice = NDI_INVALID_HANDLE;
+  device->SerialDeviceName = NULL;
+
+  // allocate the buffers, which grow as needed to fit the replies
+  device->ReplySize = 2048;
+  device->Command = (char*)malloc(2048);
+  device->Reply = (char*)malloc(device->ReplySize);
+  device->ReplyNoCRC = (char*)malloc(device->ReplySize);
+
+  // initialize the allocated memory
+  memset(device->Command, 0, 2048);
+  device->Reply[0] = '\0';
+  device->ReplyNoCRC[0] = '\0';
+
+  device->ClockModel = ndiClockModelCreate();
+  device->Session = ndiSessionCreate();
+  device->Metrics = ndiMetricsCreate();
+
+  // an offline device cannot track, so it has no frame ring
+  device->FrameRing = (hostname ? ndiFrameRingCreate() : NULL);
+
+  return device;
+}
+
+//----------------------------------------------------------------------------
+// Open a device name of the form "capture:<file>" or
+// "capture:<file>?speed=<x>" by replaying the capture file.
+static ndicapi* ndiOpenReplay(const char* name)
+{
+  std::string filename(name + strlen("capture:"));
+  double speed = 1.0;
+
+  size_t query = filename.find('?');
+  if (query != std::string::npos)
+  {
+    const char* speedText = strstr(filename.c_str() + query, "speed=");
+    if (speedText != NULL)
+    {
+      speed = atof(speedText + strlen("speed="));
+    }
+    filename.erase(query);
+  }
+
+  NDISocketHandle socket;
+  ndiReplay* replay = ndiReplayCreate(filename.c_str(), speed, &socket);
+  if (replay == NULL)
+  {
+    return NULL;
+  }
+  ndiSocketAttach(socket);
+
+  ndicapi* device = ndiNewNetworkDevice(name, -1, socket);
+  if (device == NULL)
+  {
+    ndiSocketClose(socket);
+    ndiReplayDestroy(replay);
+    return NULL;
+  }
+  device->Replay = replay;
+
+  return device;
 }
 
 //----------------------------------------------------------------------------
@@ -866,6 +1397,11 @@ ndicapiExport ndicapi* ndiOpenSerial(const char* device)
   NDIFileHandle serial_port;
   ndicapi* pol;
 
+  if (strncmp(device, "capture:", 8) == 0)
+  {
+    return ndiOpenReplay(device);
+  }
+
   serial_port = ndiSerialOpen(device);
 
   if (serial_port == NDI_INVALID_HANDLE)
@@ -899,8 +1435,9 @@ ndicapiExport ndicapi* ndiOpenSerial(const char* device)
   // allocate the buffers
   pol->SerialDeviceName = (char*)malloc(strlen(device) + 1);
   pol->Command = (char*)malloc(2048);
-  pol->Reply = (char*)malloc(2048);
-  pol->ReplyNoCRC = (char*)malloc(2048);
+  pol->ReplySize = 2048;
+  pol->Reply = (char*)malloc(pol->ReplySize);
+  pol->ReplyNoCRC = (char*)malloc(pol->ReplySize);
   pol->Hostname = NULL;
   pol->Port = -1;
   pol->Socket = -1;
@@ -931,8 +1468,13 @@ ndicapiExport ndicapi* ndiOpenSerial(const char* device)
   // initialize the allocated memory
   strcpy(pol->SerialDeviceName, device);
   memset(pol->Command, 0, 2048);
-  memset(pol->Reply, 0, 2048);
-  memset(pol->ReplyNoCRC, 0, 2048);
+  pol->Reply[0] = '\0';
+  pol->ReplyNoCRC[0] = '\0';
+
+  pol->ClockModel = ndiClockModelCreate();
+  pol->Session = ndiSessionCreate();
+  pol->Metrics = ndiMetricsCreate();
+  pol->FrameRing = ndiFrameRingCreate();
 
   return pol;
 }
@@ -943,14 +1485,17 @@ ndicapiExport ndicapi* ndiOpenNetwork(const char* hostname, int port)
   NDISocketHandle socket;
   ndicapi* device;
 
-  int connected = ndiSocketOpen(hostname, port, socket);
+  if (strncmp(hostname, "capture:", 8) == 0)
+  {
+    return ndiOpenReplay(hostname);
+  }
 
-  if (socket == -1 || connected == -1)
+  if (!ndiSocketOpen(hostname, port, socket))
   {
     return NULL;
   }
 
-  device = (ndicapi*)malloc(sizeof(ndicapi));
+  device = ndiNewNetworkDevice(hostname, port, socket);
 
   if (device == 0)
   {
@@ -958,27 +1503,15 @@ ndicapiExport ndicapi* ndiOpenNetwork(const char* hostname, int port)
     return NULL;
   }
 
-  memset(device, 0, sizeof(ndicapi));
-  device->Hostname = new char[strlen(hostname) + 1];
-  device->Hostname = strncpy(device->Hostname, hostname, strlen(hostname));
-  device->Port = port;
-  device->Socket = socket;
-  device->SerialDevice = NDI_INVALID_HANDLE;
-  device->SerialDeviceName = NULL;
-
-  // allocate the buffers
-  device->Command = (char*)malloc(2048);
-  device->Reply = (char*)malloc(2048);
-  device->ReplyNoCRC = (char*)malloc(2048);
-
-  // initialize the allocated memory
-  memset(device->Command, 0, 2048);
-  memset(device->Reply, 0, 2048);
-  memset(device->ReplyNoCRC, 0, 2048);
-
   return device;
 }
 
+//----------------------------------------------------------------------------
+ndicapiExport ndicapi* ndiOpenOffline()
+{
+  return ndiNewNetworkDevice(NULL, -1, -1);
+}
+
 //----------------------------------------------------------------------------
 ndicapiExport char* ndiGetSerialDeviceName(ndicapi* pol)
 {
@@ -1009,20 +1542,51 @@ ndicapiExport NDIFileHandle ndiGetDeviceHandle(ndicapi* pol)
   return pol->SerialDevice;
 }
 
+//----------------------------------------------------------------------------
+// Defined with ndiCommandAsync(), at the end of this file
+static void ndiCommandQueueStop(ndicapi* pol);
+
 //----------------------------------------------------------------------------
 ndicapiExport void ndiCloseSerial(ndicapi* device)
 {
-  // end the tracking thread if it is running
+  // a replayed capture uses a socket rather than a serial port
+  if (device->Replay)
+  {
+    ndiCloseNetwork(device);
+    return;
+  }
+
+  // the group must not use the device after it is freed
+  ndiDeviceGroupRemove(device);
+
+  // end the streaming session or the tracking thread if either is running
+  ndiStopStreaming(device);
   ndiSetThreadMode(device, 0);
 
-  // close the serial port
-  ndiSerialClose(device->SerialDevice);
+  // finish any commands that were queued by ndiCommandAsync()
+  ndiCommandQueueStop(device);
+  ndiStopCapture(device);
+
+  // close the serial port, unless it could not be opened again
+  if (device->SerialDevice != NDI_INVALID_HANDLE)
+  {
+    ndiSerialClose(device->SerialDevice);
+  }
 
   // free the buffers
   free(device->SerialDeviceName);
   free(device->Command);
   free(device->Reply);
   free(device->ReplyNoCRC);
+  ndiFreeReplyData(device);
+  ndiClockModelDestroy(device->ClockModel);
+  device->ClockModel = NULL;
+  ndiSessionDestroy(device->Session);
+  device->Session = NULL;
+  ndiMetricsDestroy(device->Metrics);
+  device->Metrics = NULL;
+  ndiFrameRingDestroy(device->FrameRing);
+  device->FrameRing = NULL;
   device->SerialDeviceName = NULL;
   device->SerialDevice = NDI_INVALID_HANDLE;
 
@@ -1032,17 +1596,39 @@ ndicapiExport void ndiCloseSerial(ndicapi* device)
 //----------------------------------------------------------------------------
 ndicapiExport void ndiCloseNetwork(ndicapi* device)
 {
-  // end the tracking thread if it is running
+  // the group must not use the device after it is freed
+  ndiDeviceGroupRemove(device);
+
+  // end the streaming session or the tracking thread if either is running
+  ndiStopStreaming(device);
   ndiSetThreadMode(device, 0);
 
-  // close the serial port
-  ndiSocketClose(device->Socket);
+  // finish any commands that were queued by ndiCommandAsync()
+  ndiCommandQueueStop(device);
+  ndiStopCapture(device);
+
+  // close the socket, and then stop the replay if this is one
+  if (device->Socket != -1)
+  {
+    ndiSocketClose(device->Socket);
+  }
+  ndiReplayDestroy(device->Replay);
+  device->Replay = NULL;
 
   // free the buffers
   free(device->Hostname);
   free(device->Command);
   free(device->Reply);
   free(device->ReplyNoCRC);
+  ndiFreeReplyData(device);
+  ndiClockModelDestroy(device->ClockModel);
+  device->ClockModel = NULL;
+  ndiSessionDestroy(device->Session);
+  device->Session = NULL;
+  ndiMetricsDestroy(device->Metrics);
+  device->Metrics = NULL;
+  ndiFrameRingDestroy(device->FrameRing);
+  device->FrameRing = NULL;
   device->Hostname = NULL;
   device->Port = -1;
   device->Socket = -1;
@@ -1051,1056 +1637,1008 @@ ndicapiExport void ndiCloseNetwork(ndicapi* device)
 }
 
 //----------------------------------------------------------------------------
-// the CalcCRC16 function is taken from the NDI ndicapi documentation
-//----------------------------------------------------------------------------*/
-// Name:                   CalcCRC16
-//
-// Input Values:
-//     int
-//         data        :Data value to add to running CRC16.
-//     unsigned int
-//         *puCRC16    :Ptr. to running CRC16.
-//
-// Output Values:
-//     None.
-//
-// Returned Value:
-//     None.
-//
-// Description:
-//     This routine calculates a running CRC16 using the polynomial
-//     X^16 + X^15 + X^2 + 1.
-//
-static const int oddparity[16] = { 0, 1, 1, 0, 1, 0, 0, 1,
-                                   1, 0, 0, 1, 0, 1, 1, 0
-                                 };
-
-#define CalcCRC16(nextchar, puCRC16) \
-{ \
-    int data; \
-    data = nextchar; \
-    data = (data ^ (*(puCRC16) & 0xff)) & 0xff; \
-    *puCRC16 >>= 8; \
-    if ( oddparity[data & 0x0f] ^ oddparity[data >> 4] ) { \
-      *(puCRC16) ^= 0xc001; \
-    } \
-    data <<= 6; \
-    *puCRC16 ^= data; \
-    data <<= 1; \
-    *puCRC16 ^= data; \
-}
-
-//----------------------------------------------------------------------------
-// Prototypes for helper functions for certain commands.  These functions
-//   are called whenever the corresponding command sent the Measurement System
-//   unless an error was generated.
-//
-//   cp  -> the command string that was sent to the NDICAPI
-//   crp -> the reply from the Measurement System, but with the CRC hacked off
-
+// Files that are kept between sessions, e.g. the baud rate that was chosen
+// for each device.  They go in $NDICAPI_CACHE_DIR if it is set, otherwise
+// in an "ndicapi" folder in the user's cache directory.
 namespace
 {
-  //----------------------------------------------------------------------------
-  // Copy all the PHINF reply information into the ndicapi structure, according
-  // to the PHINF reply mode that was requested.
-  //
-  // This function is called every time a PHINF command is sent to the
-  // Measurement System.
-  //
-  // This information can be later extracted through one of the ndiGetPHINFxx()
-  // functions.
-  void ndiPHINFHelper(ndicapi* pol, const char* cp, const char* crp)
+  bool ndiMakeDirectory(const std::string& path)
   {
-    unsigned long mode = 0x0001; // the default reply mode
-    char* dp;
-    int j;
-    int unoccupied = NDI_OKAY;
-
-    // if the PHINF command had a reply mode, read it
-    if ((cp[5] == ':' && cp[10] != '\r') || (cp[5] == ' ' && cp[6] != '\r'))
-    {
-      mode = ndiHexToUnsignedLong(&cp[8], 4);
-    }
+#if defined(_WIN32)
+    return (_mkdir(path.c_str()) == 0 || errno == EEXIST);
+#else
+    return (mkdir(path.c_str(), 0755) == 0 || errno == EEXIST);
+#endif
+  }
 
-    // check for unoccupied
-    if (*crp == 'U')
+  bool ndiCacheFileName(const char* name, std::string& path)
+  {
+    const char* dir = getenv("NDICAPI_CACHE_DIR");
+    if (dir != NULL && dir[0] != '\0')
     {
-      unoccupied = NDI_UNOCCUPIED;
+      path = dir;
     }
-    pol->PhinfUnoccupied = unoccupied;
-
-    // fprintf(stderr, "mode = %04lx\n", mode);
-
-    if (mode & NDI_BASIC)
+    else
     {
-      dp = pol->PhinfBasic;
-      if (!unoccupied)
+#if defined(_WIN32)
+      dir = getenv("LOCALAPPDATA");
+      if (dir == NULL || dir[0] == '\0')
       {
-        for (j = 0; j < 33 && *crp >= ' '; j++)
-        {
-          // fprintf(stderr,"%c",*crp);
-          *dp++ = *crp++;
-        }
-        // fprintf(stderr,"\n");
+        return false;
       }
-      else    // default "00000000            0000000000000"
+      path = std::string(dir) + "\\ndicapi";
+#elif defined(__APPLE__)
+      dir = getenv("HOME");
+      if (dir == NULL || dir[0] == '\0')
       {
-        for (j = 0; j < 8; j++)
-        {
-          *dp++ = '0';
-        }
-        for (j = 0; j < 12; j++)
-        {
-          *dp++ = ' ';
-        }
-        for (j = 0; j < 13; j++)
-        {
-          *dp++ = '0';
-        }
+        return false;
       }
-    }
-
-    if (mode & NDI_TESTING)
-    {
-      dp = pol->PhinfTesting;
-      if (!unoccupied)
+      path = std::string(dir) + "/Library/Caches/ndicapi";
+#else
+      dir = getenv("XDG_CACHE_HOME");
+      if (dir != NULL && dir[0] != '\0')
       {
-        for (j = 0; j < 8 && *crp >= ' '; j++)
-        {
-          *dp++ = *crp++;
-        }
+        path = dir;
       }
-      else   // default "00000000"
+      else
       {
-        for (j = 0; j < 8; j++)
+        dir = getenv("HOME");
+        if (dir == NULL || dir[0] == '\0')
         {
-          *dp++ = '0';
+          return false;
         }
+        path = std::string(dir) + "/.cache";
+        ndiMakeDirectory(path);
       }
+      path += "/ndicapi";
+#endif
     }
 
-    if (mode & NDI_PART_NUMBER)
+    if (!ndiMakeDirectory(path))
     {
-      dp = pol->PhinfPartNumber;
-      if (!unoccupied)
-      {
-        for (j = 0; j < 20 && *crp >= ' '; j++)
-        {
-          *dp++ = *crp++;
-        }
-      }
-      else   // default "                    "
-      {
-        for (j = 0; j < 20; j++)
-        {
-          *dp++ = ' ';
-        }
-      }
+      return false;
     }
+#if defined(_WIN32)
+    path += "\\";
+#else
+    path += "/";
+#endif
+    path += name;
+    return true;
+  }
 
-    if (mode & NDI_ACCESSORIES)
+  // Read the lines of a cache file that are of the form "key value".
+  void ndiReadCacheFile(const char* name, std::vector<std::pair<std::string, std::string> >& entries)
+  {
+    std::string path;
+    FILE* file;
+    char line[1024];
+
+    if (!ndiCacheFileName(name, path) || (file = fopen(path.c_str(), "r")) == NULL)
     {
-      dp = pol->PhinfAccessories;
-      if (!unoccupied)
-      {
-        for (j = 0; j < 2 && *crp >= ' '; j++)
-        {
-          *dp++ = *crp++;
-        }
-      }
-      else   // default "00"
+      return;
+    }
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+      char* value = strchr(line, '\t');
+      if (value != NULL)
       {
-        for (j = 0; j < 2; j++)
-        {
-          *dp++ = '0';
-        }
+        *value++ = '\0';
+        value[strcspn(value, "\r\n")] = '\0';
+        entries.push_back(std::make_pair(std::string(line), std::string(value)));
       }
     }
+    fclose(file);
+  }
 
-    if (mode & NDI_MARKER_TYPE)
+  // Write all the entries of a cache file.  The file is replaced rather
+  // than rewritten, so that other processes never see half of it.
+  bool ndiWriteCacheFile(const char* name, const std::vector<std::pair<std::string, std::string> >& entries)
+  {
+    std::string path;
+    if (!ndiCacheFileName(name, path))
     {
-      dp = pol->PhinfMarkerType;
-      if (!unoccupied)
-      {
-        for (j = 0; j < 2 && *crp >= ' '; j++)
-        {
-          *dp++ = *crp++;
-        }
-      }
-      else   // default "00"
-      {
-        for (j = 0; j < 2; j++)
-        {
-          *dp++ = '0';
-        }
-      }
+      return false;
     }
 
-    if (mode & NDI_PORT_LOCATION)
+    std::string temp = path + ".tmp";
+    FILE* file = fopen(temp.c_str(), "w");
+    if (file == NULL)
     {
-      dp = pol->PhinfPortLocation;
-      if (!unoccupied)
-      {
-        for (j = 0; j < 14 && *crp >= ' '; j++)
-        {
-          *dp++ = *crp++;
-        }
-      }
-      else   // default "00000000000000"
-      {
-        for (j = 0; j < 14; j++)
-        {
-          *dp++ = '0';
-        }
-      }
+      return false;
     }
-
-    if (mode & NDI_GPIO_STATUS)
+    for (size_t i = 0; i < entries.size(); i++)
     {
-      dp = pol->PhinfGpioStatus;
-      if (!unoccupied)
-      {
-        for (j = 0; j < 2 && *crp >= ' '; j++)
-        {
-          *dp++ = *crp++;
-        }
-      }
-      else   // default "00"
-      {
-        for (j = 0; j < 2; j++)
-        {
-          *dp++ = '0';
-        }
-      }
+      fprintf(file, "%s\t%s\n", entries[i].first.c_str(), entries[i].second.c_str());
+    }
+    if (fclose(file) != 0)
+    {
+      remove(temp.c_str());
+      return false;
     }
+#if defined(_WIN32)
+    if (!MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+#else
+    if (rename(temp.c_str(), path.c_str()) != 0)
+#endif
+    {
+      remove(temp.c_str());
+      return false;
+    }
+    return true;
   }
 
-  //----------------------------------------------------------------------------
-  //Copy all the PHRQ reply information into the ndicapi structure.
-  //
-  //This function is called every time a PHRQ command is sent to the
-  //Measurement System.
-  //
-  //This information can be later extracted through one of the ndiGetPHRQHandle()
-  //functions.
-  void ndiPHRQHelper(ndicapi* pol, const char* cp, const char* crp)
+  // Set the value for a key in a cache file.
+  bool ndiWriteCacheEntry(const char* name, const std::string& key, const std::string& value)
   {
-    char* dp;
-    int j;
-
-    dp = pol->PhrqReply;
-    for (j = 0; j < 2; j++)
+    std::vector<std::pair<std::string, std::string> > entries;
+    ndiReadCacheFile(name, entries);
+    for (size_t i = entries.size(); i > 0; i--)
     {
-      *dp++ = *crp++;
+      if (entries[i - 1].first == key)
+      {
+        entries.erase(entries.begin() + (i - 1));
+      }
     }
+    entries.push_back(std::make_pair(key, value));
+    return ndiWriteCacheFile(name, entries);
   }
 
-  //----------------------------------------------------------------------------
-  // Copy all the PHSR reply information into the ndicapi structure.
-  //
-  // This function is called every time a PHSR command is sent to the
-  // Measurement System.
-  //
-  // This information can be later extracted through one of the ndiGetPHSRxx()
-  // functions.
-  void ndiPHSRHelper(ndicapi* pol, const char* command, const char* commandReply)
+  // Remove the entries whose keys start with the prefix from a cache file.
+  bool ndiRemoveCacheEntries(const char* name, const std::string& prefix)
   {
-    char* writePointer;
-    int j;
-
-    writePointer = pol->PhsrReply;
-    for (j = 0; j < 1282 && *commandReply >= ' '; j++)
+    std::vector<std::pair<std::string, std::string> > entries;
+    ndiReadCacheFile(name, entries);
+    size_t n = entries.size();
+    for (size_t i = n; i > 0; i--)
     {
-      *writePointer++ = *commandReply++;
+      if (entries[i - 1].first.compare(0, prefix.size(), prefix) == 0)
+      {
+        entries.erase(entries.begin() + (i - 1));
+      }
     }
-    *writePointer++ = '\0';
+    return (entries.size() == n || ndiWriteCacheFile(name, entries));
   }
+}
 
-  //----------------------------------------------------------------------------
-  // Copy all the TX reply information into the ndicapi structure, according
-  // to the TX reply mode that was requested.
-  //
-  // This function is called every time a TX command is sent to the
-  // Measurement System.
-  //
-  // This information can be later extracted through one of the ndiGetTXxx()
-  // functions.
-  void ndiTXHelper(ndicapi* pol, const char* command, const char* commandReply)
+//----------------------------------------------------------------------------
+// Baud rate negotiation.  The rates are tried from slowest to fastest, and
+// each one must pass an echo burst before the next one is tried.
+namespace
+{
+  struct ndiBaudRate
   {
-    unsigned long mode = NDI_XFORMS_AND_STATUS; // the default reply mode
-    char* writePointer;
-    int i, j, n;
-    int handle, handleCount, strayCount;
+    int Rate;                             // bits per second
+    char Code;                            // the baud rate digit for COMM
+  };
 
-    // if the TX command had a reply mode, read it
-    if ((command[2] == ':' && command[7] != '\r') || (command[2] == ' ' && command[3] != '\r'))
+  const ndiBaudRate ndiBaudRates[] =
+  {
+    { 9600, '0' }, { 115200, '5' }, { 230400, 'A' }, { 921600, '6' }, { 1228739, '7' }
+  };
+
+  const int ndiNumberOfBaudRates = sizeof(ndiBaudRates) / sizeof(ndiBaudRates[0]);
+
+  // Get the serial number from the reply to VER:0, e.g. "NDI S/N: P6-00451".
+  std::string ndiVersionSerialNumber(const char* version)
+  {
+    const char* cp = strstr(version, "S/N:");
+    if (cp == NULL)
     {
-      mode = ndiHexToUnsignedLong(&command[3], 4);
+      return std::string();
     }
-
-    // get the number of handles
-    handleCount = (int)ndiHexToUnsignedLong(commandReply, 2);
-    for (j = 0; j < 2 && *commandReply >= ' '; j++)
+    cp += 4;
+    while (*cp == ' ' || *cp == '\t')
     {
-      commandReply++;
+      cp++;
     }
+    size_t n = strcspn(cp, " \t\r\n");
+    return std::string(cp, n);
+  }
 
-    // go through the information for each handle
-    for (i = 0; i < handleCount; i++)
+  // Send ECHO commands with a mix of characters, every reply must come
+  // back with a good CRC and the same text.
+  bool ndiEchoBurst(ndicapi* pol)
+  {
+    static const char characters[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+    unsigned int seed = 0x5eed;
+    char text[129];
+
+    for (int i = 0; i < 8; i++)
     {
-      // get the handle itself (two chars)
-      handle = (int)ndiHexToUnsignedLong(commandReply, 2);
-      for (j = 0; j < 2 && *commandReply >= ' '; j++)
+      for (int j = 0; j < 128; j++)
       {
-        commandReply++;
+        seed = seed * 1103515245u + 12345u;
+        text[j] = characters[(seed >> 16) % (sizeof(characters) - 1)];
       }
+      text[128] = '\0';
 
-      // check for "UNOCCUPIED"
-      if (*commandReply == 'U')
+      const char* reply = ndiCommand(pol, "ECHO:%s", text);
+      if (ndiGetError(pol) != NDI_OKAY || strcmp(reply, text) != 0)
       {
-        for (j = 0; j < 10 && *commandReply >= ' '; j++)
-        {
-          commandReply++;
-        }
-        // back up and continue (don't store information for unoccupied ports)
-        i--;
-        handleCount--;
-        continue;
+        return false;
       }
+    }
+    return true;
+  }
 
-      // save the port handle in the list
-      pol->TxHandles[i] = handle;
-
-      if (mode & NDI_XFORMS_AND_STATUS)
-      {
-        // get the transform, MISSING, or DISABLED
-        writePointer = pol->TxTransforms[i];
+  // Ask the device to switch rates, and check the new rate.
+  bool ndiSwitchBaudRate(ndicapi* pol, const ndiBaudRate& rate, int handshake)
+  {
+    ndiCommand(pol, "COMM:%c000%d", rate.Code, handshake);
+    return (ndiGetError(pol) == NDI_OKAY && ndiEchoBurst(pol));
+  }
 
-        if (*commandReply == 'M')
-        {
-          // check for "MISSING"
-          for (j = 0; j < 7 && *commandReply >= ' '; j++)
-          {
-            *writePointer++ = *commandReply++;
-          }
-        }
-        else if (*commandReply == 'D')
-        {
-          // check for "DISABLED"
-          for (j = 0; j < 8 && *commandReply >= ' '; j++)
-          {
-            *writePointer++ = *commandReply++;
-          }
-        }
-        else
-        {
-          // read the transform
-          for (j = 0; j < 51 && *commandReply >= ' '; j++)
-          {
-            *writePointer++ = *commandReply++;
-          }
-        }
-        *writePointer = '\0';
+  // Whether the host serial port can be set to this rate at all.
+  bool ndiHostSupportsBaudRate(ndicapi* pol, int rate, int handshake, int currentRate, int currentHandshake)
+  {
+    bool supported = (ndiSerialComm(pol->SerialDevice, rate, "8N1", handshake) == 0);
+    ndiSerialComm(pol->SerialDevice, currentRate, "8N1", currentHandshake);
+    return supported;
+  }
 
-        // get the status
-        writePointer = pol->TxStatus[i];
-        for (j = 0; j < 8 && *commandReply >= ' '; j++)
-        {
-          *writePointer++ = *commandReply++;
-        }
+  // Go back to a rate that is known to work after a rate failed.  The COMM
+  // command usually gets through even if the replies do not, but if it
+  // doesn't then the device is reset with a serial break.
+  bool ndiRecoverBaudRate(ndicapi* pol, const ndiBaudRate& rate, int handshake)
+  {
+    ndiCommand(pol, "COMM:%c000%d", rate.Code, handshake);
+    ndiSerialSleep(pol->SerialDevice, 100);
+    ndiSerialComm(pol->SerialDevice, rate.Rate, "8N1", handshake);
+    ndiSerialFlush(pol->SerialDevice, NDI_IOFLUSH);
+    if (ndiEchoBurst(pol))
+    {
+      return true;
+    }
 
-        // get the frame number
-        writePointer = pol->TxFrame[i];
-        for (j = 0; j < 8 && *commandReply >= ' '; j++)
-        {
-          *writePointer++ = *commandReply++;
-        }
-      }
+    ndiCommand(pol, NULL);
+    if (ndiGetError(pol) != NDI_OKAY)
+    {
+      return false;
+    }
+    ndiCommand(pol, "INIT:");
+    if (ndiGetError(pol) != NDI_OKAY)
+    {
+      return false;
+    }
+    return (rate.Rate == 9600 || ndiSwitchBaudRate(pol, rate, handshake));
+  }
+}
 
-      // grab additional information
-      if (mode & NDI_ADDITIONAL_INFO)
+namespace
+{
+  // Find the fastest rate, or return -1 if the device stopped answering.
+  int ndiFindBaudRate(ndicapi* pol, const std::string& serialNumber, int maxBaudRate, int handshake)
+  {
+    // first try the rate that was chosen for this device before
+    if (!serialNumber.empty())
+    {
+      std::vector<std::pair<std::string, std::string> > entries;
+      ndiReadCacheFile("baudrates", entries);
+      int cached = 0;
+      int cachedHandshake = -1;
+      for (size_t i = 0; i < entries.size(); i++)
       {
-        writePointer = pol->TxInformation[i];
-        for (j = 0; j < 20 && *commandReply >= ' '; j++)
+        if (entries[i].first == serialNumber)
         {
-          *writePointer++ = *commandReply++;
+          sscanf(entries[i].second.c_str(), "%d %d", &cached, &cachedHandshake);
         }
       }
-
-      // grab the single marker info
-      if (mode & NDI_SINGLE_STRAY)
+      for (int i = 1; i < ndiNumberOfBaudRates; i++)
       {
-        writePointer = pol->TxSingleStray[i];
-        if (*commandReply == 'M')
-        {
-          // check for "MISSING"
-          for (j = 0; j < 7 && *commandReply >= ' '; j++)
-          {
-            *writePointer++ = *commandReply++;
-          }
-        }
-        else if (*commandReply == 'D')
+        if (ndiBaudRates[i].Rate == cached && cachedHandshake == handshake &&
+            (maxBaudRate <= 0 || cached <= maxBaudRate) &&
+            ndiHostSupportsBaudRate(pol, cached, handshake, 9600, 0))
         {
-          // check for "DISABLED"
-          for (j = 0; j < 8 && *commandReply >= ' '; j++)
+          if (ndiSwitchBaudRate(pol, ndiBaudRates[i], handshake))
           {
-            *writePointer++ = *commandReply++;
+            return i;
           }
-        }
-        else
-        {
-          // read the single stray position
-          for (j = 0; j < 21 && *commandReply >= ' '; j++)
+          if (!ndiRecoverBaudRate(pol, ndiBaudRates[0], 0))
           {
-            *writePointer++ = *commandReply++;
+            return -1;
           }
         }
-        *writePointer = '\0';
-      }
-
-      // skip over any unsupported information
-      while (*commandReply >= ' ')
-      {
-        commandReply++;
-      }
-
-      // eat the trailing newline
-      if (*commandReply == '\n')
-      {
-        commandReply++;
       }
     }
 
-    // save the number of handles (minus the unoccupied handles)
-    pol->TxHandleCount = handleCount;
-
-    // get all the passive stray information
-    // this will be a maximum of 2 + ceil(numMarkers*0.5) + Y
-    // where Y is
-    //   0800 not used: 21 * numMarkers inside characterized measurement volume
-    //   0800 used: 21 * numMarkers
-    if (mode & NDI_PASSIVE_STRAY)
+    // step up through the rates until one of them fails
+    int best = 0;
+    for (int i = 1; i < ndiNumberOfBaudRates; i++)
     {
-      // get the number of strays
-      strayCount = (int)ndiHexToUnsignedLong(commandReply, 2);
-      for (j = 0; j < 2 && *commandReply >= ' '; j++)
+      const ndiBaudRate& rate = ndiBaudRates[i];
+      if (maxBaudRate > 0 && rate.Rate > maxBaudRate)
       {
-        commandReply++;
+        break;
       }
-      if (strayCount > 50)
+      if (!ndiHostSupportsBaudRate(pol, rate.Rate, handshake, ndiBaudRates[best].Rate, (best == 0 ? 0 : handshake)))
       {
-        strayCount = 50;
+        continue;
       }
-      pol->TxPassiveStrayCount = strayCount;
-      // get the out-of-volume bits
-      writePointer = pol->TxPassiveStrayOov;
-      n = (strayCount + 3) / 4;
-      for (j = 0; j < n && *commandReply >= ' '; j++)
+      if (!ndiSwitchBaudRate(pol, rate, handshake))
       {
-        *writePointer++ = *commandReply++;
+        if (!ndiRecoverBaudRate(pol, ndiBaudRates[best], (best == 0 ? 0 : handshake)))
+        {
+          return -1;
+        }
+        break;
       }
-      // get the coordinates
-      writePointer = pol->TxPassiveStray;
-      n = strayCount * 21;
-      for (j = 0; j < n && *commandReply >= ' '; j++)
-      {
-        *writePointer++ = *commandReply++;
-      }
-      *writePointer = '\0';
+      best = i;
     }
 
-    // get the system status
-    writePointer = pol->TxSystemStatus;
-    for (j = 0; j < 4 && *commandReply >= ' '; j++)
+    if (!serialNumber.empty())
     {
-      *writePointer++ = *commandReply++;
+      char value[32];
+      sprintf(value, "%d %d", ndiBaudRates[best].Rate, handshake);
+      ndiWriteCacheEntry("baudrates", serialNumber, value);
     }
+
+    return best;
   }
+}
 
-  //----------------------------------------------------------------------------
-  // Copy all the BX reply information into the ndicapi structure, according
-  // to the BX reply mode that was requested.
-  //
-  // This function is called every time a BX command is sent to the Measurement System.
-  //
-  // This information can be later extracted through one of the ndiGetTXxx()
-  // functions.
-  void ndiBXHelper(ndicapi* api, const char* command, const char* commandReply)
+//----------------------------------------------------------------------------
+ndicapiExport int ndiNegotiateBaudRate(ndicapi* pol, int maxBaudRate, int handshake)
+{
+  if (pol->SerialDevice == NDI_INVALID_HANDLE || pol->IsThreadedMode || pol->Stream || pol->Group)
   {
-    // Reply options
-    // NDI_XFORMS_AND_STATUS  0x0001  /* transforms and status */
-    // NDI_ADDITIONAL_INFO    0x0002  /* additional tool transform info */
-    // NDI_SINGLE_STRAY       0x0004  /* stray active marker reporting */
-    // NDI_FRAME_NUMBER       0x0008  /* frame number for each tool */
-    // NDI_PASSIVE            0x8000  /* report passive tool information */
-    // NDI_PASSIVE_EXTRA      0x2000  /* add 6 extra passive tools */
-    // NDI_PASSIVE_STRAY      0x1000  /* stray passive marker reporting */
-    unsigned long mode = NDI_XFORMS_AND_STATUS;
-    const char* replyIndex;
-    unsigned short headerCRC;
+    ndiSetError(pol, NDI_INVALID_MODE);
+    return 0;
+  }
+  handshake = (handshake != 0);
 
-    // if the BX command had a reply option, read it
-    if ((command[2] == ':' && command[7] != '\r') || (command[2] == ' ' && command[3] != '\r'))
-    {
-      mode = ndiHexToUnsignedLong(&command[3], 4);
-    }
+  // start from the power-up rate, which always works
+  ndiCommand(pol, "COMM:00000");
+  if (ndiGetError(pol) != NDI_OKAY)
+  {
+    return 0;
+  }
+  std::string serialNumber = ndiVersionSerialNumber(ndiCommand(pol, "VER:0"));
+  if (ndiGetError(pol) != NDI_OKAY)
+  {
+    return 0;
+  }
 
-    replyIndex = &commandReply[0];
+  // the rates that fail are expected to give errors, so they are not
+  // reported, and they should not cost the full timeout
+  NDIErrorCallback callback = pol->ErrorCallback;
+  pol->ErrorCallback = NULL;
+  ndiSerialTimeout(pol->SerialDevice, 500);
 
-    // Confirm start sequence
-    if (replyIndex[0] != (char)0xc4 || replyIndex[1] != (char)0xa5)  // little endian
-    {
-      // Something isn't right, abort
-      return;
-    }
-    replyIndex += 2;
+  int i = ndiFindBaudRate(pol, serialNumber, maxBaudRate, handshake);
 
-    // Get the reply length
-    api->BxReplyLength = (unsigned char)replyIndex[1] << 8 | (unsigned char)replyIndex[0];
-    replyIndex += 2;
+  ndiSerialTimeout(pol->SerialDevice, 5000);
+  pol->ErrorCallback = callback;
 
-    // Get the CRC
-    headerCRC = (unsigned char)replyIndex[1] << 8 | (unsigned char)replyIndex[0];
-    replyIndex += 2;
+  if (i < 0)
+  {
+    ndiSetError(pol, (pol->ErrorCode != NDI_OKAY ? pol->ErrorCode : NDI_COMM_FAIL));
+    return 0;
+  }
+  pol->ErrorCode = NDI_OKAY;
 
-    // Get the number of handles
-    api->BxHandleCount = (unsigned char)replyIndex[0];
-    replyIndex += 1;
+  return ndiBaudRates[i].Rate;
+}
 
-    // Go through the information for each handle
-    for (unsigned short i = 0; i < api->BxHandleCount; i++)
-    {
-      // get the handle itself
-      api->BxHandles[i] = (char)replyIndex[0];
-      replyIndex++;
+//----------------------------------------------------------------------------
+ndicapiExport int ndiStartCapture(ndicapi* pol, const char* filename)
+{
+  // the background threads use the capture without a lock
+  if (pol->IsThreadedMode || pol->Stream || pol->Group)
+  {
+    return NDI_INVALID_MODE;
+  }
+  ndiCommandQueueStop(pol);
 
-      api->BxHandlesStatus[i] = (char)replyIndex[0];
-      replyIndex++;
+  ndiCapture* capture = ndiCaptureCreate(filename);
+  if (capture == NULL)
+  {
+    return NDI_OPEN_ERROR;
+  }
 
-      // Disabled handles have no reply data
-      if (api->BxHandlesStatus[i] == NDI_HANDLE_DISABLED)
-      {
-        continue;
-      }
+  ndiCaptureDestroy(pol->Capture);
+  pol->Capture = capture;
 
-      if (mode & NDI_XFORMS_AND_STATUS)
-      {
-        if (api->BxHandlesStatus[i] != NDI_HANDLE_MISSING)
-        {
-          // 4 float, Q0, Qx, Qy, Qz
-          api->BxTransforms[i][0] = *(float*)replyIndex;
-          replyIndex += 4;
-          api->BxTransforms[i][1] = *(float*)replyIndex;
-          replyIndex += 4;
-          api->BxTransforms[i][2] = *(float*)replyIndex;
-          replyIndex += 4;
-          api->BxTransforms[i][3] = *(float*)replyIndex;
-          replyIndex += 4;
+  return NDI_OKAY;
+}
 
-          // 3 float, Tx, Ty, Tz
-          api->BxTransforms[i][4] = *(float*)replyIndex;
-          replyIndex += 4;
-          api->BxTransforms[i][5] = *(float*)replyIndex;
-          replyIndex += 4;
-          api->BxTransforms[i][6] = *(float*)replyIndex;
-          replyIndex += 4;
+//----------------------------------------------------------------------------
+ndicapiExport int ndiStopCapture(ndicapi* pol)
+{
+  if (pol->IsThreadedMode || pol->Stream || pol->Group)
+  {
+    return NDI_INVALID_MODE;
+  }
+  ndiCommandQueueStop(pol);
 
-          // 1 float, RMS error
-          api->BxTransforms[i][7] = *(float*)replyIndex;
-          replyIndex += 4;
-        }
-        // 4 bytes port status
-        api->BxPortStatus[i] = (int)replyIndex[0] | (int)replyIndex[1] << 8 | (int)replyIndex[2] << 16 | (int)replyIndex[3] << 24;
-        replyIndex += 4;
-        // 4 bytes frame number
-        api->BxFrameNumber[i] = (unsigned char)replyIndex[0] | (unsigned char)replyIndex[1] << 8 | (unsigned char)replyIndex[2] << 16 | (unsigned char)replyIndex[3] << 24;
-        replyIndex += 4;
-      }
+  ndiCaptureDestroy(pol->Capture);
+  pol->Capture = NULL;
 
-      // grab additional information
-      if (mode & NDI_ADDITIONAL_INFO)
+  return NDI_OKAY;
+}
+
+//----------------------------------------------------------------------------
+// The NDI CRC16 uses the polynomial X^16 + X^15 + X^2 + 1, bit-reversed
+// (0xA001), with an initial value of zero.  The NDI documentation gives a
+// routine that adds one character at a time, here it is table driven:
+// Table[0] is the usual byte-at-a-time table, and Table[k] gives the CRC
+// of a byte that is followed by k zero bytes, so that four bytes can be
+// processed per step ("slicing-by-4").
+namespace
+{
+  struct ndiCRC16Tables
+  {
+    unsigned short Table[4][256];
+
+    ndiCRC16Tables()
+    {
+      for (int i = 0; i < 256; i++)
       {
-        api->BxToolMarkerInformation[i][0] = (char)replyIndex[0];
-        replyIndex++;
-        for (int j = 0; j < 10; j++)
+        unsigned short crc = (unsigned short)i;
+        for (int bit = 0; bit < 8; bit++)
         {
-          api->BxToolMarkerInformation[i][j + 1] = (char)replyIndex[0];
-          replyIndex++;
+          crc = ((crc & 1) ? ((crc >> 1) ^ 0xA001) : (crc >> 1));
         }
+        Table[0][i] = crc;
       }
-
-      // grab the single marker info
-      if (mode & NDI_SINGLE_STRAY)
+      for (int k = 1; k < 4; k++)
       {
-        char activeStatus = (char)replyIndex[0];
-        replyIndex++;
-        api->BxActiveSingleStrayMarkerStatus[i] = activeStatus;
-
-        if (activeStatus != 0x00 || (mode & NDI_NOT_NORMALLY_REPORTED && activeStatus & NDI_ACTIVE_STRAY_OUT_OF_VOLUME))
+        for (int i = 0; i < 256; i++)
         {
-          // Marker is not missing, or it is out-of-volume and not-normally-requested is requested
-          // Either means we have data...
-          // 3 float, Tx, Ty, Tz
-          api->BxActiveSingleStrayMarkerPosition[i][0] = *(float*)replyIndex;
-          replyIndex += 4;
-          api->BxActiveSingleStrayMarkerPosition[i][1] = *(float*)replyIndex;
-          replyIndex += 4;
-          api->BxActiveSingleStrayMarkerPosition[i][2] = *(float*)replyIndex;
-          replyIndex += 4;
+          Table[k][i] = (Table[k - 1][i] >> 8) ^ Table[0][Table[k - 1][i] & 0xff];
         }
       }
+    }
+  };
 
-      if (mode & NDI_3D_MARKER_POSITIONS)
-      {
-        // Save marker count
-        api->Bx3DMarkerCount[i] = (char)replyIndex[0];
-        replyIndex++;
+  const ndiCRC16Tables ndiCRC16Data;
+}
 
-        // Save off out of volume status
-        int numBytes = static_cast<int>(ceilf(api->Bx3DMarkerCount[i] / 8.f));
-        for (int j = 0; j < numBytes; ++j)
-        {
-          api->Bx3DMarkerOutOfVolume[i][j] = (char)replyIndex[0];
-          ++replyIndex;
-        }
+#define CalcCRC16(nextchar, puCRC16) \
+{ \
+    *(puCRC16) = (*(puCRC16) >> 8) ^ ndiCRC16Data.Table[0][(*(puCRC16) ^ (unsigned char)(nextchar)) & 0xff]; \
+}
 
-        for (int j = 0; j < api->Bx3DMarkerCount[i]; ++j)
-        {
-          // 3 float, Tx, Ty, Tz
-          api->Bx3DMarkerPosition[i][j][0] = *(float*)replyIndex;
-          replyIndex += 4;
-          api->Bx3DMarkerPosition[i][j][1] = *(float*)replyIndex;
-          replyIndex += 4;
-          api->Bx3DMarkerPosition[i][j][2] = *(float*)replyIndex;
-          replyIndex += 4;
-        }
-      }
-    }
+//----------------------------------------------------------------------------
+ndicapiExport unsigned short ndiCRC16(unsigned short crc, const void* data, int n)
+{
+  const unsigned char* cp = (const unsigned char*)data;
+  const unsigned short(*table)[256] = ndiCRC16Data.Table;
 
-    if (mode & NDI_PASSIVE_STRAY)
+  while (n >= 4)
+  {
+    crc ^= cp[0] | (cp[1] << 8);
+    crc = table[3][crc & 0xff] ^ table[2][crc >> 8] ^ table[1][cp[2]] ^ table[0][cp[3]];
+    cp += 4;
+    n -= 4;
+  }
+  while (n-- > 0)
+  {
+    crc = (crc >> 8) ^ table[0][(crc ^ *cp++) & 0xff];
+  }
+
+  return crc;
+}
+
+//----------------------------------------------------------------------------
+// Prototypes for helper functions for certain commands.  These functions
+//   are called whenever the corresponding command sent the Measurement System
+//   unless an error was generated.
+//
+//   cp  -> the command string that was sent to the NDICAPI
+//   crp -> the reply from the Measurement System, but with the CRC hacked off
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Decode a 51-character transform, or "MISSING" or "DISABLED", and
+  // return NDI_OKAY, NDI_MISSING or NDI_DISABLED.
+  int ndiDecodeTransform(const char* dp, double transform[8])
+  {
+    if (*dp == 'D' || *dp == '\0')
     {
-      // Save marker count
-      api->BxPassiveStrayCount = (char)replyIndex[0];
-      replyIndex++;
+      return NDI_DISABLED;
+    }
+    else if (*dp == 'M')
+    {
+      return NDI_MISSING;
+    }
 
-      if (api->BxPassiveStrayCount > 240)
-      {
-        // This implementation cannot report on more than 240 stray passive markers
-        api->BxPassiveStrayCount = 240;
-      }
+    ndiTransformToDouble(dp, transform);
 
-      // Save off out of volume status
-      int numBytes = static_cast<int>(ceilf(api->BxPassiveStrayCount / 8.f));
-      for (int j = 0; j < numBytes; ++j)
-      {
-        api->BxPassiveStrayOutOfVolume[j] = (char)replyIndex[0];
-        ++replyIndex;
-      }
+    return NDI_OKAY;
+  }
 
-      for (int j = 0; j < api->BxPassiveStrayCount; ++j)
-      {
-        // 3 float, Tx, Ty, Tz
-        api->BxPassiveStrayPosition[j][0] = *(float*)replyIndex;
-        replyIndex += 4;
-        api->BxPassiveStrayPosition[j][1] = *(float*)replyIndex;
-        replyIndex += 4;
-        api->BxPassiveStrayPosition[j][2] = *(float*)replyIndex;
-        replyIndex += 4;
-      }
+  //----------------------------------------------------------------------------
+  // Get the index into the decoded GX arrays for a port, or -1.
+  int ndiGXPortIndex(int port)
+  {
+    if (port >= '1' && port <= '3')
+    {
+      return port - '1';
     }
+    else if (port >= 'A' && port <= 'I')
+    {
+      return 3 + port - 'A';
+    }
+    return -1;
+  }
 
-    // Get the system status
-    api->BxSystemStatus = (char)replyIndex[1] << 8 | (char)replyIndex[0];
-    replyIndex += 2;
+  //----------------------------------------------------------------------------
+  // Get the index into the TX arrays for a port handle, or -1.
+  int ndiTXHandleIndex(ndicapi* pol, int ph)
+  {
+    if (ph < 0 || ph > 255)
+    {
+      return -1;
+    }
+    int i = pol->TxHandleIndex[ph] - 1;
+    if (i < 0 || i >= pol->TxHandleCount || pol->TxHandleValues[i].Handle != ph)
+    {
+      return -1;
+    }
+    return i;
   }
 
   //----------------------------------------------------------------------------
-  // Copy all the GX reply information into the ndicapi structure, according
-  // to the GX reply mode that was requested.
-  //
-  // This function is called every time a GX command is sent to the
-  // Measurement System.
-  //
-  // This information can be later extracted through one of the ndiGetGXxx()
-  // functions.
-  void ndiGXHelper(ndicapi* pol, const char* command, const char* commandReply)
+  // Get the index into the BX arrays for a port handle, or -1.
+  int ndiBXHandleIndex(ndicapi* pol, int ph)
   {
-    unsigned long mode = NDI_XFORMS_AND_STATUS; // the default reply mode
-    char* writePointer;
-    int i, j, k;
-    int passiveCount, activeCount;
+    if (ph < 0 || ph > 255)
+    {
+      return -1;
+    }
+    int i = pol->BxHandleIndex[ph] - 1;
+    if (i < 0 || i >= pol->BxHandleCount || pol->BxHandleValues[i].Handle != ph)
+    {
+      return -1;
+    }
+    return i;
+  }
 
-    // if the GX command had a reply mode, read it
-    if ((command[2] == ':' && command[7] != '\r') || (command[2] == ' ' && command[3] != '\r'))
+  //----------------------------------------------------------------------------
+  // Decode the ASCII TX reply fields into numbers, so that the getters
+  // do not have to parse the same reply over and over again.
+  void ndiTXDecode(ndicapi* pol)
+  {
+    int i;
+    unsigned long status;
+
+    for (i = 0; i < pol->TxHandleCount; i++)
     {
-      mode = ndiHexToUnsignedLong(&command[3], 4);
+      ndiTXHandle* values = &pol->TxHandleValues[i];
+      ndiTXHandleText* text = &pol->TxHandleText[i];
+      pol->TxHandleIndex[values->Handle] = (unsigned char)(i + 1);
+      values->TransformStatus = ndiDecodeTransform(text->Transform, values->Transform);
+      ndiHexToUnsignedLongArray(text->Status, 8, 1, &status);
+      values->PortStatus = (int)status;
+      ndiHexToUnsignedLongArray(text->Frame, 8, 1, &values->Frame);
     }
+    pol->TxSystemStatusValue = (int)ndiHexToUnsignedLong(pol->TxSystemStatus, 4);
+  }
 
-    // always three active ports
-    activeCount = 3;
+  //----------------------------------------------------------------------------
+  // Decode the ASCII GX reply fields into numbers for all twelve ports.
+  void ndiGXDecode(ndicapi* pol)
+  {
+    // offset of each port's status within GxStatus or GxPassiveStatus
+    static const int statusOffset[12] = { 6, 4, 2, 6, 4, 2, 14, 12, 10, 22, 20, 18 };
+    int i;
 
-    if (mode & NDI_XFORMS_AND_STATUS)
+    for (i = 0; i < 12; i++)
     {
-      for (k = 0; k < activeCount; k += 3)
+      const char* transform;
+      const char* status;
+      const char* frame;
+      if (i < 3)
       {
-        // grab the three transforms
-        for (i = 0; i < 3; i++)
-        {
-          writePointer = pol->GxTransforms[i];
-          for (j = 0; j < 51 && *commandReply >= ' '; j++)
-          {
-            *writePointer++ = *commandReply++;
-          }
-          *writePointer = '\0';
-          // eat the trailing newline
-          if (*commandReply == '\n')
-          {
-            commandReply++;
-          }
-        }
-        // grab the status flags
-        writePointer = pol->GxStatus + k / 3 * 8;
-        for (j = 0; j < 8 && *commandReply >= ' '; j++)
-        {
-          *writePointer++ = *commandReply++;
-        }
+        transform = pol->GxTransforms[i];
+        status = &pol->GxStatus[statusOffset[i]];
+        frame = pol->GxFrame[i];
       }
-      // eat the trailing newline
-      if (*commandReply == '\n')
+      else
       {
-        commandReply++;
+        transform = pol->GxPassiveTransforms[i - 3];
+        status = &pol->GxPassiveStatus[statusOffset[i]];
+        frame = pol->GxPassiveFrame[i - 3];
       }
+      pol->GxTransformStatus[i] = ndiDecodeTransform(transform, pol->GxTransformValues[i]);
+      pol->GxPortStatusValue[i] = (int)ndiHexToUnsignedLong(status, 2);
+      ndiHexToUnsignedLongArray(frame, 8, 1, &pol->GxFrameValue[i]);
     }
 
-    if (mode & NDI_ADDITIONAL_INFO)
+    if (pol->GxStatus[0] != '\0')
     {
-      // grab information for each port
-      for (i = 0; i < activeCount; i++)
-      {
-        writePointer = pol->GxInformation[i];
-        for (j = 0; j < 12 && *commandReply >= ' '; j++)
-        {
-          *writePointer++ = *commandReply++;
-        }
-      }
-      // eat the trailing newline
-      if (*commandReply == '\n')
-      {
-        commandReply++;
-      }
+      pol->GxSystemStatusValue = (int)ndiHexToUnsignedLong(pol->GxStatus, 2);
     }
-
-    if (mode & NDI_SINGLE_STRAY)
+    else
     {
-      // grab stray marker for each port
-      for (i = 0; i < activeCount; i++)
-      {
-        writePointer = pol->GxSingleStray[i];
-        for (j = 0; j < 21 && *commandReply >= ' '; j++)
-        {
-          *writePointer++ = *commandReply++;
-        }
-        *writePointer = '\0';
-        // eat the trailing newline
-        if (*commandReply == '\n')
-        {
-          commandReply++;
-        }
-      }
+      pol->GxSystemStatusValue = (int)ndiHexToUnsignedLong(pol->GxPassiveStatus, 2);
     }
+  }
 
-    if (mode & NDI_FRAME_NUMBER)
-    {
-      // get frame number for each port
-      for (i = 0; i < activeCount; i++)
-      {
-        writePointer = pol->GxFrame[i];
-        for (j = 0; j < 8 && *commandReply >= ' '; j++)
-        {
-          *writePointer++ = *commandReply++;
-        }
-      }
-      // eat the trailing newline
-      if (*commandReply == '\n')
-      {
-        commandReply++;
-      }
-    }
+  //----------------------------------------------------------------------------
+  // Copy all the PHINF reply information into the ndicapi structure, according
+  // to the PHINF reply mode that was requested.
+  //
+  // This function is called every time a PHINF command is sent to the
+  // Measurement System.
+  //
+  // This information can be later extracted through one of the ndiGetPHINFxx()
+  // functions.
+  void ndiPHINFHelper(ndicapi* pol, const char* cp, const char* crp)
+  {
+    ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+    unsigned long mode = 0x0001; // the default reply mode
+    char* dp;
+    int j;
+    int unoccupied = NDI_OKAY;
 
-    // if there is no passive information, stop here
-    if (!(mode & NDI_PASSIVE))
+    // if the PHINF command had a reply mode, read it
+    if ((cp[5] == ':' && cp[10] != '\r') || (cp[5] == ' ' && cp[6] != '\r'))
     {
-      return;
+      mode = ndiHexToUnsignedLong(&cp[8], 4);
     }
 
-    // in case there are 9 passive tools instead of just 3
-    passiveCount = 3;
-    if (mode & NDI_PASSIVE_EXTRA)
+    // check for unoccupied
+    if (*crp == 'U')
     {
-      passiveCount = 9;
+      unoccupied = NDI_UNOCCUPIED;
     }
+    replies->PhinfUnoccupied = unoccupied;
 
-    if ((mode & NDI_XFORMS_AND_STATUS) || (mode == NDI_PASSIVE))
+    // fprintf(stderr, "mode = %04lx\n", mode);
+
+    if (mode & NDI_BASIC)
     {
-      // the information is grouped in threes
-      for (k = 0; k < passiveCount; k += 3)
+      dp = replies->PhinfBasic;
+      if (!unoccupied)
       {
-        // grab the three transforms
-        for (i = 0; i < 3; i++)
+        for (j = 0; j < 33 && *crp >= ' '; j++)
         {
-          writePointer = pol->GxPassiveTransforms[k + i];
-          for (j = 0; j < 51 && *commandReply >= ' '; j++)
-          {
-            *writePointer++ = *commandReply++;
-          }
-          *writePointer = '\0';
-          // eat the trailing newline
-          if (*commandReply == '\n')
-          {
-            commandReply++;
-          }
+          // fprintf(stderr,"%c",*crp);
+          *dp++ = *crp++;
         }
-        // grab the status flags
-        writePointer = pol->GxPassiveStatus + k / 3 * 8;
-        for (j = 0; j < 8 && *commandReply >= ' '; j++)
+        // fprintf(stderr,"\n");
+      }
+      else    // default "00000000            0000000000000"
+      {
+        for (j = 0; j < 8; j++)
         {
-          *writePointer++ = *commandReply++;
+          *dp++ = '0';
         }
-        // skip the newline
-        if (*commandReply == '\n')
+        for (j = 0; j < 12; j++)
         {
-          commandReply++;
+          *dp++ = ' ';
         }
-        else   // no newline: no more passive transforms
+        for (j = 0; j < 13; j++)
         {
-          passiveCount = k + 3;
+          *dp++ = '0';
         }
       }
-      // eat the trailing newline
-      if (*commandReply == '\n')
-      {
-        commandReply++;
-      }
     }
 
-    if (mode & NDI_ADDITIONAL_INFO)
+    if (mode & NDI_TESTING)
     {
-      // grab information for each port
-      for (i = 0; i < passiveCount; i++)
+      dp = replies->PhinfTesting;
+      if (!unoccupied)
       {
-        writePointer = pol->GxPassiveInformation[i];
-        for (j = 0; j < 12 && *commandReply >= ' '; j++)
+        for (j = 0; j < 8 && *crp >= ' '; j++)
         {
-          *writePointer++ = *commandReply++;
+          *dp++ = *crp++;
         }
       }
-      // eat the trailing newline
-      if (*commandReply == '\n')
+      else   // default "00000000"
       {
-        commandReply++;
+        for (j = 0; j < 8; j++)
+        {
+          *dp++ = '0';
+        }
       }
     }
 
-    if (mode & NDI_FRAME_NUMBER)
+    if (mode & NDI_PART_NUMBER)
     {
-      // get frame number for each port
-      for (i = 0; i < passiveCount; i++)
+      dp = replies->PhinfPartNumber;
+      if (!unoccupied)
       {
-        writePointer = pol->GxPassiveFrame[i];
-        for (j = 0; j < 8 && *commandReply >= ' '; j++)
+        for (j = 0; j < 20 && *crp >= ' '; j++)
         {
-          *writePointer++ = *commandReply++;
+          *dp++ = *crp++;
         }
       }
-      // eat the trailing newline
-      if (*commandReply == '\n')
+      else   // default "                    "
       {
-        commandReply++;
+        for (j = 0; j < 20; j++)
+        {
+          *dp++ = ' ';
+        }
       }
     }
 
-    if (mode & NDI_PASSIVE_STRAY)
+    if (mode & NDI_ACCESSORIES)
     {
-      // get all the passive stray information
-      // this will be a maximum of 3 + 20*3*7 = 423 bytes
-      writePointer = pol->GxPassiveStray;
-      for (j = 0; j < 423 && *commandReply >= ' '; j++)
+      dp = replies->PhinfAccessories;
+      if (!unoccupied)
       {
-        *writePointer++ = *commandReply++;
+        for (j = 0; j < 2 && *crp >= ' '; j++)
+        {
+          *dp++ = *crp++;
+        }
+      }
+      else   // default "00"
+      {
+        for (j = 0; j < 2; j++)
+        {
+          *dp++ = '0';
+        }
       }
     }
-  }
-
-  //----------------------------------------------------------------------------
-  // Copy all the PSTAT reply information into the ndicapi structure.
-  void ndiPSTATHelper(ndicapi* pol, const char* command, const char* commandReply)
-  {
-    unsigned long mode = NDI_XFORMS_AND_STATUS; // the default reply mode
-    char* writePointer;
-    int i, j;
-    int passiveCount, activeCount;
-
-    // if the PSTAT command had a reply mode, read it
-    if ((command[5] == ':' && command[10] != '\r') || (command[5] == ' ' && command[6] != '\r'))
-    {
-      mode = ndiHexToUnsignedLong(&command[6], 4);
-    }
-
-    // always three active ports
-    activeCount = 3;
 
-    // information for each port is separated by a newline
-    for (i = 0; i < activeCount; i++)
+    if (mode & NDI_MARKER_TYPE)
     {
-      // basic tool information and port status
-      if (mode & NDI_BASIC)
+      dp = replies->PhinfMarkerType;
+      if (!unoccupied)
       {
-        writePointer = pol->PstatBasic[i];
-        for (j = 0; j < 32 && *commandReply >= ' '; j++)
+        for (j = 0; j < 2 && *crp >= ' '; j++)
         {
-          *writePointer++ = *commandReply++;
+          *dp++ = *crp++;
         }
-        // terminate if UNOCCUPIED
-        if (j < 32)
+      }
+      else   // default "00"
+      {
+        for (j = 0; j < 2; j++)
         {
-          *writePointer = '\0';
+          *dp++ = '0';
         }
       }
+    }
 
-      // current testing
-      if (mode & NDI_TESTING)
+    if (mode & NDI_PORT_LOCATION)
+    {
+      dp = replies->PhinfPortLocation;
+      if (!unoccupied)
       {
-        writePointer = pol->PstatTesting[i];
-        *writePointer = '\0';
-        for (j = 0; j < 8 && *commandReply >= ' '; j++)
+        for (j = 0; j < 14 && *crp >= ' '; j++)
         {
-          *writePointer++ = *commandReply++;
+          *dp++ = *crp++;
         }
       }
-
-      // part number
-      if (mode & NDI_PART_NUMBER)
+      else   // default "00000000000000"
       {
-        writePointer = pol->PstatPartNumber[i];
-        *writePointer = '\0';
-        for (j = 0; j < 20 && *commandReply >= ' '; j++)
+        for (j = 0; j < 14; j++)
         {
-          *writePointer++ = *commandReply++;
+          *dp++ = '0';
         }
       }
+    }
 
-      // accessories
-      if (mode & NDI_ACCESSORIES)
+    if (mode & NDI_GPIO_STATUS)
+    {
+      dp = replies->PhinfGpioStatus;
+      if (!unoccupied)
       {
-        writePointer = pol->PstatAccessories[i];
-        *writePointer = '\0';
-        for (j = 0; j < 2 && *commandReply >= ' '; j++)
+        for (j = 0; j < 2 && *crp >= ' '; j++)
         {
-          *writePointer++ = *commandReply++;
+          *dp++ = *crp++;
         }
       }
-
-      // marker type
-      if (mode & NDI_MARKER_TYPE)
+      else   // default "00"
       {
-        writePointer = pol->PstatMarkerType[i];
-        *writePointer = '\0';
-        for (j = 0; j < 2 && *commandReply >= ' '; j++)
+        for (j = 0; j < 2; j++)
         {
-          *writePointer++ = *commandReply++;
+          *dp++ = '0';
         }
       }
+    }
+  }
 
-      // skip any other information that might be present
-      while (*commandReply >= ' ')
-      {
-        commandReply++;
-      }
-
-      // eat the trailing newline
-      if (*commandReply == '\n')
-      {
-        commandReply++;
-      }
+  //----------------------------------------------------------------------------
+  //Copy all the PHRQ reply information into the ndicapi structure.
+  //
+  //This function is called every time a PHRQ command is sent to the
+  //Measurement System.
+  //
+  //This information can be later extracted through one of the ndiGetPHRQHandle()
+  //functions.
+  void ndiPHRQHelper(ndicapi* pol, const char* cp, const char* crp)
+  {
+    ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+    char* dp;
+    int j;
+
+    dp = replies->PhrqReply;
+    for (j = 0; j < 2; j++)
+    {
+      *dp++ = *crp++;
     }
+  }
 
-    // if there is no passive information, stop here
-    if (!(mode & NDI_PASSIVE))
+  //----------------------------------------------------------------------------
+  // Copy all the PHSR reply information into the ndicapi structure.
+  //
+  // This function is called every time a PHSR command is sent to the
+  // Measurement System.
+  //
+  // This information can be later extracted through one of the ndiGetPHSRxx()
+  // functions.
+  void ndiPHSRHelper(ndicapi* pol, const char* command, const char* commandReply)
+  {
+    ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+    char* writePointer;
+    int j;
+
+    writePointer = replies->PhsrReply;
+    for (j = 0; j < 1282 && *commandReply >= ' '; j++)
     {
-      return;
+      *writePointer++ = *commandReply++;
     }
+    *writePointer++ = '\0';
+  }
 
-    // in case there are 9 passive tools instead of just 3
-    passiveCount = 3;
-    if (mode & NDI_PASSIVE_EXTRA)
+  //----------------------------------------------------------------------------
+  // Copy all the TX reply information into the ndicapi structure, according
+  // to the TX reply mode that was requested.
+  //
+  // This function is called every time a TX command is sent to the
+  // Measurement System.
+  //
+  // This information can be later extracted through one of the ndiGetTXxx()
+  // functions.
+  void ndiTXHelper(ndicapi* pol, const char* command, const char* commandReply)
+  {
+    unsigned long mode = NDI_XFORMS_AND_STATUS; // the default reply mode
+    char* writePointer;
+    int i, j, n;
+    int handle, handleCount, strayCount;
+
+    // if the TX command had a reply mode, read it
+    if ((command[2] == ':' && command[7] != '\r') || (command[2] == ' ' && command[3] != '\r'))
     {
-      passiveCount = 9;
+      mode = ndiHexToUnsignedLong(&command[3], 4);
     }
 
-    // information for each port is separated by a newline
-    for (i = 0; i < passiveCount; i++)
+    // get the number of handles
+    handleCount = (int)ndiHexToUnsignedLong(commandReply, 2);
+    for (j = 0; j < 2 && *commandReply >= ' '; j++)
     {
-      // basic tool information and port status
-      if (mode & NDI_BASIC)
+      commandReply++;
+    }
+
+    // go through the information for each handle
+    for (i = 0; i < handleCount; i++)
+    {
+      // get the handle itself (two chars)
+      handle = (int)ndiHexToUnsignedLong(commandReply, 2);
+      for (j = 0; j < 2 && *commandReply >= ' '; j++)
       {
-        writePointer = pol->PstatPassiveBasic[i];
-        *writePointer = '\0';
-        for (j = 0; j < 32 && *commandReply >= ' '; j++)
+        commandReply++;
+      }
+
+      // check for "UNOCCUPIED"
+      if (*commandReply == 'U')
+      {
+        for (j = 0; j < 10 && *commandReply >= ' '; j++)
         {
-          *writePointer++ = *commandReply++;
+          commandReply++;
         }
-        // terminate if UNOCCUPIED
-        if (j < 32)
+        // back up and continue (don't store information for unoccupied ports)
+        i--;
+        handleCount--;
+        continue;
+      }
+
+      // skip the rest of the line if there is no memory for more handles
+      if (!ndiReserveTXHandles(pol, i + 1))
+      {
+        while (*commandReply >= ' ')
         {
-          *writePointer = '\0';
+          commandReply++;
+        }
+        if (*commandReply == '\n')
+        {
+          commandReply++;
         }
+        i--;
+        handleCount--;
+        continue;
       }
 
-      // current testing
-      if (mode & NDI_TESTING)
+      // save the port handle in the list
+      ndiTXHandleText* text = &pol->TxHandleText[i];
+      pol->TxHandleValues[i].Handle = handle;
+
+      if (mode & NDI_XFORMS_AND_STATUS)
       {
-        writePointer = pol->PstatPassiveTesting[i];
+        // get the transform, MISSING, or DISABLED
+        writePointer = text->Transform;
+
+        if (*commandReply == 'M')
+        {
+          // check for "MISSING"
+          for (j = 0; j < 7 && *commandReply >= ' '; j++)
+          {
+            *writePointer++ = *commandReply++;
+          }
+        }
+        else if (*commandReply == 'D')
+        {
+          // check for "DISABLED"
+          for (j = 0; j < 8 && *commandReply >= ' '; j++)
+          {
+            *writePointer++ = *commandReply++;
+          }
+        }
+        else
+        {
+          // read the transform
+          for (j = 0; j < 51 && *commandReply >= ' '; j++)
+          {
+            *writePointer++ = *commandReply++;
+          }
+        }
         *writePointer = '\0';
+
+        // get the status
+        writePointer = text->Status;
         for (j = 0; j < 8 && *commandReply >= ' '; j++)
         {
           *writePointer++ = *commandReply++;
         }
-      }
-
-      // part number
-      if (mode & NDI_PART_NUMBER)
-      {
-        writePointer = pol->PstatPassivePartNumber[i];
         *writePointer = '\0';
-        for (j = 0; j < 20 && *commandReply >= ' '; j++)
+
+        // get the frame number
+        writePointer = text->Frame;
+        for (j = 0; j < 8 && *commandReply >= ' '; j++)
         {
           *writePointer++ = *commandReply++;
         }
+        *writePointer = '\0';
       }
 
-      // accessories
-      if (mode & NDI_ACCESSORIES)
+      // grab additional information
+      if (mode & NDI_ADDITIONAL_INFO)
       {
-        writePointer = pol->PstatPassiveAccessories[i];
-        *writePointer = '\0';
-        for (j = 0; j < 2 && *commandReply >= ' '; j++)
+        writePointer = text->Information;
+        for (j = 0; j < 20 && *commandReply >= ' '; j++)
         {
           *writePointer++ = *commandReply++;
         }
+        *writePointer = '\0';
       }
 
-      // marker type
-      if (mode & NDI_MARKER_TYPE)
+      // grab the single marker info
+      if (mode & NDI_SINGLE_STRAY)
       {
-        writePointer = pol->PstatPassiveMarkerType[i];
-        *writePointer = '\0';
-        for (j = 0; j < 2 && *commandReply >= ' '; j++)
+        writePointer = text->SingleStray;
+        if (*commandReply == 'M')
         {
-          *writePointer++ = *commandReply++;
+          // check for "MISSING"
+          for (j = 0; j < 7 && *commandReply >= ' '; j++)
+          {
+            *writePointer++ = *commandReply++;
+          }
+        }
+        else if (*commandReply == 'D')
+        {
+          // check for "DISABLED"
+          for (j = 0; j < 8 && *commandReply >= ' '; j++)
+          {
+            *writePointer++ = *commandReply++;
+          }
+        }
+        else
+        {
+          // read the single stray position
+          for (j = 0; j < 21 && *commandReply >= ' '; j++)
+          {
+            *writePointer++ = *commandReply++;
+          }
         }
+        *writePointer = '\0';
       }
 
-      // skip any other information that might be present
+      // skip over any unsupported information
       while (*commandReply >= ' ')
       {
         commandReply++;
@@ -2112,1854 +2650,5854 @@ namespace
         commandReply++;
       }
     }
-  }
-
-  //----------------------------------------------------------------------------
-  // Copy all the SSTAT reply information into the ndicapi structure.
-  void ndiSSTATHelper(ndicapi* pol, const char* command, const char* commandReply)
-  {
-    unsigned long mode;
-    char* writePointer;
 
-    // read the SSTAT command reply mode
-    mode = ndiHexToUnsignedLong(&command[6], 4);
+    // save the number of handles (minus the unoccupied handles)
+    pol->TxHandleCount = handleCount;
 
-    if (mode & NDI_CONTROL)
+    // get all the passive stray information
+    // this will be a maximum of 2 + ceil(numMarkers*0.5) + Y
+    // where Y is
+    //   0800 not used: 21 * numMarkers inside characterized measurement volume
+    //   0800 used: 21 * numMarkers
+    if (mode & NDI_PASSIVE_STRAY)
     {
-      writePointer = pol->SstatControl;
-      *writePointer++ = *commandReply++;
-      *writePointer++ = *commandReply++;
+      // get the number of strays
+      strayCount = (int)ndiHexToUnsignedLong(commandReply, 2);
+      for (j = 0; j < 2 && *commandReply >= ' '; j++)
+      {
+        commandReply++;
+      }
+      if (strayCount > 50)
+      {
+        strayCount = 50;
+      }
+      if (!ndiReserveArray(pol->TxPassiveStray, pol->TxPassiveStrayCapacity, strayCount * 21 + 1))
+      {
+        // skip over the strays that cannot be stored, then read the rest
+        ndiSetError(pol, NDI_BAD_REPLY);
+        pol->TxPassiveStrayCount = 0;
+        n = (strayCount + 3) / 4 + strayCount * 21;
+        for (j = 0; j < n && *commandReply >= ' '; j++)
+        {
+          commandReply++;
+        }
+      }
+      else
+      {
+        pol->TxPassiveStrayCount = strayCount;
+        // get the out-of-volume bits
+        writePointer = pol->TxPassiveStrayOov;
+        n = (strayCount + 3) / 4;
+        for (j = 0; j < n && *commandReply >= ' '; j++)
+        {
+          *writePointer++ = *commandReply++;
+        }
+        // get the coordinates
+        writePointer = pol->TxPassiveStray;
+        n = strayCount * 21;
+        for (j = 0; j < n && *commandReply >= ' '; j++)
+        {
+          *writePointer++ = *commandReply++;
+        }
+        *writePointer = '\0';
+      }
     }
 
-    if (mode & NDI_SENSORS)
+    // get the system status
+    writePointer = pol->TxSystemStatus;
+    for (j = 0; j < 4 && *commandReply >= ' '; j++)
     {
-      writePointer = pol->SstatSensor;
-      *writePointer++ = *commandReply++;
       *writePointer++ = *commandReply++;
     }
+    *writePointer = '\0';
 
-    if (mode & NDI_TIU)
-    {
-      writePointer = pol->SstatTiu;
-      *writePointer++ = *commandReply++;
-      *writePointer++ = *commandReply++;
-    }
+    // decode everything once, rather than in every getter
+    ndiTXDecode(pol);
   }
 
   //----------------------------------------------------------------------------
-  // Copy all the IRCHK reply information into the ndicapi structure.
-  void ndiIRCHKHelper(ndicapi* pol, const char* command, const char* commandReply)
+  // Copy all the BX reply information into the ndicapi structure, according
+  // to the BX reply mode that was requested.
+  //
+  // This function is called every time a BX command is sent to the Measurement System.
+  //
+  // This information can be later extracted through one of the ndiGetTXxx()
+  // functions.
+  void ndiBXHelper(ndicapi* api, const char* command, const char* commandReply)
   {
-    unsigned long mode = NDI_XFORMS_AND_STATUS; // the default reply mode
-    int j;
+    // Reply options
+    // NDI_XFORMS_AND_STATUS  0x0001  /* transforms and status */
+    // NDI_ADDITIONAL_INFO    0x0002  /* additional tool transform info */
+    // NDI_SINGLE_STRAY       0x0004  /* stray active marker reporting */
+    // NDI_FRAME_NUMBER       0x0008  /* frame number for each tool */
+    // NDI_PASSIVE            0x8000  /* report passive tool information */
+    // NDI_PASSIVE_EXTRA      0x2000  /* add 6 extra passive tools */
+    // NDI_PASSIVE_STRAY      0x1000  /* stray passive marker reporting */
+    unsigned long mode = NDI_XFORMS_AND_STATUS;
+    const char* replyIndex;
+    unsigned short headerCRC;
 
-    // if the IRCHK command had a reply mode, read it
-    if ((command[5] == ':' && command[10] != '\r') || (command[5] == ' ' && command[6] != '\r'))
+    // if the BX command had a reply option, read it
+    if ((command[2] == ':' && command[7] != '\r') || (command[2] == ' ' && command[3] != '\r'))
     {
-      mode = ndiHexToUnsignedLong(&command[6], 4);
+      mode = ndiHexToUnsignedLong(&command[3], 4);
     }
 
-    // a single character, '0' or '1'
-    if (mode & NDI_DETECTED)
+    replyIndex = &commandReply[0];
+
+    // Confirm start sequence, 0xA5C4 for a reply or 0xB5D4 for a streamed reply
+    if (!(replyIndex[0] == (char)0xc4 && replyIndex[1] == (char)0xa5) &&
+        !(replyIndex[0] == (char)0xd4 && replyIndex[1] == (char)0xb5))  // little endian
     {
-      pol->IrchkDetected = *commandReply++;
+      // Something isn't right, abort
+      return;
     }
+    replyIndex += 2;
 
-    // maximum string length for 20 sources is 2*(3 + 20*3) = 126
-    // copy until a control char (less than 0x20) is found
-    if (mode & NDI_SOURCES)
+    // Get the reply length
+    api->BxReplyLength = (unsigned char)replyIndex[1] << 8 | (unsigned char)replyIndex[0];
+    replyIndex += 2;
+
+    // Get the CRC
+    headerCRC = (unsigned char)replyIndex[1] << 8 | (unsigned char)replyIndex[0];
+    replyIndex += 2;
+
+    // Get the number of handles, if there is no memory for all of them then
+    // the rest of the reply is dropped
+    int handleCount = (unsigned char)replyIndex[0];
+    replyIndex += 1;
+    bool isTruncated = !ndiReserveBXHandles(api, handleCount);
+    if (isTruncated)
     {
-      for (j = 0; j < 126 && *commandReply >= ' '; j++)
-      {
-        pol->IrchkSources[j] = *commandReply++;
-      }
+      handleCount = api->BxHandleCapacity;
     }
-  }
+    api->BxHandleCount = handleCount;
 
-  //----------------------------------------------------------------------------
-  // Adjust the host to match a COMM command.
-  void ndiCOMMHelper(ndicapi* pol, const char* command, const char* commandReply)
-  {
-    static int convert_baud[8] = { 9600, 14400, 19200, 38400, 57600, 115200, 921600, 1228739 };
-    char newdps[4] = "8N1";
-    int newspeed = 9600;
-    int newhand = 0;
+    // The markers of all the tools share a single pool
+    int markerTotal = 0;
 
-    if ((command[5] >= '0' && command[5] <= '7') || command[5] == 'A')
+    // Go through the information for each handle
+    for (int i = 0; i < handleCount; i++)
     {
-      if (command[5] != 'A')
+      ndiBXHandle* values = &api->BxHandleValues[i];
+      ndiBXHandleExtra* extra = &api->BxHandleExtra[i];
+
+      // get the handle itself
+      values->Handle = (unsigned char)replyIndex[0];
+      replyIndex++;
+      api->BxHandleIndex[values->Handle] = (unsigned char)(i + 1);
+
+      values->Status = (char)replyIndex[0];
+      replyIndex++;
+
+      // Disabled handles have no reply data
+      if (values->Status == NDI_HANDLE_DISABLED)
       {
-        newspeed = convert_baud[command[5] - '0'];
+        if (mode & NDI_3D_MARKER_POSITIONS)
+        {
+          extra->MarkerCount = 0;
+        }
+        continue;
       }
-      else
+
+      if (mode & NDI_XFORMS_AND_STATUS)
       {
-        newspeed = 230400;
+        if (values->Status != NDI_HANDLE_MISSING)
+        {
+          // 4 float Q0, Qx, Qy, Qz, then 3 float Tx, Ty, Tz, then 1 float RMS error
+          memcpy(values->Transform, replyIndex, sizeof(float) * 8);
+          replyIndex += 32;
+        }
+        // 4 bytes port status
+        values->PortStatus = (int)replyIndex[0] | (int)replyIndex[1] << 8 | (int)replyIndex[2] << 16 | (int)replyIndex[3] << 24;
+        replyIndex += 4;
+        // 4 bytes frame number
+        values->FrameNumber = (unsigned char)replyIndex[0] | (unsigned char)replyIndex[1] << 8 | (unsigned char)replyIndex[2] << 16 | (unsigned int)(unsigned char)replyIndex[3] << 24;
+        replyIndex += 4;
+      }
+
+      // grab additional information
+      if (mode & NDI_ADDITIONAL_INFO)
+      {
+        memcpy(extra->ToolMarkerInformation, replyIndex, 11);
+        replyIndex += 11;
+      }
+
+      // grab the single marker info
+      if (mode & NDI_SINGLE_STRAY)
+      {
+        char activeStatus = (char)replyIndex[0];
+        replyIndex++;
+        extra->SingleStrayStatus = activeStatus;
+
+        if (activeStatus != 0x00 || (mode & NDI_NOT_NORMALLY_REPORTED && activeStatus & NDI_ACTIVE_STRAY_OUT_OF_VOLUME))
+        {
+          // Marker is not missing, or it is out-of-volume and not-normally-requested is requested
+          // Either means we have data...
+          // 3 float, Tx, Ty, Tz
+          memcpy(extra->SingleStray, replyIndex, sizeof(float) * 3);
+          replyIndex += 12;
+        }
+      }
+
+      if (mode & NDI_3D_MARKER_POSITIONS)
+      {
+        // Save marker count
+        int markerCount = (unsigned char)replyIndex[0];
+        replyIndex++;
+
+        // Save off out of volume status
+        int numBytes = (markerCount + 7) / 8;
+        for (int j = 0; j < numBytes; ++j)
+        {
+          extra->MarkerOutOfVolume[j] = (unsigned char)replyIndex[0];
+          ++replyIndex;
+        }
+
+        // 3 float, Tx, Ty, Tz for each marker, into the shared pool
+        if (!ndiReserveArray(api->BxMarkerPositions, api->BxMarkerCapacity, markerTotal + markerCount))
+        {
+          extra->MarkerCount = 0;
+          api->BxHandleCount = i + 1;
+          return;
+        }
+        for (int j = 0; j < markerCount; ++j)
+        {
+          memcpy(api->BxMarkerPositions[markerTotal + j], replyIndex, sizeof(float) * 3);
+          replyIndex += 12;
+        }
+        extra->MarkerCount = markerCount;
+        extra->MarkerOffset = markerTotal;
+        markerTotal += markerCount;
       }
     }
-    if (command[6] == '1')
-    {
-      newdps[0] = '7';
-    }
-    if (command[7] == '1')
-    {
-      newdps[1] = 'O';
-    }
-    else if (command[7] == '2')
-    {
-      newdps[1] = 'E';
-    }
-    if (command[8] == '1')
-    {
-      newdps[2] = '2';
-    }
-    if (command[9] == '1')
+
+    if (isTruncated)
     {
-      newhand = 1;
+      return;
     }
 
-    ndiSerialSleep(pol->SerialDevice, 100);  // let the device adjust itself
-    if (ndiSerialComm(pol->SerialDevice, newspeed, newdps, newhand) != 0)
+    if (mode & NDI_PASSIVE_STRAY)
     {
-      ndiSetError(pol, NDI_BAD_COMM);
+      // Save marker count
+      int strayCount = (unsigned char)replyIndex[0];
+      replyIndex++;
+
+      // Save off out of volume status
+      int numBytes = (strayCount + 7) / 8;
+      for (int j = 0; j < numBytes; ++j)
+      {
+        api->BxPassiveStrayOutOfVolume[j] = (unsigned char)replyIndex[0];
+        ++replyIndex;
+      }
+
+      // 3 float, Tx, Ty, Tz for each marker
+      if (!ndiReserveArray(api->BxPassiveStrayPosition, api->BxPassiveStrayCapacity, strayCount))
+      {
+        api->BxPassiveStrayCount = 0;
+        return;
+      }
+      for (int j = 0; j < strayCount; ++j)
+      {
+        memcpy(api->BxPassiveStrayPosition[j], replyIndex, sizeof(float) * 3);
+        replyIndex += 12;
+      }
+      api->BxPassiveStrayCount = strayCount;
     }
+
+    // Get the system status
+    api->BxSystemStatus = (char)replyIndex[1] << 8 | (char)replyIndex[0];
+    replyIndex += 2;
   }
 
   //----------------------------------------------------------------------------
-  // Sleep for 100 milliseconds after an INIT command.
-  void ndiINITHelper(ndicapi* pol, const char* command, const char* commandReply)
+  // Copy all the GX reply information into the ndicapi structure, according
+  // to the GX reply mode that was requested.
+  //
+  // This function is called every time a GX command is sent to the
+  // Measurement System.
+  //
+  // This information can be later extracted through one of the ndiGetGXxx()
+  // functions.
+  void ndiGXHelper(ndicapi* pol, const char* command, const char* commandReply)
   {
-    if (pol->SerialDevice != NDI_INVALID_HANDLE)
-    {
-      ndiSerialSleep(pol->SerialDevice, 100);
-    }
-    else
+    unsigned long mode = NDI_XFORMS_AND_STATUS; // the default reply mode
+    char* writePointer;
+    int i, j, k;
+    int passiveCount, activeCount;
+
+    // if the GX command had a reply mode, read it
+    if ((command[2] == ':' && command[7] != '\r') || (command[2] == ' ' && command[3] != '\r'))
     {
-      ndiSocketSleep(pol->Socket, 100);
+      mode = ndiHexToUnsignedLong(&command[3], 4);
     }
-  }
-}
 
-//----------------------------------------------------------------------------
-ndicapiExport char* ndiCommand(ndicapi* pol, const char* format, ...)
-{
-  char* reply;
-  va_list ap;            // see stdarg.h
-  va_start(ap, format);
+    // always three active ports
+    activeCount = 3;
 
-  reply = ndiCommandVA(pol, format, ap);
+    if (mode & NDI_XFORMS_AND_STATUS)
+    {
+      for (k = 0; k < activeCount; k += 3)
+      {
+        // grab the three transforms
+        for (i = 0; i < 3; i++)
+        {
+          writePointer = pol->GxTransforms[i];
+          for (j = 0; j < 51 && *commandReply >= ' '; j++)
+          {
+            *writePointer++ = *commandReply++;
+          }
+          *writePointer = '\0';
+          // eat the trailing newline
+          if (*commandReply == '\n')
+          {
+            commandReply++;
+          }
+        }
+        // grab the status flags
+        writePointer = pol->GxStatus + k / 3 * 8;
+        for (j = 0; j < 8 && *commandReply >= ' '; j++)
+        {
+          *writePointer++ = *commandReply++;
+        }
+      }
+      // eat the trailing newline
+      if (*commandReply == '\n')
+      {
+        commandReply++;
+      }
+    }
 
-  va_end(ap);
+    if (mode & NDI_ADDITIONAL_INFO)
+    {
+      // grab information for each port
+      for (i = 0; i < activeCount; i++)
+      {
+        writePointer = pol->GxInformation[i];
+        for (j = 0; j < 12 && *commandReply >= ' '; j++)
+        {
+          *writePointer++ = *commandReply++;
+        }
+      }
+      // eat the trailing newline
+      if (*commandReply == '\n')
+      {
+        commandReply++;
+      }
+    }
 
-  return reply;
+    if (mode & NDI_SINGLE_STRAY)
+    {
+      // grab stray marker for each port
+      for (i = 0; i < activeCount; i++)
+      {
+        writePointer = pol->GxSingleStray[i];
+        for (j = 0; j < 21 && *commandReply >= ' '; j++)
+        {
+          *writePointer++ = *commandReply++;
+        }
+        *writePointer = '\0';
+        // eat the trailing newline
+        if (*commandReply == '\n')
+        {
+          commandReply++;
+        }
+      }
+    }
+
+    if (mode & NDI_FRAME_NUMBER)
+    {
+      // get frame number for each port
+      for (i = 0; i < activeCount; i++)
+      {
+        writePointer = pol->GxFrame[i];
+        for (j = 0; j < 8 && *commandReply >= ' '; j++)
+        {
+          *writePointer++ = *commandReply++;
+        }
+      }
+      // eat the trailing newline
+      if (*commandReply == '\n')
+      {
+        commandReply++;
+      }
+    }
+
+    // if there is no passive information, stop here
+    if (!(mode & NDI_PASSIVE))
+    {
+      ndiGXDecode(pol);
+      return;
+    }
+
+    // in case there are 9 passive tools instead of just 3
+    passiveCount = 3;
+    if (mode & NDI_PASSIVE_EXTRA)
+    {
+      passiveCount = 9;
+    }
+
+    if ((mode & NDI_XFORMS_AND_STATUS) || (mode == NDI_PASSIVE))
+    {
+      // the information is grouped in threes
+      for (k = 0; k < passiveCount; k += 3)
+      {
+        // grab the three transforms
+        for (i = 0; i < 3; i++)
+        {
+          writePointer = pol->GxPassiveTransforms[k + i];
+          for (j = 0; j < 51 && *commandReply >= ' '; j++)
+          {
+            *writePointer++ = *commandReply++;
+          }
+          *writePointer = '\0';
+          // eat the trailing newline
+          if (*commandReply == '\n')
+          {
+            commandReply++;
+          }
+        }
+        // grab the status flags
+        writePointer = pol->GxPassiveStatus + k / 3 * 8;
+        for (j = 0; j < 8 && *commandReply >= ' '; j++)
+        {
+          *writePointer++ = *commandReply++;
+        }
+        // skip the newline
+        if (*commandReply == '\n')
+        {
+          commandReply++;
+        }
+        else   // no newline: no more passive transforms
+        {
+          passiveCount = k + 3;
+        }
+      }
+      // eat the trailing newline
+      if (*commandReply == '\n')
+      {
+        commandReply++;
+      }
+    }
+
+    if (mode & NDI_ADDITIONAL_INFO)
+    {
+      // grab information for each port
+      for (i = 0; i < passiveCount; i++)
+      {
+        writePointer = pol->GxPassiveInformation[i];
+        for (j = 0; j < 12 && *commandReply >= ' '; j++)
+        {
+          *writePointer++ = *commandReply++;
+        }
+      }
+      // eat the trailing newline
+      if (*commandReply == '\n')
+      {
+        commandReply++;
+      }
+    }
+
+    if (mode & NDI_FRAME_NUMBER)
+    {
+      // get frame number for each port
+      for (i = 0; i < passiveCount; i++)
+      {
+        writePointer = pol->GxPassiveFrame[i];
+        for (j = 0; j < 8 && *commandReply >= ' '; j++)
+        {
+          *writePointer++ = *commandReply++;
+        }
+      }
+      // eat the trailing newline
+      if (*commandReply == '\n')
+      {
+        commandReply++;
+      }
+    }
+
+    if (mode & NDI_PASSIVE_STRAY)
+    {
+      // get all the passive stray information
+      // this will be a maximum of 3 + 20*3*7 = 423 bytes
+      writePointer = pol->GxPassiveStray;
+      for (j = 0; j < 423 && *commandReply >= ' '; j++)
+      {
+        *writePointer++ = *commandReply++;
+      }
+    }
+
+    // decode everything once, rather than in every getter
+    ndiGXDecode(pol);
+  }
+
+  //----------------------------------------------------------------------------
+  // Copy all the PSTAT reply information into the ndicapi structure.
+  void ndiPSTATHelper(ndicapi* pol, const char* command, const char* commandReply)
+  {
+    ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+    unsigned long mode = NDI_XFORMS_AND_STATUS; // the default reply mode
+    char* writePointer;
+    int i, j;
+    int passiveCount, activeCount;
+
+    // if the PSTAT command had a reply mode, read it
+    if ((command[5] == ':' && command[10] != '\r') || (command[5] == ' ' && command[6] != '\r'))
+    {
+      mode = ndiHexToUnsignedLong(&command[6], 4);
+    }
+
+    // always three active ports
+    activeCount = 3;
+
+    // information for each port is separated by a newline
+    for (i = 0; i < activeCount; i++)
+    {
+      // basic tool information and port status
+      if (mode & NDI_BASIC)
+      {
+        writePointer = replies->PstatBasic[i];
+        for (j = 0; j < 32 && *commandReply >= ' '; j++)
+        {
+          *writePointer++ = *commandReply++;
+        }
+        // terminate if UNOCCUPIED
+        if (j < 32)
+        {
+          *writePointer = '\0';
+        }
+      }
+
+      // current testing
+      if (mode & NDI_TESTING)
+      {
+        writePointer = replies->PstatTesting[i];
+        *writePointer = '\0';
+        for (j = 0; j < 8 && *commandReply >= ' '; j++)
+        {
+          *writePointer++ = *commandReply++;
+        }
+      }
+
+      // part number
+      if (mode & NDI_PART_NUMBER)
+      {
+        writePointer = replies->PstatPartNumber[i];
+        *writePointer = '\0';
+        for (j = 0; j < 20 && *commandReply >= ' '; j++)
+        {
+          *writePointer++ = *commandReply++;
+        }
+      }
+
+      // accessories
+      if (mode & NDI_ACCESSORIES)
+      {
+        writePointer = replies->PstatAccessories[i];
+        *writePointer = '\0';
+        for (j = 0; j < 2 && *commandReply >= ' '; j++)
+        {
+          *writePointer++ = *commandReply++;
+        }
+      }
+
+      // marker type
+      if (mode & NDI_MARKER_TYPE)
+      {
+        writePointer = replies->PstatMarkerType[i];
+        *writePointer = '\0';
+        for (j = 0; j < 2 && *commandReply >= ' '; j++)
+        {
+          *writePointer++ = *commandReply++;
+        }
+      }
+
+      // skip any other information that might be present
+      while (*commandReply >= ' ')
+      {
+        commandReply++;
+      }
+
+      // eat the trailing newline
+      if (*commandReply == '\n')
+      {
+        commandReply++;
+      }
+    }
+
+    // if there is no passive information, stop here
+    if (!(mode & NDI_PASSIVE))
+    {
+      return;
+    }
+
+    // in case there are 9 passive tools instead of just 3
+    passiveCount = 3;
+    if (mode & NDI_PASSIVE_EXTRA)
+    {
+      passiveCount = 9;
+    }
+
+    // information for each port is separated by a newline
+    for (i = 0; i < passiveCount; i++)
+    {
+      // basic tool information and port status
+      if (mode & NDI_BASIC)
+      {
+        writePointer = replies->PstatPassiveBasic[i];
+        *writePointer = '\0';
+        for (j = 0; j < 32 && *commandReply >= ' '; j++)
+        {
+          *writePointer++ = *commandReply++;
+        }
+        // terminate if UNOCCUPIED
+        if (j < 32)
+        {
+          *writePointer = '\0';
+        }
+      }
+
+      // current testing
+      if (mode & NDI_TESTING)
+      {
+        writePointer = replies->PstatPassiveTesting[i];
+        *writePointer = '\0';
+        for (j = 0; j < 8 && *commandReply >= ' '; j++)
+        {
+          *writePointer++ = *commandReply++;
+        }
+      }
+
+      // part number
+      if (mode & NDI_PART_NUMBER)
+      {
+        writePointer = replies->PstatPassivePartNumber[i];
+        *writePointer = '\0';
+        for (j = 0; j < 20 && *commandReply >= ' '; j++)
+        {
+          *writePointer++ = *commandReply++;
+        }
+      }
+
+      // accessories
+      if (mode & NDI_ACCESSORIES)
+      {
+        writePointer = replies->PstatPassiveAccessories[i];
+        *writePointer = '\0';
+        for (j = 0; j < 2 && *commandReply >= ' '; j++)
+        {
+          *writePointer++ = *commandReply++;
+        }
+      }
+
+      // marker type
+      if (mode & NDI_MARKER_TYPE)
+      {
+        writePointer = replies->PstatPassiveMarkerType[i];
+        *writePointer = '\0';
+        for (j = 0; j < 2 && *commandReply >= ' '; j++)
+        {
+          *writePointer++ = *commandReply++;
+        }
+      }
+
+      // skip any other information that might be present
+      while (*commandReply >= ' ')
+      {
+        commandReply++;
+      }
+
+      // eat the trailing newline
+      if (*commandReply == '\n')
+      {
+        commandReply++;
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Copy all the SSTAT reply information into the ndicapi structure.
+  void ndiSSTATHelper(ndicapi* pol, const char* command, const char* commandReply)
+  {
+    ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+    unsigned long mode;
+    char* writePointer;
+
+    // read the SSTAT command reply mode
+    mode = ndiHexToUnsignedLong(&command[6], 4);
+
+    if (mode & NDI_CONTROL)
+    {
+      writePointer = replies->SstatControl;
+      *writePointer++ = *commandReply++;
+      *writePointer++ = *commandReply++;
+    }
+
+    if (mode & NDI_SENSORS)
+    {
+      writePointer = replies->SstatSensor;
+      *writePointer++ = *commandReply++;
+      *writePointer++ = *commandReply++;
+    }
+
+    if (mode & NDI_TIU)
+    {
+      writePointer = replies->SstatTiu;
+      *writePointer++ = *commandReply++;
+      *writePointer++ = *commandReply++;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Copy all the IRCHK reply information into the ndicapi structure.
+  void ndiIRCHKHelper(ndicapi* pol, const char* command, const char* commandReply)
+  {
+    ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+    unsigned long mode = NDI_XFORMS_AND_STATUS; // the default reply mode
+    int j;
+
+    // if the IRCHK command had a reply mode, read it
+    if ((command[5] == ':' && command[10] != '\r') || (command[5] == ' ' && command[6] != '\r'))
+    {
+      mode = ndiHexToUnsignedLong(&command[6], 4);
+    }
+
+    // a single character, '0' or '1'
+    if (mode & NDI_DETECTED)
+    {
+      replies->IrchkDetected = *commandReply++;
+    }
+
+    // maximum string length for 20 sources is 2*(3 + 20*3) = 126
+    // copy until a control char (less than 0x20) is found
+    if (mode & NDI_SOURCES)
+    {
+      for (j = 0; j < 126 && *commandReply >= ' '; j++)
+      {
+        replies->IrchkSources[j] = *commandReply++;
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Adjust the host to match a COMM command.
+  void ndiCOMMHelper(ndicapi* pol, const char* command, const char* commandReply)
+  {
+    static int convert_baud[8] = { 9600, 14400, 19200, 38400, 57600, 115200, 921600, 1228739 };
+    char newdps[4] = "8N1";
+    int newspeed = 9600;
+    int newhand = 0;
+
+    if ((command[5] >= '0' && command[5] <= '7') || command[5] == 'A')
+    {
+      if (command[5] != 'A')
+      {
+        newspeed = convert_baud[command[5] - '0'];
+      }
+      else
+      {
+        newspeed = 230400;
+      }
+    }
+    if (command[6] == '1')
+    {
+      newdps[0] = '7';
+    }
+    if (command[7] == '1')
+    {
+      newdps[1] = 'O';
+    }
+    else if (command[7] == '2')
+    {
+      newdps[1] = 'E';
+    }
+    if (command[8] == '1')
+    {
+      newdps[2] = '2';
+    }
+    if (command[9] == '1')
+    {
+      newhand = 1;
+    }
+
+    if (pol->SerialDevice == NDI_INVALID_HANDLE)
+    {
+      // network devices and replayed captures have no serial settings
+      return;
+    }
+
+    ndiSerialSleep(pol->SerialDevice, 100);  // let the device adjust itself
+    if (ndiSerialComm(pol->SerialDevice, newspeed, newdps, newhand) != 0)
+    {
+      ndiSetError(pol, NDI_BAD_COMM);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Sleep for 100 milliseconds after an INIT command.
+  void ndiINITHelper(ndicapi* pol, const char* command, const char* commandReply)
+  {
+    if (pol->SerialDevice != NDI_INVALID_HANDLE)
+    {
+      ndiSerialSleep(pol->SerialDevice, 100);
+    }
+    else
+    {
+      ndiSocketSleep(pol->Socket, 100);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Copy a reply into commandReply with the CRC hacked off, and check the CRC.
+  //
+  // The return value is the length of commandReply, or -1 if the reply was
+  // too short to contain a CRC.  The crcOkay flag is set according to
+  // whether the CRC matched the contents of the reply.
+  int ndiStripReplyCRC(const char* reply, int bytes, bool isBinary, char* commandReply, bool* crcOkay)
+  {
+    int i;
+
+    *crcOkay = false;
+
+    // back up to before the CRC
+    if (!isBinary)
+    {
+      bytes -= 5; // 4 ASCII chars
+    }
+    else
+    {
+      bytes -= 2; // 2 bytes (unsigned short)
+    }
+    if (bytes < 0)
+    {
+      return -1;
+    }
+
+    // calculate the CRC and copy reply to commandReply
+    unsigned short CRC16 = ndiCRC16(0, reply, bytes);
+    memcpy(commandReply, reply, bytes);
+    i = bytes;
+
+    if (!isBinary)
+    {
+      // terminate commandReply before the CRC
+      commandReply[i] = '\0';
+      *crcOkay = (CRC16 == ndiHexToUnsignedLong(&reply[bytes], 4));
+    }
+    else
+    {
+      unsigned short replyCrc = (unsigned char)reply[bytes + 1] << 8 | (unsigned char)reply[bytes];
+      *crcOkay = (CRC16 == replyCrc);
+    }
+
+    return bytes;
+  }
+
+  //----------------------------------------------------------------------------
+  // Check whether the reply to a command will be binary, given the length
+  // of the command name.
+  bool ndiIsBinaryCommand(const char* command, int n)
+  {
+    return (n == 2 && strncmp(command, "BX", n) == 0) ||
+           (n == 6 && strncmp(command, "GETLOG", n) == 0) ||
+           (n == 4 && strncmp(command, "VGET", n) == 0);
+  }
+
+  //----------------------------------------------------------------------------
+  // Append the CRC and a carriage return to a formatted command, the CRC
+  // is only used if a ':' follows the command name.  Returns the length of
+  // the framed command, and also provides the length of the command name
+  // and whether the reply will be binary.
+  int ndiFrameCommand(char* command, int* commandLength, bool* isBinary)
+  {
+    int i;
+    bool useCrc = false;
+    bool inCommand = true;
+
+    *commandLength = 0;
+    for (i = 0; command[i] != '\0'; i++)
+    {
+      if (inCommand && command[i] == ':')             // only use CRC if a ':'
+      {
+        useCrc = true;                                //  follows the command
+      }
+      if (inCommand && !((command[i] >= 'A' && command[i] <= 'Z') ||
+                         (command[i] >= '0' && command[i] <= '9')))
+      {
+        inCommand = false;                            // 'command' part has ended
+        *commandLength = i;                           // command length
+      }
+    }
+    if (inCommand)
+    {
+      // Command was sent with no ':'
+      // Example, ndiCommand("INIT");
+      *commandLength = i;
+    }
+
+    if (useCrc)
+    {
+      sprintf(&command[i], "%04X", ndiCRC16(0, command, i)); // tack on the CRC
+      i += 4;
+    }
+
+    command[i++] = '\r';                              // tack on carriage return
+    command[i] = '\0';                                // terminate for good luck
+
+    *isBinary = ndiIsBinaryCommand(command, *commandLength);
+
+    return i;
+  }
+
+  //----------------------------------------------------------------------------
+  // Call the helper function for the command, if it has one.
+  void ndiCommandHelper(ndicapi* api, const char* command, int commandLength, const char* commandReply)
+  {
+    if (command[0] == 'T' && command[1] == 'X' && commandLength == 2)   // the TX command
+    {
+      ndiTXHelper(api, command, commandReply);
+    }
+    else if (command[0] == 'B' && command[1] == 'X' && commandLength == 2)   // the BX command
+    {
+      ndiBXHelper(api, command, commandReply);
+    }
+    else if (command[0] == 'G' && command[1] == 'X' && commandLength == 2)   // the GX command
+    {
+      ndiGXHelper(api, command, commandReply);
+    }
+    else if (command[0] == 'C' && commandLength == 4 && strncmp(command, "COMM", commandLength) == 0)
+    {
+      ndiCOMMHelper(api, command, commandReply);
+    }
+    else if (command[0] == 'I' && commandLength == 4 && strncmp(command, "INIT", commandLength) == 0)
+    {
+      ndiINITHelper(api, command, commandReply);
+    }
+    else if (command[0] == 'I' && commandLength == 5 && strncmp(command, "IRCHK", commandLength) == 0)
+    {
+      ndiIRCHKHelper(api, command, commandReply);
+    }
+    else if (command[0] == 'P' && commandLength == 5 && strncmp(command, "PHINF", commandLength) == 0)
+    {
+      ndiPHINFHelper(api, command, commandReply);
+    }
+    else if (command[0] == 'P' && commandLength == 4 && strncmp(command, "PHRQ", commandLength) == 0)
+    {
+      ndiPHRQHelper(api, command, commandReply);
+    }
+    else if (command[0] == 'P' && commandLength == 4 && strncmp(command, "PHSR", commandLength) == 0)
+    {
+      ndiPHSRHelper(api, command, commandReply);
+    }
+    else if (command[0] == 'P' && commandLength == 5 && strncmp(command, "PSTAT", commandLength) == 0)
+    {
+      ndiPSTATHelper(api, command, commandReply);
+    }
+    else if (command[0] == 'S' && commandLength == 5 && strncmp(command, "SSTAT", commandLength) == 0)
+    {
+      ndiSSTATHelper(api, command, commandReply);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+// The commands that configured the device, so that the session can be
+// restored after the connection is lost.  Each command is kept exactly as
+// it was sent, with its CRC and carriage return.
+struct ndiSession
+{
+  struct Entry
+  {
+    std::string Name;                     // the command name, e.g. "PINIT"
+    std::string Text;                     // the framed command
+    std::string Reply;                    // the reply, which is checked for PHRQ
+  };
+
+  std::mutex Mutex;                       // for everything but MaxAttempts
+  std::vector<Entry> Commands;
+  std::atomic<int> MaxAttempts;           // see ndiSetAutoReconnect()
+  std::string SerialNumber;               // from "VER:0", for the SROM cache
+  bool IsSROMCacheStale;                  // INIT was sent before SerialNumber was known
+  ndiReconnectStats Stats;
+  std::deque<ndiReconnectIncident> Incidents;
+};
+
+//----------------------------------------------------------------------------
+static ndiSession* ndiSessionCreate()
+{
+  ndiSession* session = new ndiSession();
+  session->MaxAttempts = 0;
+  session->IsSROMCacheStale = false;
+  memset(&session->Stats, 0, sizeof(session->Stats));
+  return session;
+}
+
+//----------------------------------------------------------------------------
+static void ndiSessionDestroy(ndiSession* session)
+{
+  delete session;
+}
+
+namespace
+{
+  const int NDI_RECONNECT_FIRST_DELAY_MS = 100;
+  const int NDI_RECONNECT_MAX_DELAY_MS = 5000;
+  const size_t NDI_RECONNECT_MAX_INCIDENTS = 32;
+
+  //----------------------------------------------------------------------------
+  // Record a command that succeeded, if it is one that configures the device.
+  void ndiSessionRecord(ndicapi* pol, const char* command, int n, int commandLength, const char* commandReply)
+  {
+    static const char* const recorded[] =
+    {
+      "INIT", "COMM", "PHRQ", "PVWR", "PINIT", "PENA", "PDIS", "PHF",
+      "TTCFG", "SET", "VSEL", "IRATE", "TSTART", "TSTOP", NULL
+    };
+    ndiSession* session = pol->Session;
+    int i;
+
+    if (session == NULL)
+    {
+      return;
+    }
+    std::string name(command, commandLength);
+    for (i = 0; recorded[i] != NULL && name != recorded[i]; i++)
+    {
+    }
+    if (recorded[i] == NULL)
+    {
+      return;
+    }
+
+    ndiSession::Entry entry;
+    entry.Name = name;
+    entry.Text.assign(command, n);
+    if (name == "PHRQ")
+    {
+      entry.Reply = commandReply;
+    }
+
+    std::lock_guard<std::mutex> lock(session->Mutex);
+    std::vector<ndiSession::Entry>& commands = session->Commands;
+    if (name == "INIT")
+    {
+      // the device forgets everything else, including the ROMs that were
+      // written to its ports, so the SROM cache no longer describes it
+      commands.clear();
+      if (session->SerialNumber.empty())
+      {
+        session->IsSROMCacheStale = true;
+      }
+      else
+      {
+        ndiRemoveCacheEntries("sroms", session->SerialNumber + " ");
+      }
+    }
+    else if (name == "TSTART" || name == "TSTOP")
+    {
+      for (size_t j = commands.size(); j > 0; j--)
+      {
+        if (commands[j - 1].Name == "TSTART")
+        {
+          commands.erase(commands.begin() + (j - 1));
+        }
+      }
+      if (name == "TSTOP")
+      {
+        return;
+      }
+    }
+    else if (name == "COMM")
+    {
+      // only the most recent rate matters
+      for (size_t j = 0; j < commands.size(); j++)
+      {
+        if (commands[j].Name == "COMM")
+        {
+          commands[j] = entry;
+          return;
+        }
+      }
+    }
+    commands.push_back(entry);
+  }
+
+  //----------------------------------------------------------------------------
+  // Forget the recorded commands, e.g. after a serial break.
+  void ndiSessionClear(ndicapi* pol)
+  {
+    if (pol->Session)
+    {
+      std::lock_guard<std::mutex> lock(pol->Session->Mutex);
+      pol->Session->Commands.clear();
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void ndiSessionSleep(ndicapi* pol, int milliseconds)
+  {
+    if (pol->SerialDeviceName != NULL)
+    {
+      ndiSerialSleep(pol->SerialDevice, milliseconds);
+    }
+    else
+    {
+      ndiSocketSleep(pol->Socket, milliseconds);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Send a framed command and check the reply, without touching the reply
+  // data of the device handle, since the application may be reading it.
+  // Returns an error code.
+  int ndiSessionSend(ndicapi* pol, const std::string& text, std::string* reply)
+  {
+    char buffer[2048];          // the replies to these commands are short
+    char commandReply[2048];
+    int n = (int)text.size();
+    int errorCode = 0;
+    int m;
+    unsigned long long sendTime = ndiTimeNanoseconds();
+
+    ndiCaptureWrite(pol->Capture, NDI_CAPTURE_COMMAND, sendTime, text.c_str(), n);
+    if (pol->SerialDevice != NDI_INVALID_HANDLE)
+    {
+      ndiSerialFlush(pol->SerialDevice, NDI_IFLUSH);
+      m = ndiSerialWrite(pol->SerialDevice, text.c_str(), n);
+    }
+    else
+    {
+      ndiSocketFlush(pol->Socket, NDI_IFLUSH);
+      m = ndiSocketWrite(pol->Socket, text.c_str(), n);
+    }
+    if (m < 0)
+    {
+      return NDI_WRITE_ERROR;
+    }
+    else if (m < n)
+    {
+      return NDI_TIMEOUT;
+    }
+    ndiMetricsCommand(pol, n, sendTime);
+
+    if (pol->SerialDevice != NDI_INVALID_HANDLE)
+    {
+      m = ndiSerialRead(pol->SerialDevice, buffer, sizeof(buffer) - 1, false, &errorCode);
+    }
+    else
+    {
+      m = ndiSocketRead(pol->Socket, buffer, sizeof(buffer) - 1, false, &errorCode);
+    }
+    if (m < 0)
+    {
+      return NDI_READ_ERROR;
+    }
+    else if (m == 0)
+    {
+      return NDI_TIMEOUT;
+    }
+    else if (errorCode != 0)
+    {
+      return errorCode;
+    }
+    unsigned long long replyTime = ndiTimeNanoseconds();
+    ndiCaptureWrite(pol->Capture, NDI_CAPTURE_REPLY, replyTime, buffer, m);
+    ndiMetricsReply(pol, m, 0, 0, replyTime);
+
+    bool crcOkay;
+    if (ndiStripReplyCRC(buffer, m, false, commandReply, &crcOkay) < 0 || !crcOkay)
+    {
+      return NDI_BAD_CRC;
+    }
+    if (strncmp(commandReply, "ERROR", 5) == 0)
+    {
+      return (int)ndiHexToUnsignedLong(&commandReply[5], 2);
+    }
+    if (reply)
+    {
+      *reply = commandReply;
+    }
+    return NDI_OKAY;
+  }
+
+  //----------------------------------------------------------------------------
+  // Close the serial port or the socket and open it again.
+  int ndiSessionReopen(ndicapi* pol)
+  {
+    if (pol->SerialDeviceName != NULL)
+    {
+      if (pol->SerialDevice != NDI_INVALID_HANDLE)
+      {
+        ndiSerialClose(pol->SerialDevice);
+      }
+      pol->SerialDevice = ndiSerialOpen(pol->SerialDeviceName);
+      if (pol->SerialDevice == NDI_INVALID_HANDLE)
+      {
+        return NDI_OPEN_ERROR;
+      }
+      if (ndiSerialComm(pol->SerialDevice, 9600, "8N1", 0) < 0 ||
+          ndiSerialFlush(pol->SerialDevice, NDI_IOFLUSH) < 0)
+      {
+        return NDI_BAD_COMM;
+      }
+      return NDI_OKAY;
+    }
+
+    NDISocketHandle socket;
+    if (pol->Socket != -1)
+    {
+      ndiSocketClose(pol->Socket);
+      pol->Socket = -1;
+    }
+    if (!ndiSocketOpen(pol->Hostname, pol->Port, socket))
+    {
+      return NDI_OPEN_ERROR;
+    }
+    pol->Socket = socket;
+    return NDI_OKAY;
+  }
+
+  //----------------------------------------------------------------------------
+  // Bring a serial device to 9600 baud.  If only the connection was lost,
+  // then the device is still at the rate of the last COMM, and if it was
+  // reset then it is at 9600 baud.  If it answers at neither, it is reset
+  // with a serial break.
+  int ndiSessionSyncSerial(ndicapi* pol, const std::string& comm)
+  {
+    static const std::string init = "INIT:E3A5\r";
+    NDIFileHandle device = pol->SerialDevice;
+
+    ndiSerialTimeout(device, 500);
+    int errorCode = ndiSessionSend(pol, init, NULL);
+    if (errorCode != NDI_OKAY && !comm.empty())
+    {
+      char text[16] = "COMM:00000";
+      int commandLength;
+      bool isBinary;
+      ndiFrameCommand(text, &commandLength, &isBinary);
+
+      ndiCOMMHelper(pol, comm.c_str(), "");
+      errorCode = ndiSessionSend(pol, init, NULL);
+      if (errorCode == NDI_OKAY)
+      {
+        errorCode = ndiSessionSend(pol, text, NULL);
+      }
+      ndiCOMMHelper(pol, text, "");
+    }
+    ndiSerialTimeout(device, 5000);
+
+    if (errorCode != NDI_OKAY)
+    {
+      char reply[64];
+      int m;
+      ndiSerialComm(device, 9600, "8N1", 0);
+      ndiSerialFlush(device, NDI_IOFLUSH);
+      ndiSerialBreak(device);
+      m = ndiSerialRead(device, reply, sizeof(reply) - 1, false, &errorCode);
+      errorCode = (m >= 5 && strncmp(reply, "RESET", 5) == 0 ? NDI_OKAY : NDI_RESET_FAIL);
+    }
+
+    return errorCode;
+  }
+
+  //----------------------------------------------------------------------------
+  // Send the recorded commands again.
+  int ndiSessionReplay(ndicapi* pol, const std::vector<ndiSession::Entry>& commands)
+  {
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+      const ndiSession::Entry& entry = commands[i];
+      std::string reply;
+      int errorCode = ndiSessionSend(pol, entry.Text, &reply);
+      if (errorCode != NDI_OKAY)
+      {
+        return errorCode;
+      }
+      if (entry.Name == "PHRQ" && reply != entry.Reply)
+      {
+        // the tools would not be where the application expects them
+        return NDI_BAD_REPLY;
+      }
+      if (entry.Name == "COMM")
+      {
+        ndiCOMMHelper(pol, entry.Text.c_str(), reply.c_str());
+      }
+      else if (entry.Name == "INIT")
+      {
+        ndiINITHelper(pol, entry.Text.c_str(), reply.c_str());
+      }
+    }
+    return NDI_OKAY;
+  }
+
+  //----------------------------------------------------------------------------
+  // Restore the session after the connection failed with the given error.
+  // The delay between attempts doubles each time, and the attempts stop
+  // early if isCancelled() returns true.  Returns an error code.
+  int ndiSessionReconnect(ndicapi* pol, int errorCode, int maxAttempts, bool (*isCancelled)(ndicapi*))
+  {
+    ndiSession* session = pol->Session;
+    std::vector<ndiSession::Entry> commands;
+    std::string comm;
+
+    if (session == NULL || pol->Replay || (pol->SerialDeviceName == NULL && pol->Hostname == NULL))
+    {
+      return NDI_OPEN_ERROR;
+    }
+
+    ndiReconnectIncident incident;
+    incident.StartTime = ndiTimeNanoseconds();
+    incident.Downtime = 0;
+    incident.ErrorCode = errorCode;
+    incident.ResultCode = errorCode;
+    incident.Attempts = 0;
+
+    {
+      std::lock_guard<std::mutex> lock(session->Mutex);
+      commands = session->Commands;
+      session->Stats.IsReconnecting = 1;
+    }
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+      if (commands[i].Name == "COMM")
+      {
+        comm = commands[i].Text;
+      }
+    }
+
+    int delay = NDI_RECONNECT_FIRST_DELAY_MS;
+    while ((maxAttempts < 0 || incident.Attempts < maxAttempts) && !(isCancelled && isCancelled(pol)))
+    {
+      incident.Attempts++;
+      int result = ndiSessionReopen(pol);
+      if (result == NDI_OKAY && pol->SerialDevice != NDI_INVALID_HANDLE)
+      {
+        result = ndiSessionSyncSerial(pol, comm);
+      }
+      if (result == NDI_OKAY)
+      {
+        result = ndiSessionReplay(pol, commands);
+      }
+      incident.ResultCode = result;
+      if (result == NDI_OKAY || (maxAttempts >= 0 && incident.Attempts >= maxAttempts))
+      {
+        break;
+      }
+
+      // wait a little longer each time, but not if asked to stop
+      for (int waited = 0; waited < delay && !(isCancelled && isCancelled(pol)); waited += 50)
+      {
+        ndiSessionSleep(pol, 50);
+      }
+      delay = std::min(2 * delay, NDI_RECONNECT_MAX_DELAY_MS);
+    }
+    incident.Downtime = ndiTimeNanoseconds() - incident.StartTime;
+
+    std::lock_guard<std::mutex> lock(session->Mutex);
+    ndiReconnectStats& stats = session->Stats;
+    stats.Incidents++;
+    stats.Recovered += (incident.ResultCode == NDI_OKAY);
+    stats.Attempts += incident.Attempts;
+    stats.IsReconnecting = 0;
+    stats.TotalDowntime += incident.Downtime;
+    stats.MaxDowntime = std::max(stats.MaxDowntime, incident.Downtime);
+    session->Incidents.push_back(incident);
+    if (session->Incidents.size() > NDI_RECONNECT_MAX_INCIDENTS)
+    {
+      session->Incidents.pop_front();
+    }
+
+    return incident.ResultCode;
+  }
+
+  //----------------------------------------------------------------------------
+  // Reconnect from the tracking thread or the streaming thread, if the
+  // application asked for it and if the error means the connection failed.
+  bool ndiSessionAutoReconnect(ndicapi* pol, int errorCode, bool (*isCancelled)(ndicapi*))
+  {
+    if (pol->Session == NULL || pol->Session->MaxAttempts == 0 ||
+        (errorCode != NDI_WRITE_ERROR && errorCode != NDI_READ_ERROR && errorCode != NDI_TIMEOUT))
+    {
+      return false;
+    }
+    return (ndiSessionReconnect(pol, errorCode, pol->Session->MaxAttempts, isCancelled) == NDI_OKAY);
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiReconnect(ndicapi* pol)
+{
+  if (pol->IsThreadedMode || pol->Stream || pol->Group)
+  {
+    return ndiSetError(pol, NDI_INVALID_MODE);
+  }
+
+  int errnum = ndiSessionReconnect(pol, pol->ErrorCode, 1, NULL);
+  if (errnum != NDI_OKAY)
+  {
+    return ndiSetError(pol, errnum);
+  }
+  pol->ErrorCode = NDI_OKAY;
+
+  return NDI_OKAY;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiSetAutoReconnect(ndicapi* pol, int maxAttempts)
+{
+  if (pol->Session)
+  {
+    pol->Session->MaxAttempts = (maxAttempts < 0 ? -1 : maxAttempts);
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetReconnectStats(ndicapi* pol, ndiReconnectStats* stats)
+{
+  memset(stats, 0, sizeof(ndiReconnectStats));
+  if (pol->Session)
+  {
+    std::lock_guard<std::mutex> lock(pol->Session->Mutex);
+    *stats = pol->Session->Stats;
+  }
+
+  return NDI_OKAY;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetReconnectIncidents(ndicapi* pol, ndiReconnectIncident* incidents, int maxCount)
+{
+  int count = 0;
+
+  if (pol->Session)
+  {
+    std::lock_guard<std::mutex> lock(pol->Session->Mutex);
+    const std::deque<ndiReconnectIncident>& recent = pol->Session->Incidents;
+    size_t first = (recent.size() > (size_t)maxCount ? recent.size() - maxCount : 0);
+    for (size_t i = first; i < recent.size(); i++)
+    {
+      incidents[count++] = recent[i];
+    }
+  }
+
+  return count;
+}
+
+//----------------------------------------------------------------------------
+// The SROM cache.  For each device serial number and port handle, the
+// cache file "sroms" holds the hash of the last ROM that was written and
+// the identity that PHINF reported for the tool afterwards.  If both still
+// match, the ROM is already in the virtual SROM and is not written again.
+namespace
+{
+  const int NDI_SROM_SIZE = 1024;
+
+  //----------------------------------------------------------------------------
+  // Read the start of a ROM file into rom, which is padded with zeros.  The
+  // file is mapped into memory rather than read through a buffer.
+  bool ndiReadROMFile(const char* filename, unsigned char rom[NDI_SROM_SIZE])
+  {
+    memset(rom, 0, NDI_SROM_SIZE);
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+      return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize))
+    {
+      CloseHandle(file);
+      return false;
+    }
+    size_t size = (fileSize.QuadPart < NDI_SROM_SIZE ? (size_t)fileSize.QuadPart : NDI_SROM_SIZE);
+    bool success = true;
+    if (size > 0)
+    {
+      HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+      const void* data = (mapping != NULL ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size) : NULL);
+      if (data != NULL)
+      {
+        memcpy(rom, data, size);
+        UnmapViewOfFile(data);
+      }
+      success = (data != NULL);
+      if (mapping != NULL)
+      {
+        CloseHandle(mapping);
+      }
+    }
+    CloseHandle(file);
+    return success;
+#else
+    int file = open(filename, O_RDONLY);
+    if (file < 0)
+    {
+      return false;
+    }
+    struct stat info;
+    if (fstat(file, &info) != 0)
+    {
+      close(file);
+      return false;
+    }
+    size_t size = (info.st_size < NDI_SROM_SIZE ? (size_t)info.st_size : NDI_SROM_SIZE);
+    bool success = true;
+    if (size > 0)
+    {
+      void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+      if (data != MAP_FAILED)
+      {
+        memcpy(rom, data, size);
+        munmap(data, size);
+      }
+      success = (data != MAP_FAILED);
+    }
+    close(file);
+    return success;
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  // FNV-1a, to recognize a ROM that has been written before.
+  unsigned long long ndiHashROM(const unsigned char rom[NDI_SROM_SIZE])
+  {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (int i = 0; i < NDI_SROM_SIZE; i++)
+    {
+      hash = (hash ^ rom[i]) * 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the serial number of the device, which is asked for only once.
+  std::string ndiSROMDeviceSerialNumber(ndicapi* pol)
+  {
+    ndiSession* session = pol->Session;
+    if (session == NULL)
+    {
+      return std::string();
+    }
+    if (session->SerialNumber.empty())
+    {
+      // a device that doesn't answer just isn't cached, so don't report it
+      NDIErrorCallback callback = pol->ErrorCallback;
+      pol->ErrorCallback = NULL;
+      const char* reply = ndiCommand(pol, "VER:0");
+      if (ndiGetError(pol) == NDI_OKAY)
+      {
+        session->SerialNumber = ndiVersionSerialNumber(reply);
+      }
+      pol->ErrorCallback = callback;
+      pol->ErrorCode = NDI_OKAY;
+    }
+    return session->SerialNumber;
+  }
+
+  //----------------------------------------------------------------------------
+  // Get what PHINF says about the tool on the port: the tool type,
+  // manufacturer, revision, serial number and part number, hex encoded.
+  // Returns false if the port is unoccupied or PHINF failed.
+  bool ndiSROMIdentity(ndicapi* pol, int port, std::string& identity)
+  {
+    char information[31 + 20];
+    char text[2 * sizeof(information) + 1];
+
+    NDIErrorCallback callback = pol->ErrorCallback;
+    pol->ErrorCallback = NULL;
+    ndiPHINF(pol, port, NDI_BASIC | NDI_PART_NUMBER);
+    pol->ErrorCallback = callback;
+    if (ndiGetError(pol) != NDI_OKAY)
+    {
+      pol->ErrorCode = NDI_OKAY;
+      return false;
+    }
+    if (ndiGetPHINFToolInfo(pol, information) != NDI_OKAY ||
+        ndiGetPHINFPartNumber(pol, &information[31]) != NDI_OKAY)
+    {
+      return false;
+    }
+    identity.assign(ndiHexEncode(text, information, sizeof(information)), 2 * sizeof(information));
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Record the PVWR commands for a ROM that was not written, so that
+  // ndiReconnect() still writes it.
+  void ndiSROMRecord(ndicapi* pol, int port, const unsigned char rom[NDI_SROM_SIZE])
+  {
+    char hexdata[128];
+    char command[2048];
+    int commandLength;
+    bool isBinary;
+
+    for (int addr = 0; addr < NDI_SROM_SIZE; addr += 64)
+    {
+      sprintf(command, "PVWR:%02X%04X%.128s", port, addr, ndiHexEncode(hexdata, &rom[addr], 64));
+      int n = ndiFrameCommand(command, &commandLength, &isBinary);
+      ndiSessionRecord(pol, command, n, commandLength, "OKAY");
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiPVWRFromFile(ndicapi* pol, int port, char* filename)
+{
+  unsigned char rom[NDI_SROM_SIZE];
+  char hexdata[128];
+  char value[32];
+  int addr;
+
+  pol->ErrorCode = 0;
+
+  if (!ndiReadROMFile(filename, rom))
+  {
+    return -1;
+  }
+
+  // check whether this ROM is already on the port
+  std::string key = ndiSROMDeviceSerialNumber(pol);
+  std::string identity;
+  sprintf(value, "%016llx", ndiHashROM(rom));
+  if (!key.empty())
+  {
+    // forget the ROMs that were written before an INIT that was sent
+    // before the serial number was known
+    {
+      std::lock_guard<std::mutex> lock(pol->Session->Mutex);
+      if (pol->Session->IsSROMCacheStale)
+      {
+        ndiRemoveCacheEntries("sroms", key + " ");
+        pol->Session->IsSROMCacheStale = false;
+      }
+    }
+
+    sprintf(&value[16], " %02X", port & 0xff);
+    key += &value[16];
+    value[16] = '\0';
+
+    std::vector<std::pair<std::string, std::string> > entries;
+    ndiReadCacheFile("sroms", entries);
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+      if (entries[i].first == key && entries[i].second.compare(0, 17, std::string(value) + " ") == 0 &&
+          ndiSROMIdentity(pol, port, identity) && entries[i].second.compare(17, std::string::npos, identity) == 0)
+      {
+        ndiSROMRecord(pol, port, rom);
+        return 0;
+      }
+    }
+  }
+
+  for (addr = 0; addr < NDI_SROM_SIZE; addr += 64)   // write in chunks of 64 bytes
+  {
+    ndiPVWR(pol, port, addr, ndiHexEncode(hexdata, &rom[addr], 64));
+    if (ndiGetError(pol) != NDI_OKAY)
+    {
+      return -1;
+    }
+  }
+
+  // remember what the tool looks like with this ROM
+  if (!key.empty() && ndiSROMIdentity(pol, port, identity))
+  {
+    ndiWriteCacheEntry("sroms", key, std::string(value) + " " + identity);
+  }
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport char* ndiCommand(ndicapi* pol, const char* format, ...)
+{
+  char* reply;
+  va_list ap;            // see stdarg.h
+  va_start(ap, format);
+
+  reply = ndiCommandVA(pol, format, ap);
+
+  va_end(ap);
+
+  return reply;
+}
+
+//----------------------------------------------------------------------------
+// Check the reply in api->Reply and give it to the helper for the command
+// in api->Command.  The reply is copied to api->ReplyNoCRC with the CRC
+// removed.  Returns an error code.
+static int ndiCommandReply(ndicapi* api, int bytes, int commandLength, bool isBinary)
+{
+  char* commandReply = api->ReplyNoCRC;
+  unsigned long long parseTime = ndiTimeNanoseconds();
+
+  // copy the reply to commandReply with the CRC hacked off
+  bool crcOkay;
+  bytes = ndiStripReplyCRC(api->Reply, bytes, isBinary, commandReply, &crcOkay);
+  if (bytes < 0 || !crcOkay)
+  {
+    ndiMetricsParse(api, parseTime);
+    return NDI_BAD_CRC;
+  }
+
+  // check for error code
+  if (commandReply[0] == 'E' && strncmp(commandReply, "ERROR", 5) == 0)
+  {
+    ndiMetricsParse(api, parseTime);
+    return (int)ndiHexToUnsignedLong(&commandReply[5], 2);
+  }
+
+  // special behavior for specific commands, where the helpers for INIT and
+  // COMM wait for the device and set up the port rather than decode
+  bool isSetup = (commandLength == 4 && (strncmp(api->Command, "INIT", 4) == 0 ||
+                                         strncmp(api->Command, "COMM", 4) == 0));
+  if (isSetup)
+  {
+    ndiMetricsParse(api, parseTime);
+  }
+  ndiCommandHelper(api, api->Command, commandLength, commandReply);
+  if (!isSetup)
+  {
+    ndiMetricsParse(api, parseTime);
+  }
+
+  return NDI_OKAY;
+}
+
+//----------------------------------------------------------------------------
+// Read from the serial port or the socket, whichever the device uses.
+static int ndiDeviceReadTimed(ndicapi* pol, char* reply, int n, bool isBinary, int* errorCode,
+                              unsigned long long* firstByteTime, unsigned long long* lastByteTime)
+{
+  if (pol->SerialDevice != NDI_INVALID_HANDLE)
+  {
+    return ndiSerialReadTimed(pol->SerialDevice, reply, n, isBinary, errorCode, firstByteTime, lastByteTime);
+  }
+  return ndiSocketReadTimed(pol->Socket, reply, n, isBinary, errorCode, firstByteTime, lastByteTime);
+}
+
+//----------------------------------------------------------------------------
+// Read one reply into a buffer that grows to fit it.  Most replies fit the
+// buffer as it is.  If a reply fills it, the buffer grows to the length in
+// the BX header, or for an ASCII reply until the carriage return arrives,
+// and the rest of the reply is read into the new space.  Returns the
+// length of the reply, or the result of the read that failed.
+static int ndiReadReply(ndicapi* pol, char*& reply, int& size, bool isBinary, int* errorCode,
+                        unsigned long long* firstByteTime, unsigned long long* lastByteTime)
+{
+  int bytes = ndiDeviceReadTimed(pol, reply, size - 1, isBinary, errorCode, firstByteTime, lastByteTime);
+
+  while (bytes > 0 && bytes == size - 1)
+  {
+    bool hasLength = (isBinary && reply[0] == (char)0xc4 && reply[1] == (char)0xa5);
+    // a text reply has no length, so double the buffer until the '\r' arrives
+    int length = (2 * size < NDI_REPLY_BUFFER_SIZE ? 2 * size : NDI_REPLY_BUFFER_SIZE) - 1;
+    if (hasLength)
+    {
+      // 2 for start sequence, 2 for length, 2 for header CRC, 2 for CRC16
+      length = ((unsigned char)reply[2] | (unsigned char)reply[3] << 8) + 8;
+    }
+    else if (reply[bytes - 1] == '\r')
+    {
+      break;
+    }
+    if (length <= bytes || !ndiReserveArray(reply, size, length + 1))
+    {
+      break;
+    }
+
+    // read the rest as plain bytes, which stops early at each '\r'
+    int end = (length < size - 1 ? length : size - 1);
+    while (bytes < end)
+    {
+      int m = ndiDeviceReadTimed(pol, &reply[bytes], end - bytes, false, errorCode, NULL, lastByteTime);
+      if (m <= 0)
+      {
+        return m;
+      }
+      bytes += m;
+      if (!hasLength && reply[bytes - 1] == '\r')
+      {
+        return bytes;
+      }
+    }
+  }
+
+  return bytes;
+}
+
+//----------------------------------------------------------------------------
+// Send a command that already has its CRC and carriage return, and handle
+// the reply.  This is the part of ndiCommandVA() that is shared with
+// ndiCommandPrepared().
+static char* ndiCommandFramed(ndicapi* api, int i, int commandLength, bool isBinary)
+{
+  int bytes;
+  char* command = api->Command;
+  char* reply = api->Reply;
+  char* commandReply = api->ReplyNoCRC;
+  int errorCode = 0;
+  bool isThreadReply = false;
+
+  // if the command is GX, TX, or BX and thread_mode is on, we copy the reply from
+  //  the thread rather than getting it directly from the Measurement System
+  if (api->IsThreadedMode && api->IsTracking &&
+      commandLength == 2 && ((command[0] == 'G' && command[1] == 'X') ||
+                             (command[0] == 'T' && command[1] == 'X') ||
+                             (command[0] == 'B' && command[1] == 'X')))
+  {
+    // check that the thread is sending the GX/BX/TX command that we want
+    if (strcmp(command, api->ThreadCommand) != 0)
+    {
+      // tell thread to start using the new GX/BX/TX command
+      ndiMutexLock(api->ThreadMutex);
+      strcpy(api->ThreadCommand, command);
+      api->IsThreadedCommandBinary = (command[0] == 'B');
+      ndiMutexUnlock(api->ThreadMutex);
+      // wait for the next data record to arrive (we have to throw it away)
+      if (ndiEventWait(api->ThreadBufferEvent, 5000))
+      {
+        ndiSetError(api, NDI_TIMEOUT);
+        return commandReply;
+      }
+    }
+    // there is usually no wait, because usually new data is ready
+    if (ndiEventWait(api->ThreadBufferEvent, 5000))
+    {
+      ndiSetError(api, NDI_TIMEOUT);
+      return commandReply;
+    }
+    // copy the thread's reply buffer into the main reply buffer, using the
+    // length rather than the terminator because BX replies can contain zeros
+    ndiMutexLock(api->ThreadBufferMutex);
+    bytes = api->ThreadBufferLength;
+    if (!ndiReserveReply(api, bytes))
+    {
+      ndiMutexUnlock(api->ThreadBufferMutex);
+      ndiSetError(api, NDI_BAD_REPLY);
+      return api->ReplyNoCRC;
+    }
+    reply = api->Reply;
+    commandReply = api->ReplyNoCRC;
+    memcpy(reply, api->ThreadBuffer, bytes);
+    if (!isBinary)
+    {
+      reply[bytes] = '\0';   // terminate string
+    }
+    errorCode = api->ThreadErrorCode;
+    api->ReplyFirstByteTime = api->ThreadBufferFirstByteTime;
+    api->ReplyLastByteTime = api->ThreadBufferLastByteTime;
+    ndiMutexUnlock(api->ThreadBufferMutex);
+    // the tracking thread has already added this reply to the clock model
+    isThreadReply = true;
+
+    if (errorCode != 0)
+    {
+      ndiSetError(api, errorCode);
+      return commandReply;
+    }
+  }
+  // if the command is not a GX or thread_mode is not on, then
+  //   send the command directly to the Measurement System and get a reply
+  else
+  {
+    bool isThreadMode = api->IsThreadedMode;
+
+    if (isThreadMode && api->IsTracking)
+    {
+      // block the tracking thread while we slip this command through
+      ndiMutexLock(api->ThreadMutex);
+    }
+
+    // change pol->tracking if either TSTOP or TSTART is sent
+    if ((commandLength == 5 && strncmp(command, "TSTOP", commandLength) == 0) ||
+        (commandLength == 4 && strncmp(command, "INIT", commandLength) == 0))
+    {
+      api->IsTracking = false;
+    }
+    else if (commandLength == 6 && strncmp(command, "TSTART", commandLength) == 0)
+    {
+      api->IsTracking = true;
+      if (isThreadMode)
+      {
+        // this will force the thread to wait until the application sends the first GX command
+        api->ThreadCommand[0] = '\0';
+      }
+    }
+
+    if (api->SerialDevice != NDI_INVALID_HANDLE)
+    {
+      // flush the input buffer, because anything that we haven't read
+      //   yet is garbage left over by a previously failed command
+      ndiSerialFlush(api->SerialDevice, NDI_IFLUSH);
+    }
+    else
+    {
+      ndiSocketFlush(api->Socket, NDI_IFLUSH);
+    }
+
+    // send the command to the Measurement System
+    unsigned long long sendTime = ndiTimeNanoseconds();
+    ndiCaptureWrite(api->Capture, NDI_CAPTURE_COMMAND, sendTime, command, i);
+    if (api->SerialDevice != NDI_INVALID_HANDLE)
+    {
+      bytes = ndiSerialWrite(api->SerialDevice, command, i);
+    }
+    else
+    {
+      bytes = ndiSocketWrite(api->Socket, command, i);
+    }
+    if (bytes < 0)
+    {
+      errorCode = NDI_WRITE_ERROR;
+    }
+    else if (bytes < i)
+    {
+      errorCode = NDI_TIMEOUT;
+    }
+    else
+    {
+      ndiMetricsCommand(api, i, sendTime);
+    }
+
+    // read the reply from the Measurement System
+    bytes = 0;
+    if (errorCode == 0)
+    {
+      int replySize = api->ReplySize;
+      bytes = ndiReadReply(api, api->Reply, replySize, isBinary, &errorCode,
+                           &api->ReplyFirstByteTime, &api->ReplyLastByteTime);
+      reply = api->Reply;
+      if (bytes < 0)
+      {
+        errorCode = NDI_READ_ERROR;
+        bytes = 0;
+      }
+      else if (bytes == 0)
+      {
+        errorCode = NDI_TIMEOUT;
+      }
+      else
+      {
+        ndiCaptureWrite(api->Capture, NDI_CAPTURE_REPLY, api->ReplyLastByteTime, reply, bytes);
+        ndiMetricsReply(api, bytes, sendTime, api->ReplyFirstByteTime, api->ReplyLastByteTime);
+      }
+      if (replySize > api->ReplySize)
+      {
+        // Reply grew to fit the reply, so ReplyNoCRC must grow to match
+        if (ndiResizeArray(api->ReplyNoCRC, api->ReplySize, replySize))
+        {
+          api->ReplySize = replySize;
+          commandReply = api->ReplyNoCRC;
+        }
+        else if (errorCode == 0)
+        {
+          errorCode = NDI_BAD_REPLY;
+        }
+      }
+      if (!isBinary)
+      {
+        reply[bytes] = '\0';   // terminate string
+      }
+    }
+
+    if (isThreadMode & api->IsTracking)
+    {
+      // unblock the tracking thread
+      ndiMutexUnlock(api->ThreadMutex);
+    }
+
+    if (errorCode != 0)
+    {
+      ndiMetricsError(api, errorCode);
+      ndiSetError(api, errorCode);
+      return commandReply;
+    }
+  }
+
+  errorCode = ndiCommandReply(api, bytes, commandLength, isBinary);
+  if (errorCode != NDI_OKAY)
+  {
+    // the tracking thread has already counted the errors in its replies
+    if (!isThreadReply)
+    {
+      ndiMetricsError(api, errorCode);
+    }
+    ndiSetError(api, errorCode);
+    return commandReply;
+  }
+
+  // remember the commands that configure the device, for ndiReconnect()
+  ndiSessionRecord(api, command, i, commandLength, commandReply);
+
+  // GX, TX and BX replies carry frame numbers for the clock model
+  if (commandLength == 2 && !isThreadReply)
+  {
+    ndiClockModelAddReply(api, command[0]);
+  }
+
+  // return the Measurement System reply, but with the CRC hacked off
+  return commandReply;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport char* ndiCommandVA(ndicapi* api, const char* format, va_list ap)
+{
+  int i, bytes, commandLength;
+  char* command;
+  char* reply;
+  char* commandReply;
+  int errorCode = 0;
+
+  command = api->Command;       // text sent to ndicapi
+  reply = api->Reply;     // text received from ndicapi
+  commandReply = api->ReplyNoCRC;   // received text, with CRC hacked off
+  commandLength = 0;                  // length of 'command' part of command
+
+  api->ErrorCode = 0;                 // clear error
+  command[0] = '\0';
+  reply[0] = '\0';
+  commandReply[0] = '\0';
+
+  // verify that the serial device was opened
+  if (api->SerialDevice == NDI_INVALID_HANDLE && api->Hostname == NULL && api->Port < 0)
+  {
+    ndiSetError(api, NDI_OPEN_ERROR);
+    return commandReply;
+  }
+
+  // if the command is NULL, send a break to reset the Measurement System
+  if (format == NULL)
+  {
+    if (api->IsThreadedMode && api->IsTracking)
+    {
+      // block the tracking thread
+      ndiMutexLock(api->ThreadMutex);
+    }
+    api->IsTracking = false;
+
+    if (api->SerialDevice != NDI_INVALID_HANDLE)
+    {
+      ndiSerialComm(api->SerialDevice, 9600, "8N1", 0);
+      ndiSerialFlush(api->SerialDevice, NDI_IOFLUSH);
+      ndiSerialBreak(api->SerialDevice);
+      bytes = ndiSerialRead(api->SerialDevice, reply, api->ReplySize - 1, false, &errorCode);
+    }
+    else
+    {
+      bytes = ndiSocketRead(api->Socket, reply, api->ReplySize - 1, false, &errorCode);
+    }
+
+    // check for correct reply
+    if (strncmp(reply, "RESETBE6F\r", 8) != 0)
+    {
+      ndiSetError(api, NDI_RESET_FAIL);
+      return commandReply;
+    }
+
+    // the device has forgotten its configuration
+    ndiSessionClear(api);
+
+    // terminate the reply string
+    reply[bytes] = '\0';
+    bytes -= 5;
+    strncpy(commandReply, reply, bytes);
+    commandReply[bytes] = '\0';
+
+    // return the reply string, minus the CRC
+    return commandReply;
+  }
+
+  vsprintf(command, format, ap);                    // format parameters
+
+  bool isBinary;
+  i = ndiFrameCommand(command, &commandLength, &isBinary);
+
+  return ndiCommandFramed(api, i, commandLength, isBinary);
+}
+
+//----------------------------------------------------------------------------
+// A command that has been formatted and framed ahead of time.
+struct ndiPreparedCommand
+{
+  char* Text;                             // command with CRC and carriage return
+  int Length;                             // length of the text
+  int CommandLength;                      // length of the command name
+  bool IsBinary;                          // whether the reply is binary
+};
+
+//----------------------------------------------------------------------------
+ndicapiExport ndiPreparedCommand* ndiPrepareCommand(const char* format, ...)
+{
+  char text[2048];
+  va_list ap;
+
+  va_start(ap, format);
+  int n = vsnprintf(text, sizeof(text), format, ap);
+  va_end(ap);
+
+  // leave room for the CRC and carriage return
+  if (n < 0 || n > (int)sizeof(text) - 6)
+  {
+    return NULL;
+  }
+
+  ndiPreparedCommand* prepared = (ndiPreparedCommand*)malloc(sizeof(ndiPreparedCommand));
+  prepared->Length = ndiFrameCommand(text, &prepared->CommandLength, &prepared->IsBinary);
+  prepared->Text = (char*)malloc(prepared->Length + 1);
+  memcpy(prepared->Text, text, prepared->Length + 1);
+
+  return prepared;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport char* ndiCommandPrepared(ndicapi* api, const ndiPreparedCommand* prepared)
+{
+  api->ErrorCode = 0;                 // clear error
+  api->Reply[0] = '\0';
+  api->ReplyNoCRC[0] = '\0';
+
+  // verify that the serial device was opened
+  if (api->SerialDevice == NDI_INVALID_HANDLE && api->Hostname == NULL && api->Port < 0)
+  {
+    ndiSetError(api, NDI_OPEN_ERROR);
+    return api->ReplyNoCRC;
+  }
+
+  // the helpers and the tracking thread look at the command buffer
+  memcpy(api->Command, prepared->Text, prepared->Length + 1);
+
+  return ndiCommandFramed(api, prepared->Length, prepared->CommandLength, prepared->IsBinary);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiFreePreparedCommand(ndiPreparedCommand* prepared)
+{
+  if (prepared)
+  {
+    free(prepared->Text);
+    free(prepared);
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport char* ndiParseReply(ndicapi* api, const char* command, const char* reply, int n)
+{
+  api->ErrorCode = 0;                 // clear error
+  api->ReplyNoCRC[0] = '\0';
+
+  // the helpers look at the command buffer, including the carriage return
+  // that tells them whether the command had a reply mode
+  int i = 0;
+  while (command[i] != '\0' && i < 2047)
+  {
+    api->Command[i] = command[i];
+    if (command[i++] == '\r')
+    {
+      break;
+    }
+  }
+  api->Command[i] = '\0';
+
+  int commandLength = 0;
+  while ((command[commandLength] >= 'A' && command[commandLength] <= 'Z') ||
+         (command[commandLength] >= '0' && command[commandLength] <= '9'))
+  {
+    commandLength++;
+  }
+  bool isBinary = ndiIsBinaryCommand(command, commandLength);
+
+  if (n < 0 || n > NDI_REPLY_BUFFER_SIZE - 1)
+  {
+    ndiSetError(api, NDI_BAD_REPLY);
+    return api->ReplyNoCRC;
+  }
+  if (!ndiReserveReply(api, n))
+  {
+    ndiSetError(api, NDI_BAD_REPLY);
+    return api->ReplyNoCRC;
+  }
+  memcpy(api->Reply, reply, n);
+  api->Reply[n] = '\0';
+
+  int errorCode = ndiCommandReply(api, n, commandLength, isBinary);
+  if (errorCode != NDI_OKAY)
+  {
+    ndiSetError(api, errorCode);
+  }
+
+  return api->ReplyNoCRC;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetPHINFPortStatus(ndicapi* pol)
+{
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+  char* dp;
+
+  dp = &replies->PhinfBasic[31];
+
+  return (int)ndiHexToUnsignedLong(dp, 2);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetPHINFToolInfo(ndicapi* pol, char information[31])
+{
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+  char* dp;
+  int i;
+
+  dp = replies->PhinfBasic;
+
+  for (i = 0; i < 31; i++)
+  {
+    information[i] = *dp++;
+  }
+
+  return replies->PhinfUnoccupied;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport unsigned long ndiGetPHINFCurrentTest(ndicapi* pol)
+{
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+  char* dp;
+
+  dp = replies->PhinfTesting;
+
+  return (int)ndiHexToUnsignedLong(dp, 8);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetPHINFPartNumber(ndicapi* pol, char part[20])
+{
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+  char* dp;
+  int i;
+
+  dp = replies->PhinfPartNumber;
+
+  for (i = 0; i < 20; i++)
+  {
+    part[i] = *dp++;
+  }
+
+  return replies->PhinfUnoccupied;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetPHINFAccessories(ndicapi* pol)
+{
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+  char* dp;
+
+  dp = replies->PhinfAccessories;
+
+  return (int)ndiHexToUnsignedLong(dp, 2);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetPHINFMarkerType(ndicapi* pol)
+{
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+  char* dp;
+
+  dp = replies->PhinfMarkerType;
+
+  return (int)ndiHexToUnsignedLong(dp, 2);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetPHINFPortLocation(ndicapi* pol, char location[14])
+{
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+  char* dp;
+  int i;
+
+  dp = replies->PhinfPortLocation;
+
+  for (i = 0; i < 14; i++)
+  {
+    location[i] = *dp++;
+  }
+
+  return replies->PhinfUnoccupied;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetPHINFGPIOStatus(ndicapi* pol)
+{
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+  char* dp;
+
+  dp = replies->PhinfGpioStatus;
+
+  return (int)ndiHexToUnsignedLong(dp, 2);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetPHRQHandle(ndicapi* pol)
+{
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+  char* dp;
+
+  dp = replies->PhrqReply;
+  return (int)ndiHexToUnsignedLong(dp, 2);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetPHSRNumberOfHandles(ndicapi* pol)
+{
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+  char* dp;
+
+  dp = replies->PhsrReply;
+
+  return (int)ndiHexToUnsignedLong(dp, 2);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetPHSRHandle(ndicapi* pol, int i)
+{
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+  char* dp;
+  int n;
+
+  dp = replies->PhsrReply;
+  n = (int)ndiHexToUnsignedLong(dp, 2);
+  dp += 2;
+
+  if (i < 0 || i > n)
+  {
+    return 0;
+  }
+  dp += 5 * i;
+
+  return (int)ndiHexToUnsignedLong(dp, 2);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetPHSRInformation(ndicapi* pol, int i)
+{
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+  char* dp;
+  int n;
+
+  dp = replies->PhsrReply;
+  n = (int)ndiHexToUnsignedLong(dp, 2);
+  dp += 2;
+
+  if (i < 0 || i > n)
+  {
+    return 0;
+  }
+  dp += 5 * i + 2;
+
+  return (int)ndiHexToUnsignedLong(dp, 3);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetTXTransformf(ndicapi* pol, int portHandle, float transform[8])
+{
+  int i = ndiTXHandleIndex(pol, portHandle);
+  if (i < 0)
+  {
+    return NDI_DISABLED;
+  }
+
+  const ndiTXHandle* values = &pol->TxHandleValues[i];
+  if (values->TransformStatus == NDI_OKAY)
+  {
+    for (int j = 0; j < 8; j++)
+    {
+      transform[j] = (float)values->Transform[j];
+    }
+  }
+
+  return values->TransformStatus;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetTXTransform(ndicapi* pol, int portHandle, double transform[8])
+{
+  int i = ndiTXHandleIndex(pol, portHandle);
+  if (i < 0)
+  {
+    return NDI_DISABLED;
+  }
+
+  const ndiTXHandle* values = &pol->TxHandleValues[i];
+  if (values->TransformStatus == NDI_OKAY)
+  {
+    memcpy(transform, values->Transform, sizeof(double) * 8);
+  }
+
+  return values->TransformStatus;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetTXPortStatus(ndicapi* pol, int ph)
+{
+  int i = ndiTXHandleIndex(pol, ph);
+  if (i < 0)
+  {
+    return 0;
+  }
+
+  return pol->TxHandleValues[i].PortStatus;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport unsigned long ndiGetTXFrame(ndicapi* pol, int ph)
+{
+  int i = ndiTXHandleIndex(pol, ph);
+  if (i < 0)
+  {
+    return 0;
+  }
+
+  return pol->TxHandleValues[i].Frame;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetTXToolInfo(ndicapi* pol, int ph)
+{
+  char* dp;
+  int i;
+
+  i = ndiTXHandleIndex(pol, ph);
+  if (i < 0)
+  {
+    return 0;
+  }
+
+  dp = pol->TxHandleText[i].Information;
+  return (int)ndiHexToUnsignedLong(dp, 2);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetTXMarkerInfo(ndicapi* pol, int ph, int marker)
+{
+  char* dp;
+  int i;
+
+  i = ndiTXHandleIndex(pol, ph);
+  if (i < 0 || marker < 0 || marker >= 20)
+  {
+    return NDI_DISABLED;
+  }
+
+  dp = &pol->TxHandleText[i].Information[2 + marker];
+  return (int)ndiHexToUnsignedLong(dp, 1);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetTXSingleStray(ndicapi* pol, int ph, double coord[3])
+{
+  char* dp;
+  int i;
+  long values[3];
+
+  i = ndiTXHandleIndex(pol, ph);
+  if (i < 0)
+  {
+    return NDI_DISABLED;
+  }
+
+  dp = pol->TxHandleText[i].SingleStray;
+  if (*dp == 'D' || *dp == '\0')
+  {
+    return NDI_DISABLED;
+  }
+  else if (*dp == 'M')
+  {
+    return NDI_MISSING;
+  }
+
+  ndiSignedToLongArray(dp, 7, 3, values);
+  coord[0] = values[0] * 0.01;
+  coord[1] = values[1] * 0.01;
+  coord[2] = values[2] * 0.01;
+
+  return NDI_OKAY;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetTXNumberOfPassiveStrays(ndicapi* pol)
+{
+  return pol->TxPassiveStrayCount;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetTXPassiveStray(ndicapi* pol, int i, double coord[3])
+{
+  const char* dp;
+  int n;
+  long values[3];
+
+  dp = pol->TxPassiveStray;
+
+  if (dp == NULL || *dp == '\0')
+  {
+    return NDI_DISABLED;
+  }
+
+  n = pol->TxPassiveStrayCount;
+  if (n < 0)
+  {
+    return NDI_MISSING;
+  }
+  if (n > 50)
+  {
+    n = 50;
+  }
+
+  if (i < 0 || i >= n)
+  {
+    return NDI_MISSING;
+  }
+
+  dp += 7 * 3 * i;
+  ndiSignedToLongArray(dp, 7, 3, values);
+  coord[0] = values[0] * 0.01;
+  coord[1] = values[1] * 0.01;
+  coord[2] = values[2] * 0.01;
+
+  return NDI_OKAY;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetTXPassiveStrays(ndicapi* pol, double coords[][3], int maxCount)
+{
+  long values[3 * 50];
+  int n;
+  int i;
+
+  n = pol->TxPassiveStrayCount;
+  if (pol->TxPassiveStray == NULL || pol->TxPassiveStray[0] == '\0' || n < 0)
+  {
+    return 0;
+  }
+  if (n > 50)
+  {
+    n = 50;
+  }
+  if (n > maxCount)
+  {
+    n = maxCount;
+  }
+
+  ndiSignedToLongArray(pol->TxPassiveStray, 7, 3 * n, values);
+  for (i = 0; i < n; i++)
+  {
+    coords[i][0] = values[3 * i] * 0.01;
+    coords[i][1] = values[3 * i + 1] * 0.01;
+    coords[i][2] = values[3 * i + 2] * 0.01;
+  }
+
+  return n;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetTXNumberOfHandles(ndicapi* pol)
+{
+  return pol->TxHandleCount;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetTXTransforms(ndicapi* pol, int handles[], int status[], double transforms[][8], int maxCount)
+{
+  int i, n;
+
+  n = pol->TxHandleCount;
+  if (n > maxCount)
+  {
+    n = maxCount;
+  }
+
+  for (i = 0; i < n; i++)
+  {
+    const ndiTXHandle* values = &pol->TxHandleValues[i];
+    handles[i] = values->Handle;
+    status[i] = values->TransformStatus;
+    if (values->TransformStatus == NDI_OKAY)
+    {
+      memcpy(transforms[i], values->Transform, sizeof(double) * 8);
+    }
+  }
+
+  return n;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetTXSystemStatus(ndicapi* pol)
+{
+  return pol->TxSystemStatusValue;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetGXTransform(ndicapi* pol, int port, double transform[8])
+{
+  int i = ndiGXPortIndex(port);
+  if (i < 0)
+  {
+    return NDI_DISABLED;
+  }
+
+  if (pol->GxTransformStatus[i] == NDI_OKAY)
+  {
+    memcpy(transform, pol->GxTransformValues[i], sizeof(double) * 8);
+  }
+
+  return pol->GxTransformStatus[i];
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetGXPortStatus(ndicapi* pol, int port)
+{
+  int i = ndiGXPortIndex(port);
+  if (i < 0)
+  {
+    return 0;
+  }
+
+  return pol->GxPortStatusValue[i];
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetGXSystemStatus(ndicapi* pol)
+{
+  return pol->GxSystemStatusValue;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetGXToolInfo(ndicapi* pol, int port)
+{
+  char* dp;
+
+  if (port >= '1' && port <= '3')
+  {
+    dp = pol->GxInformation[port - '1'];
+  }
+  else if (port >= 'A' && port <= 'I')
+  {
+    dp = pol->GxPassiveInformation[port - 'A'];
+  }
+  else
+  {
+    return 0;
+  }
+
+  return (int)ndiHexToUnsignedLong(dp, 2);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetGXMarkerInfo(ndicapi* pol, int port, int marker)
+{
+  char* dp;
+
+  if (marker < 'A' || marker > 'T')
+  {
+    return 0;
+  }
+
+  if (port >= '1' && port <= '3')
+  {
+    dp = pol->GxInformation[port - '1'];
+  }
+  else if (port >= 'A' && port <= 'I')
+  {
+    dp = pol->GxPassiveInformation[port - 'A'];
+  }
+  else
+  {
+    return 0;
+  }
+  dp += 11 - (marker - 'A');
+
+  return (int)ndiHexToUnsignedLong(dp, 1);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetGXSingleStray(ndicapi* pol, int port, double coord[3])
+{
+  char* dp;
+  long values[3];
+
+  if (port >= '1' && port <= '3')
+  {
+    dp = pol->GxSingleStray[port - '1'];
+  }
+  else
+  {
+    return NDI_DISABLED;
+  }
+
+  if (*dp == 'D' || *dp == '\0')
+  {
+    return NDI_DISABLED;
+  }
+  else if (*dp == 'M')
+  {
+    return NDI_MISSING;
+  }
+
+  ndiSignedToLongArray(dp, 7, 3, values);
+  coord[0] = values[0] * 0.01;
+  coord[1] = values[1] * 0.01;
+  coord[2] = values[2] * 0.01;
+
+  return NDI_OKAY;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport unsigned long ndiGetGXFrame(ndicapi* pol, int port)
+{
+  int i = ndiGXPortIndex(port);
+  if (i < 0)
+  {
+    return 0;
+  }
+
+  return pol->GxFrameValue[i];
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetGXNumberOfPassiveStrays(ndicapi* pol)
+{
+  const char* dp;
+  int n;
+
+  dp = pol->GxPassiveStray;
+
+  if (*dp == '\0')
+  {
+    return 0;
+  }
+
+  n = (int)ndiSignedToLong(dp, 3);
+  if (n < 0)
+  {
+    return 0;
+  }
+  if (n > 20)
+  {
+    return 20;
+  }
+
+  return n;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetGXPassiveStray(ndicapi* pol, int i, double coord[3])
+{
+  const char* dp;
+  int n;
+  long values[3];
+
+  dp = pol->GxPassiveStray;
+
+  if (*dp == '\0')
+  {
+    return NDI_DISABLED;
+  }
+
+  n = (int)ndiSignedToLong(dp, 3);
+  dp += 3;
+  if (n < 0)
+  {
+    return NDI_MISSING;
+  }
+  if (n > 20)
+  {
+    n = 20;
+  }
+
+  if (i < 0 || i >= n)
+  {
+    return NDI_MISSING;
+  }
+
+  dp += 7 * 3 * i;
+  ndiSignedToLongArray(dp, 7, 3, values);
+  coord[0] = values[0] * 0.01;
+  coord[1] = values[1] * 0.01;
+  coord[2] = values[2] * 0.01;
+
+  return NDI_OKAY;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport unsigned short ndiGetBXReplyLength(ndicapi* pol)
+{
+  return pol->BxReplyLength;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetBXTransform(ndicapi* pol, int portHandle, float transform[8])
+{
+  int i = ndiBXHandleIndex(pol, portHandle);
+  if (i < 0)
+  {
+    return NDI_DISABLED;
+  }
+
+  const ndiBXHandle* values = &pol->BxHandleValues[i];
+  memcpy(&transform[0], values->Transform, sizeof(float) * 8);
+  if (values->Status & NDI_HANDLE_DISABLED)
+  {
+    return NDI_DISABLED;
+  }
+  else if (values->Status & NDI_HANDLE_MISSING)
+  {
+    return NDI_MISSING;
+  }
+
+  return NDI_OKAY;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetBXPortStatus(ndicapi* pol, int portHandle)
+{
+  int i = ndiBXHandleIndex(pol, portHandle);
+  if (i < 0)
+  {
+    return 0;
+  }
+
+  return pol->BxHandleValues[i].PortStatus;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport unsigned long ndiGetBXFrame(ndicapi* pol, int portHandle)
+{
+  int i = ndiBXHandleIndex(pol, portHandle);
+  if (i < 0)
+  {
+    return 0;
+  }
+
+  return pol->BxHandleValues[i].FrameNumber;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetBXToolInfo(ndicapi* pol, int portHandle, char& outToolInfo)
+{
+  int i = ndiBXHandleIndex(pol, portHandle);
+  if (i < 0)
+  {
+    return NDI_DISABLED;
+  }
+
+  outToolInfo = pol->BxHandleExtra[i].ToolMarkerInformation[0];
+  return NDI_OKAY;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetBXMarkerInfo(ndicapi* pol, int portHandle, int marker, char& outMarkerInfo)
+{
+  if (marker >= 20)
+  {
+    return false;
+  }
+
+  int i = ndiBXHandleIndex(pol, portHandle);
+  if (i < 0)
+  {
+    return NDI_DISABLED;
+  }
+
+  int byteIndex = marker / 2;
+  if (marker % 2 == 0)
+  {
+    // low 4 bits, little endian format, so index backwards from the rear
+    outMarkerInfo = pol->BxHandleExtra[i].ToolMarkerInformation[1 + (10 - byteIndex)] & 0x00FF;
+  }
+  else
+  {
+    // high 4 bits, little endian format, so index backwards from the rear
+    outMarkerInfo = pol->BxHandleExtra[i].ToolMarkerInformation[1 + (10 - byteIndex)] & 0xFF00 >> 4;
+  }
+  return NDI_OKAY;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetBXSingleStray(ndicapi* pol, int portHandle, float outCoord[3])
+{
+  int i = ndiBXHandleIndex(pol, portHandle);
+  if (i < 0)
+  {
+    return NDI_DISABLED;
+  }
+
+  memcpy(outCoord, pol->BxHandleExtra[i].SingleStray, sizeof(float) * 3);
+  return NDI_OKAY;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetBXNumberOfPassiveStrays(ndicapi* pol)
+{
+  return pol->BxPassiveStrayCount;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetBXPassiveStray(ndicapi* pol, int i, float outCoord[3])
+{
+  if (i < 0 || i >= pol->BxPassiveStrayCount)
+  {
+    return NDI_DISABLED;
+  }
+  memcpy(outCoord, pol->BxPassiveStrayPosition[i], sizeof(float) * 3);
+  return NDI_OKAY;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport char* ndiCommandVA(ndicapi* api, const char* format, va_list ap)
+ndicapiExport int ndiGetBXSystemStatus(ndicapi* pol)
 {
-  int i, bytes, commandLength;
-  bool useCrc = false;
-  bool inCommand = true;
-  char* command;
-  char* reply;
-  char* commandReply;
-  int errorCode = 0;
+  return pol->BxSystemStatus;
+}
 
-  command = api->Command;       // text sent to ndicapi
-  reply = api->Reply;     // text received from ndicapi
-  commandReply = api->ReplyNoCRC;   // received text, with CRC hacked off
-  commandLength = 0;                  // length of 'command' part of command
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetBXNumberOfHandles(ndicapi* pol)
+{
+  return pol->BxHandleCount;
+}
 
-  api->ErrorCode = 0;                 // clear error
-  command[0] = '\0';
-  reply[0] = '\0';
-  commandReply[0] = '\0';
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetBXTransforms(ndicapi* pol, int handles[], int status[], float transforms[][8], int maxCount)
+{
+  int i, n;
 
-  // verify that the serial device was opened
-  if (api->SerialDevice == NDI_INVALID_HANDLE && api->Hostname == NULL && api->Port < 0)
+  n = pol->BxHandleCount;
+  if (n > maxCount)
   {
-    ndiSetError(api, NDI_OPEN_ERROR);
-    return commandReply;
+    n = maxCount;
   }
 
-  // if the command is NULL, send a break to reset the Measurement System
-  if (format == NULL)
+  for (i = 0; i < n; i++)
   {
-    if (api->IsThreadedMode && api->IsTracking)
+    const ndiBXHandle* values = &pol->BxHandleValues[i];
+    handles[i] = values->Handle;
+    if (values->Status & NDI_HANDLE_DISABLED)
     {
-      // block the tracking thread
-      ndiMutexLock(api->ThreadMutex);
+      status[i] = NDI_DISABLED;
     }
-    api->IsTracking = false;
-
-    if (api->SerialDevice != NDI_INVALID_HANDLE)
+    else if (values->Status & NDI_HANDLE_MISSING)
     {
-      ndiSerialComm(api->SerialDevice, 9600, "8N1", 0);
-      ndiSerialFlush(api->SerialDevice, NDI_IOFLUSH);
-      ndiSerialBreak(api->SerialDevice);
-      bytes = ndiSerialRead(api->SerialDevice, reply, 2047, false, &errorCode);
+      status[i] = NDI_MISSING;
     }
     else
     {
-      int errorCode;
-      bytes = ndiSocketRead(api->Socket, reply, 2047, false, &errorCode);
+      status[i] = NDI_OKAY;
+      memcpy(transforms[i], values->Transform, sizeof(float) * 8);
     }
+  }
 
-    // check for correct reply
-    if (strncmp(reply, "RESETBE6F\r", 8) != 0)
-    {
-      ndiSetError(api, NDI_RESET_FAIL);
-      return commandReply;
-    }
+  return n;
+}
 
-    // terminate the reply string
-    reply[bytes] = '\0';
-    bytes -= 5;
-    strncpy(commandReply, reply, bytes);
-    commandReply[bytes] = '\0';
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetBXMarkerPositions(ndicapi* pol, int counts[], float markers[][3], int markersPerHandle, int maxCount)
+{
+  int i, n;
 
-    // return the reply string, minus the CRC
-    return commandReply;
+  n = pol->BxHandleCount;
+  if (n > maxCount)
+  {
+    n = maxCount;
   }
 
-  vsprintf(command, format, ap);                    // format parameters
-
-  unsigned short CRC16 = 0;                         // calculate CRC
-  for (i = 0; command[i] != '\0'; i++)
+  for (i = 0; i < n; i++)
   {
-    CalcCRC16(command[i], &CRC16);
-    if (inCommand && command[i] == ':')             // only use CRC if a ':'
+    const ndiBXHandleExtra* extra = &pol->BxHandleExtra[i];
+    int m = extra->MarkerCount;
+    if (m < 0 || extra->MarkerOffset < 0 || extra->MarkerOffset + m > pol->BxMarkerCapacity)
+    {
+      m = 0;
+    }
+    counts[i] = m;
+    if (m > markersPerHandle)
     {
-      useCrc = true;                                //  follows the command
+      m = markersPerHandle;
     }
-    if (inCommand && !((command[i] >= 'A' && command[i] <= 'Z') ||
-                       (command[i] >= '0' && command[i] <= '9')))
+    if (m > 0)
     {
-      inCommand = false;                            // 'command' part has ended
-      commandLength = i;                            // command length
+      memcpy(markers[i * markersPerHandle], pol->BxMarkerPositions[extra->MarkerOffset], m * sizeof(markers[0]));
     }
   }
-  if (inCommand)
+
+  return n;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetBXFrameSnapshot(ndicapi* pol, ndiBXSnapshot* snapshot)
+{
+  int i, n;
+
+  if (pol->BxReplyLength == 0)
   {
-    // Command was sent with no ':'
-    // Example, ndiCommand("INIT");
-    commandLength = i;
+    return NDI_MISSING;
   }
 
-  if (useCrc)
+  n = pol->BxHandleCount;
+  if (n > NDI_MAX_HANDLES)
   {
-    sprintf(&command[i], "%04X", CRC16);            // tack on the CRC
-    i += 4;
+    n = NDI_MAX_HANDLES;
   }
 
-  command[i++] = '\r';                              // tack on carriage return
-  command[i] = '\0';                                // terminate for good luck
-
-  bool isBinary = (strncmp(command, "BX", commandLength) == 0 && commandLength == strlen("BX")) ||
-                   (strncmp(command, "GETLOG", commandLength) == 0 && commandLength == strlen("GETLOG")) ||
-                   (strncmp(command, "VGET", commandLength) == 0 && commandLength == strlen("VGET"));
+  snapshot->HandleCount = n;
+  snapshot->SystemStatus = pol->BxSystemStatus;
+  snapshot->ReplyLength = pol->BxReplyLength;
 
-
-  // if the command is GX, TX, or BX and thread_mode is on, we copy the reply from
-  //  the thread rather than getting it directly from the Measurement System
-  if (api->IsThreadedMode && api->IsTracking &&
-      commandLength == 2 && ((command[0] == 'G' && command[1] == 'X') ||
-                             (command[0] == 'T' && command[1] == 'X') ||
-                             (command[0] == 'B' && command[1] == 'X')))
+  for (i = 0; i < n; i++)
   {
-    // check that the thread is sending the GX/BX/TX command that we want
-    if (strcmp(command, api->ThreadCommand) != 0)
+    ndiBXToolSnapshot* tool = &snapshot->Tools[i];
+    const ndiBXHandle* values = &pol->BxHandleValues[i];
+    const ndiBXHandleExtra* extra = &pol->BxHandleExtra[i];
+    int markerCount = extra->MarkerCount;
+    if (markerCount > 20)
     {
-      // tell thread to start using the new GX/BX/TX command
-      ndiMutexLock(api->ThreadMutex);
-      strcpy(api->ThreadCommand, command);
-      api->IsThreadedCommandBinary = (command[0] == 'B');
-      ndiMutexUnlock(api->ThreadMutex);
-      // wait for the next data record to arrive (we have to throw it away)
-      if (ndiEventWait(api->ThreadBufferEvent, 5000))
-      {
-        ndiSetError(api, NDI_TIMEOUT);
-        return commandReply;
-      }
+      markerCount = 20;
     }
-    // there is usually no wait, because usually new data is ready
-    if (ndiEventWait(api->ThreadBufferEvent, 5000))
+
+    tool->Handle = values->Handle;
+    if (values->Status & NDI_HANDLE_DISABLED)
     {
-      ndiSetError(api, NDI_TIMEOUT);
-      return commandReply;
+      tool->Status = NDI_DISABLED;
     }
-    // copy the thread's reply buffer into the main reply buffer
-    ndiMutexLock(api->ThreadBufferMutex);
-    for (bytes = 0; api->ThreadBuffer[bytes] != '\0'; bytes++)
+    else if (values->Status & NDI_HANDLE_MISSING)
     {
-      reply[bytes] = api->ThreadBuffer[bytes];
+      tool->Status = NDI_MISSING;
     }
-    if (!isBinary)
+    else
     {
-      reply[bytes] = '\0';   // terminate string
+      tool->Status = NDI_OKAY;
     }
-    errorCode = api->ThreadErrorCode;
-    ndiMutexUnlock(api->ThreadBufferMutex);
-
-    if (errorCode != 0)
+    tool->PortStatus = values->PortStatus;
+    tool->FrameNumber = values->FrameNumber;
+    memcpy(tool->Transform, values->Transform, sizeof(tool->Transform));
+    tool->ToolInfo = extra->ToolMarkerInformation[0];
+    memcpy(tool->MarkerInfo, &extra->ToolMarkerInformation[1], sizeof(tool->MarkerInfo));
+    tool->SingleStrayStatus = extra->SingleStrayStatus;
+    memcpy(tool->SingleStray, extra->SingleStray, sizeof(tool->SingleStray));
+    tool->MarkerCount = markerCount;
+    memcpy(tool->MarkerOutOfVolume, extra->MarkerOutOfVolume, 3);
+    tool->MarkerOutOfVolume[3] = 0;
+    if (markerCount > 0)
     {
-      ndiSetError(api, errorCode);
-      return commandReply;
+      memcpy(tool->Markers, pol->BxMarkerPositions[extra->MarkerOffset], markerCount * sizeof(tool->Markers[0]));
     }
   }
-  // if the command is not a GX or thread_mode is not on, then
-  //   send the command directly to the Measurement System and get a reply
-  else
+
+  n = pol->BxPassiveStrayCount;
+  if (n < 0 || n > 240)
   {
-    bool isThreadMode = api->IsThreadedMode;
+    n = 0;
+  }
+  snapshot->PassiveStrayCount = n;
+  memcpy(snapshot->PassiveStrayOutOfVolume, pol->BxPassiveStrayOutOfVolume, sizeof(snapshot->PassiveStrayOutOfVolume));
+  if (n > 0)
+  {
+    memcpy(snapshot->PassiveStrays, pol->BxPassiveStrayPosition, n * sizeof(snapshot->PassiveStrays[0]));
+  }
 
-    if (isThreadMode && api->IsTracking)
-    {
-      // block the tracking thread while we slip this command through
-      ndiMutexLock(api->ThreadMutex);
-    }
+  return NDI_OKAY;
+}
 
-    // change pol->tracking if either TSTOP or TSTART is sent
-    if ((commandLength == 5 && strncmp(command, "TSTOP", commandLength) == 0) ||
-        (commandLength == 4 && strncmp(command, "INIT", commandLength) == 0))
-    {
-      api->IsTracking = false;
-    }
-    else if (commandLength == 6 && strncmp(command, "TSTART", commandLength) == 0)
-    {
-      api->IsTracking = true;
-      if (isThreadMode)
-      {
-        // this will force the thread to wait until the application sends the first GX command
-        api->ThreadCommand[0] = '\0';
-      }
-    }
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetPSTATPortStatus(ndicapi* pol, int port)
+{
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+  char* dp;
 
-    if (api->SerialDevice != NDI_INVALID_HANDLE)
-    {
-      // flush the input buffer, because anything that we haven't read
-      //   yet is garbage left over by a previously failed command
-      ndiSerialFlush(api->SerialDevice, NDI_IFLUSH);
-    }
-    else
-    {
-      ndiSocketFlush(api->Socket, NDI_IFLUSH);
-    }
+  if (port >= '1' && port <= '3')
+  {
+    dp = replies->PstatBasic[port - '1'];
+  }
+  else if (port >= 'A' && port <= 'I')
+  {
+    dp = replies->PstatPassiveBasic[port - 'A'];
+  }
+  else
+  {
+    return 0;
+  }
 
-    // send the command to the Measurement System
-    if (api->SerialDevice != NDI_INVALID_HANDLE)
-    {
-      bytes = ndiSerialWrite(api->SerialDevice, command, i);
-    }
-    else
-    {
-      bytes = ndiSocketWrite(api->Socket, command, i);
-    }
-    if (bytes < 0)
-    {
-      errorCode = NDI_WRITE_ERROR;
-    }
-    else if (bytes < i)
-    {
-      errorCode = NDI_TIMEOUT;
-    }
+  // the 'U' is for UNOCCUPIED
+  if (*dp == 'U' || *dp == '\0')
+  {
+    return 0;
+  }
 
-    // read the reply from the Measurement System
-    bytes = 0;
-    if (errorCode == 0)
-    {
-      if (api->SerialDevice != NDI_INVALID_HANDLE)
-      {
-        bytes = ndiSerialRead(api->SerialDevice, reply, 2047, isBinary, &errorCode);
-      }
-      else
-      {
-        bytes = ndiSocketRead(api->Socket, reply, 2047, isBinary, &errorCode);
-      }
-      if (bytes < 0)
-      {
-        errorCode = NDI_READ_ERROR;
-        bytes = 0;
-      }
-      else if (bytes == 0)
-      {
-        errorCode = NDI_TIMEOUT;
-      }
-      if (!isBinary)
-      {
-        reply[bytes] = '\0';   // terminate string
-      }
-    }
+  // skip to the last two characters
+  dp += 30;
 
-    if (isThreadMode & api->IsTracking)
-    {
-      // unblock the tracking thread
-      ndiMutexUnlock(api->ThreadMutex);
-    }
+  return (int)ndiHexToUnsignedLong(dp, 2);
+}
 
-    if (errorCode != 0)
-    {
-      ndiSetError(api, errorCode);
-      return commandReply;
-    }
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetPSTATToolInfo(ndicapi* pol, int port, char information[30])
+{
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+  char* dp;
+
+  if (port >= '1' && port <= '3')
+  {
+    dp = replies->PstatBasic[port - '1'];
+  }
+  else if (port >= 'A' && port <= 'I')
+  {
+    dp = replies->PstatPassiveBasic[port - 'A'];
+  }
+  else
+  {
+    return NDI_UNOCCUPIED;
+  }
+
+  // the 'U' is for UNOCCUPIED
+  if (*dp == 'U' || *dp == '\0')
+  {
+    return NDI_UNOCCUPIED;
   }
 
-  // back up to before the CRC
-  if (!isBinary)
+  strncpy(information, dp, 30);
+
+  return NDI_OKAY;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport unsigned long ndiGetPSTATCurrentTest(ndicapi* pol, int port)
+{
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+  char* dp;
+
+  if (port >= '1' && port <= '3')
   {
-    bytes -= 5; // 4 ASCII chars
+    dp = replies->PstatTesting[port - '1'];
   }
-  else
+  else if (port >= 'A' && port <= 'I')
   {
-    bytes -= 2; // 2 bytes (unsigned short)
+    dp = replies->PstatPassiveTesting[port - 'A'];
   }
-  if (bytes < 0)
+  else
   {
-    ndiSetError(api, NDI_BAD_CRC);
-    return commandReply;
+    return 0;
   }
 
-  // calculate the CRC and copy serial_reply to command_reply
-  CRC16 = 0;
-  for (i = 0; i < bytes; i++)
+  if (*dp == '\0')
   {
-    CalcCRC16(reply[i], &CRC16);
-    commandReply[i] = reply[i];
+    return 0;
   }
 
-  if (!isBinary)
-  {
-    // terminate command_reply before the CRC
-    commandReply[i] = '\0';
-  }
+  return (unsigned long)ndiHexToUnsignedLong(dp, 8);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetPSTATPartNumber(ndicapi* pol, int port, char part[20])
+{
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+  char* dp;
 
-  if (errorCode != 0)
+  if (port >= '1' && port <= '3')
   {
-    // Any above errors are caught here and returned after the command has had its CRC stripped
-    return commandReply;
+    dp = replies->PstatPartNumber[port - '1'];
   }
-
-  if (!isBinary)
+  else if (port >= 'A' && port <= 'I')
   {
-    // read and check the CRC value of the reply
-    if (CRC16 != ndiHexToUnsignedLong(&reply[bytes], 4))
-    {
-      ndiSetError(api, NDI_BAD_CRC);
-      return commandReply;
-    }
+    dp = replies->PstatPassivePartNumber[port - 'A'];
   }
   else
   {
-    unsigned short replyCrc = (unsigned char)reply[bytes + 1] << 8 | (unsigned char)reply[bytes];
-    if (replyCrc != CRC16)
-    {
-      ndiSetError(api, NDI_BAD_CRC);
-      return commandReply;
-    }
+    return NDI_UNOCCUPIED;
   }
 
-  // check for error code
-  if (commandReply[0] == 'E' && strncmp(commandReply, "ERROR", 5) == 0)
+  if (*dp == '\0')
   {
-    ndiSetError(api, (int)ndiHexToUnsignedLong(&commandReply[5], 2));
-    return commandReply;
+    return NDI_UNOCCUPIED;
   }
 
-  // special behavior for specific commands
-  if (command[0] == 'T' && command[1] == 'X' && commandLength == 2)   // the TX command
-  {
-    ndiTXHelper(api, command, commandReply);
-  }
-  else if (command[0] == 'B' && command[1] == 'X' && commandLength == 2)   // the BX command
-  {
-    ndiBXHelper(api, command, commandReply);
-  }
-  else if (command[0] == 'G' && command[1] == 'X' && commandLength == 2)   // the GX command
-  {
-    ndiGXHelper(api, command, commandReply);
-  }
-  else if (command[0] == 'C' && commandLength == 4 && strncmp(command, "COMM", commandLength) == 0)
+  strncpy(part, dp, 20);
+
+  return NDI_OKAY;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetPSTATAccessories(ndicapi* pol, int port)
+{
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+  char* dp;
+
+  if (port >= '1' && port <= '3')
   {
-    ndiCOMMHelper(api, command, commandReply);
+    dp = replies->PstatAccessories[port - '1'];
   }
-  else if (command[0] == 'I' && commandLength == 4 && strncmp(command, "INIT", commandLength) == 0)
+  else if (port >= 'A' && port <= 'I')
   {
-    ndiINITHelper(api, command, commandReply);
+    dp = replies->PstatPassiveAccessories[port - 'A'];
   }
-  else if (command[0] == 'I' && commandLength == 5 && strncmp(command, "IRCHK", commandLength) == 0)
+  else
   {
-    ndiIRCHKHelper(api, command, commandReply);
+    return 0;
   }
-  else if (command[0] == 'P' && commandLength == 5 && strncmp(command, "PHINF", commandLength) == 0)
+
+  if (*dp == '\0')
   {
-    ndiPHINFHelper(api, command, commandReply);
+    return 0;
   }
-  else if (command[0] == 'P' && commandLength == 4 && strncmp(command, "PHRQ", commandLength) == 0)
+
+  return (int)ndiHexToUnsignedLong(dp, 2);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetPSTATMarkerType(ndicapi* pol, int port)
+{
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+  char* dp;
+
+  if (port >= '1' && port <= '3')
   {
-    ndiPHRQHelper(api, command, commandReply);
+    dp = replies->PstatMarkerType[port - '1'];
   }
-  else if (command[0] == 'P' && commandLength == 4 && strncmp(command, "PHSR", commandLength) == 0)
+  else if (port >= 'A' && port <= 'I')
   {
-    ndiPHSRHelper(api, command, commandReply);
+    dp = replies->PstatPassiveMarkerType[port - 'A'];
   }
-  else if (command[0] == 'P' && commandLength == 5 && strncmp(command, "PSTAT", commandLength) == 0)
+  else
   {
-    ndiPSTATHelper(api, command, commandReply);
+    return 0;
   }
-  else if (command[0] == 'S' && commandLength == 5 && strncmp(command, "SSTAT", commandLength) == 0)
+
+  if (*dp == '\0')
   {
-    ndiSSTATHelper(api, command, commandReply);
+    return 0;
   }
 
-  // return the Measurement System reply, but with the CRC hacked off
-  return commandReply;
+  return (int)ndiHexToUnsignedLong(dp, 2);
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetPHINFPortStatus(ndicapi* pol)
+ndicapiExport int ndiGetSSTATControl(ndicapi* pol)
 {
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
   char* dp;
 
-  dp = &pol->PhinfBasic[31];
+  dp = replies->SstatControl;
+
+  if (*dp == '\0')
+  {
+    return 0;
+  }
 
   return (int)ndiHexToUnsignedLong(dp, 2);
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetPHINFToolInfo(ndicapi* pol, char information[31])
+ndicapiExport int ndiGetSSTATSensors(ndicapi* pol)
 {
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
   char* dp;
-  int i;
 
-  dp = pol->PhinfBasic;
+  dp = replies->SstatSensor;
 
-  for (i = 0; i < 31; i++)
+  if (*dp == '\0')
   {
-    information[i] = *dp++;
+    return 0;
   }
 
-  return pol->PhinfUnoccupied;
+  return (int)ndiHexToUnsignedLong(dp, 2);
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport unsigned long ndiGetPHINFCurrentTest(ndicapi* pol)
+ndicapiExport int ndiGetSSTATTIU(ndicapi* pol)
 {
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
   char* dp;
 
-  dp = pol->PhinfTesting;
+  dp = replies->SstatTiu;
 
-  return (int)ndiHexToUnsignedLong(dp, 8);
+  if (*dp == '\0')
+  {
+    return 0;
+  }
+
+  return (int)ndiHexToUnsignedLong(dp, 2);
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetPHINFPartNumber(ndicapi* pol, char part[20])
+ndicapiExport int ndiGetIRCHKDetected(ndicapi* pol)
 {
-  char* dp;
-  int i;
-
-  dp = pol->PhinfPartNumber;
-
-  for (i = 0; i < 20; i++)
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+  if (replies->IrchkDetected == '1')
   {
-    part[i] = *dp++;
+    return 1;
   }
-
-  return pol->PhinfUnoccupied;
+  return 0;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetPHINFAccessories(ndicapi* pol)
+ndicapiExport int ndiGetIRCHKNumberOfSources(ndicapi* pol, int side)
 {
-  char* dp;
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+  const char* dp;
+  int n, m;
 
-  dp = pol->PhinfAccessories;
+  dp = replies->IrchkSources;
 
-  return (int)ndiHexToUnsignedLong(dp, 2);
-}
+  if (*dp == '\0')
+  {
+    return 0;
+  }
 
-//----------------------------------------------------------------------------
-ndicapiExport int ndiGetPHINFMarkerType(ndicapi* pol)
-{
-  char* dp;
+  n = (int)ndiSignedToLong(dp, 3);
+  if (n < 0 || n > 20)
+  {
+    return 0;
+  }
+  m = (int)ndiSignedToLong(dp + 3 + 2 * 3 * n, 3);
+  if (m < 0 || m > 20)
+  {
+    return 0;
+  }
 
-  dp = pol->PhinfMarkerType;
+  if (side == NDI_LEFT)
+  {
+    return n;
+  }
+  else if (side == NDI_RIGHT)
+  {
+    return m;
+  }
 
-  return (int)ndiHexToUnsignedLong(dp, 2);
+  return 0;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetPHINFPortLocation(ndicapi* pol, char location[14])
+ndicapiExport int ndiGetIRCHKSourceXY(ndicapi* pol, int side, int i, double xy[2])
 {
-  char* dp;
-  int i;
+  ndiStatusReplies* replies = ndiGetStatusReplies(pol);
+  const char* dp;
+  int n, m;
 
-  dp = pol->PhinfPortLocation;
+  dp = replies->IrchkSources;
 
-  for (i = 0; i < 14; i++)
+  if (dp == NULL || *dp == '\0')
   {
-    location[i] = *dp++;
+    return NDI_MISSING;
   }
 
-  return pol->PhinfUnoccupied;
-}
+  n = (int)ndiSignedToLong(dp, 3);
+  if (n < 0 || n > 20)
+  {
+    return NDI_MISSING;
+  }
+  m = (int)ndiSignedToLong(dp + 3 + 2 * 3 * n, 3);
+  if (m < 0 || m > 20)
+  {
+    return NDI_MISSING;
+  }
 
-//----------------------------------------------------------------------------
-ndicapiExport int ndiGetPHINFGPIOStatus(ndicapi* pol)
-{
-  char* dp;
+  if (side == NDI_LEFT)
+  {
+    if (i < 0 || i >= n)
+    {
+      return NDI_MISSING;
+    }
+    dp += 3 + 2 * 3 * i;
+  }
+  else if (side == NDI_RIGHT)
+  {
+    if (i < 0 || i >= m)
+    {
+      return NDI_MISSING;
+    }
+    dp += 3 + 2 * 3 * n + 3 + 2 * 3 * i;
+  }
+  else if (side == NDI_RIGHT)
+  {
+    return NDI_MISSING;
+  }
 
-  dp = pol->PhinfGpioStatus;
+  xy[0] = ndiSignedToLong(&dp[0], 3) * 0.01;
+  xy[1] = ndiSignedToLong(&dp[3], 3) * 0.01;
 
-  return (int)ndiHexToUnsignedLong(dp, 2);
+  return NDI_OKAY;
 }
 
+
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetPHRQHandle(ndicapi* pol)
+// The ring of parsed frames that is filled by the tracking thread.
+//
+// There is only one writer (the tracking thread), so each slot is
+// protected by a sequence lock: the writer zeroes the slot's sequence
+// number, copies the frame, and then stores the frame's sequence number.
+// A reader copies the frame and then checks that the sequence number
+// did not change while it was copying.  Neither side ever waits.
+//
+// Each device has one ring from the time it is opened until it is closed,
+// so readers can hold on to the pointer.  Starting thread mode, streaming
+// or a device group resets the ring, and stopping them leaves the last
+// frames in it.
+struct ndiFrameRing
 {
-  char* dp;
+  struct Slot
+  {
+    std::atomic<unsigned long long> Sequence;
+    ndiFrame Frame;
+  };
 
-  dp = pol->PhrqReply;
-  return (int)ndiHexToUnsignedLong(dp, 2);
-}
+  Slot Slots[NDI_FRAME_RING_SIZE];
+  std::atomic<unsigned long long> WriteSequence;   // newest frame in the ring
+  std::atomic<unsigned long long> ReadSequence;    // newest frame that was read
+  std::atomic<unsigned long long> DroppedCount;    // frames a reader missed
+};
 
-//----------------------------------------------------------------------------
-ndicapiExport int ndiGetPHSRNumberOfHandles(ndicapi* pol)
+namespace
 {
-  char* dp;
+  //----------------------------------------------------------------------------
+  // Append a frame to the ring, this must only be called by the tracking thread.
+  // Returns true if a frame was overwritten before it was read, after the
+  // ring had been read at least once.
+  bool ndiFrameRingPush(ndiFrameRing* ring, ndiFrame* frame)
+  {
+    bool isDropped = false;
+    unsigned long long sequence = ring->WriteSequence.load(std::memory_order_relaxed) + 1;
+    ndiFrameRing::Slot* slot = &ring->Slots[sequence & (NDI_FRAME_RING_SIZE - 1)];
 
-  dp = pol->PhsrReply;
+    // count the frame that is about to be overwritten if nobody read it,
+    // but only once the ring has a reader, since most applications only
+    // read the replies and never read the ring
+    unsigned long long readSequence = ring->ReadSequence.load(std::memory_order_relaxed);
+    if (readSequence != 0 && sequence > NDI_FRAME_RING_SIZE &&
+        readSequence < sequence - NDI_FRAME_RING_SIZE)
+    {
+      ring->DroppedCount.fetch_add(1, std::memory_order_relaxed);
+      isDropped = true;
+    }
 
-  return (int)ndiHexToUnsignedLong(dp, 2);
-}
+    frame->Sequence = sequence;
+    slot->Sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&slot->Frame, frame, sizeof(ndiFrame));
+    slot->Sequence.store(sequence, std::memory_order_release);
+    ring->WriteSequence.store(sequence, std::memory_order_release);
 
-//----------------------------------------------------------------------------
-ndicapiExport int ndiGetPHSRHandle(ndicapi* pol, int i)
-{
-  char* dp;
-  int n;
+    return isDropped;
+  }
 
-  dp = pol->PhsrReply;
-  n = (int)ndiHexToUnsignedLong(dp, 2);
-  dp += 2;
+  //----------------------------------------------------------------------------
+  // Append a frame to the device's ring, and count its error, if any.
+  void ndiPushFrame(ndicapi* pol, ndiFrame* frame)
+  {
+    ndiMetricsError(pol, frame->ErrorCode);
+    if (ndiFrameRingPush(pol->FrameRing, frame))
+    {
+      ndiMetricsDroppedFrame(pol);
+    }
+  }
 
-  if (i < 0 || i > n)
+  //----------------------------------------------------------------------------
+  // Copy the frame with the given sequence number from the ring.  Returns
+  // false if that frame has already been overwritten.
+  bool ndiFrameRingRead(ndiFrameRing* ring, unsigned long long sequence, ndiFrame* frame)
   {
-    return 0;
+    ndiFrameRing::Slot* slot = &ring->Slots[sequence & (NDI_FRAME_RING_SIZE - 1)];
+
+    if (slot->Sequence.load(std::memory_order_acquire) != sequence)
+    {
+      return false;
+    }
+    memcpy(frame, &slot->Frame, sizeof(ndiFrame));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot->Sequence.load(std::memory_order_relaxed) != sequence)
+    {
+      return false;
+    }
+
+    // raise the read mark, so that the writer knows this frame was seen
+    unsigned long long readSequence = ring->ReadSequence.load(std::memory_order_relaxed);
+    while (readSequence < sequence &&
+           !ring->ReadSequence.compare_exchange_weak(readSequence, sequence, std::memory_order_relaxed))
+    {
+    }
+
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Fill in a frame from a GX, TX or BX reply that has already had its CRC
+  // checked.  The parser is a scratch ndicapi structure that only the
+  // tracking thread touches, so the application's own replies are untouched.
+  void ndiFrameFromReply(ndicapi* parser, const char* command, const char* commandReply, ndiFrame* frame)
+  {
+    static const char gxPorts[] = "123ABCDEFGHI";
+    int i, n;
+
+    if (command[0] == 'T')
+    {
+      ndiTXHelper(parser, command, commandReply);
+      n = parser->TxHandleCount;
+      for (i = 0; i < n && i < NDI_MAX_HANDLES; i++)
+      {
+        int ph = parser->TxHandleValues[i].Handle;
+        frame->Handles[i] = ph;
+        frame->HandleStatus[i] = ndiGetTXTransform(parser, ph, frame->Transforms[i]);
+        frame->PortStatus[i] = ndiGetTXPortStatus(parser, ph);
+        frame->FrameNumber[i] = ndiGetTXFrame(parser, ph);
+      }
+      frame->HandleCount = i;
+      frame->SystemStatus = ndiGetTXSystemStatus(parser);
+    }
+    else if (command[0] == 'B')
+    {
+      ndiBXHelper(parser, command, commandReply);
+      n = parser->BxHandleCount;
+      for (i = 0; i < n && i < NDI_MAX_HANDLES; i++)
+      {
+        float transform[8];
+        int ph = parser->BxHandleValues[i].Handle;
+        frame->Handles[i] = ph;
+        frame->HandleStatus[i] = ndiGetBXTransform(parser, ph, transform);
+        for (int j = 0; j < 8; j++)
+        {
+          frame->Transforms[i][j] = transform[j];
+        }
+        frame->PortStatus[i] = parser->BxHandleValues[i].PortStatus;
+        frame->FrameNumber[i] = parser->BxHandleValues[i].FrameNumber;
+      }
+      frame->HandleCount = i;
+      frame->SystemStatus = parser->BxSystemStatus;
+    }
+    else
+    {
+      // clear the ports, since GX only reports the ports that were requested
+      memset(parser->GxTransforms, 0, sizeof(parser->GxTransforms));
+      memset(parser->GxPassiveTransforms, 0, sizeof(parser->GxPassiveTransforms));
+      memset(parser->GxStatus, 0, sizeof(parser->GxStatus));
+      memset(parser->GxPassiveStatus, 0, sizeof(parser->GxPassiveStatus));
+      ndiGXHelper(parser, command, commandReply);
+      n = 0;
+      for (i = 0; gxPorts[i] != '\0'; i++)
+      {
+        int port = gxPorts[i];
+        if ((port <= '3' && parser->GxTransforms[port - '1'][0] == '\0') ||
+            (port >= 'A' && parser->GxPassiveTransforms[port - 'A'][0] == '\0'))
+        {
+          continue;
+        }
+        frame->Handles[n] = port;
+        frame->HandleStatus[n] = ndiGetGXTransform(parser, port, frame->Transforms[n]);
+        frame->PortStatus[n] = ndiGetGXPortStatus(parser, port);
+        frame->FrameNumber[n] = ndiGetGXFrame(parser, port);
+        n++;
+      }
+      frame->HandleCount = n;
+      frame->SystemStatus = ndiGetGXSystemStatus(parser);
+    }
   }
-  dp += 5 * i;
-
-  return (int)ndiHexToUnsignedLong(dp, 2);
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetPHSRInformation(ndicapi* pol, int i)
+static ndiFrameRing* ndiFrameRingCreate()
 {
-  char* dp;
-  int n;
-
-  dp = pol->PhsrReply;
-  n = (int)ndiHexToUnsignedLong(dp, 2);
-  dp += 2;
+  ndiFrameRing* ring = new ndiFrameRing();
+  ndiFrameRingReset(ring);
+  return ring;
+}
 
-  if (i < 0 || i > n)
+//----------------------------------------------------------------------------
+// Empty the ring before a new writer starts.  Readers may still be copying
+// frames, so the sequence numbers are cleared rather than the frames.
+static void ndiFrameRingReset(ndiFrameRing* ring)
+{
+  ring->WriteSequence.store(0, std::memory_order_release);
+  for (int i = 0; i < NDI_FRAME_RING_SIZE; i++)
   {
-    return 0;
+    ring->Slots[i].Sequence.store(0, std::memory_order_release);
   }
-  dp += 5 * i + 2;
+  ring->ReadSequence.store(0, std::memory_order_relaxed);
+  ring->DroppedCount.store(0, std::memory_order_relaxed);
+}
 
-  return (int)ndiHexToUnsignedLong(dp, 3);
+//----------------------------------------------------------------------------
+static void ndiFrameRingDestroy(ndiFrameRing* ring)
+{
+  delete ring;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetTXTransformf(ndicapi* pol, int portHandle, float transform[8])
+ndicapiExport int ndiGetLatestFrame(ndicapi* pol, ndiFrame* frame)
 {
-  char* readPointer;
-  int i, n;
+  ndiFrameRing* ring = pol->FrameRing;
 
-  n = pol->TxHandleCount;
-  for (i = 0; i < n; i++)
-  {
-    if (pol->TxHandles[i] == portHandle)
-    {
-      break;
-    }
-  }
-  if (i == n)
+  if (ring == 0)
   {
     return NDI_DISABLED;
   }
 
-  readPointer = pol->TxTransforms[i];
-  if (*readPointer == 'D' || *readPointer == '\0')
-  {
-    return NDI_DISABLED;
-  }
-  else if (*readPointer == 'M')
+  // if the writer laps us while we copy, try again with the newer frame
+  for (;;)
   {
-    return NDI_MISSING;
+    unsigned long long sequence = ring->WriteSequence.load(std::memory_order_acquire);
+    if (sequence == 0)
+    {
+      return NDI_MISSING;
+    }
+    if (ndiFrameRingRead(ring, sequence, frame))
+    {
+      return NDI_OKAY;
+    }
   }
-
-  transform[0] = ndiSignedToLong(&readPointer[0],  6) * 0.0001f;
-  transform[1] = ndiSignedToLong(&readPointer[6],  6) * 0.0001f;
-  transform[2] = ndiSignedToLong(&readPointer[12], 6) * 0.0001f;
-  transform[3] = ndiSignedToLong(&readPointer[18], 6) * 0.0001f;
-  transform[4] = ndiSignedToLong(&readPointer[24], 7) * 0.01f;
-  transform[5] = ndiSignedToLong(&readPointer[31], 7) * 0.01f;
-  transform[6] = ndiSignedToLong(&readPointer[38], 7) * 0.01f;
-  transform[7] = ndiSignedToLong(&readPointer[45], 6) * 0.0001f;
-
-  return NDI_OKAY;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetTXTransform(ndicapi* pol, int portHandle, double transform[8])
+ndicapiExport int ndiGetFramesSince(ndicapi* pol, unsigned long long sequence, ndiFrame* frames, int maxFrames)
 {
-  char* readPointer;
-  int i, n;
+  ndiFrameRing* ring = pol->FrameRing;
+  int count = 0;
 
-  n = pol->TxHandleCount;
-  for (i = 0; i < n; i++)
-  {
-    if (pol->TxHandles[i] == portHandle)
-    {
-      break;
-    }
-  }
-  if (i == n)
+  if (ring == 0)
   {
-    return NDI_DISABLED;
+    return 0;
   }
 
-  readPointer = pol->TxTransforms[i];
-  if (*readPointer == 'D' || *readPointer == '\0')
+  unsigned long long last = ring->WriteSequence.load(std::memory_order_acquire);
+  unsigned long long next = sequence + 1;
+  if (last >= NDI_FRAME_RING_SIZE && next <= last - NDI_FRAME_RING_SIZE)
   {
-    return NDI_DISABLED;
+    // the older frames have already been overwritten
+    next = last - NDI_FRAME_RING_SIZE + 1;
   }
-  else if (*readPointer == 'M')
+
+  for (; next <= last && count < maxFrames; next++)
   {
-    return NDI_MISSING;
+    if (ndiFrameRingRead(ring, next, &frames[count]))
+    {
+      count++;
+    }
   }
 
-  transform[0] = ndiSignedToLong(&readPointer[0], 6) * 0.0001;
-  transform[1] = ndiSignedToLong(&readPointer[6], 6) * 0.0001;
-  transform[2] = ndiSignedToLong(&readPointer[12], 6) * 0.0001;
-  transform[3] = ndiSignedToLong(&readPointer[18], 6) * 0.0001;
-  transform[4] = ndiSignedToLong(&readPointer[24], 7) * 0.01;
-  transform[5] = ndiSignedToLong(&readPointer[31], 7) * 0.01;
-  transform[6] = ndiSignedToLong(&readPointer[38], 7) * 0.01;
-  transform[7] = ndiSignedToLong(&readPointer[45], 6) * 0.0001;
-
-  return NDI_OKAY;
+  return count;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetTXPortStatus(ndicapi* pol, int ph)
+ndicapiExport unsigned long long ndiGetDroppedFrameCount(ndicapi* pol)
 {
-  char* dp;
-  int i, n;
-
-  n = pol->TxHandleCount;
-  for (i = 0; i < n; i++)
-  {
-    if (pol->TxHandles[i] == ph)
-    {
-      break;
-    }
-  }
-  if (i == n)
+  if (pol->FrameRing == 0)
   {
     return 0;
   }
 
-  dp = pol->TxStatus[i];
+  return pol->FrameRing->DroppedCount.load(std::memory_order_relaxed);
+}
 
-  return (int)ndiHexToUnsignedLong(dp, 8);
+//----------------------------------------------------------------------------
+// Whether the tracking thread should stop reconnecting.
+static bool ndiThreadIsCancelled(ndicapi* pol)
+{
+  return !pol->IsThreadedMode;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport unsigned long ndiGetTXFrame(ndicapi* pol, int ph)
+// The tracking thread.
+//
+// This thread continually sends the most recent GX command to the
+// NDICAPI until it is told to quit or until an error occurs.  If the
+// connection fails and ndiSetAutoReconnect() is on, the thread restores
+// the session and carries on.
+//
+// The thread is blocked unless the Measurement System is in tracking mode.
+static void* ndiThreadFunc(void* userdata)
 {
-  char* dp;
-  int i, n;
+  int i, m;
+  int errorCode = 0;
+  char* command;
+  char* parsedReply = NULL;               // grows to fit the replies
+  int parsedReplySize = 0;
+  ndiFrame frame;
+  ndicapi* pol;
 
-  n = pol->TxHandleCount;
-  for (i = 0; i < n; i++)
+  pol = (ndicapi*)userdata;
+  command = pol->ThreadCommand;
+
+  while (errorCode == 0)
   {
-    if (pol->TxHandles[i] == ph)
+    // if the application is blocking us, we sit here and wait
+    ndiMutexLock(pol->ThreadMutex);
+
+    // quit if threading has been turned off
+    if (!pol->IsThreadedMode)
     {
+      ndiMutexUnlock(pol->ThreadMutex);
       break;
     }
-  }
-  if (i == n)
-  {
-    return 0;
-  }
 
-  dp = pol->TxFrame[i];
+    // check whether we have a GX/BX/TX command ready to send
+    if (command[0] == '\0')
+    {
+      if (pol->SerialDevice != NDI_INVALID_HANDLE)
+      {
+        ndiSerialSleep(pol->SerialDevice, 20);
+      }
+      else
+      {
+        ndiSocketSleep(pol->Socket, 20);
+      }
+      ndiMutexUnlock(pol->ThreadMutex);
+      continue;
+    }
 
-  return (unsigned long)ndiHexToUnsignedLong(dp, 8);
-}
+    // flush the input buffer, because anything that we haven't read
+    //   yet is garbage left over by a previously failed command
+    if (pol->SerialDevice != NDI_INVALID_HANDLE)
+    {
+      ndiSerialFlush(pol->SerialDevice, NDI_IFLUSH);
+    }
+    else
+    {
+      ndiSocketFlush(pol->Socket, NDI_IFLUSH);
+    }
 
-//----------------------------------------------------------------------------
-ndicapiExport int ndiGetTXToolInfo(ndicapi* pol, int ph)
-{
-  char* dp;
-  int i, n;
+    // send the command to the Measurement System
+    i = (int)strlen(command);
+    unsigned long long sendTime = ndiTimeNanoseconds();
+    ndiCaptureWrite(pol->Capture, NDI_CAPTURE_COMMAND, sendTime, command, i);
+    if (errorCode == 0)
+    {
+      if (pol->SerialDevice != NDI_INVALID_HANDLE)
+      {
+        m = ndiSerialWrite(pol->SerialDevice, command, i);
+      }
+      else
+      {
+        m = ndiSocketWrite(pol->Socket, command, i);
+      }
+      if (m < 0)
+      {
+        errorCode = NDI_WRITE_ERROR;
+      }
+      else if (m < i)
+      {
+        errorCode = NDI_TIMEOUT;
+      }
+      else
+      {
+        ndiMetricsCommand(pol, i, sendTime);
+      }
+    }
 
-  n = pol->TxHandleCount;
-  for (i = 0; i < n; i++)
-  {
-    if (pol->TxHandles[i] == ph)
+    // read the reply from the Measurement System
+    m = 0;
+    pol->ThreadReply[0] = '\0';
+    unsigned long long firstByteTime = 0;
+    unsigned long long lastByteTime = 0;
+    if (errorCode == 0)
     {
-      break;
+      m = ndiReadReply(pol, pol->ThreadReply, pol->ThreadReplySize, pol->IsThreadedCommandBinary, &errorCode,
+                       &firstByteTime, &lastByteTime);
+      if (m < 0)
+      {
+        errorCode = NDI_READ_ERROR;
+        m = 0;
+      }
+      else if (m == 0)
+      {
+        errorCode = NDI_TIMEOUT;
+      }
+      else
+      {
+        ndiCaptureWrite(pol->Capture, NDI_CAPTURE_REPLY, lastByteTime, pol->ThreadReply, m);
+        ndiMetricsWakeup(pol, lastByteTime);
+        ndiMetricsReply(pol, m, sendTime, firstByteTime, lastByteTime);
+      }
+      // terminate the string
+      pol->ThreadReply[m] = '\0';
     }
-  }
-  if (i == n)
-  {
-    return 0;
+    char* reply = pol->ThreadReply;
+
+    // parse the reply and add it to the frame ring
+    memset(&frame, 0, sizeof(ndiFrame));
+    frame.Timestamp = (lastByteTime != 0 ? lastByteTime : ndiTimeNanoseconds());
+    frame.FirstByteTime = firstByteTime;
+    frame.Command[0] = command[0];
+    frame.Command[1] = command[1];
+    frame.ErrorCode = errorCode;
+    if (errorCode == 0)
+    {
+      bool isBinary = pol->IsThreadedCommandBinary;
+      bool crcOkay;
+      unsigned long long parseTime = ndiTimeNanoseconds();
+      if (!ndiReserveArray(parsedReply, parsedReplySize, m + 1))
+      {
+        frame.ErrorCode = NDI_BAD_REPLY;
+      }
+      else if (ndiStripReplyCRC(reply, m, isBinary, parsedReply, &crcOkay) < 0 || !crcOkay)
+      {
+        frame.ErrorCode = NDI_BAD_CRC;
+      }
+      else if (!isBinary && strncmp(parsedReply, "ERROR", 5) == 0)
+      {
+        frame.ErrorCode = (int)ndiHexToUnsignedLong(&parsedReply[5], 2);
+      }
+      else
+      {
+        ndiFrameFromReply(pol->ThreadParser, command, parsedReply, &frame);
+        ndiClockModelAddFrame(pol->ClockModel, &frame);
+      }
+      ndiMetricsParse(pol, parseTime);
+    }
+    ndiPushFrame(pol, &frame);
+
+    // lock the buffer
+    ndiMutexLock(pol->ThreadBufferMutex);
+    // copy the reply into the buffer, also copy the length and error code
+    bool isCopied = ndiReserveArray(pol->ThreadBuffer, pol->ThreadBufferSize, m + 1);
+    if (isCopied)
+    {
+      memcpy(pol->ThreadBuffer, reply, m + 1);
+    }
+    pol->ThreadBufferLength = (isCopied ? m : 0);
+    pol->ThreadBufferFirstByteTime = firstByteTime;
+    pol->ThreadBufferLastByteTime = lastByteTime;
+    pol->ThreadErrorCode = (isCopied ? errorCode : NDI_BAD_REPLY);
+    // signal the main thread that a new data record is ready
+    ndiEventSignal(pol->ThreadBufferEvent);
+    // unlock the buffer
+    ndiMutexUnlock(pol->ThreadBufferMutex);
+
+    // the application's commands wait while the session is restored
+    if (errorCode != 0 && ndiSessionAutoReconnect(pol, errorCode, &ndiThreadIsCancelled))
+    {
+      errorCode = 0;
+    }
+
+    // release the lock to give the application a chance to block us
+    ndiMutexUnlock(pol->ThreadMutex);
   }
 
-  dp = pol->TxInformation[i];
-  return (int)ndiHexToUnsignedLong(dp, 2);
+  free(parsedReply);
+  return NULL;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetTXMarkerInfo(ndicapi* pol, int ph, int marker)
+// Allocate all the objects needed for threading and then start the thread.
+static void ndiSpawnThread(ndicapi* pol)
 {
-  char* dp;
-  int i, n;
+  pol->ThreadCommand = (char*)malloc(2048);
+  pol->ThreadCommand[0] = '\0';
+  pol->ThreadReplySize = 2048;
+  pol->ThreadReply = (char*)malloc(pol->ThreadReplySize);
+  pol->ThreadReply[0] = '\0';
+  pol->ThreadBufferSize = 2048;
+  pol->ThreadBuffer = (char*)malloc(pol->ThreadBufferSize);
+  pol->ThreadBuffer[0] = '\0';
+  pol->ThreadBufferLength = 0;
+  pol->ThreadErrorCode = 0;
+  pol->ThreadParser = (ndicapi*)calloc(1, sizeof(ndicapi));
+  ndiFrameRingReset(pol->FrameRing);
 
-  n = pol->TxHandleCount;
-  for (i = 0; i < n; i++)
+  pol->ThreadBufferMutex = ndiMutexCreate();
+  pol->ThreadBufferEvent = ndiEventCreate();
+  pol->ThreadMutex = ndiMutexCreate();
+  if (!pol->IsTracking)
   {
-    if (pol->TxHandles[i] == ph)
-    {
-      break;
-    }
+    // if not tracking, then block the thread
+    ndiMutexLock(pol->ThreadMutex);
   }
-  if (i == n || marker < 0 || marker >= 20)
+  pol->Thread = ndiThreadSplit(&ndiThreadFunc, pol);
+}
+
+//----------------------------------------------------------------------------
+// Wait for the tracking thread to end, and then do the clean - up.
+static void ndiJoinThread(ndicapi* pol)
+{
+  if (!pol->IsTracking)
   {
-    return NDI_DISABLED;
+    // if not tracking, unblock the thread or it can't stop
+    ndiMutexUnlock(pol->ThreadMutex);
   }
+  ndiThreadJoin(pol->Thread);
+  ndiEventDestroy(pol->ThreadBufferEvent);
+  ndiMutexDestroy(pol->ThreadBufferMutex);
+  ndiMutexDestroy(pol->ThreadMutex);
 
-  dp = pol->TxInformation[2 + marker];
-  return (int)ndiHexToUnsignedLong(dp, 1);
+  free(pol->ThreadBuffer);
+  pol->ThreadBuffer = 0;
+  pol->ThreadBufferSize = 0;
+  free(pol->ThreadReply);
+  pol->ThreadReply = 0;
+  pol->ThreadReplySize = 0;
+  free(pol->ThreadCommand);
+  pol->ThreadCommand = 0;
+  ndiFreeReplyData(pol->ThreadParser);
+  free(pol->ThreadParser);
+  pol->ThreadParser = 0;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetTXSingleStray(ndicapi* pol, int ph, double coord[3])
+// For starting and stopping the tracking thread.
+//
+// The mode is either 0(no thread) or 1(thread).  Other modes
+// might be added in the future.
+ndicapiExport void ndiSetThreadMode(ndicapi* pol, bool mode)
 {
-  char* dp;
-  int i, n;
-
-  n = pol->TxHandleCount;
-  for (i = 0; i < n; i++)
+  if ((pol->IsThreadedMode && mode) || (!pol->IsThreadedMode && !mode))
   {
-    if (pol->TxHandles[i] == ph)
-    {
-      break;
-    }
+    return;
   }
-  if (i == n)
+
+  // thread mode cannot be used at the same time as streaming or a group,
+  // or by an offline device
+  if (mode && (pol->Stream || pol->Group || pol->FrameRing == 0))
   {
-    return NDI_DISABLED;
+    return;
   }
 
-  dp = pol->TxSingleStray[i];
-  if (*dp == 'D' || *dp == '\0')
+  pol->IsThreadedMode = mode;
+
+  if (mode)
   {
-    return NDI_DISABLED;
+    ndiSpawnThread(pol);
   }
-  else if (*dp == 'M')
+  else
   {
-    return NDI_MISSING;
+    ndiJoinThread(pol);
   }
-
-  coord[0] = ndiSignedToLong(&dp[0],  7) * 0.01;
-  coord[1] = ndiSignedToLong(&dp[7],  7) * 0.01;
-  coord[2] = ndiSignedToLong(&dp[14], 7) * 0.01;
-
-  return NDI_OKAY;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetTXNumberOfPassiveStrays(ndicapi* pol)
+ndicapiExport int ndiGetThreadMode(ndicapi* pol)
 {
-  return pol->TxPassiveStrayCount;
+  return pol->IsThreadedMode;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetTXPassiveStray(ndicapi* pol, int i, double coord[3])
+// The queue of commands for ndiCommandAsync().  The commands are sent by
+// a worker thread, which exits once the queue is empty and Quit is set.
+struct ndiCommandQueue
 {
-  const char* dp;
-  int n;
-
-  dp = pol->TxPassiveStray;
-
-  if (*dp == '\0')
+  struct Entry
   {
-    return NDI_DISABLED;
-  }
+    std::string Command;
+    NDICommandCallback Callback;
+    void* UserData;
+  };
 
-  n = pol->TxPassiveStrayCount;
-  if (n < 0)
-  {
-    return NDI_MISSING;
-  }
-  if (n > 50)
-  {
-    n = 50;
-  }
+  std::deque<Entry> Entries;              // commands that have not been sent
+  int Pending;                            // queued plus in-flight commands
+  int FirstError;                         // first error since the last wait
+  bool Quit;                              // set when the device is closed
+  NDIMutex Mutex;                         // protects all of the above
+  NDIEvent WorkEvent;                     // signalled when a command is queued
+  NDIEvent DoneEvent;                     // signalled when Pending drops to zero
+  NDIThread Thread;
+};
 
-  if (i < 0 || i >= n)
+//----------------------------------------------------------------------------
+// The worker thread for ndiCommandAsync().
+static void* ndiCommandQueueFunc(void* userdata)
+{
+  ndicapi* pol = (ndicapi*)userdata;
+  ndiCommandQueue* queue = pol->CommandQueue;
+
+  for (;;)
   {
-    return NDI_MISSING;
-  }
+    ndiMutexLock(queue->Mutex);
+    while (queue->Entries.empty() && !queue->Quit)
+    {
+      ndiMutexUnlock(queue->Mutex);
+      ndiEventWait(queue->WorkEvent, -1);
+      ndiMutexLock(queue->Mutex);
+    }
+    if (queue->Entries.empty())
+    {
+      ndiMutexUnlock(queue->Mutex);
+      return NULL;
+    }
+    ndiCommandQueue::Entry entry = queue->Entries.front();
+    queue->Entries.pop_front();
+    ndiMutexUnlock(queue->Mutex);
 
-  dp += 7 * 3 * i;
-  coord[0] = ndiSignedToLong(&dp[0],  7) * 0.01;
-  coord[1] = ndiSignedToLong(&dp[7],  7) * 0.01;
-  coord[2] = ndiSignedToLong(&dp[14], 7) * 0.01;
+    const char* reply = ndiCommand(pol, "%s", entry.Command.c_str());
+    int errnum = ndiGetError(pol);
+    if (entry.Callback)
+    {
+      entry.Callback(pol, errnum, reply, entry.UserData);
+    }
 
-  return NDI_OKAY;
+    ndiMutexLock(queue->Mutex);
+    if (errnum != NDI_OKAY && queue->FirstError == NDI_OKAY)
+    {
+      queue->FirstError = errnum;
+    }
+    if (--queue->Pending == 0)
+    {
+      ndiEventSignal(queue->DoneEvent);
+    }
+    ndiMutexUnlock(queue->Mutex);
+  }
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetTXSystemStatus(ndicapi* pol)
+// Finish all queued commands and stop the worker thread, this is called
+// when the device is closed.
+static void ndiCommandQueueStop(ndicapi* pol)
 {
-  char* dp;
+  ndiCommandQueue* queue = pol->CommandQueue;
+
+  if (queue == 0)
+  {
+    return;
+  }
 
-  dp = pol->TxSystemStatus;
+  ndiMutexLock(queue->Mutex);
+  queue->Quit = true;
+  ndiEventSignal(queue->WorkEvent);
+  ndiMutexUnlock(queue->Mutex);
+  ndiThreadJoin(queue->Thread);
 
-  return (int)ndiHexToUnsignedLong(dp, 4);
+  ndiEventDestroy(queue->DoneEvent);
+  ndiEventDestroy(queue->WorkEvent);
+  ndiMutexDestroy(queue->Mutex);
+  delete queue;
+  pol->CommandQueue = 0;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetGXTransform(ndicapi* pol, int port, double transform[8])
+ndicapiExport int ndiCommandAsync(ndicapi* pol, NDICommandCallback callback, void* userdata, const char* format, ...)
 {
-  char* dp;
+  char command[2048];
+  va_list ap;
 
-  if (port >= '1' && port <= '3')
-  {
-    dp = pol->GxTransforms[port - '1'];
-  }
-  else if (port >= 'A' && port <= 'I')
-  {
-    dp = pol->GxPassiveTransforms[port - 'A'];
-  }
-  else
+  va_start(ap, format);
+  int n = vsnprintf(command, sizeof(command), format, ap);
+  va_end(ap);
+  if (n < 0 || n > (int)sizeof(command) - 6) // leave room for the CRC and <CR>
   {
-    return NDI_DISABLED;
+    return NDI_TOO_LONG;
   }
 
-  if (*dp == 'D' || *dp == '\0')
-  {
-    return NDI_DISABLED;
-  }
-  else if (*dp == 'M')
+  // start the worker thread the first time that it is needed
+  if (pol->CommandQueue == 0)
   {
-    return NDI_MISSING;
+    ndiCommandQueue* queue = new ndiCommandQueue();
+    queue->Pending = 0;
+    queue->FirstError = NDI_OKAY;
+    queue->Quit = false;
+    queue->Mutex = ndiMutexCreate();
+    queue->WorkEvent = ndiEventCreate();
+    queue->DoneEvent = ndiEventCreate();
+    pol->CommandQueue = queue;
+    queue->Thread = ndiThreadSplit(&ndiCommandQueueFunc, pol);
   }
 
-  transform[0] = ndiSignedToLong(&dp[0],  6) * 0.0001;
-  transform[1] = ndiSignedToLong(&dp[6],  6) * 0.0001;
-  transform[2] = ndiSignedToLong(&dp[12], 6) * 0.0001;
-  transform[3] = ndiSignedToLong(&dp[18], 6) * 0.0001;
-  transform[4] = ndiSignedToLong(&dp[24], 7) * 0.01;
-  transform[5] = ndiSignedToLong(&dp[31], 7) * 0.01;
-  transform[6] = ndiSignedToLong(&dp[38], 7) * 0.01;
-  transform[7] = ndiSignedToLong(&dp[45], 6) * 0.0001;
+  ndiCommandQueue* queue = pol->CommandQueue;
+  ndiCommandQueue::Entry entry;
+  entry.Command = command;
+  entry.Callback = callback;
+  entry.UserData = userdata;
+
+  ndiMutexLock(queue->Mutex);
+  queue->Entries.push_back(entry);
+  queue->Pending++;
+  ndiEventSignal(queue->WorkEvent);
+  ndiMutexUnlock(queue->Mutex);
 
   return NDI_OKAY;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetGXPortStatus(ndicapi* pol, int port)
+ndicapiExport int ndiWaitForCommands(ndicapi* pol, int milliseconds)
 {
-  char* dp;
+  ndiCommandQueue* queue = pol->CommandQueue;
+  unsigned long long deadline = ndiTimeNanoseconds() + milliseconds * 1000000ULL;
 
-  if (port >= '1' && port <= '3')
+  if (queue == 0)
   {
-    dp = &pol->GxStatus[6 - 2 * (port - '1')];
+    return NDI_OKAY;
   }
-  else if (port >= 'A' && port <= 'C')
-  {
-    dp = &pol->GxPassiveStatus[6 - 2 * (port - 'A')];
-  }
-  else if (port >= 'D' && port <= 'F')
-  {
-    dp = &pol->GxPassiveStatus[14 - 2 * (port - 'D')];
-  }
-  else if (port >= 'G' && port <= 'I')
-  {
-    dp = &pol->GxPassiveStatus[22 - 2 * (port - 'G')];
-  }
-  else
+
+  ndiMutexLock(queue->Mutex);
+  while (queue->Pending > 0)
   {
-    return 0;
+    ndiMutexUnlock(queue->Mutex);
+    int timeout = -1;
+    if (milliseconds >= 0)
+    {
+      unsigned long long now = ndiTimeNanoseconds();
+      timeout = (now < deadline ? (int)((deadline - now + 999999) / 1000000) : 0);
+    }
+    if (ndiEventWait(queue->DoneEvent, timeout))
+    {
+      ndiMutexLock(queue->Mutex);
+      if (queue->Pending > 0)
+      {
+        ndiMutexUnlock(queue->Mutex);
+        return NDI_TIMEOUT;
+      }
+      break;
+    }
+    ndiMutexLock(queue->Mutex);
   }
+  int errnum = queue->FirstError;
+  queue->FirstError = NDI_OKAY;
+  ndiMutexUnlock(queue->Mutex);
 
-  return (int)ndiHexToUnsignedLong(dp, 2);
+  return errnum;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetGXSystemStatus(ndicapi* pol)
+// The state of a streaming session.
+struct ndiStreamSession
 {
-  char* dp;
-
-  dp = pol->GxStatus;
+  char Command[64];                       // the streamed command, for parsing
+  NDIFrameCallback Callback;
+  void* UserData;
+  ndicapi* Parser;                        // scratch state for parsing
+  bool HasThread;                         // false for ndiStartStreamingPolled()
+  NDIThread Thread;
+  NDIEvent AckEvent;                      // signalled when STREAM/USTREAM is answered
+  std::atomic<int> AckError;              // reply to STREAM or USTREAM
+  std::atomic<bool> IsStopping;           // USTREAM was sent
+  std::atomic<bool> IsFinished;           // USTREAM was answered
+  std::mutex ConnectionMutex;             // held to reconnect, or to send USTREAM
+  int FrameCount;                         // frames added to the ring so far
+  char* Buffer;                           // bytes that have not been parsed yet
+  int BufferSize;
+  int BufferLength;
+  unsigned long long FirstByteTime;       // when the first byte in Buffer arrived
+  char* ParsedReply;                      // the reply without its CRC, for parsing
+  int ParsedReplySize;
+};
+
+// the stream id that is sent with STREAM and USTREAM
+#define NDI_STREAM_ID "ndicapi"
 
-  if (*dp == '\0')
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Write a command without waiting for a reply, because the replies belong
+  // to the streaming thread.  Commands sent this way never need a CRC.
+  int ndiStreamWrite(ndicapi* pol, const char* text)
   {
-    dp = pol->GxPassiveStatus;
-  }
+    int n = (int)strlen(text);
+    int m;
+    unsigned long long sendTime = ndiTimeNanoseconds();
 
-  return (int)ndiHexToUnsignedLong(dp, 2);
-}
+    ndiCaptureWrite(pol->Capture, NDI_CAPTURE_COMMAND, sendTime, text, n);
+    if (pol->SerialDevice != NDI_INVALID_HANDLE)
+    {
+      m = ndiSerialWrite(pol->SerialDevice, text, n);
+    }
+    else
+    {
+      m = ndiSocketWrite(pol->Socket, text, n);
+    }
 
-//----------------------------------------------------------------------------
-ndicapiExport int ndiGetGXToolInfo(ndicapi* pol, int port)
-{
-  char* dp;
+    if (m < 0)
+    {
+      return NDI_WRITE_ERROR;
+    }
+    else if (m < n)
+    {
+      return NDI_TIMEOUT;
+    }
+    ndiMetricsCommand(pol, n, sendTime);
+    return NDI_OKAY;
+  }
 
-  if (port >= '1' && port <= '3')
+  //----------------------------------------------------------------------------
+  // Ask the device to start streaming the session's command.
+  int ndiStreamStart(ndicapi* pol)
   {
-    dp = pol->GxInformation[port - '1'];
+    const char* command = pol->Stream->Command;
+    char text[2048];
+
+    // the command is kept with a carriage return, which STREAM doesn't want
+    snprintf(text, sizeof(text), "STREAM --cmd=\"%.*s\" --id=%s\r",
+             (int)strlen(command) - 1, command, NDI_STREAM_ID);
+    return ndiStreamWrite(pol, text);
   }
-  else if (port >= 'A' && port <= 'I')
+
+  //----------------------------------------------------------------------------
+  // Whether the streaming thread should stop reconnecting.
+  bool ndiStreamIsCancelled(ndicapi* pol)
   {
-    dp = pol->GxPassiveInformation[port - 'A'];
+    return pol->Stream->IsStopping;
   }
-  else
+
+  //----------------------------------------------------------------------------
+  // Get the length of the reply at the start of the buffer.  Returns zero if
+  // the reply is not complete yet, or -1 if the buffer does not start with
+  // something that looks like a reply.
+  int ndiStreamReplyLength(const char* buffer, int n)
   {
-    return 0;
-  }
+    int i;
 
-  return (int)ndiHexToUnsignedLong(dp, 2);
-}
+    if (n >= 2 && ((buffer[0] == (char)0xc4 && buffer[1] == (char)0xa5) ||
+                   (buffer[0] == (char)0xd4 && buffer[1] == (char)0xb5)))
+    {
+      if (n < 6)
+      {
+        return 0;
+      }
+      // a corrupted length would swallow the replies that follow it
+      unsigned short headerCRC = (unsigned char)buffer[4] | (unsigned char)buffer[5] << 8;
+      if (ndiCRC16(0, buffer, 4) != headerCRC)
+      {
+        return -1;
+      }
+      // 2 for start sequence, 2 for length, 2 for header CRC, 2 for CRC16
+      int length = ((unsigned char)buffer[2] | (unsigned char)buffer[3] << 8) + 8;
+      return (n >= length ? length : 0);
+    }
 
-//----------------------------------------------------------------------------
-ndicapiExport int ndiGetGXMarkerInfo(ndicapi* pol, int port, int marker)
-{
-  char* dp;
+    for (i = 0; i < n; i++)
+    {
+      if (buffer[i] == '\r')
+      {
+        return i + 1;
+      }
+      else if (buffer[i] & 0x80)
+      {
+        // ASCII replies are 7-bit, so this is the remains of a binary reply
+        return -1;
+      }
+    }
+    return (n < NDI_REPLY_BUFFER_SIZE ? 0 : -1);
+  }
 
-  if (marker < 'A' || marker > 'T')
+  //----------------------------------------------------------------------------
+  // Handle one complete reply from the stream.
+  void ndiStreamReply(ndicapi* pol, const char* reply, int n, unsigned long long firstByteTime,
+                      unsigned long long timestamp)
   {
-    return 0;
+    ndiStreamSession* stream = pol->Stream;
+    bool crcOkay = false;
+    bool isBinary = (reply[0] == (char)0xc4 || reply[0] == (char)0xd4);
+
+    ndiCaptureWrite(pol->Capture, NDI_CAPTURE_REPLY, timestamp, reply, n);
+    ndiMetricsReply(pol, n, 0, firstByteTime, timestamp);
+
+    // a reply that there is no memory to parse is handled like a bad CRC
+    unsigned long long parseTime = ndiTimeNanoseconds();
+    if (ndiReserveArray(stream->ParsedReply, stream->ParsedReplySize, n + 1) &&
+        ndiStripReplyCRC(reply, n, isBinary, stream->ParsedReply, &crcOkay) < 0)
+    {
+      crcOkay = false;
+    }
+    const char* parsedReply = stream->ParsedReply;
+
+    // the replies to STREAM and USTREAM
+    if (crcOkay && !isBinary && strncmp(parsedReply, "OKAY", 4) == 0)
+    {
+      stream->AckError = NDI_OKAY;
+      stream->IsFinished = stream->IsStopping.load();
+      ndiEventSignal(stream->AckEvent);
+      return;
+    }
+    if (crcOkay && !isBinary && strncmp(parsedReply, "ERROR", 5) == 0 &&
+        (stream->IsStopping || stream->AckError != NDI_OKAY))
+    {
+      stream->AckError = (int)ndiHexToUnsignedLong(&parsedReply[5], 2);
+      stream->IsFinished = stream->IsStopping.load();
+      ndiEventSignal(stream->AckEvent);
+      return;
+    }
+
+    ndiFrame frame;
+    memset(&frame, 0, sizeof(ndiFrame));
+    frame.Timestamp = timestamp;
+    frame.FirstByteTime = firstByteTime;
+    frame.Command[0] = stream->Command[0];
+    frame.Command[1] = stream->Command[1];
+    if (!crcOkay)
+    {
+      frame.ErrorCode = NDI_BAD_CRC;
+    }
+    else if (!isBinary && strncmp(parsedReply, "ERROR", 5) == 0)
+    {
+      frame.ErrorCode = (int)ndiHexToUnsignedLong(&parsedReply[5], 2);
+    }
+    else
+    {
+      ndiFrameFromReply(stream->Parser, stream->Command, parsedReply, &frame);
+      ndiClockModelAddFrame(pol->ClockModel, &frame);
+    }
+    ndiMetricsParse(pol, parseTime);
+
+    ndiPushFrame(pol, &frame);
+    stream->FrameCount++;
+    if (stream->Callback)
+    {
+      stream->Callback(pol, &frame, stream->UserData);
+    }
   }
 
-  if (port >= '1' && port <= '3')
+  //----------------------------------------------------------------------------
+  // Read what the device has streamed, split it at reply boundaries, and
+  // handle the complete replies.  This waits for at most the device timeout
+  // for data to arrive.  Returns false when the stream has ended, either
+  // because USTREAM was answered or because an IO error occurred.
+  bool ndiStreamRead(ndicapi* pol)
   {
-    dp = pol->GxInformation[port - '1'];
+    ndiStreamSession* stream = pol->Stream;
+    int m;
+    unsigned long long timestamp = 0;
+
+    if (stream->IsFinished)
+    {
+      return false;
+    }
+
+    // a partial reply that fills the buffer needs more room
+    bool hasRoom = ndiReserveReadBuffer(stream->Buffer, stream->BufferSize, stream->BufferLength);
+    char* buffer = stream->Buffer;
+    int bufferSize = stream->BufferSize;
+    if (!hasRoom)
+    {
+      m = -1;
+    }
+    else if (pol->SerialDevice != NDI_INVALID_HANDLE)
+    {
+      m = ndiSerialReadAvailable(pol->SerialDevice, &buffer[stream->BufferLength], bufferSize - stream->BufferLength, &timestamp);
+    }
+    else
+    {
+      m = ndiSocketReadAvailable(pol->Socket, &buffer[stream->BufferLength], bufferSize - stream->BufferLength, &timestamp);
+    }
+    if (timestamp == 0)
+    {
+      timestamp = ndiTimeNanoseconds();
+    }
+    else if (m > 0)
+    {
+      ndiMetricsWakeup(pol, timestamp);
+    }
+
+    if (m < 0 || (m == 0 && stream->IsStopping))
+    {
+      // record the failure so that readers of the ring can see it
+      ndiFrame frame;
+      memset(&frame, 0, sizeof(ndiFrame));
+      frame.Timestamp = timestamp;
+      frame.ErrorCode = (m < 0 ? NDI_READ_ERROR : NDI_TIMEOUT);
+      ndiPushFrame(pol, &frame);
+      stream->FrameCount++;
+
+      // ndiStopStreaming() must not send USTREAM while the connection is
+      // being replaced, or after the stream has finished
+      std::lock_guard<std::mutex> lock(stream->ConnectionMutex);
+
+      // the streaming thread can restore the session and stream again
+      if (m < 0 && stream->HasThread && !stream->IsStopping &&
+          ndiSessionAutoReconnect(pol, frame.ErrorCode, &ndiStreamIsCancelled) &&
+          !stream->IsStopping && ndiStreamStart(pol) == NDI_OKAY)
+      {
+        stream->BufferLength = 0;
+        return true;
+      }
+
+      stream->AckError = frame.ErrorCode;
+      stream->IsFinished = true;
+      ndiEventSignal(stream->AckEvent);
+      return false;
+    }
+    if (stream->BufferLength == 0)
+    {
+      stream->FirstByteTime = timestamp;
+    }
+    stream->BufferLength += m;
+
+    // handle all of the complete replies in the buffer
+    int start = 0;
+    for (;;)
+    {
+      int n = ndiStreamReplyLength(&buffer[start], stream->BufferLength - start);
+      if (n == 0)
+      {
+        break;
+      }
+      else if (n < 0)
+      {
+        // lost sync, skip ahead one byte at a time until a reply is found
+        start++;
+        continue;
+      }
+      ndiStreamReply(pol, &buffer[start], n, stream->FirstByteTime, timestamp);
+      start += n;
+      // any further replies began to arrive with this read
+      stream->FirstByteTime = timestamp;
+
+      if (stream->IsFinished)
+      {
+        return false;
+      }
+    }
+    stream->BufferLength -= start;
+    memmove(buffer, &buffer[start], stream->BufferLength);
+
+    return true;
   }
-  else if (port >= 'A' && port <= 'I')
+
+  //----------------------------------------------------------------------------
+  // Wait for the reply to STREAM or USTREAM.  Without a streaming thread,
+  // the replies are read here, along with any frames that come before them.
+  int ndiStreamWaitForAck(ndicapi* pol, int milliseconds)
   {
-    dp = pol->GxPassiveInformation[port - 'A'];
+    ndiStreamSession* stream = pol->Stream;
+
+    if (stream->HasThread)
+    {
+      return (ndiEventWait(stream->AckEvent, milliseconds) ? NDI_TIMEOUT : (int)stream->AckError);
+    }
+
+    unsigned long long deadline = ndiTimeNanoseconds() + milliseconds * 1000000ULL;
+    while (stream->AckError == -1 && ndiTimeNanoseconds() < deadline)
+    {
+      if (!ndiStreamRead(pol))
+      {
+        break;
+      }
+    }
+    return (stream->AckError == -1 ? NDI_TIMEOUT : (int)stream->AckError);
   }
-  else
+}
+
+//----------------------------------------------------------------------------
+// The streaming thread, which reads and parses the replies until the
+// stream ends.
+static void* ndiStreamFunc(void* userdata)
+{
+  ndicapi* pol = (ndicapi*)userdata;
+
+  while (ndiStreamRead(pol))
   {
-    return 0;
   }
-  dp += 11 - (marker - 'A');
 
-  return (int)ndiHexToUnsignedLong(dp, 1);
+  return NULL;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetGXSingleStray(ndicapi* pol, int port, double coord[3])
+// Start a streaming session, with or without a thread to read it.
+static int ndiStartStreamSession(ndicapi* pol, const char* command, NDIFrameCallback callback, void* userdata,
+                                 bool hasThread)
 {
-  char* dp;
-
-  if (port >= '1' && port <= '3')
+  if (pol->Stream || pol->IsThreadedMode || pol->Group || pol->FrameRing == 0)
   {
-    dp = pol->GxSingleStray[port - '1'];
+    return NDI_INVALID_MODE;
   }
-  else
+  if (strlen(command) + 2 > sizeof(pol->Stream->Command) ||
+      !((command[0] == 'G' || command[0] == 'T' || command[0] == 'B') && command[1] == 'X'))
   {
-    return NDI_DISABLED;
+    return NDI_INVALID;
   }
 
-  if (*dp == 'D' || *dp == '\0')
+  ndiStreamSession* stream = new ndiStreamSession();
+  sprintf(stream->Command, "%s\r", command);
+  stream->Callback = callback;
+  stream->UserData = userdata;
+  stream->Parser = (ndicapi*)calloc(1, sizeof(ndicapi));
+  stream->AckEvent = ndiEventCreate();
+  stream->AckError = -1;
+  stream->IsStopping = false;
+  stream->IsFinished = false;
+  stream->FrameCount = 0;
+  stream->BufferSize = 2048;
+  stream->Buffer = (char*)malloc(stream->BufferSize);
+  stream->BufferLength = 0;
+  stream->ParsedReply = NULL;
+  stream->ParsedReplySize = 0;
+  stream->HasThread = hasThread;
+  ndiFrameRingReset(pol->FrameRing);
+  pol->Stream = stream;
+
+  // discard anything left over from previous commands
+  if (pol->SerialDevice != NDI_INVALID_HANDLE)
   {
-    return NDI_DISABLED;
+    ndiSerialFlush(pol->SerialDevice, NDI_IFLUSH);
   }
-  else if (*dp == 'M')
+  else
   {
-    return NDI_MISSING;
+    ndiSocketFlush(pol->Socket, NDI_IFLUSH);
   }
 
-  coord[0] = ndiSignedToLong(&dp[0],  7) * 0.01;
-  coord[1] = ndiSignedToLong(&dp[7],  7) * 0.01;
-  coord[2] = ndiSignedToLong(&dp[14], 7) * 0.01;
-
-  return NDI_OKAY;
-}
-
-//----------------------------------------------------------------------------
-ndicapiExport unsigned long ndiGetGXFrame(ndicapi* pol, int port)
-{
-  char* dp;
-
-  if (port >= '1' && port <= '3')
+  // the streaming thread reads the reply to STREAM, since the first
+  // frame can follow right behind it
+  if (hasThread)
   {
-    dp = pol->GxFrame[port - '1'];
+    pol->Stream->Thread = ndiThreadSplit(&ndiStreamFunc, pol);
   }
-  else if (port >= 'A' && port <= 'I')
+  int errnum = ndiStreamStart(pol);
+  if (errnum == NDI_OKAY)
   {
-    dp = pol->GxPassiveFrame[port - 'A'];
+    errnum = ndiStreamWaitForAck(pol, 5000);
   }
-  else
+
+  if (errnum != NDI_OKAY)
   {
-    return 0;
+    ndiStopStreaming(pol);
+    ndiSetError(pol, errnum);
   }
 
-  return (unsigned long)ndiHexToUnsignedLong(dp, 8);
+  return errnum;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetGXNumberOfPassiveStrays(ndicapi* pol)
+ndicapiExport int ndiStartStreaming(ndicapi* pol, const char* command, NDIFrameCallback callback, void* userdata)
 {
-  const char* dp;
-  int n;
+  return ndiStartStreamSession(pol, command, callback, userdata, true);
+}
 
-  dp = pol->GxPassiveStray;
+//----------------------------------------------------------------------------
+ndicapiExport int ndiStartStreamingPolled(ndicapi* pol, const char* command, NDIFrameCallback callback,
+                                          void* userdata)
+{
+  return ndiStartStreamSession(pol, command, callback, userdata, false);
+}
 
-  if (*dp == '\0')
-  {
-    return 0;
-  }
+//----------------------------------------------------------------------------
+ndicapiExport int ndiPollStream(ndicapi* pol)
+{
+  ndiStreamSession* stream = pol->Stream;
 
-  n = (int)ndiSignedToLong(dp, 3);
-  if (n < 0)
+  if (stream == 0 || stream->HasThread)
   {
-    return 0;
+    return -1;
   }
-  if (n > 20)
+
+  int frameCount = stream->FrameCount;
+#if !defined(_WIN32)
+  // only read if the device has data, so that this never blocks
+  struct pollfd fds;
+  fds.fd = ndiGetStreamDescriptor(pol);
+  fds.events = POLLIN;
+  fds.revents = 0;
+  if ((pol->Socket == -1 || ndiSocketBufferedBytes(pol->Socket) == 0) && poll(&fds, 1, 0) == 0)
   {
-    return 20;
+    return (stream->IsFinished ? -1 : 0);
   }
+#endif
+  bool isStreaming = ndiStreamRead(pol);
+  frameCount = stream->FrameCount - frameCount;
 
-  return n;
+  return (frameCount > 0 || isStreaming ? frameCount : -1);
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetGXPassiveStray(ndicapi* pol, int i, double coord[3])
+ndicapiExport int ndiGetStreamDescriptor(ndicapi* pol)
 {
-  const char* dp;
-  int n;
+#if defined(_WIN32)
+  return -1;
+#else
+  return (pol->SerialDevice != NDI_INVALID_HANDLE ? pol->SerialDevice : pol->Socket);
+#endif
+}
 
-  dp = pol->GxPassiveStray;
+//----------------------------------------------------------------------------
+ndicapiExport int ndiStopStreaming(ndicapi* pol)
+{
+  ndiStreamSession* stream = pol->Stream;
+  int errnum = NDI_OKAY;
 
-  if (*dp == '\0')
+  if (stream == 0)
   {
-    return NDI_DISABLED;
+    return NDI_OKAY;
   }
 
-  n = (int)ndiSignedToLong(dp, 3);
-  dp += 3;
-  if (n < 0)
+  // this also cancels a reconnection by the streaming thread
+  stream->IsStopping = true;
+
+  // the thread has already ended if the connection failed
+  bool isSent = false;
   {
-    return NDI_MISSING;
+    std::lock_guard<std::mutex> lock(stream->ConnectionMutex);
+    if (!stream->IsFinished)
+    {
+      ndiEventWait(stream->AckEvent, 0); // clear the STREAM acknowledgement
+      stream->AckError = -1;
+      errnum = ndiStreamWrite(pol, "USTREAM --id=" NDI_STREAM_ID "\r");
+      isSent = (errnum == NDI_OKAY);
+    }
   }
-  if (n > 20)
+  if (isSent)
   {
-    n = 20;
+    errnum = ndiStreamWaitForAck(pol, 5000);
   }
-
-  if (i < 0 || i >= n)
+  if (stream->HasThread)
   {
-    return NDI_MISSING;
+    ndiThreadJoin(stream->Thread);
   }
 
-  dp += 7 * 3 * i;
-  coord[0] = ndiSignedToLong(&dp[0],  7) * 0.01;
-  coord[1] = ndiSignedToLong(&dp[7],  7) * 0.01;
-  coord[2] = ndiSignedToLong(&dp[14], 7) * 0.01;
+  ndiEventDestroy(stream->AckEvent);
+  ndiFreeReplyData(stream->Parser);
+  free(stream->Parser);
+  free(stream->Buffer);
+  free(stream->ParsedReply);
+  delete stream;
+  pol->Stream = 0;
 
-  return NDI_OKAY;
+  return errnum;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport unsigned short ndiGetBXReplyLength(ndicapi* pol)
+ndicapiExport int ndiGetStreamingMode(ndicapi* pol)
 {
-  return pol->BxReplyLength;
+  return (pol->Stream != 0);
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetBXTransform(ndicapi* pol, int portHandle, float transform[8])
+// One device in a device group.
+struct ndiGroupDevice
 {
-  int i, n;
+  ndicapi* Device;
+  char Command[64];                       // command with CRC and "\r" appended
+  ndicapi* Parser;                        // scratch state for parsing
+  char* Buffer;                           // bytes that have not been parsed yet
+  int BufferSize;
+  int BufferLength;
+  unsigned long long FirstByteTime;       // when the first byte in Buffer arrived
+  bool IsWaiting;                         // waiting for a reply
+  bool IsFailed;                          // an IO error occurred
+  unsigned long long SendTime;            // when the command was sent
+  unsigned long long NextSendTime;        // when the next command can be sent
+
+  std::atomic<unsigned long long> Replies;
+  std::atomic<unsigned long long> Errors;
+  std::atomic<unsigned long long> Timeouts;
+  std::atomic<unsigned long long> BytesRead;
+  std::atomic<unsigned long long> TotalLatency;
+  std::atomic<unsigned long long> MaxLatency;
+};
 
-  n = pol->BxHandleCount;
-  for (i = 0; i < n; i++)
+//----------------------------------------------------------------------------
+// A set of devices that are served by one thread.
+struct ndiDeviceGroup
+{
+  std::vector<ndiGroupDevice*> Devices;
+  NDIThread Thread;
+  bool IsRunning;
+  std::atomic<bool> IsStopping;
+  unsigned long long Interval;            // nanoseconds between commands
+  char* ParsedReply;                      // the reply without its CRC, for parsing
+  int ParsedReplySize;
+#if !defined(_WIN32)
+  int WakePipe[2];                        // wakes the thread to stop it
+#endif
+};
+
+// time to wait for a reply before giving up, in milliseconds
+#define NDI_GROUP_TIMEOUT 5000
+
+namespace
+{
+#if !defined(_WIN32)
+  //----------------------------------------------------------------------------
+  int ndiGroupDeviceFD(ndicapi* pol)
+  {
+    return (pol->SerialDevice != NDI_INVALID_HANDLE ? pol->SerialDevice : pol->Socket);
+  }
+#endif
+
+  //----------------------------------------------------------------------------
+  // Free a device's group state, and detach the device from the group.
+  void ndiGroupDeviceFree(ndiGroupDevice* device)
+  {
+    device->Device->Group = 0;
+    ndiFreeReplyData(device->Parser);
+    free(device->Parser);
+    free(device->Buffer);
+    delete device;
+  }
+
+  //----------------------------------------------------------------------------
+  // Add a frame to the device's ring and count it.
+  void ndiGroupPushFrame(ndiGroupDevice* device, ndiFrame* frame)
   {
-    if (pol->BxHandles[i] == portHandle)
+    if (frame->ErrorCode == NDI_OKAY)
     {
-      break;
+      device->Replies++;
     }
+    else
+    {
+      device->Errors++;
+    }
+    ndiPushFrame(device->Device, frame);
   }
-  if (i == n)
+
+  //----------------------------------------------------------------------------
+  // Record an error that was not caused by a reply.
+  void ndiGroupError(ndiGroupDevice* device, int errnum, unsigned long long timestamp)
   {
-    return NDI_DISABLED;
+    ndiFrame frame;
+    memset(&frame, 0, sizeof(ndiFrame));
+    frame.Timestamp = timestamp;
+    frame.Command[0] = device->Command[0];
+    frame.Command[1] = device->Command[1];
+    frame.ErrorCode = errnum;
+    ndiGroupPushFrame(device, &frame);
   }
 
-  memcpy(&transform[0], &pol->BxTransforms[i][0], sizeof(float) * 8);
-  if (pol->BxHandlesStatus[i] & NDI_HANDLE_DISABLED)
+  //----------------------------------------------------------------------------
+  // Send the command to a device.
+  void ndiGroupSend(ndiGroupDevice* device, unsigned long long now)
   {
-    return NDI_DISABLED;
+    int errnum = ndiStreamWrite(device->Device, device->Command);
+    if (errnum != NDI_OKAY)
+    {
+      ndiGroupError(device, errnum, now);
+      device->IsFailed = (errnum == NDI_WRITE_ERROR);
+      device->NextSendTime = now + NDI_GROUP_TIMEOUT * 1000000ULL;
+      return;
+    }
+    device->IsWaiting = true;
+    device->SendTime = now;
   }
-  else if (pol->BxHandlesStatus[i] & NDI_HANDLE_MISSING)
+
+  //----------------------------------------------------------------------------
+  // Handle one complete reply from a device.
+  void ndiGroupReply(ndiDeviceGroup* group, ndiGroupDevice* device, const char* reply, int n,
+                     unsigned long long firstByteTime, unsigned long long timestamp)
   {
-    return NDI_MISSING;
+    bool crcOkay;
+    bool isBinary = (reply[0] == (char)0xc4 || reply[0] == (char)0xd4);
+
+    ndiCaptureWrite(device->Device->Capture, NDI_CAPTURE_REPLY, timestamp, reply, n);
+
+    if (!device->IsWaiting)
+    {
+      // a late reply to a command that already timed out
+      ndiMetricsReply(device->Device, n, 0, firstByteTime, timestamp);
+      return;
+    }
+    ndiMetricsReply(device->Device, n, device->SendTime, firstByteTime, timestamp);
+    device->IsWaiting = false;
+    device->NextSendTime = device->SendTime + group->Interval;
+
+    unsigned long long latency = (timestamp > device->SendTime ? timestamp - device->SendTime : 0);
+    device->TotalLatency += latency;
+    if (latency > device->MaxLatency)
+    {
+      device->MaxLatency = latency;
+    }
+
+    ndiFrame frame;
+    memset(&frame, 0, sizeof(ndiFrame));
+    frame.Timestamp = timestamp;
+    frame.FirstByteTime = firstByteTime;
+    frame.Command[0] = device->Command[0];
+    frame.Command[1] = device->Command[1];
+    unsigned long long parseTime = ndiTimeNanoseconds();
+    if (!ndiReserveArray(group->ParsedReply, group->ParsedReplySize, n + 1))
+    {
+      frame.ErrorCode = NDI_BAD_REPLY;
+    }
+    else if (ndiStripReplyCRC(reply, n, isBinary, group->ParsedReply, &crcOkay) < 0 || !crcOkay)
+    {
+      frame.ErrorCode = NDI_BAD_CRC;
+    }
+    else if (!isBinary && strncmp(group->ParsedReply, "ERROR", 5) == 0)
+    {
+      frame.ErrorCode = (int)ndiHexToUnsignedLong(&group->ParsedReply[5], 2);
+    }
+    else
+    {
+      ndiFrameFromReply(device->Parser, device->Command, group->ParsedReply, &frame);
+      ndiClockModelAddFrame(device->Device->ClockModel, &frame);
+    }
+    ndiMetricsParse(device->Device, parseTime);
+    ndiGroupPushFrame(device, &frame);
   }
 
-  return NDI_OKAY;
+  //----------------------------------------------------------------------------
+  // Read whatever a device has sent, and handle any complete replies.
+  void ndiGroupRead(ndiDeviceGroup* group, ndiGroupDevice* device)
+  {
+    ndicapi* pol = device->Device;
+    int m;
+    unsigned long long timestamp = 0;
+
+    // a partial reply that fills the buffer needs more room
+    bool hasRoom = ndiReserveReadBuffer(device->Buffer, device->BufferSize, device->BufferLength);
+    char* buffer = device->Buffer;
+    int bufferSize = device->BufferSize;
+    if (!hasRoom)
+    {
+      m = -1;
+    }
+    else if (pol->SerialDevice != NDI_INVALID_HANDLE)
+    {
+      m = ndiSerialReadAvailable(pol->SerialDevice, &buffer[device->BufferLength], bufferSize - device->BufferLength, &timestamp);
+    }
+    else
+    {
+      m = ndiSocketReadAvailable(pol->Socket, &buffer[device->BufferLength], bufferSize - device->BufferLength, &timestamp);
+    }
+    if (timestamp == 0)
+    {
+      timestamp = ndiTimeNanoseconds();
+    }
+    else if (m > 0)
+    {
+      ndiMetricsWakeup(pol, timestamp);
+    }
+
+    if (m < 0)
+    {
+      ndiGroupError(device, NDI_READ_ERROR, timestamp);
+      device->IsWaiting = false;
+      device->IsFailed = true;
+      return;
+    }
+    if (device->BufferLength == 0)
+    {
+      device->FirstByteTime = timestamp;
+    }
+    device->BytesRead += m;
+    device->BufferLength += m;
+
+    int start = 0;
+    for (;;)
+    {
+      int n = ndiStreamReplyLength(&buffer[start], device->BufferLength - start);
+      if (n == 0)
+      {
+        break;
+      }
+      else if (n < 0)
+      {
+        start++;
+        continue;
+      }
+      ndiGroupReply(group, device, &buffer[start], n, device->FirstByteTime, timestamp);
+      start += n;
+      device->FirstByteTime = timestamp;
+    }
+    device->BufferLength -= start;
+    memmove(buffer, &buffer[start], device->BufferLength);
+  }
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetBXPortStatus(ndicapi* pol, int portHandle)
+// The device group thread.
+//
+// Each device has at most one command outstanding, since the device will
+// not accept another command until it has replied.  The thread sends the
+// command to every device that is due, and then waits until any device
+// has data, a reply times out, or the group is stopped.
+static void* ndiDeviceGroupFunc(void* userdata)
 {
-  int i, n;
+  ndiDeviceGroup* group = (ndiDeviceGroup*)userdata;
+  int n = (int)group->Devices.size();
+  int i;
 
-  n = pol->BxHandleCount;
+#if defined(__linux__)
+  int epollHandle = epoll_create1(EPOLL_CLOEXEC);
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.u32 = n;
+  epoll_ctl(epollHandle, EPOLL_CTL_ADD, group->WakePipe[0], &event);
+  for (i = 0; i < n; i++)
+  {
+    event.data.u32 = i;
+    epoll_ctl(epollHandle, EPOLL_CTL_ADD, ndiGroupDeviceFD(group->Devices[i]->Device), &event);
+  }
+  std::vector<struct epoll_event> events(n + 1);
+#elif !defined(_WIN32)
+  std::vector<struct pollfd> fds(n + 1);
   for (i = 0; i < n; i++)
   {
-    if (pol->BxHandles[i] == portHandle)
+    fds[i].fd = ndiGroupDeviceFD(group->Devices[i]->Device);
+    fds[i].events = POLLIN;
+  }
+  fds[n].fd = group->WakePipe[0];
+  fds[n].events = POLLIN;
+#endif
+
+  for (;;)
+  {
+    unsigned long long now = ndiTimeNanoseconds();
+    unsigned long long wakeTime = now + NDI_GROUP_TIMEOUT * 1000000ULL;
+    bool isStopping = group->IsStopping;
+    bool isWaiting = false;
+
+    for (i = 0; i < n; i++)
+    {
+      ndiGroupDevice* device = group->Devices[i];
+      if (device->IsFailed)
+      {
+        continue;
+      }
+      if (device->IsWaiting && now - device->SendTime > NDI_GROUP_TIMEOUT * 1000000ULL)
+      {
+        device->Timeouts++;
+        ndiGroupError(device, NDI_TIMEOUT, now);
+        device->IsWaiting = false;
+        device->BufferLength = 0;
+        device->NextSendTime = now;
+      }
+      if (!device->IsWaiting && !isStopping && now >= device->NextSendTime)
+      {
+        ndiGroupSend(device, now);
+      }
+
+      unsigned long long deviceTime = (device->IsWaiting ?
+                                       device->SendTime + NDI_GROUP_TIMEOUT * 1000000ULL :
+                                       device->NextSendTime);
+      if (device->IsWaiting || !isStopping)
+      {
+        wakeTime = (deviceTime < wakeTime ? deviceTime : wakeTime);
+      }
+      isWaiting = (isWaiting || device->IsWaiting);
+    }
+
+    // stop waiting on devices that have failed, or they will keep
+    // reporting that they have hung up
+    for (i = 0; i < n; i++)
+    {
+      if (group->Devices[i]->IsFailed)
+      {
+#if defined(__linux__)
+        epoll_ctl(epollHandle, EPOLL_CTL_DEL, ndiGroupDeviceFD(group->Devices[i]->Device), &event);
+#elif !defined(_WIN32)
+        fds[i].fd = -1;
+#endif
+      }
+    }
+
+    // when stopping, wait for the outstanding replies so that the
+    // devices are ready for ndiCommand() again
+    if (isStopping && !isWaiting)
     {
       break;
     }
-  }
-  if (i == n)
-  {
-    return 0;
+
+    int timeout = (wakeTime > now ? (int)((wakeTime - now + 999999) / 1000000) : 0);
+#if defined(__linux__)
+    int k = epoll_wait(epollHandle, &events[0], n + 1, timeout);
+    for (int j = 0; j < k; j++)
+    {
+      if ((int)events[j].data.u32 == n)
+      {
+        char c;
+        ssize_t ignored = read(group->WakePipe[0], &c, 1);
+        (void)ignored;
+      }
+      else if (!group->Devices[events[j].data.u32]->IsFailed)
+      {
+        ndiGroupRead(group, group->Devices[events[j].data.u32]);
+      }
+    }
+#elif !defined(_WIN32)
+    if (poll(&fds[0], n + 1, timeout) > 0)
+    {
+      if (fds[n].revents & POLLIN)
+      {
+        char c;
+        ssize_t ignored = read(group->WakePipe[0], &c, 1);
+        (void)ignored;
+      }
+      for (i = 0; i < n; i++)
+      {
+        if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) && !group->Devices[i]->IsFailed)
+        {
+          ndiGroupRead(group, group->Devices[i]);
+        }
+      }
+    }
+#else
+    // there is no way to wait on serial ports and sockets together, so
+    // check each device in turn, the reads return within a millisecond
+    bool hasRead = false;
+    for (i = 0; i < n; i++)
+    {
+      if (group->Devices[i]->IsWaiting && !group->Devices[i]->IsFailed)
+      {
+        ndiGroupRead(group, group->Devices[i]);
+        hasRead = true;
+      }
+    }
+    if (!hasRead && timeout > 0)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(timeout < 10 ? timeout : 10));
+    }
+#endif
   }
 
-  return pol->BxPortStatus[i];
+#if defined(__linux__)
+  close(epollHandle);
+#endif
+
+  return NULL;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport unsigned long ndiGetBXFrame(ndicapi* pol, int portHandle)
+ndicapiExport ndiDeviceGroup* ndiDeviceGroupCreate()
 {
-  int i, n;
+  ndiDeviceGroup* group = new ndiDeviceGroup();
+  group->IsRunning = false;
+  group->IsStopping = false;
+  group->Interval = 0;
+  group->ParsedReply = NULL;
+  group->ParsedReplySize = 0;
+#if !defined(_WIN32)
+  group->WakePipe[0] = -1;
+  group->WakePipe[1] = -1;
+#endif
+  return group;
+}
 
-  n = pol->BxHandleCount;
-  for (i = 0; i < n; i++)
+//----------------------------------------------------------------------------
+ndicapiExport void ndiDeviceGroupDestroy(ndiDeviceGroup* group)
+{
+  if (group == 0)
   {
-    if (pol->BxHandles[i] == portHandle)
-    {
-      break;
-    }
+    return;
   }
-  if (i == n)
+
+  ndiDeviceGroupStop(group);
+
+  for (size_t i = 0; i < group->Devices.size(); i++)
   {
-    return 0;
+    ndiGroupDeviceFree(group->Devices[i]);
   }
-
-  return pol->BxFrameNumber[i];
+  free(group->ParsedReply);
+  delete group;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetBXToolInfo(ndicapi* pol, int portHandle, char& outToolInfo)
+ndicapiExport int ndiDeviceGroupAdd(ndiDeviceGroup* group, ndicapi* pol, const char* command)
 {
-  int i, n;
-
-  n = pol->BxHandleCount;
-  for (i = 0; i < n; i++)
+  if (group->IsRunning || pol->Group || pol->Stream || pol->IsThreadedMode || pol->FrameRing == 0)
   {
-    if (pol->BxHandles[i] == portHandle)
-    {
-      break;
-    }
+    return -1;
   }
-  if (i == n)
+  // leave room for the CRC, the carriage return and the terminator
+  if (strlen(command) + 6 > sizeof(((ndiGroupDevice*)0)->Command) ||
+      !((command[0] == 'G' || command[0] == 'T' || command[0] == 'B') && command[1] == 'X'))
   {
-    return NDI_DISABLED;
+    return -1;
   }
 
-  outToolInfo = pol->BxToolMarkerInformation[i][0];
-  return NDI_OKAY;
+  ndiGroupDevice* device = new ndiGroupDevice();
+  device->Device = pol;
+  strcpy(device->Command, command);
+  int commandLength;
+  bool isBinary;
+  ndiFrameCommand(device->Command, &commandLength, &isBinary);
+  device->Parser = (ndicapi*)calloc(1, sizeof(ndicapi));
+  device->BufferSize = 2048;
+  device->Buffer = (char*)malloc(device->BufferSize);
+  device->BufferLength = 0;
+  device->IsWaiting = false;
+  device->IsFailed = false;
+  device->SendTime = 0;
+  device->NextSendTime = 0;
+  device->Replies = 0;
+  device->Errors = 0;
+  device->Timeouts = 0;
+  device->BytesRead = 0;
+  device->TotalLatency = 0;
+  device->MaxLatency = 0;
+
+  pol->Group = group;
+  ndiFrameRingReset(pol->FrameRing);
+  group->Devices.push_back(device);
+
+  return (int)group->Devices.size() - 1;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetBXMarkerInfo(ndicapi* pol, int portHandle, int marker, char& outMarkerInfo)
+// Take a device that is being closed out of its group.  The group is
+// stopped first, since its thread may be using the device.
+static void ndiDeviceGroupRemove(ndicapi* pol)
 {
-  int i, n;
-
-  if (marker >= 20)
+  ndiDeviceGroup* group = pol->Group;
+  if (group == 0)
   {
-    return false;
+    return;
   }
 
-  n = pol->BxHandleCount;
-  for (i = 0; i < n; i++)
+  ndiDeviceGroupStop(group);
+  for (size_t i = 0; i < group->Devices.size(); i++)
   {
-    if (pol->BxHandles[i] == portHandle)
+    if (group->Devices[i]->Device == pol)
     {
+      ndiGroupDeviceFree(group->Devices[i]);
+      group->Devices.erase(group->Devices.begin() + i);
       break;
     }
   }
-  if (i == n)
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiDeviceGroupSetInterval(ndiDeviceGroup* group, int microseconds)
+{
+  group->Interval = (microseconds > 0 ? microseconds * 1000ULL : 0);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiDeviceGroupStart(ndiDeviceGroup* group)
+{
+  if (group->IsRunning)
   {
-    return NDI_DISABLED;
+    return NDI_INVALID_MODE;
   }
 
-  int byteIndex = marker / 2;
-  if (marker % 2 == 0)
+#if !defined(_WIN32)
+  if (pipe(group->WakePipe) != 0)
   {
-    // low 4 bits, little endian format, so index backwards from the rear
-    outMarkerInfo = pol->BxToolMarkerInformation[i][1 + (10 - byteIndex)] & 0x00FF;
+    return NDI_OPEN_ERROR;
   }
-  else
+#endif
+
+  for (size_t i = 0; i < group->Devices.size(); i++)
   {
-    // high 4 bits, little endian format, so index backwards from the rear
-    outMarkerInfo = pol->BxToolMarkerInformation[i][1 + (10 - byteIndex)] & 0xFF00 >> 4;
+    ndiGroupDevice* device = group->Devices[i];
+    ndicapi* pol = device->Device;
+
+    // discard anything left over from previous commands
+    if (pol->SerialDevice != NDI_INVALID_HANDLE)
+    {
+      ndiSerialFlush(pol->SerialDevice, NDI_IFLUSH);
+#if defined(_WIN32)
+      ndiSerialTimeout(pol->SerialDevice, 1);
+#endif
+    }
+    else
+    {
+      ndiSocketFlush(pol->Socket, NDI_IFLUSH);
+#if defined(_WIN32)
+      ndiSocketTimeout(pol->Socket, 1);
+#endif
+    }
+    device->BufferLength = 0;
+    device->IsWaiting = false;
+    device->IsFailed = false;
+    device->NextSendTime = 0;
   }
+
+  group->IsStopping = false;
+  group->IsRunning = true;
+  group->Thread = ndiThreadSplit(&ndiDeviceGroupFunc, group);
+
   return NDI_OKAY;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetBXSingleStray(ndicapi* pol, int portHandle, float outCoord[3])
+ndicapiExport void ndiDeviceGroupStop(ndiDeviceGroup* group)
 {
-  int i, n;
+  if (!group->IsRunning)
+  {
+    return;
+  }
 
-  n = pol->BxHandleCount;
-  for (i = 0; i < n; i++)
+  group->IsStopping = true;
+#if !defined(_WIN32)
+  char c = 0;
+  ssize_t ignored = write(group->WakePipe[1], &c, 1);
+  (void)ignored;
+#endif
+  ndiThreadJoin(group->Thread);
+  group->IsRunning = false;
+
+#if !defined(_WIN32)
+  close(group->WakePipe[0]);
+  close(group->WakePipe[1]);
+  group->WakePipe[0] = -1;
+  group->WakePipe[1] = -1;
+#else
+  for (size_t i = 0; i < group->Devices.size(); i++)
   {
-    if (pol->BxHandles[i] == portHandle)
+    ndicapi* pol = group->Devices[i]->Device;
+    if (pol->SerialDevice != NDI_INVALID_HANDLE)
     {
-      break;
+      ndiSerialTimeout(pol->SerialDevice, 5000);
+    }
+    else
+    {
+      ndiSocketTimeout(pol->Socket, 5000);
     }
   }
-  if (i == n)
-  {
-    return NDI_DISABLED;
-  }
-
-  memcpy(outCoord, pol->BxActiveSingleStrayMarkerPosition[i], sizeof(float) * 3);
-  return NDI_OKAY;
+#endif
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetBXNumberOfPassiveStrays(ndicapi* pol)
+ndicapiExport int ndiDeviceGroupGetNumberOfDevices(ndiDeviceGroup* group)
 {
-  return pol->BxPassiveStrayCount;
+  return (int)group->Devices.size();
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetBXPassiveStray(ndicapi* pol, int i, float outCoord[3])
+ndicapiExport ndicapi* ndiDeviceGroupGetDevice(ndiDeviceGroup* group, int i)
 {
-  if (i > pol->BxPassiveStrayCount)
+  if (i < 0 || i >= (int)group->Devices.size())
   {
-    return NDI_DISABLED;
+    return NULL;
   }
-  memcpy(outCoord, pol->BxPassiveStrayPosition[i], sizeof(float) * 3);
-  return NDI_OKAY;
-}
-
-//----------------------------------------------------------------------------
-ndicapiExport int ndiGetBXSystemStatus(ndicapi* pol)
-{
-  return pol->BxSystemStatus;
+  return group->Devices[i]->Device;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetPSTATPortStatus(ndicapi* pol, int port)
+ndicapiExport int ndiDeviceGroupGetStats(ndiDeviceGroup* group, int i, ndiDeviceGroupStats* stats)
 {
-  char* dp;
+  int n = (int)group->Devices.size();
+  int first = i;
+  int last = i + 1;
 
-  if (port >= '1' && port <= '3')
-  {
-    dp = pol->PstatBasic[port - '1'];
-  }
-  else if (port >= 'A' && port <= 'I')
+  if (i == -1)
   {
-    dp = pol->PstatPassiveBasic[port - 'A'];
+    first = 0;
+    last = n;
   }
-  else
+  else if (i < 0 || i >= n)
   {
-    return 0;
+    return NDI_INVALID;
   }
 
-  // the 'U' is for UNOCCUPIED
-  if (*dp == 'U' || *dp == '\0')
+  memset(stats, 0, sizeof(ndiDeviceGroupStats));
+  for (int j = first; j < last; j++)
   {
-    return 0;
+    ndiGroupDevice* device = group->Devices[j];
+    stats->Replies += device->Replies;
+    stats->Errors += device->Errors;
+    stats->Timeouts += device->Timeouts;
+    stats->DroppedFrames += ndiGetDroppedFrameCount(device->Device);
+    stats->BytesRead += device->BytesRead;
+    stats->TotalLatency += device->TotalLatency;
+    if (device->MaxLatency > stats->MaxLatency)
+    {
+      stats->MaxLatency = device->MaxLatency;
+    }
   }
 
-  // skip to the last two characters
-  dp += 30;
-
-  return (int)ndiHexToUnsignedLong(dp, 2);
+  return NDI_OKAY;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetPSTATToolInfo(ndicapi* pol, int port, char information[30])
+// The clock model fits the arrival time of the first byte of each reply
+// against the device's frame number.  The slope (the frame period) comes
+// from an exponentially weighted least squares fit, which follows slow
+// drift of the device clock.  The intercept comes from the lower envelope
+// of the recent samples instead of from their mean, since the host can
+// only ever delay a reply.
+
+// decay of the weights, which gives an effective window of ~1024 replies
+#define NDI_CLOCK_DECAY (1.0 - 1.0 / 1024)
+// number of recent samples that are searched for the lower envelope
+#define NDI_CLOCK_SAMPLES 64
+// number of samples that are needed before the model can be used
+#define NDI_CLOCK_MIN_SAMPLES 8
+// the model is reset if the frame number jumps forward by more than this
+#define NDI_CLOCK_MAX_GAP 0x100000
+
+struct ndiClockModel
 {
-  char* dp;
+  NDIMutex Mutex;
+  unsigned long long Samples;
+  unsigned long ReferenceFrame;           // frame number of the first sample
+  unsigned long long ReferenceTime;       // host time of the first sample
+  unsigned long LastFrame;
+  double Weight;                          // sum of the weights
+  double MeanX;                           // weighted mean of frames since reference
+  double MeanY;                           // weighted mean of nanoseconds since reference
+  double Cxx;                             // weighted sums of squares
+  double Cxy;
+  double Period;                          // nanoseconds per frame
+  double Offset;                          // nanoseconds at the reference frame
+  double JitterSquared;
+  double X[NDI_CLOCK_SAMPLES];            // recent samples, for the lower envelope
+  double Y[NDI_CLOCK_SAMPLES];
+};
 
-  if (port >= '1' && port <= '3')
-  {
-    dp = pol->PstatBasic[port - '1'];
-  }
-  else if (port >= 'A' && port <= 'I')
+namespace
+{
+  //----------------------------------------------------------------------------
+  void ndiClockModelClear(ndiClockModel* model)
   {
-    dp = pol->PstatPassiveBasic[port - 'A'];
+    model->Samples = 0;
+    model->Weight = 0.0;
+    model->MeanX = 0.0;
+    model->MeanY = 0.0;
+    model->Cxx = 0.0;
+    model->Cxy = 0.0;
+    model->Period = 0.0;
+    model->Offset = 0.0;
+    model->JitterSquared = 0.0;
   }
-  else
+
+  //----------------------------------------------------------------------------
+  // Frames since the reference frame, which allows for the frame counter
+  // wrapping around.
+  double ndiClockModelFrames(const ndiClockModel* model, unsigned long frame)
   {
-    return NDI_UNOCCUPIED;
+    return (double)(int)(unsigned int)(frame - model->ReferenceFrame);
   }
 
-  // the 'U' is for UNOCCUPIED
-  if (*dp == 'U' || *dp == '\0')
+  //----------------------------------------------------------------------------
+  void ndiClockModelAdd(ndiClockModel* model, unsigned long frame, unsigned long long time)
   {
-    return NDI_UNOCCUPIED;
-  }
+    if (model->Samples > 0)
+    {
+      int step = (int)(unsigned int)(frame - model->LastFrame);
+      if (step == 0)
+      {
+        // the same frame was read twice
+        return;
+      }
+      if (step < 0 || step > NDI_CLOCK_MAX_GAP || time < model->ReferenceTime)
+      {
+        // the device was reset, or tracking was restarted
+        ndiClockModelClear(model);
+      }
+    }
+    if (model->Samples == 0)
+    {
+      model->ReferenceFrame = frame;
+      model->ReferenceTime = time;
+    }
+    model->LastFrame = frame;
 
-  strncpy(information, dp, 30);
+    double x = ndiClockModelFrames(model, frame);
+    double y = (double)(time - model->ReferenceTime);
+    int slot = (int)(model->Samples % NDI_CLOCK_SAMPLES);
+    model->X[slot] = x;
+    model->Y[slot] = y;
+    model->Samples++;
 
-  return NDI_OKAY;
+    // exponentially weighted mean and covariance, updated in the manner of
+    // Welford so that there is no loss of precision from large sums
+    model->Weight = model->Weight * NDI_CLOCK_DECAY + 1.0;
+    double dx = x - model->MeanX;
+    model->MeanX += dx / model->Weight;
+    model->MeanY += (y - model->MeanY) / model->Weight;
+    model->Cxx = model->Cxx * NDI_CLOCK_DECAY + dx * (x - model->MeanX);
+    model->Cxy = model->Cxy * NDI_CLOCK_DECAY + dx * (y - model->MeanY);
+    if (model->Cxx <= 0.0)
+    {
+      return;
+    }
+    model->Period = model->Cxy / model->Cxx;
+
+    // the line through the earliest of the recent arrivals
+    int n = (model->Samples < NDI_CLOCK_SAMPLES ? (int)model->Samples : NDI_CLOCK_SAMPLES);
+    double offset = y - model->Period * x;
+    for (int i = 0; i < n; i++)
+    {
+      double residual = model->Y[i] - model->Period * model->X[i];
+      if (residual < offset)
+      {
+        offset = residual;
+      }
+    }
+    model->Offset = offset;
+
+    double jitter = y - model->Period * x - offset;
+    model->JitterSquared = model->JitterSquared * NDI_CLOCK_DECAY + jitter * jitter * (1.0 - NDI_CLOCK_DECAY);
+  }
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport unsigned long ndiGetPSTATCurrentTest(ndicapi* pol, int port)
+static ndiClockModel* ndiClockModelCreate()
 {
-  char* dp;
+  ndiClockModel* model = new ndiClockModel();
+  model->Mutex = ndiMutexCreate();
+  ndiClockModelClear(model);
+  return model;
+}
 
-  if (port >= '1' && port <= '3')
-  {
-    dp = pol->PstatTesting[port - '1'];
-  }
-  else if (port >= 'A' && port <= 'I')
+//----------------------------------------------------------------------------
+static void ndiClockModelDestroy(ndiClockModel* model)
+{
+  if (model)
   {
-    dp = pol->PstatPassiveTesting[port - 'A'];
+    ndiMutexDestroy(model->Mutex);
+    delete model;
   }
-  else
+}
+
+//----------------------------------------------------------------------------
+// Add a parsed frame, using the frame number of the first visible tool.
+static void ndiClockModelAddFrame(ndiClockModel* model, const ndiFrame* frame)
+{
+  if (model == 0 || frame->FirstByteTime == 0)
   {
-    return 0;
+    return;
   }
 
-  if (*dp == '\0')
+  for (int i = 0; i < frame->HandleCount; i++)
   {
-    return 0;
+    if (frame->FrameNumber[i] != 0)
+    {
+      ndiMutexLock(model->Mutex);
+      ndiClockModelAdd(model, frame->FrameNumber[i], frame->FirstByteTime);
+      ndiMutexUnlock(model->Mutex);
+      return;
+    }
   }
-
-  return (unsigned long)ndiHexToUnsignedLong(dp, 8);
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetPSTATPartNumber(ndicapi* pol, int port, char part[20])
+// Add the reply that ndiCommand() just parsed, if it was GX, TX or BX.
+static void ndiClockModelAddReply(ndicapi* pol, char command)
 {
-  char* dp;
+  static const char gxPorts[] = "123ABCDEFGHI";
+  unsigned long frame = 0;
+  int i;
 
-  if (port >= '1' && port <= '3')
+  if (pol->ClockModel == 0 || pol->ReplyFirstByteTime == 0)
   {
-    dp = pol->PstatPartNumber[port - '1'];
+    return;
   }
-  else if (port >= 'A' && port <= 'I')
+
+  if (command == 'T')
   {
-    dp = pol->PstatPassivePartNumber[port - 'A'];
+    for (i = 0; i < pol->TxHandleCount && frame == 0; i++)
+    {
+      frame = pol->TxHandleValues[i].Frame;
+    }
   }
-  else
+  else if (command == 'B')
   {
-    return NDI_UNOCCUPIED;
+    for (i = 0; i < pol->BxHandleCount && frame == 0; i++)
+    {
+      frame = pol->BxHandleValues[i].FrameNumber;
+    }
   }
-
-  if (*dp == '\0')
+  else if (command == 'G')
   {
-    return NDI_UNOCCUPIED;
+    for (i = 0; gxPorts[i] != '\0' && frame == 0; i++)
+    {
+      frame = ndiGetGXFrame(pol, gxPorts[i]);
+    }
   }
 
-  strncpy(part, dp, 20);
-
-  return NDI_OKAY;
+  if (frame != 0)
+  {
+    ndiMutexLock(pol->ClockModel->Mutex);
+    ndiClockModelAdd(pol->ClockModel, frame, pol->ReplyFirstByteTime);
+    ndiMutexUnlock(pol->ClockModel->Mutex);
+  }
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetPSTATAccessories(ndicapi* pol, int port)
+ndicapiExport void ndiGetReplyTimestamps(ndicapi* pol, unsigned long long* first, unsigned long long* last)
 {
-  char* dp;
-
-  if (port >= '1' && port <= '3')
+  if (first)
   {
-    dp = pol->PstatAccessories[port - '1'];
+    *first = pol->ReplyFirstByteTime;
   }
-  else if (port >= 'A' && port <= 'I')
+  if (last)
   {
-    dp = pol->PstatPassiveAccessories[port - 'A'];
+    *last = pol->ReplyLastByteTime;
   }
-  else
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetFrameHostTime(ndicapi* pol, unsigned long frame, unsigned long long* hostTime)
+{
+  ndiClockModel* model = pol->ClockModel;
+  int errnum = NDI_MISSING;
+
+  if (model == 0)
   {
-    return 0;
+    return NDI_MISSING;
   }
 
-  if (*dp == '\0')
+  ndiMutexLock(model->Mutex);
+  if (model->Samples >= NDI_CLOCK_MIN_SAMPLES && model->Period > 0.0)
   {
-    return 0;
+    double t = model->Offset + model->Period * ndiClockModelFrames(model, frame);
+    *hostTime = (unsigned long long)((long long)model->ReferenceTime + (long long)floor(t + 0.5));
+    errnum = NDI_OKAY;
   }
+  ndiMutexUnlock(model->Mutex);
 
-  return (int)ndiHexToUnsignedLong(dp, 2);
+  return errnum;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetPSTATMarkerType(ndicapi* pol, int port)
+ndicapiExport int ndiGetClockModel(ndicapi* pol, ndiClockModelInfo* info)
 {
-  char* dp;
+  ndiClockModel* model = pol->ClockModel;
+  int errnum = NDI_MISSING;
 
-  if (port >= '1' && port <= '3')
-  {
-    dp = pol->PstatMarkerType[port - '1'];
-  }
-  else if (port >= 'A' && port <= 'I')
+  memset(info, 0, sizeof(ndiClockModelInfo));
+  if (model == 0)
   {
-    dp = pol->PstatPassiveMarkerType[port - 'A'];
+    return NDI_MISSING;
   }
-  else
+
+  ndiMutexLock(model->Mutex);
+  info->Samples = model->Samples;
+  if (model->Samples >= NDI_CLOCK_MIN_SAMPLES && model->Period > 0.0)
   {
-    return 0;
+    info->ReferenceFrame = model->ReferenceFrame;
+    info->ReferenceTime = (unsigned long long)((long long)model->ReferenceTime + (long long)floor(model->Offset + 0.5));
+    info->FramePeriod = model->Period;
+    info->FrameRate = 1e9 / model->Period;
+    // compare against the nearest whole frame rate, e.g. 60 Hz or 250 Hz
+    double nominalRate = floor(info->FrameRate + 0.5);
+    if (nominalRate > 0.0)
+    {
+      info->DriftPpm = (info->FrameRate / nominalRate - 1.0) * 1e6;
+    }
+    info->Jitter = sqrt(model->JitterSquared);
+    errnum = NDI_OKAY;
   }
+  ndiMutexUnlock(model->Mutex);
 
-  if (*dp == '\0')
+  return errnum;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiResetClockModel(ndicapi* pol)
+{
+  ndiClockModel* model = pol->ClockModel;
+
+  if (model)
   {
-    return 0;
+    ndiMutexLock(model->Mutex);
+    ndiClockModelClear(model);
+    ndiMutexUnlock(model->Mutex);
   }
-
-  return (int)ndiHexToUnsignedLong(dp, 2);
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetSSTATControl(ndicapi* pol)
+// A latency histogram that any thread can add to.
+struct ndiHistogramCounters
 {
-  char* dp;
+  std::atomic<unsigned long long> Count;
+  std::atomic<unsigned long long> Total;
+  std::atomic<unsigned long long> Max;
+  std::atomic<unsigned long long> Buckets[NDI_HISTOGRAM_BUCKETS];
+};
 
-  dp = pol->SstatControl;
+//----------------------------------------------------------------------------
+// The counters behind ndiGetMetrics().  Every update is a relaxed atomic
+// addition, so the threads that talk to the device never wait for a lock.
+struct ndiMetrics
+{
+  std::atomic<unsigned long long> Commands;
+  std::atomic<unsigned long long> Replies;
+  std::atomic<unsigned long long> BytesSent;
+  std::atomic<unsigned long long> BytesReceived;
+  std::atomic<unsigned long long> CrcErrors;
+  std::atomic<unsigned long long> Timeouts;
+  std::atomic<unsigned long long> Errors;
+  std::atomic<unsigned long long> DroppedFrames;
+  ndiHistogramCounters ReplyLatency;
+  ndiHistogramCounters TransferTime;
+  ndiHistogramCounters ParseTime;
+  ndiHistogramCounters WakeupLatency;
+  std::atomic<NDITraceCallback> TraceCallback;
+  std::atomic<void*> TraceCallbackData;
+};
 
-  if (*dp == '\0')
+namespace
+{
+  //----------------------------------------------------------------------------
+  void ndiHistogramClear(ndiHistogramCounters* histogram)
   {
-    return 0;
+    histogram->Count.store(0, std::memory_order_relaxed);
+    histogram->Total.store(0, std::memory_order_relaxed);
+    histogram->Max.store(0, std::memory_order_relaxed);
+    for (int i = 0; i < NDI_HISTOGRAM_BUCKETS; i++)
+    {
+      histogram->Buckets[i].store(0, std::memory_order_relaxed);
+    }
   }
 
-  return (int)ndiHexToUnsignedLong(dp, 2);
+  //----------------------------------------------------------------------------
+  void ndiHistogramAdd(ndiHistogramCounters* histogram, unsigned long long duration)
+  {
+    int bucket = 0;
+#if defined(__GNUC__)
+    bucket = (duration > 1 ? 63 - __builtin_clzll(duration) : 0);
+#else
+    for (unsigned long long d = duration; d > 1; d >>= 1)
+    {
+      bucket++;
+    }
+#endif
+    bucket = (bucket < NDI_HISTOGRAM_BUCKETS ? bucket : NDI_HISTOGRAM_BUCKETS - 1);
+
+    histogram->Count.fetch_add(1, std::memory_order_relaxed);
+    histogram->Total.fetch_add(duration, std::memory_order_relaxed);
+    histogram->Buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    unsigned long long max = histogram->Max.load(std::memory_order_relaxed);
+    while (duration > max && !histogram->Max.compare_exchange_weak(max, duration, std::memory_order_relaxed))
+    {
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void ndiHistogramGet(const ndiHistogramCounters* histogram, ndiLatencyHistogram* info)
+  {
+    info->Count = histogram->Count.load(std::memory_order_relaxed);
+    info->Total = histogram->Total.load(std::memory_order_relaxed);
+    info->Max = histogram->Max.load(std::memory_order_relaxed);
+    for (int i = 0; i < NDI_HISTOGRAM_BUCKETS; i++)
+    {
+      info->Buckets[i] = histogram->Buckets[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Give an event to the USDT probes and to the trace callback.
+  void ndiMetricsTrace(ndicapi* pol, ndiMetrics* metrics, int event, unsigned long long time, long long value)
+  {
+#if defined(NDI_HAVE_SDT)
+    switch (event)
+    {
+      case NDI_TRACE_COMMAND:
+        DTRACE_PROBE3(ndicapi, command, pol, time, value);
+        break;
+      case NDI_TRACE_REPLY:
+        DTRACE_PROBE3(ndicapi, reply, pol, time, value);
+        break;
+      case NDI_TRACE_PARSED:
+        DTRACE_PROBE3(ndicapi, parsed, pol, time, value);
+        break;
+      case NDI_TRACE_ERROR:
+        DTRACE_PROBE3(ndicapi, error, pol, time, value);
+        break;
+      case NDI_TRACE_WAKEUP:
+        DTRACE_PROBE3(ndicapi, wakeup, pol, time, value);
+        break;
+    }
+#endif
+    NDITraceCallback callback = metrics->TraceCallback.load(std::memory_order_acquire);
+    if (callback)
+    {
+      callback(pol, event, time, value, metrics->TraceCallbackData.load(std::memory_order_relaxed));
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void ndiMetricsClear(ndiMetrics* metrics)
+  {
+    metrics->Commands.store(0, std::memory_order_relaxed);
+    metrics->Replies.store(0, std::memory_order_relaxed);
+    metrics->BytesSent.store(0, std::memory_order_relaxed);
+    metrics->BytesReceived.store(0, std::memory_order_relaxed);
+    metrics->CrcErrors.store(0, std::memory_order_relaxed);
+    metrics->Timeouts.store(0, std::memory_order_relaxed);
+    metrics->Errors.store(0, std::memory_order_relaxed);
+    metrics->DroppedFrames.store(0, std::memory_order_relaxed);
+    ndiHistogramClear(&metrics->ReplyLatency);
+    ndiHistogramClear(&metrics->TransferTime);
+    ndiHistogramClear(&metrics->ParseTime);
+    ndiHistogramClear(&metrics->WakeupLatency);
+  }
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetSSTATSensors(ndicapi* pol)
+static ndiMetrics* ndiMetricsCreate()
 {
-  char* dp;
-
-  dp = pol->SstatSensor;
-
-  if (*dp == '\0')
-  {
-    return 0;
-  }
-
-  return (int)ndiHexToUnsignedLong(dp, 2);
+  ndiMetrics* metrics = new ndiMetrics();
+  ndiMetricsClear(metrics);
+  metrics->TraceCallback.store(0, std::memory_order_relaxed);
+  metrics->TraceCallbackData.store(0, std::memory_order_relaxed);
+  return metrics;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetSSTATTIU(ndicapi* pol)
+static void ndiMetricsDestroy(ndiMetrics* metrics)
 {
-  char* dp;
-
-  dp = pol->SstatTiu;
-
-  if (*dp == '\0')
-  {
-    return 0;
-  }
-
-  return (int)ndiHexToUnsignedLong(dp, 2);
+  delete metrics;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetIRCHKDetected(ndicapi* pol)
+// A command was written to the device.
+static void ndiMetricsCommand(ndicapi* pol, int bytes, unsigned long long sendTime)
 {
-  if (pol->IrchkDetected == '1')
+  ndiMetrics* metrics = pol->Metrics;
+  if (metrics == 0)
   {
-    return 1;
+    return;
   }
-  return 0;
+
+  metrics->Commands.fetch_add(1, std::memory_order_relaxed);
+  metrics->BytesSent.fetch_add(bytes, std::memory_order_relaxed);
+  ndiMetricsTrace(pol, metrics, NDI_TRACE_COMMAND, sendTime, bytes);
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetIRCHKNumberOfSources(ndicapi* pol, int side)
+// A complete reply was read, the send time is zero for streamed replies.
+static void ndiMetricsReply(ndicapi* pol, int bytes, unsigned long long sendTime,
+                            unsigned long long firstByteTime, unsigned long long lastByteTime)
 {
-  const char* dp;
-  int n, m;
-
-  dp = pol->IrchkSources;
-
-  if (*dp == '\0')
+  ndiMetrics* metrics = pol->Metrics;
+  if (metrics == 0)
   {
-    return 0;
+    return;
   }
 
-  n = (int)ndiSignedToLong(dp, 3);
-  if (n < 0 || n > 20)
+  metrics->Replies.fetch_add(1, std::memory_order_relaxed);
+  metrics->BytesReceived.fetch_add(bytes, std::memory_order_relaxed);
+  if (sendTime != 0 && firstByteTime >= sendTime)
   {
-    return 0;
+    ndiHistogramAdd(&metrics->ReplyLatency, firstByteTime - sendTime);
   }
-  m = (int)ndiSignedToLong(dp + 3 + 2 * 3 * n, 3);
-  if (m < 0 || m > 20)
+  if (firstByteTime != 0 && lastByteTime >= firstByteTime)
   {
-    return 0;
+    ndiHistogramAdd(&metrics->TransferTime, lastByteTime - firstByteTime);
   }
+  ndiMetricsTrace(pol, metrics, NDI_TRACE_REPLY, lastByteTime, bytes);
+}
 
-  if (side == NDI_LEFT)
-  {
-    return n;
-  }
-  else if (side == NDI_RIGHT)
+//----------------------------------------------------------------------------
+// A reply was parsed, starting at the given time.
+static void ndiMetricsParse(ndicapi* pol, unsigned long long startTime)
+{
+  ndiMetrics* metrics = pol->Metrics;
+  if (metrics == 0)
   {
-    return m;
+    return;
   }
 
-  return 0;
+  unsigned long long now = ndiTimeNanoseconds();
+  unsigned long long duration = (now > startTime ? now - startTime : 0);
+  ndiHistogramAdd(&metrics->ParseTime, duration);
+  ndiMetricsTrace(pol, metrics, NDI_TRACE_PARSED, now, (long long)duration);
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetIRCHKSourceXY(ndicapi* pol, int side, int i, double xy[2])
+// A write or a reply failed.
+static void ndiMetricsError(ndicapi* pol, int errnum)
 {
-  const char* dp;
-  int n, m;
-
-  dp = pol->IrchkSources;
-
-  if (dp == NULL || *dp == '\0')
+  ndiMetrics* metrics = pol->Metrics;
+  if (metrics == 0 || errnum == NDI_OKAY)
   {
-    return NDI_MISSING;
+    return;
   }
 
-  n = (int)ndiSignedToLong(dp, 3);
-  if (n < 0 || n > 20)
-  {
-    return NDI_MISSING;
-  }
-  m = (int)ndiSignedToLong(dp + 3 + 2 * 3 * n, 3);
-  if (m < 0 || m > 20)
+  if (errnum == NDI_BAD_CRC)
   {
-    return NDI_MISSING;
+    metrics->CrcErrors.fetch_add(1, std::memory_order_relaxed);
   }
-
-  if (side == NDI_LEFT)
+  else if (errnum == NDI_TIMEOUT)
   {
-    if (i < 0 || i >= n)
-    {
-      return NDI_MISSING;
-    }
-    dp += 3 + 2 * 3 * i;
+    metrics->Timeouts.fetch_add(1, std::memory_order_relaxed);
   }
-  else if (side == NDI_RIGHT)
+  else
   {
-    if (i < 0 || i >= m)
-    {
-      return NDI_MISSING;
-    }
-    dp += 3 + 2 * 3 * n + 3 + 2 * 3 * i;
+    metrics->Errors.fetch_add(1, std::memory_order_relaxed);
   }
-  else if (side == NDI_RIGHT)
+  ndiMetricsTrace(pol, metrics, NDI_TRACE_ERROR, ndiTimeNanoseconds(), errnum);
+}
+
+//----------------------------------------------------------------------------
+// A thread has read data that arrived at the given time.
+static void ndiMetricsWakeup(ndicapi* pol, unsigned long long arrivalTime)
+{
+  ndiMetrics* metrics = pol->Metrics;
+  if (metrics == 0 || arrivalTime == 0)
   {
-    return NDI_MISSING;
+    return;
   }
 
-  xy[0] = ndiSignedToLong(&dp[0], 3) * 0.01;
-  xy[1] = ndiSignedToLong(&dp[3], 3) * 0.01;
-
-  return NDI_OKAY;
+  unsigned long long now = ndiTimeNanoseconds();
+  unsigned long long latency = (now > arrivalTime ? now - arrivalTime : 0);
+  ndiHistogramAdd(&metrics->WakeupLatency, latency);
+  ndiMetricsTrace(pol, metrics, NDI_TRACE_WAKEUP, now, (long long)latency);
 }
 
-
 //----------------------------------------------------------------------------
-// The tracking thread.
-//
-// This thread continually sends the most recent GX command to the
-// NDICAPI until it is told to quit or until an error occurs.
-//
-// The thread is blocked unless the Measurement System is in tracking mode.
-static void* ndiThreadFunc(void* userdata)
+// A reader of the ring missed a frame that was overwritten.
+static void ndiMetricsDroppedFrame(ndicapi* pol)
 {
-  int i, m;
-  int errorCode = 0;
-  char* command, *reply;
-  ndicapi* pol;
-
-  pol = (ndicapi*)userdata;
-  command = pol->ThreadCommand;
-  reply = pol->ThreadReply;
-
-  while (errorCode == 0)
+  if (pol->Metrics)
   {
-    // if the application is blocking us, we sit here and wait
-    ndiMutexLock(pol->ThreadMutex);
-
-    // quit if threading has been turned off
-    if (!pol->IsThreadedMode)
-    {
-      ndiMutexUnlock(pol->ThreadMutex);
-      return NULL;
-    }
-
-    // check whether we have a GX/BX/TX command ready to send
-    if (command[0] == '\0')
-    {
-      if (pol->SerialDevice != NDI_INVALID_HANDLE)
-      {
-        ndiSerialSleep(pol->SerialDevice, 20);
-      }
-      else
-      {
-        ndiSocketSleep(pol->Socket, 20);
-      }
-      ndiMutexUnlock(pol->ThreadMutex);
-      continue;
-    }
-
-    // flush the input buffer, because anything that we haven't read
-    //   yet is garbage left over by a previously failed command
-    if (pol->SerialDevice != NDI_INVALID_HANDLE)
-    {
-      ndiSerialFlush(pol->SerialDevice, NDI_IFLUSH);
-    }
-    else
-    {
-      ndiSocketFlush(pol->Socket, NDI_IFLUSH);
-    }
-
-    // send the command to the Measurement System
-    i = (int)strlen(command);
-    if (errorCode == 0)
-    {
-      if (pol->SerialDevice != NDI_INVALID_HANDLE)
-      {
-        m = ndiSerialWrite(pol->SerialDevice, command, i);
-      }
-      else
-      {
-        m = ndiSocketWrite(pol->Socket, command, i);
-      }
-      if (m < 0)
-      {
-        errorCode = NDI_WRITE_ERROR;
-      }
-      else if (m < i)
-      {
-        errorCode = NDI_TIMEOUT;
-      }
-    }
-
-    // read the reply from the Measurement System
-    if (errorCode == 0)
-    {
-      if (pol->SerialDevice != NDI_INVALID_HANDLE)
-      {
-        m = ndiSerialRead(pol->SerialDevice, reply, 2047, pol->IsThreadedCommandBinary, &errorCode);
-      }
-      else
-      {
-        int errorCode;
-        m = ndiSocketRead(pol->Socket, reply, 2047, pol->IsThreadedCommandBinary, &errorCode);
-      }
-      if (m < 0)
-      {
-        errorCode = NDI_READ_ERROR;
-        m = 0;
-      }
-      else if (m == 0)
-      {
-        errorCode = NDI_TIMEOUT;
-      }
-      // terminate the string
-      reply[m] = '\0';
-    }
-
-    // lock the buffer
-    ndiMutexLock(pol->ThreadBufferMutex);
-    // copy the reply into the buffer, also copy the error code
-    strcpy(pol->ThreadBuffer, reply);
-    pol->ThreadErrorCode = errorCode;
-    // signal the main thread that a new data record is ready
-    ndiEventSignal(pol->ThreadBufferEvent);
-    // unlock the buffer
-    ndiMutexUnlock(pol->ThreadBufferMutex);
-
-    // release the lock to give the application a chance to block us
-    ndiMutexUnlock(pol->ThreadMutex);
+    pol->Metrics->DroppedFrames.fetch_add(1, std::memory_order_relaxed);
   }
-
-  return NULL;
 }
 
 //----------------------------------------------------------------------------
-// Allocate all the objects needed for threading and then start the thread.
-static void ndiSpawnThread(ndicapi* pol)
+ndicapiExport int ndiGetMetrics(ndicapi* pol, ndiMetricsInfo* info)
 {
-  pol->ThreadCommand = (char*)malloc(2048);
-  pol->ThreadCommand[0] = '\0';
-  pol->ThreadReply = (char*)malloc(2048);
-  pol->ThreadReply[0] = '\0';
-  pol->ThreadBuffer = (char*)malloc(2048);
-  pol->ThreadBuffer[0] = '\0';
-  pol->ThreadErrorCode = 0;
+  ndiMetrics* metrics = pol->Metrics;
 
-  pol->ThreadBufferMutex = ndiMutexCreate();
-  pol->ThreadBufferEvent = ndiEventCreate();
-  pol->ThreadMutex = ndiMutexCreate();
-  if (!pol->IsTracking)
+  memset(info, 0, sizeof(ndiMetricsInfo));
+  if (metrics == 0)
   {
-    // if not tracking, then block the thread
-    ndiMutexLock(pol->ThreadMutex);
+    return NDI_OKAY;
   }
-  pol->Thread = ndiThreadSplit(&ndiThreadFunc, pol);
+
+  info->Commands = metrics->Commands.load(std::memory_order_relaxed);
+  info->Replies = metrics->Replies.load(std::memory_order_relaxed);
+  info->BytesSent = metrics->BytesSent.load(std::memory_order_relaxed);
+  info->BytesReceived = metrics->BytesReceived.load(std::memory_order_relaxed);
+  info->CrcErrors = metrics->CrcErrors.load(std::memory_order_relaxed);
+  info->Timeouts = metrics->Timeouts.load(std::memory_order_relaxed);
+  info->Errors = metrics->Errors.load(std::memory_order_relaxed);
+  info->DroppedFrames = metrics->DroppedFrames.load(std::memory_order_relaxed);
+  ndiHistogramGet(&metrics->ReplyLatency, &info->ReplyLatency);
+  ndiHistogramGet(&metrics->TransferTime, &info->TransferTime);
+  ndiHistogramGet(&metrics->ParseTime, &info->ParseTime);
+  ndiHistogramGet(&metrics->WakeupLatency, &info->WakeupLatency);
+
+  return NDI_OKAY;
 }
 
 //----------------------------------------------------------------------------
-// Wait for the tracking thread to end, and then do the clean - up.
-static void ndiJoinThread(ndicapi* pol)
+ndicapiExport void ndiResetMetrics(ndicapi* pol)
 {
-  if (!pol->IsTracking)
+  if (pol->Metrics)
   {
-    // if not tracking, unblock the thread or it can't stop
-    ndiMutexUnlock(pol->ThreadMutex);
+    ndiMetricsClear(pol->Metrics);
   }
-  ndiThreadJoin(pol->Thread);
-  ndiEventDestroy(pol->ThreadBufferEvent);
-  ndiMutexDestroy(pol->ThreadBufferMutex);
-  ndiMutexDestroy(pol->ThreadMutex);
-
-  free(pol->ThreadBuffer);
-  pol->ThreadBuffer = 0;
-  free(pol->ThreadReply);
-  pol->ThreadReply = 0;
-  free(pol->ThreadCommand);
-  pol->ThreadCommand = 0;
 }
 
 //----------------------------------------------------------------------------
-// For starting and stopping the tracking thread.
-//
-// The mode is either 0(no thread) or 1(thread).  Other modes
-// might be added in the future.
-ndicapiExport void ndiSetThreadMode(ndicapi* pol, bool mode)
+ndicapiExport unsigned long long ndiGetHistogramPercentile(const ndiLatencyHistogram* histogram, double fraction)
 {
-  if ((pol->IsThreadedMode && mode) || (!pol->IsThreadedMode && !mode))
+  if (histogram->Count == 0)
   {
-    return;
+    return 0;
   }
 
-  pol->IsThreadedMode = mode;
-
-  if (mode)
+  // the counts are read one at a time, so they may not add up to Count
+  unsigned long long total = 0;
+  for (int i = 0; i < NDI_HISTOGRAM_BUCKETS; i++)
   {
-    ndiSpawnThread(pol);
+    total += histogram->Buckets[i];
   }
-  else
+  double target = fraction * (double)total;
+  double count = 0.0;
+  for (int i = 0; i < NDI_HISTOGRAM_BUCKETS; i++)
   {
-    ndiJoinThread(pol);
+    double n = (double)histogram->Buckets[i];
+    if (n > 0.0 && count + n >= target)
+    {
+      double low = (i == 0 ? 0.0 : ldexp(1.0, i));
+      double high = ldexp(1.0, i + 1);
+      if (high > (double)histogram->Max)
+      {
+        high = (double)histogram->Max;
+      }
+      if (high < low)
+      {
+        high = low;
+      }
+      double t = (target - count) / n;
+      t = (t < 0.0 ? 0.0 : t);
+      return (unsigned long long)(low + (high - low) * t + 0.5);
+    }
+    count += n;
   }
+
+  return histogram->Max;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiGetThreadMode(ndicapi* pol)
+ndicapiExport void ndiSetTraceCallback(ndicapi* pol, NDITraceCallback callback, void* userdata)
 {
-  return pol->IsThreadedMode;
-}
\ No newline at end of file
+  if (pol->Metrics)
+  {
+    pol->Metrics->TraceCallbackData.store(userdata, std::memory_order_relaxed);
+    pol->Metrics->TraceCallback.store(callback, std::memory_order_release);
+  }
+}
@@ -53,9 +53,156 @@ POSSIBILITY OF SUCH DAMAGES.
 
 // Max tools is 12 active plus 9 passive, so 24 is a safe number
 // (note that we are only counting the number of handles that can
-// be simultaneously occupied)
+// be simultaneously occupied).  This limits ndiFrame and ndiBXSnapshot,
+// the TX and BX reply data in ndicapi grows to fit any number of handles.
 #define NDI_MAX_HANDLES 24
 
+// Size of the largest reply from a device.  The length of a BX reply is
+// 16 bits, so no reply is longer than 65535 bytes plus the header and CRC.
+// The reply buffers start out small and grow to fit the replies as they
+// arrive, up to this size.
+#define NDI_REPLY_BUFFER_SIZE 65544
+
+// Number of parsed frames kept by the tracking thread, must be a power of two
+#define NDI_FRAME_RING_SIZE 16
+
+//----------------------------------------------------------------------------
+// A tracking frame that was received and parsed by the tracking thread.
+// For GX frames the handles are the port characters '1' to '3' and 'A' to 'I'.
+typedef struct ndiFrame
+{
+  unsigned long long Sequence;            // sequence number, the first frame is 1
+  unsigned long long Timestamp;           // ndiTimeNanoseconds() when the last byte arrived
+  unsigned long long FirstByteTime;       // ndiTimeNanoseconds() when the first byte arrived
+  int ErrorCode;                          // error code for this reply (zero if no error)
+  char Command[4];                        // "GX", "TX" or "BX"
+  int HandleCount;                        // number of valid entries below
+  int Handles[NDI_MAX_HANDLES];           // port handles
+  int HandleStatus[NDI_MAX_HANDLES];      // NDI_OKAY, NDI_MISSING or NDI_DISABLED
+  double Transforms[NDI_MAX_HANDLES][8];  // quaternion, translation, error
+  int PortStatus[NDI_MAX_HANDLES];        // port status bits
+  unsigned long FrameNumber[NDI_MAX_HANDLES]; // device frame number
+  int SystemStatus;                       // system status bits
+} ndiFrame;
+
+//----------------------------------------------------------------------------
+// The relationship between device frame numbers and host time, as
+// estimated from the arrival times of tracking replies.
+typedef struct ndiClockModelInfo
+{
+  unsigned long long Samples;             // number of replies used for the estimate
+  unsigned long ReferenceFrame;           // device frame number at ReferenceTime
+  unsigned long long ReferenceTime;       // ndiTimeNanoseconds() of ReferenceFrame
+  double FramePeriod;                     // nanoseconds of host time per device frame
+  double FrameRate;                       // frames per second of host time
+  double DriftPpm;                        // device clock drift relative to the nominal rate
+  double Jitter;                          // RMS arrival jitter in nanoseconds
+} ndiClockModelInfo;
+
+//----------------------------------------------------------------------------
+// All of the information for one tool from the most recent BX reply.
+typedef struct alignas(64) ndiBXToolSnapshot
+{
+  int Handle;                             // port handle
+  int Status;                             // NDI_OKAY, NDI_MISSING or NDI_DISABLED
+  int PortStatus;                         // port status bits
+  unsigned int FrameNumber;               // device frame number
+  float Transform[8];                     // quaternion, translation, error
+  char ToolInfo;                          // tool information (NDI_ADDITIONAL_INFO)
+  char MarkerInfo[10];                    // marker information (NDI_ADDITIONAL_INFO)
+  char SingleStrayStatus;                 // active stray status (NDI_SINGLE_STRAY)
+  float SingleStray[3];                   // active stray position (NDI_SINGLE_STRAY)
+  int MarkerCount;                        // number of 3D markers (NDI_3D_MARKER_POSITIONS)
+  char MarkerOutOfVolume[4];              // out-of-volume bit for each marker
+  float Markers[20][3];                   // 3D marker positions
+} ndiBXToolSnapshot;
+
+//----------------------------------------------------------------------------
+// The most recent BX reply in one contiguous block that can be copied
+// with memcpy(), e.g. into shared memory.
+typedef struct alignas(64) ndiBXSnapshot
+{
+  int HandleCount;                        // number of valid entries in Tools
+  int SystemStatus;                       // system status bits
+  int PassiveStrayCount;                  // number of passive strays (NDI_PASSIVE_STRAY)
+  unsigned int ReplyLength;               // length of the BX reply
+  ndiBXToolSnapshot Tools[NDI_MAX_HANDLES];
+  char PassiveStrayOutOfVolume[30];       // out-of-volume bit for each stray
+  float PassiveStrays[240][3];            // passive stray positions
+} ndiBXSnapshot;
+
+//----------------------------------------------------------------------------
+// A device that was found by ndiProbeAll().
+typedef struct ndiProbeResult
+{
+  char DeviceName[256];                   // serial port device, for ndiOpenSerial()
+  char Version[1024];                     // reply to "VER:0" without the CRC
+} ndiProbeResult;
+
+//----------------------------------------------------------------------------
+// One connection failure, see ndiReconnect() and ndiSetAutoReconnect().
+typedef struct ndiReconnectIncident
+{
+  unsigned long long StartTime;           // ndiTimeNanoseconds() when the failure was seen
+  unsigned long long Downtime;            // nanoseconds until the session was restored, or given up
+  int ErrorCode;                          // the error that caused the reconnect
+  int ResultCode;                         // NDI_OKAY if the session was restored
+  int Attempts;                           // number of times the connection was opened
+} ndiReconnectIncident;
+
+//----------------------------------------------------------------------------
+// Totals for all of the connection failures of a device.
+typedef struct ndiReconnectStats
+{
+  int Incidents;                          // connection failures
+  int Recovered;                          // failures after which the session was restored
+  int Attempts;                           // times the connection was opened again
+  int IsReconnecting;                     // 1 while a reconnect is in progress
+  unsigned long long TotalDowntime;       // nanoseconds, for all incidents
+  unsigned long long MaxDowntime;         // nanoseconds, for the longest incident
+} ndiReconnectStats;
+
+// Number of buckets in an ndiLatencyHistogram.  Bucket k counts the
+// durations from 2^k up to 2^(k+1) nanoseconds, and bucket 0 also
+// counts durations of zero.  The last bucket counts everything longer.
+#define NDI_HISTOGRAM_BUCKETS 40
+
+//----------------------------------------------------------------------------
+// A histogram of durations, see ndiGetMetrics().
+typedef struct ndiLatencyHistogram
+{
+  unsigned long long Count;               // number of durations
+  unsigned long long Total;               // sum of the durations, in nanoseconds
+  unsigned long long Max;                 // longest duration, in nanoseconds
+  unsigned long long Buckets[NDI_HISTOGRAM_BUCKETS]; // counts for powers of two
+} ndiLatencyHistogram;
+
+//----------------------------------------------------------------------------
+// Counters and latencies for the communication with a device, from
+// ndiCommand(), thread mode, streaming and device groups together.
+typedef struct ndiMetricsInfo
+{
+  unsigned long long Commands;            // commands written to the device
+  unsigned long long Replies;             // complete replies read from the device
+  unsigned long long BytesSent;           // bytes written
+  unsigned long long BytesReceived;       // bytes of complete replies
+  unsigned long long CrcErrors;           // replies with NDI_BAD_CRC
+  unsigned long long Timeouts;            // NDI_TIMEOUT, for a write or a reply
+  unsigned long long Errors;              // other IO errors, and ERROR replies
+  unsigned long long DroppedFrames;       // overwritten frames that a reader of the ring missed
+  ndiLatencyHistogram ReplyLatency;       // from the write to the first byte of the reply
+  ndiLatencyHistogram TransferTime;       // from the first byte of a reply to the last
+  ndiLatencyHistogram ParseTime;          // checking the CRC and decoding a reply
+  ndiLatencyHistogram WakeupLatency;      // from the arrival of data until a thread reads it
+} ndiMetricsInfo;
+
+// the events that are given to the NDITraceCallback
+#define NDI_TRACE_COMMAND  1   // a command was written, the value is its length
+#define NDI_TRACE_REPLY    2   // a reply arrived, the value is its length
+#define NDI_TRACE_PARSED   3   // a reply was parsed, the value is the parse time
+#define NDI_TRACE_ERROR    4   // an error occurred, the value is the error code
+#define NDI_TRACE_WAKEUP   5   // a thread read new data, the value is the wakeup latency
+
 //----------------------------------------------------------------------------
 // Structure for holding ndicapi data.
 struct ndicapi
@@ -71,6 +218,7 @@ struct ndicapi
 
   char* Command;                          // text sent to the ndicapi
   char* Reply;                            // reply from the ndicapi
+  int ReplySize;                          // size of Reply and of ReplyNoCRC
 
   // this is set to true during tracking mode
   bool IsTracking;
@@ -83,9 +231,29 @@ struct ndicapi
   NDIEvent ThreadBufferEvent;             // for when buffer is updated
   char* ThreadCommand;                    // last command sent from thread
   char* ThreadReply;                      // reply from the ndicapi
+  int ThreadReplySize;                    // size of ThreadReply
   char* ThreadBuffer;                     // buffer for previous reply
+  int ThreadBufferSize;                   // size of ThreadBuffer
+  int ThreadBufferLength;                 // number of bytes in buffer (BX replies can contain zeros)
   bool IsThreadedCommandBinary;           // cache whether we're sending BX (true) or TX/GX (false)
   int ThreadErrorCode;                    // error code to go with buffer
+  struct ndicapi* ThreadParser;           // scratch state for parsing in the thread
+  struct ndiFrameRing* FrameRing;         // parsed frames, NULL for ndiOpenOffline()
+  struct ndiCommandQueue* CommandQueue;   // commands for ndiCommandAsync()
+  struct ndiStreamSession* Stream;        // streaming session, see ndiStartStreaming()
+  struct ndiDeviceGroup* Group;           // device group, see ndiDeviceGroupAdd()
+  unsigned long long ThreadBufferFirstByteTime; // arrival times of the reply in ThreadBuffer
+  unsigned long long ThreadBufferLastByteTime;
+
+  // arrival times of the last reply, see ndiGetReplyTimestamps()
+  unsigned long long ReplyFirstByteTime;
+  unsigned long long ReplyLastByteTime;
+  struct ndiClockModel* ClockModel;       // device frame numbers to host time
+
+  struct ndiCapture* Capture;             // capture file, see ndiStartCapture()
+  struct ndiReplay* Replay;               // replay that acts as the device, if any
+  struct ndiSession* Session;             // configuration commands, see ndiReconnect()
+  struct ndiMetrics* Metrics;             // counters and latencies, see ndiGetMetrics()
 
   // command reply -- this is the return value from plCommand()
   char* ReplyNoCRC;                     // reply without CRC and <CR>
@@ -110,83 +278,56 @@ struct ndicapi
 
   char GxPassiveStray[424];               // all passive stray markers
 
-  // PSTAT command reply data
-  char PstatBasic[3][32];                 // basic pstat info
-  char PstatTesting[3][8];                // testing results
-  char PstatPartNumber[3][20];            // part number
-  char PstatAccessories[3][2];            // accessory information
-  char PstatMarkerType[3][2];             // marker information
-
-  char PstatPassiveBasic[9][32];          // basic passive pstat info
-  char PstatPassiveTesting[9][8];         // meaningless info
-  char PstatPassivePartNumber[9][20];     // virtual srom part number
-  char PstatPassiveAccessories[9][2];     // virtual srom accessories
-  char PstatPassiveMarkerType[9][2];      // meaningless for passive
-
-  // SSTAT command reply data
-  char SstatControl[2];                   // control processor status
-  char SstatSensor[2];                    // sensor processors status
-  char SstatTiu[2];                       // tiu processor status
-
-  // IRCHK command reply data
-  int IrchkDetected;                      // irchk detected infrared
-  char IrchkSources[128];                 // coordinates of sources
-
-  // PHRQ command reply data
-  char PhrqReply[2];
-
-  // PHSR command reply data
-  char PhsrReply[1284];
-
-  // PHINF command reply data
-  int PhinfUnoccupied;
-  char PhinfBasic[34];
-  char PhinfTesting[8];
-  char PhinfPartNumber[20];
-  char PhinfAccessories[2];
-  char PhinfMarkerType[2];
-  char PhinfPortLocation[14];
-  char PhinfGpioStatus[2];
-
-  // TX command reply data
+  // GX reply data decoded by the GX helper, index 0 to 2 are the
+  // active ports '1' to '3' and index 3 to 11 are passive ports 'A' to 'I'
+  double GxTransformValues[12][8];        // decoded transforms
+  int GxTransformStatus[12];              // NDI_OKAY, NDI_MISSING or NDI_DISABLED
+  int GxPortStatusValue[12];              // decoded port status
+  unsigned long GxFrameValue[12];         // decoded frame numbers
+  int GxSystemStatusValue;                // decoded system status
+
+  // PSTAT, SSTAT, IRCHK, PHRQ, PHSR and PHINF reply data, which is
+  // allocated by the first of these commands since it is rarely needed
+  struct ndiStatusReplies* StatusReplies;
+
+  // TX command reply data, with room for TxHandleCapacity handles.  The
+  // decoded values are kept apart from the reply text, so that the values
+  // for all handles share as few cache lines as possible.
   int TxHandleCount;
-  unsigned char TxHandles[NDI_MAX_HANDLES];
-  char TxTransforms[NDI_MAX_HANDLES][52];
-  char TxStatus[NDI_MAX_HANDLES][8];
-  char TxFrame[NDI_MAX_HANDLES][8];
-  char TxInformation[NDI_MAX_HANDLES][12];
-  char TxSingleStray[NDI_MAX_HANDLES][24];
-  char TxSystemStatus[4];
+  int TxHandleCapacity;
+  struct ndiTXHandle* TxHandleValues;     // decoded transform, status and frame
+  struct ndiTXHandleText* TxHandleText;   // the reply text for each handle
+  unsigned char TxHandleIndex[256];       // index + 1 for each handle
+  char TxSystemStatus[5];
+  int TxSystemStatusValue;                // decoded system status
 
   int TxPassiveStrayCount;
   char TxPassiveStrayOov[14];
-  char TxPassiveStray[1052];
+  int TxPassiveStrayCapacity;             // bytes allocated for TxPassiveStray
+  char* TxPassiveStray;                   // 21 characters per stray
 
-  // BX command reply data
+  // BX command reply data, with room for BxHandleCapacity handles.  The
+  // 3D markers of all the tools are stored one after another.
   unsigned short BxReplyLength;
-  unsigned char BxHandleCount;
-  char BxHandles[NDI_MAX_HANDLES];
-  char BxHandlesStatus[NDI_MAX_HANDLES];
-  unsigned int BxFrameNumber[NDI_MAX_HANDLES];
-  float BxTransforms[NDI_MAX_HANDLES][8];
-  int BxPortStatus[NDI_MAX_HANDLES];
-  char BxToolMarkerInformation[NDI_MAX_HANDLES][11];
-
-  char BxActiveSingleStrayMarkerStatus[NDI_MAX_HANDLES];
-  float BxActiveSingleStrayMarkerPosition[NDI_MAX_HANDLES][3];
-
-  char Bx3DMarkerCount[NDI_MAX_HANDLES];
-  char Bx3DMarkerOutOfVolume[NDI_MAX_HANDLES][3]; // 3 bytes holds 1 bit entries for up to 24 markers (but 20 is max)
-  float Bx3DMarkerPosition[NDI_MAX_HANDLES][20][3]; // a tool can have up to 20 markers
+  int BxHandleCount;
+  int BxHandleCapacity;
+  struct ndiBXHandle* BxHandleValues;     // transform, status and frame
+  struct ndiBXHandleExtra* BxHandleExtra; // tool info, single stray and markers
+  unsigned char BxHandleIndex[256];       // index + 1 for each handle
+  int BxMarkerCapacity;
+  float (*BxMarkerPositions)[3];          // 3D markers of all tools
 
   int BxPassiveStrayCount;
-  char BxPassiveStrayOutOfVolume[30]; // 30 bytes holds 1 bit entries for up to 240 markers
-  float BxPassiveStrayPosition[240][3]; // hold up to 240 stray markers
+  int BxPassiveStrayCapacity;
+  unsigned char BxPassiveStrayOutOfVolume[32]; // 1 bit per stray, up to 255 strays
+  float (*BxPassiveStrayPosition)[3];
 
   int BxSystemStatus;
 };
 
 typedef struct ndicapi ndicapi;
+typedef struct ndiDeviceGroup ndiDeviceGroup;
+typedef struct ndiPreparedCommand ndiPreparedCommand;
 
 /*=====================================================================*/
 /*! \defgroup NDIMethods Core Interface Methods
@@ -218,7 +359,7 @@ ndicapiExport const char* ndiSerialDeviceName(int i);
   -# open the device at 9600 baud, 8 data bits, no parity, 1 stop bit
   -# send an "INIT:" command and check for the expected reply
   -# if the "INIT:" failed, send a serial break and re-try the "INIT:"
-  -# if the "INIT:" succeeds, send "VER:0" and check for response.
+  -# if the "INIT:" succeeds, ask for the firmware version and check for response.
   -# restore the device to its previous state and close the device.
 
   \param device    name of a valid serial port device
@@ -235,6 +376,25 @@ ndicapiExport const char* ndiSerialDeviceName(int i);
 */
 ndicapiExport int ndiSerialProbe(const char* device, bool checkDSR);
 
+/*! \ingroup NDIMethods
+  Probe all of the serial ports for NDI devices at the same time.
+  The ports are the USB adapters (/dev/serial/by-id/, /dev/ttyUSB* and
+  /dev/ttyACM*) and the devices of ndiSerialDeviceName() on Linux, the
+  /dev/cu.* devices on macOS, and the COM ports that exist on Windows.
+  Each port is probed as for ndiSerialProbe() in its own thread, so the
+  probe takes as long as the slowest port rather than the sum of them.
+
+  \param results       array to store the devices that were found
+  \param maxResults    size of the results array
+  \param resetTimeout  how long to wait for a device to reset after a
+                       serial break, in milliseconds (ndiSerialProbe()
+                       uses 7000, but 1000 is usually enough)
+  \param checkDSR      whether or not to perform a DSR check
+
+  \return the number of devices that were stored in results
+*/
+ndicapiExport int ndiProbeAll(ndiProbeResult* results, int maxResults, int resetTimeout, bool checkDSR);
+
 /*! \ingroup NDIMethods
   Open communication with the NDI device on the specified
   serial port device.  This also sets the serial port parameters to
@@ -244,6 +404,9 @@ ndicapiExport int ndiSerialProbe(const char* device, bool checkDSR);
 
   \return 1 if an NDI device was found on the specified port, 0 otherwise
 
+  If the name has the form "capture:<file>" or "capture:<file>?speed=<x>",
+  then the capture file is replayed instead, see ndiReplayCreate().  The
+  speed is 1 by default, and 0 replays as fast as possible.
 */
 ndicapiExport ndicapi* ndiOpenSerial(const char* device);
 
@@ -256,9 +419,114 @@ network host and port.
 
 \return 1 if an NDI device was found at the specified address, 0 otherwise
 
+A hostname of the form "capture:<file>" replays a capture file, as for
+ndiOpenSerial(), and the port is ignored.
 */
 ndicapiExport ndicapi* ndiOpenNetwork(const char* hostname, int port);
 
+/*! \ingroup NDIMethods
+  Switch a serial connection to the fastest baud rate that works.
+  The device is first set to 9600 baud, and then 115200, 230400, 921600
+  and 1228739 baud are tried in that order.  Each rate must pass a burst
+  of "ECHO:" commands with no CRC errors and no timeouts before the next
+  one is tried, and the first rate that fails ends the search.  The host
+  and the device are left at the fastest rate that passed.
+
+  The rate is remembered for the serial number reported by "VER:0", and
+  is tried first the next time, so that usually only one rate has to be
+  checked.  The rates are kept in the file "baudrates" in the directory
+  given by the NDICAPI_CACHE_DIR environment variable, or otherwise in
+  an "ndicapi" folder in the user's cache directory.
+
+  If the device does not answer a COMM command at the old rate after a
+  rate fails, it is reset with a serial break and "INIT:" is sent again.
+  For this reason, and because the search sends commands, this should be
+  called after "INIT:" and before the tools are set up.  It cannot be
+  called in threaded mode or while streaming.
+
+  \param pol          a device that was opened with ndiOpenSerial()
+  \param maxBaudRate  the fastest rate to try, or 0 for no limit
+  \param handshake    1 for hardware handshaking, 0 for none
+
+  \return the baud rate that was chosen, or 0 if an error occurred,
+  see ndiGetError()
+*/
+ndicapiExport int ndiNegotiateBaudRate(ndicapi* pol, int maxBaudRate, int handshake);
+
+/*! \ingroup NDIMethods
+  Open the connection to the device again, and restore the session.
+
+  The commands that configure the device are recorded as they succeed:
+  "INIT:", "COMM:", "PHRQ:", "PVWR:" (including those that are sent by
+  ndiPVWRFromFile()), "PINIT:", "PENA:", "PDIS:", "PHF:", "TTCFG:",
+  "SET:", "VSEL:", "IRATE:" and "TSTART:".  "INIT:" or a serial break
+  starts a new recording, only the most recent "COMM:" is kept, and
+  "TSTOP:" removes "TSTART:".
+
+  To reconnect, the serial port or the socket is closed and opened
+  again.  A serial device is brought back to 9600 baud, with "INIT:" at
+  9600 baud or at the rate of the last "COMM:", or with a serial break
+  if neither is answered.  Then the recorded commands are sent again in
+  order, and the handles that "PHRQ:" assigns must be the same as
+  before.  The reply data of the device handle is not changed.
+
+  \param pol  valid NDI device handle
+
+  \return NDI_OKAY, NDI_INVALID_MODE if thread mode, streaming or a device
+  group is active, or the error that stopped the session from being
+  restored
+*/
+ndicapiExport int ndiReconnect(ndicapi* pol);
+
+/*! \ingroup NDIMethods
+  Reconnect automatically when the tracking thread or the streaming
+  thread loses the connection, i.e. when a read or a write fails or the
+  device does not reply in time.  The failed frame is added to the ring
+  with its error code as usual, and then the connection is restored as
+  for ndiReconnect().  Attempts are spaced 100 ms apart at first, and the
+  delay doubles after each failed attempt up to 5 seconds.  Once the
+  session is restored, the thread sends its command again (or "STREAM"
+  again) and the frames continue in the same ring.  Reconnecting stops
+  when thread mode or streaming is turned off.
+
+  This is off by default.  Sessions from ndiStartStreamingPolled() and
+  device groups do not reconnect, since their descriptors would change.
+
+  \param pol          valid NDI device handle
+  \param maxAttempts  attempts for each failure, 0 to turn it off, or
+                      -1 to try until thread mode or streaming is
+                      turned off
+*/
+ndicapiExport void ndiSetAutoReconnect(ndicapi* pol, int maxAttempts);
+
+/*! \ingroup NDIMethods
+  Get the totals for all the connection failures of the device.
+
+  \return NDI_OKAY
+*/
+ndicapiExport int ndiGetReconnectStats(ndicapi* pol, ndiReconnectStats* stats);
+
+/*! \ingroup NDIMethods
+  Get the most recent connection failures, oldest first.  The last 32
+  are kept.
+
+  \param pol        valid NDI device handle
+  \param incidents  array to hold the incidents
+  \param maxCount   size of the incidents array
+
+  \return the number of incidents that were stored
+*/
+ndicapiExport int ndiGetReconnectIncidents(ndicapi* pol, ndiReconnectIncident* incidents, int maxCount);
+
+/*! \ingroup NDIMethods
+  Create a device handle that is not connected to any device.  It can
+  only be used with ndiParseReply() and the functions that retrieve the
+  parsed data, any command will fail with NDI_OPEN_ERROR.  It has no frame
+  ring, so it cannot use thread mode, streaming or a device group.  Close
+  it with ndiCloseNetwork().
+*/
+ndicapiExport ndicapi* ndiOpenOffline();
+
 /*! \ingroup NDIMethods
   Close communication with the NDI device.  You should send
   a "COMM:00000" command before you close communication so that you
@@ -272,6 +540,35 @@ Close communication with the NDI device.
 */
 ndicapiExport void ndiCloseNetwork(ndicapi* pol);
 
+/*! \ingroup NDIMethods
+  Record all traffic with the device to a capture file.
+
+  \param pol       valid NDI device handle
+  \param filename  the capture file, an existing file is replaced
+
+  \return NDI_OKAY, NDI_OPEN_ERROR if the file could not be created, or
+          NDI_INVALID_MODE if thread mode, streaming or a device group
+          is active
+
+  Every command and every reply is written to the file together with
+  the time at which it was sent or received, whether it goes through
+  ndiCommand(), the tracking thread, a streaming session or a device
+  group.  The file can be read with ndiCaptureOpen(), or replayed by
+  opening "capture:<file>" with ndiOpenSerial() or ndiOpenNetwork().
+  The capture is stopped by ndiStopCapture() or when the device is
+  closed.  Start the capture before turning on thread mode or
+  streaming, since it cannot be started or stopped while they run.
+*/
+ndicapiExport int ndiStartCapture(ndicapi* pol, const char* filename);
+
+/*! \ingroup NDIMethods
+  Stop recording to the capture file and close it.
+
+  \return NDI_OKAY, or NDI_INVALID_MODE if thread mode, streaming or a
+          device group is active
+*/
+ndicapiExport int ndiStopCapture(ndicapi* pol);
+
 /*! \ingroup NDIMethods
   Set up multithreading to increase efficiency.
 
@@ -301,6 +598,186 @@ ndicapiExport void ndiCloseNetwork(ndicapi* pol);
 */
 ndicapiExport void ndiSetThreadMode(ndicapi* pol, bool mode);
 
+/*! \ingroup NDIMethods
+  Callback type for use with ndiStartStreaming().  It is called from
+  the streaming thread for every frame that arrives.
+*/
+typedef void (*NDIFrameCallback)(ndicapi* pol, const ndiFrame* frame, void* userdata);
+
+/*! \ingroup NDIMethods
+  Ask the device to stream the replies to a GX, TX or BX command.
+
+  \param pol       valid NDI device handle
+  \param command   the command to stream, e.g. "BX 0801" or "TX 0001"
+  \param callback  function to call for each frame, can be NULL
+  \param userdata  data to send to the callback
+
+  \return NDI_OKAY, or an error code if the stream could not be started
+
+  The device must already be in tracking mode, and thread mode must be off.
+  A STREAM command is sent to the device, which then sends a reply to the
+  command every frame without being asked, which saves one round trip
+  per frame compared to thread mode.  A dedicated thread reads the
+  replies, parses them, and stores them in the same frame ring that is
+  used by thread mode, so they can be retrieved with ndiGetLatestFrame()
+  and ndiGetFramesSince().  Streamed binary replies start with 0xB5D4
+  instead of 0xA5C4, and are otherwise identical to BX replies.
+
+  While streaming, ndiCommand() must not be used.  Call ndiStopStreaming()
+  first.
+*/
+ndicapiExport int ndiStartStreaming(ndicapi* pol, const char* command, NDIFrameCallback callback, void* userdata);
+
+/*! \ingroup NDIMethods
+  Send USTREAM to stop streaming, and wait for the streaming thread to end.
+
+  \return NDI_OKAY, or an error code if the device did not acknowledge
+*/
+ndicapiExport int ndiStopStreaming(ndicapi* pol);
+
+/*! \ingroup NDIMethods
+  Check whether a streaming session is active.
+*/
+ndicapiExport int ndiGetStreamingMode(ndicapi* pol);
+
+/*! \ingroup NDIMethods
+  Start streaming like ndiStartStreaming(), but without a thread.
+
+  \param pol       valid NDI device handle
+  \param command   the command to stream, e.g. "BX 0801" or "TX 0001"
+  \param callback  function to call for each frame, can be NULL
+  \param userdata  data to send to the callback
+
+  \return NDI_OKAY, or an error code if the stream could not be started
+
+  Instead of a thread, the application calls ndiPollStream() whenever
+  the descriptor from ndiGetStreamDescriptor() is readable, so that an
+  event loop (select, poll, epoll or e.g. Python's asyncio) can serve
+  many devices from one thread.  The frames go to the same frame ring,
+  and the callback is called from within ndiPollStream().  Stop the
+  stream with ndiStopStreaming().
+*/
+ndicapiExport int ndiStartStreamingPolled(ndicapi* pol, const char* command, NDIFrameCallback callback,
+                                          void* userdata);
+
+/*! \ingroup NDIMethods
+  Read and parse whatever the device has streamed since the last call,
+  for a stream that was started with ndiStartStreamingPolled().
+
+  \param pol    valid NDI device handle
+
+  \return the number of frames that were added to the frame ring, or -1
+  if the stream has ended, e.g. because of an IO error
+
+  This never waits for the device, except on Windows where it waits
+  for at most the device timeout.  Read the new frames with
+  ndiGetFramesSince().  A stream that ends with an error leaves a frame
+  with that error in the ring.
+*/
+ndicapiExport int ndiPollStream(ndicapi* pol);
+
+/*! \ingroup NDIMethods
+  Get the file descriptor of the serial port or the socket of a device,
+  so that it can be watched for data by an event loop.
+
+  \return the descriptor, or -1 if it is not available (on Windows)
+*/
+ndicapiExport int ndiGetStreamDescriptor(ndicapi* pol);
+
+/*! \ingroup NDIMethods
+  Get the most recent frame that was received by the tracking thread.
+
+  \param pol    valid NDI device handle
+  \param frame  the frame is copied here
+
+  \return one of:
+  - NDI_OKAY - the frame was copied
+  - NDI_DISABLED - the device was opened with ndiOpenOffline()
+  - NDI_MISSING - no frame has been received yet
+
+  While thread mode is on, the tracking thread parses every GX, TX or BX
+  reply that it receives and appends it to a ring of the last
+  NDI_FRAME_RING_SIZE frames.  Reading the ring never takes a lock and
+  never blocks the tracking thread, so any number of threads can
+  read frames at the same time.  Check frame->ErrorCode, because
+  communication errors are recorded in the ring as well.  The ring is
+  emptied when thread mode is turned on, and its frames can still be
+  read after thread mode is turned off.
+*/
+ndicapiExport int ndiGetLatestFrame(ndicapi* pol, ndiFrame* frame);
+
+/*! \ingroup NDIMethods
+  Copy all frames newer than the given sequence number, oldest first.
+
+  \param pol        valid NDI device handle
+  \param sequence   the sequence number of the last frame already seen,
+                    or zero to get all frames that are still in the ring
+  \param frames     array to copy the frames into
+  \param maxFrames  the size of the array
+
+  \return the number of frames that were copied
+
+  Frames that were overwritten before they could be read are skipped,
+  which can be detected as a gap in the sequence numbers.  Pass the
+  sequence number of the last copied frame to the next call.
+*/
+ndicapiExport int ndiGetFramesSince(ndicapi* pol, unsigned long long sequence, ndiFrame* frames, int maxFrames);
+
+/*! \ingroup NDIMethods
+  Get the number of frames that the tracking thread overwrote
+  before they were read by ndiGetLatestFrame() or ndiGetFramesSince().
+  Frames are only counted after the ring has been read at least once,
+  so the count stays at zero for applications that never read the ring.
+  The count is reset when thread mode is turned on.
+*/
+ndicapiExport unsigned long long ndiGetDroppedFrameCount(ndicapi* pol);
+
+/*! \ingroup NDIMethods
+  Get the arrival times of the most recent reply to ndiCommand().
+
+  \param pol    valid NDI device handle
+  \param first  ndiTimeNanoseconds() when the first byte arrived
+  \param last   ndiTimeNanoseconds() when the last byte arrived
+
+  On Linux network connections the times come from the kernel's receive
+  timestamps (SO_TIMESTAMPNS), so they do not include the time that the
+  reply waited in the socket buffer.  Either pointer can be NULL.
+*/
+ndicapiExport void ndiGetReplyTimestamps(ndicapi* pol, unsigned long long* first, unsigned long long* last);
+
+/*! \ingroup NDIMethods
+  Convert a device frame number into the host time at which the device
+  sent that frame.
+
+  \param pol       valid NDI device handle
+  \param frame     device frame number, e.g. from ndiGetBXFrame()
+  \param hostTime  the time, on the ndiTimeNanoseconds() clock
+
+  \return NDI_OKAY, or NDI_MISSING if too few replies have been seen
+
+  Every GX, TX and BX reply, whether from ndiCommand(), thread mode,
+  streaming or a device group, updates a per-device clock model that fits
+  the arrival time of the first byte of each reply against its frame
+  number.  The fit follows the earliest arrivals, because a reply can be
+  delayed by the host but never arrives before the device sends it, so
+  the result is free of most of the host's scheduling jitter.
+*/
+ndicapiExport int ndiGetFrameHostTime(ndicapi* pol, unsigned long frame, unsigned long long* hostTime);
+
+/*! \ingroup NDIMethods
+  Get the current state of the clock model, including the measured frame
+  rate and the drift of the device clock relative to the host clock.
+
+  \return NDI_OKAY, or NDI_MISSING if too few replies have been seen
+*/
+ndicapiExport int ndiGetClockModel(ndicapi* pol, ndiClockModelInfo* info);
+
+/*! \ingroup NDIMethods
+  Discard the clock model, e.g. after the device has been reset.  The
+  model is also reset automatically when the frame numbers jump.
+*/
+ndicapiExport void ndiResetClockModel(ndicapi* pol);
+
 /*! \ingroup NDIMethods
   Send a command to the device using a printf-style format string.
 
@@ -353,6 +830,114 @@ ndicapiExport char* ndiCommand(ndicapi* pol, const char* format, ...);
 */
 ndicapiExport char* ndiCommandVA(ndicapi* pol, const char* format, va_list ap);
 
+/*! \ingroup NDIMethods
+  Format a command once, so that it can be sent many times with
+  ndiCommandPrepared() without formatting it or computing its CRC again.
+
+  \param format a printf-style format string, as for ndiCommand()
+  \param ...    format arguments as per the format string
+
+  \return the prepared command, or NULL if it is too long.  It must be
+  freed with ndiFreePreparedCommand().
+
+  A prepared command is not tied to a device, so one prepared command
+  such as "BX:0801" can be shared by all devices.
+*/
+ndicapiExport ndiPreparedCommand* ndiPrepareCommand(const char* format, ...);
+
+/*! \ingroup NDIMethods
+  Send a command that was prepared with ndiPrepareCommand().  This
+  behaves exactly like ndiCommand(), including thread mode and the
+  reply helpers, but it does not format the command or compute its CRC,
+  and it does not allocate memory.
+*/
+ndicapiExport char* ndiCommandPrepared(ndicapi* pol, const ndiPreparedCommand* command);
+
+/*! \ingroup NDIMethods
+  Free a command that was prepared with ndiPrepareCommand().
+*/
+ndicapiExport void ndiFreePreparedCommand(ndiPreparedCommand* command);
+
+/*! \ingroup NDIMethods
+  Parse a reply that was received earlier, without any communication
+  with the device.
+
+  \param pol      valid NDI device handle, it holds the parsed data
+  \param command  the command that the reply belongs to, either as it
+                  was sent (with the CRC and carriage return) or as it
+                  was given to ndiCommand()
+  \param reply    the complete reply, including its CRC
+  \param n        the length of the reply in bytes
+
+  \return the reply with the CRC chopped off, as for ndiCommand()
+
+  The reply is checked and given to the same helpers as a reply to
+  ndiCommand(), so the results can be retrieved with e.g. ndiGetBXTransform()
+  or ndiGetTXTransform().  This is meant for the records of a capture file,
+  see ndiCaptureGetRecord().  Use ndiGetError() to check for a bad CRC or
+  an error reply.
+*/
+ndicapiExport char* ndiParseReply(ndicapi* pol, const char* command, const char* reply, int n);
+
+/*! \ingroup NDIMethods
+  Compute the CRC16 that is used by the NDI protocol.
+
+  \param crc   the running CRC, zero to start a new one
+  \param data  the bytes to add to the CRC
+  \param n     the number of bytes
+
+  \return the new running CRC
+
+  The CRC of a binary reply, including the CRC at its end, is zero if the
+  reply is intact.
+*/
+ndicapiExport unsigned short ndiCRC16(unsigned short crc, const void* data, int n);
+
+/*! \ingroup NDIMethods
+  Callback type for use with ndiCommandAsync().  The reply is the same
+  string that ndiCommand() would have returned, and it is only valid
+  until the callback returns.
+*/
+typedef void (*NDICommandCallback)(ndicapi* pol, int errnum, const char* reply, void* userdata);
+
+/*! \ingroup NDIMethods
+  Queue a command to be sent to the device by a background thread.
+
+  \param pol       valid NDI device handle
+  \param callback  function to call with the reply, can be NULL
+  \param userdata  data to send to the callback
+  \param format    a printf-style format string, as for ndiCommand()
+
+  \return NDI_OKAY if the command was queued, or NDI_TOO_LONG if the
+  formatted command does not fit in the command buffer
+
+  The command is formatted immediately, so the arguments do not have to
+  stay valid.  Queued commands are sent one after another in the order
+  that they were queued, and the callbacks are called in the same order
+  from the background thread.  While the thread is still working, the
+  next command is formatted and ready, so the link never sits idle
+  waiting for the application between commands.  The NDI protocol does
+  not accept a new command until the previous reply has been received,
+  so commands are never written ahead of the previous reply.
+
+  Use ndiWaitForCommands() before calling ndiCommand() directly, because
+  the two must not be interleaved.  Queued commands are finished before
+  the device is closed.
+*/
+ndicapiExport int ndiCommandAsync(ndicapi* pol, NDICommandCallback callback, void* userdata, const char* format, ...);
+
+/*! \ingroup NDIMethods
+  Wait until all commands that were queued with ndiCommandAsync() are done.
+
+  \param pol           valid NDI device handle
+  \param milliseconds  the maximum time to wait, or -1 to wait forever
+
+  \return NDI_TIMEOUT if the commands did not finish in time, otherwise the
+  error code of the first queued command that failed since the previous
+  call to this function, or NDI_OKAY if none failed
+*/
+ndicapiExport int ndiWaitForCommands(ndicapi* pol, int milliseconds);
+
 /*! \ingroup NDIMethods
   Error callback type for use with ndiSetErrorCallback().
 */
@@ -378,6 +963,68 @@ Log current state of NDICAPI to string
 */
 ndicapiExport void ndiLogState(ndicapi* pol, char outInformation[USHRT_MAX]);
 
+/*! \ingroup NDIMethods
+  Get the counters and latency histograms of a device.  These are kept
+  for every device, and cost a few atomic additions per reply, so they
+  can be left on.  The counters cover ndiCommand(), thread mode,
+  streaming and device groups.
+
+  \param pol   valid NDI device handle
+  \param info  the metrics, see ndiMetricsInfo
+
+  \return NDI_OKAY
+
+  The reply latency is only measured for replies to a command, not for
+  streamed replies.  The wakeup latency is the time from the arrival of
+  the data until the thread that reads it got it.  On Linux network
+  connections the arrival time comes from the kernel's receive timestamps,
+  otherwise it is the time when the read returned, so the latency is
+  close to zero.
+*/
+ndicapiExport int ndiGetMetrics(ndicapi* pol, ndiMetricsInfo* info);
+
+/*! \ingroup NDIMethods
+  Set all of the counters and histograms of a device to zero.
+*/
+ndicapiExport void ndiResetMetrics(ndicapi* pol);
+
+/*! \ingroup NDIMethods
+  Estimate a percentile of a latency histogram.
+
+  \param histogram  a histogram from ndiGetMetrics()
+  \param fraction   the percentile as a fraction, e.g. 0.99
+
+  \return the duration in nanoseconds, interpolated within its bucket,
+          or zero if the histogram is empty
+*/
+ndicapiExport unsigned long long ndiGetHistogramPercentile(const ndiLatencyHistogram* histogram, double fraction);
+
+/*! \ingroup NDIMethods
+  The signature of a trace callback, see ndiSetTraceCallback().  The time
+  is on the ndiTimeNanoseconds() clock.
+*/
+typedef void (*NDITraceCallback)(ndicapi* pol, int event, unsigned long long time, long long value,
+                                 void* userdata);
+
+/*! \ingroup NDIMethods
+  Set a function that is called for each NDI_TRACE event, e.g. to write
+  the events into a system trace for correlation with other activity.
+
+  \param pol       valid NDI device handle
+  \param callback  the callback, or NULL to remove it
+  \param userdata  data to send to the callback
+
+  The callback is called from whichever thread handled the event, such
+  as the tracking thread or the streaming thread, so it must be quick
+  and thread-safe.  Set it while the device is idle.
+
+  Where <sys/sdt.h> is available when ndicapi is built, each event is
+  also a USDT probe in the "ndicapi" provider, named "command", "reply",
+  "parsed", "error" and "wakeup", with the device, the time and the value
+  as arguments.  These probes cost nothing unless a tracer is attached.
+*/
+ndicapiExport void ndiSetTraceCallback(ndicapi* pol, NDITraceCallback callback, void* userdata);
+
 /*! \ingroup NDIMethods
 Set the socket timeout
 
@@ -385,6 +1032,93 @@ Set the socket timeout
 */
 ndicapiExport void ndiTimeoutSocket(ndicapi* pol, int timeoutMsec);
 
+/*! \ingroup NDIMethods
+  Statistics for a device group, see ndiDeviceGroupGetStats().
+  All times are in nanoseconds.
+*/
+typedef struct ndiDeviceGroupStats
+{
+  unsigned long long Replies;             // replies that were parsed without error
+  unsigned long long Errors;              // replies with errors, including timeouts
+  unsigned long long Timeouts;            // commands that got no reply in time
+  unsigned long long DroppedFrames;       // overwritten frames that a reader of the ring missed
+  unsigned long long BytesRead;           // total bytes received
+  unsigned long long TotalLatency;        // sum of command-to-reply times
+  unsigned long long MaxLatency;          // longest command-to-reply time
+} ndiDeviceGroupStats;
+
+/*! \ingroup NDIMethods
+  Create an empty device group.
+
+  A device group sends a GX, TX or BX command to each of its devices
+  over and over again, like ndiSetThreadMode() does for one device, but
+  it uses a single thread that waits on all of the devices at once
+  (with epoll on Linux and poll on other Unix systems) instead of one
+  blocking thread per device.  The parsed frames are stored in each
+  device's frame ring, so they are read with ndiGetLatestFrame() and
+  ndiGetFramesSince() as usual.
+*/
+ndicapiExport ndiDeviceGroup* ndiDeviceGroupCreate();
+
+/*! \ingroup NDIMethods
+  Stop the group and free it.  The devices are not closed.
+*/
+ndicapiExport void ndiDeviceGroupDestroy(ndiDeviceGroup* group);
+
+/*! \ingroup NDIMethods
+  Add a device to a group that has not been started yet.
+
+  \param group    the device group
+  \param pol      valid NDI device handle that is in tracking mode
+  \param command  the command to send repeatedly, e.g. "BX:0801"
+
+  \return the index of the device in the group, or a negative value if the
+  device is already streaming, threaded, or in a group, or if the group
+  is running or the command is not GX, TX or BX
+
+  While the device is in the group, ndiCommand() must not be used with it.
+  Closing the device removes it from the group, which stops the group
+  and renumbers the devices that follow it.
+*/
+ndicapiExport int ndiDeviceGroupAdd(ndiDeviceGroup* group, ndicapi* pol, const char* command);
+
+/*! \ingroup NDIMethods
+  Set the minimum time between commands to the same device.  The default
+  is zero, which sends the next command as soon as the reply arrives.
+*/
+ndicapiExport void ndiDeviceGroupSetInterval(ndiDeviceGroup* group, int microseconds);
+
+/*! \ingroup NDIMethods
+  Start the I/O thread for the group.
+
+  \return NDI_OKAY, or NDI_INVALID_MODE if it is already running
+*/
+ndicapiExport int ndiDeviceGroupStart(ndiDeviceGroup* group);
+
+/*! \ingroup NDIMethods
+  Stop the I/O thread, waiting for any outstanding replies.  The devices
+  stay in the group and in tracking mode, and ndiCommand() can be used
+  again afterwards.
+*/
+ndicapiExport void ndiDeviceGroupStop(ndiDeviceGroup* group);
+
+/*! \ingroup NDIMethods
+  Get the number of devices in the group.
+*/
+ndicapiExport int ndiDeviceGroupGetNumberOfDevices(ndiDeviceGroup* group);
+
+/*! \ingroup NDIMethods
+  Get a device from the group by index.
+*/
+ndicapiExport ndicapi* ndiDeviceGroupGetDevice(ndiDeviceGroup* group, int i);
+
+/*! \ingroup NDIMethods
+  Get the statistics for one device, or for all devices if the index is -1.
+
+  \return NDI_OKAY, or NDI_INVALID if the index is out of range
+*/
+ndicapiExport int ndiDeviceGroupGetStats(ndiDeviceGroup* group, int i, ndiDeviceGroupStats* stats);
+
 /*=====================================================================*/
 /*! \defgroup NDIMacros Command Macros
   These are a set of macros that send commands to the device via
@@ -791,6 +1525,7 @@ ndicapiExport void ndiTimeoutSocket(ndicapi* pol, int timeoutMsec);
   - int \ref ndiGetTXSingleStray(ndicapi *pol, int ph, double coord[3])
   - int \ref ndiGetTXNumberOfPassiveStrays(ndicapi *pol)
   - int \ref ndiGetTXPassiveStray(ndicapi *pol, int i, double coord[3])
+  - int \ref ndiGetTXPassiveStrays(ndicapi *pol, double coords[][3], int maxCount)
   - int \ref ndiGetTXSystemStatus(ndicapi *pol)
 */
 #define ndiTX(p,mode) ndiCommand((p),"TX:%04X",(mode))
@@ -831,6 +1566,18 @@ ndicapiExport void ndiTimeoutSocket(ndicapi* pol, int timeoutMsec);
   This function uses the PVWR command to write the SROM.  The total size
   of the virtual SROM is 1024 bytes.  If the file is shorter than this,
   then zeros will be written to the remaining space in the SROM.
+
+  The ROMs that are written are remembered in the file "sroms" in the
+  cache directory (see ndiNegotiateBaudRate()), by the device's serial
+  number and the port handle, together with the tool identity that
+  PHINF reports afterwards.  If the same ROM was written to the same
+  port before, and PHINF still reports the same tool type, manufacturer,
+  revision, serial number and part number, then the ROM is already in
+  place and is not written again.  This costs a "VER:0" the first time
+  and a "PHINF:" each time, instead of 16 "PVWR:" commands.  Since
+  "INIT:" clears the ROMs, sending it forgets the device's entries, so
+  a ROM that was written by another process is only kept if this
+  process has not sent "INIT:".
 */
 ndicapiExport int ndiPVWRFromFile(ndicapi* pol, int ph, char* filename);
 /*\}*/
@@ -1255,6 +2002,48 @@ ndicapiExport int ndiGetTXNumberOfPassiveStrays(ndicapi* pol);
 */
 ndicapiExport int ndiGetTXPassiveStray(ndicapi* pol, int i, double coord[3]);
 
+/*! \ingroup GetMethods
+  Get the coordinates of all the passive stray markers at once.  This
+  is faster than calling ndiGetTXPassiveStray() for each marker, since
+  all the coordinates are decoded together.
+
+  \param pol       valid NDI device handle
+  \param coords    array to hold the coordinates
+  \param maxCount  the size of the coords array
+  \return          the number of markers that were returned in coords
+
+  <p>The passive stray marker coordinates are updated when a TX command
+  is sent with the NDI_PASSIVE_STRAY (0x1000) bit set in the reply mode.
+*/
+ndicapiExport int ndiGetTXPassiveStrays(ndicapi* pol, double coords[][3], int maxCount);
+
+/*! \ingroup GetMethods
+  Get the number of port handles in the last TX reply.
+
+  \param pol       valid NDI device handle
+  \return          the number of handles, in the order of the reply
+*/
+ndicapiExport int ndiGetTXNumberOfHandles(ndicapi* pol);
+
+/*! \ingroup GetMethods
+  Get the handles and transformations of all the tools in the last TX
+  reply at once, in the order of the reply.  This needs no handle
+  lookups, so it is faster than calling ndiGetTXTransform() for each
+  handle.
+
+  \param pol         valid NDI device handle
+  \param handles     array to hold the port handles
+  \param status      array to hold NDI_OKAY, NDI_MISSING or NDI_DISABLED
+                     for each handle
+  \param transforms  array to hold the transformations
+  \param maxCount    the size of the arrays
+  \return            the number of handles that were returned
+
+  <p>The transformations of handles that are missing or disabled are
+  left unchanged, just like with ndiGetTXTransform().
+*/
+ndicapiExport int ndiGetTXTransforms(ndicapi* pol, int handles[], int status[], double transforms[][8], int maxCount);
+
 /*! \ingroup GetMethods
   Get an 16-bit status bitfield for the system.
 
@@ -1622,6 +2411,67 @@ called with the NDI_XFORMS_AND_STATUS (0x0001) bit set in the reply mode.
 */
 ndicapiExport int ndiGetBXSystemStatus(ndicapi* pol);
 
+/*! \ingroup GetMethods
+Copy everything from the last BX reply into one contiguous structure.
+
+\param pol       valid NDI device handle
+\param snapshot  structure to fill in
+
+\return one of:
+- NDI_OKAY - the snapshot was filled in
+- NDI_MISSING - no BX reply has been received yet
+
+<p>The tools are in the same order as in the BX reply, so no handle
+lookups are needed.  Fields for reply options that were not requested
+hold whatever the last reply with those options contained, just like
+the individual ndiGetBXxx() methods.  The structure is plain data and
+can be copied with memcpy().
+*/
+ndicapiExport int ndiGetBXFrameSnapshot(ndicapi* pol, ndiBXSnapshot* snapshot);
+
+/*! \ingroup GetMethods
+  Get the number of port handles in the last BX reply.
+
+  \param pol       valid NDI device handle
+  \return          the number of handles, in the order of the reply
+*/
+ndicapiExport int ndiGetBXNumberOfHandles(ndicapi* pol);
+
+/*! \ingroup GetMethods
+  Get the handles and transformations of all the tools in the last BX
+  reply at once, in the order of the reply.
+
+  \param pol         valid NDI device handle
+  \param handles     array to hold the port handles
+  \param status      array to hold NDI_OKAY, NDI_MISSING or NDI_DISABLED
+                     for each handle
+  \param transforms  array to hold the transformations
+  \param maxCount    the size of the arrays
+  \return            the number of handles that were returned
+
+  <p>The transformations of handles that are missing or disabled are
+  left unchanged.
+*/
+ndicapiExport int ndiGetBXTransforms(ndicapi* pol, int handles[], int status[], float transforms[][8], int maxCount);
+
+/*! \ingroup GetMethods
+  Get the 3D marker positions of all the tools in the last BX reply
+  that was sent with NDI_3D_MARKER_POSITIONS, in the order of the reply.
+  The markers of tool i go to markers[i*markersPerHandle] onwards.
+
+  \param pol               valid NDI device handle
+  \param counts            array to hold the number of markers of each tool
+  \param markers           array to hold the marker positions, or NULL
+  \param markersPerHandle  the number of markers of each tool that fit in markers
+  \param maxCount          the size of the counts array
+  \return                  the number of handles that were returned
+
+  <p>The counts are not limited by markersPerHandle, so calling this
+  method with markersPerHandle set to zero gives the size that the
+  markers array needs for all the markers.
+*/
+ndicapiExport int ndiGetBXMarkerPositions(ndicapi* pol, int counts[], float markers[][3], int markersPerHandle, int maxCount);
+
 /*! \ingroup GetMethods
   Get the 8-bit status value for the specified port.
 
@@ -0,0 +1,721 @@
+/*=======================================================================
+
+Copyright (c) 2000-2005 Atamai, Inc.
+
+Use, modification and redistribution of the software, in source or
+binary forms, are permitted provided that the following terms and
+conditions are met:
+
+1) Redistribution of the source code, in verbatim or modified
+   form, must retain the above copyright notice, this license,
+   the following disclaimer, and any notices that refer to this
+   license and/or the following disclaimer.
+
+2) Redistribution in binary form must include the above copyright
+   notice, a copy of this license and the following disclaimer
+   in the documentation or with other materials provided with the
+   distribution.
+
+3) Modified copies of the source code must be clearly marked as such,
+   and must not be misrepresented as verbatim copies of the source code.
+
+THE COPYRIGHT HOLDERS AND/OR OTHER PARTIES PROVIDE THE SOFTWARE "AS IS"
+WITHOUT EXPRESSED OR IMPLIED WARRANTY INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE.  IN NO EVENT SHALL ANY COPYRIGHT HOLDER OR OTHER PARTY WHO MAY
+MODIFY AND/OR REDISTRIBUTE THE SOFTWARE UNDER THE TERMS OF THIS LICENSE
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, LOSS OF DATA OR DATA BECOMING INACCURATE
+OR LOSS OF PROFIT OR BUSINESS INTERRUPTION) ARISING IN ANY WAY OUT OF
+THE USE OR INABILITY TO USE THE SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGES.
+
+=======================================================================*/
+
+#include "ndicapi_capture.h"
+#include "ndicapi_thread.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// the first 8 bytes of every capture file
+#define NDI_CAPTURE_MAGIC "NDICAP01"
+
+// reads back as this value only on a host with the writer's byte order
+#define NDI_CAPTURE_BYTE_ORDER 0x01020304
+
+// the file grows by doubling, but by no more than this at a time
+#define NDI_CAPTURE_MIN_SIZE 0x100000
+#define NDI_CAPTURE_MAX_GROWTH 0x4000000
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // The file header, which is rewritten after every record.
+  struct ndiCaptureFileHeader
+  {
+    char Magic[8];                        // NDI_CAPTURE_MAGIC
+    unsigned int HeaderSize;              // offset of the first record
+    unsigned int ByteOrder;               // NDI_CAPTURE_BYTE_ORDER, or zero in old files
+    unsigned long long DataEnd;           // offset just past the last record
+    unsigned long long NumberOfRecords;   // number of records
+    unsigned long long IndexOffset;       // offset of the index, or zero
+    unsigned long long Reserved[3];
+  };
+
+  //----------------------------------------------------------------------------
+  // The header of each record, the data follows it.
+  struct ndiCaptureRecordHeader
+  {
+    unsigned long long Timestamp;         // ndiTimeNanoseconds()
+    unsigned int Length;                  // number of data bytes
+    unsigned short Direction;             // NDI_CAPTURE_COMMAND or NDI_CAPTURE_REPLY
+    unsigned short Reserved;
+  };
+
+  //----------------------------------------------------------------------------
+  // A file that is mapped into memory.
+  struct ndiMappedFile
+  {
+#if defined(_WIN32)
+    HANDLE File;
+    HANDLE Mapping;
+#else
+    int File;
+#endif
+    char* Data;
+    size_t Size;
+  };
+
+  //----------------------------------------------------------------------------
+  // Unmap the file, without closing it.
+  void ndiMappedFileUnmap(ndiMappedFile* file)
+  {
+    if (file->Data)
+    {
+#if defined(_WIN32)
+      UnmapViewOfFile(file->Data);
+      CloseHandle(file->Mapping);
+      file->Mapping = NULL;
+#else
+      munmap(file->Data, file->Size);
+#endif
+      file->Data = NULL;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Map the file with the given size, the file is extended if necessary.
+  bool ndiMappedFileMap(ndiMappedFile* file, size_t size, bool writable)
+  {
+#if defined(_WIN32)
+    file->Mapping = CreateFileMapping(file->File, NULL, (writable ? PAGE_READWRITE : PAGE_READONLY),
+                                      (DWORD)((unsigned long long)size >> 32), (DWORD)size, NULL);
+    if (file->Mapping == NULL)
+    {
+      return false;
+    }
+    file->Data = (char*)MapViewOfFile(file->Mapping, (writable ? FILE_MAP_WRITE : FILE_MAP_READ), 0, 0, size);
+    if (file->Data == NULL)
+    {
+      CloseHandle(file->Mapping);
+      file->Mapping = NULL;
+      return false;
+    }
+#else
+    if (writable && ftruncate(file->File, (off_t)size) != 0)
+    {
+      return false;
+    }
+    void* data = mmap(NULL, size, (writable ? PROT_READ | PROT_WRITE : PROT_READ), MAP_SHARED, file->File, 0);
+    if (data == MAP_FAILED)
+    {
+      return false;
+    }
+    file->Data = (char*)data;
+#endif
+    file->Size = size;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Open a file and map all of it, or create a new file of the given size.
+  bool ndiMappedFileOpen(ndiMappedFile* file, const char* filename, bool create, size_t size)
+  {
+    file->Data = NULL;
+    file->Size = 0;
+#if defined(_WIN32)
+    file->Mapping = NULL;
+    if (create)
+    {
+      file->File = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                               CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    }
+    else
+    {
+      file->File = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    }
+    if (file->File == INVALID_HANDLE_VALUE)
+    {
+      return false;
+    }
+    if (!create)
+    {
+      LARGE_INTEGER fileSize;
+      if (!GetFileSizeEx(file->File, &fileSize))
+      {
+        CloseHandle(file->File);
+        return false;
+      }
+      size = (size_t)fileSize.QuadPart;
+    }
+#else
+    if (create)
+    {
+      file->File = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    }
+    else
+    {
+      file->File = open(filename, O_RDONLY);
+    }
+    if (file->File < 0)
+    {
+      return false;
+    }
+    if (!create)
+    {
+      struct stat info;
+      if (fstat(file->File, &info) != 0)
+      {
+        close(file->File);
+        return false;
+      }
+      size = (size_t)info.st_size;
+    }
+#endif
+
+    if (size == 0 || !ndiMappedFileMap(file, size, create))
+    {
+#if defined(_WIN32)
+      CloseHandle(file->File);
+#else
+      close(file->File);
+#endif
+      return false;
+    }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Unmap and close the file.  If the file was writable, it is truncated
+  // to the given size.
+  void ndiMappedFileClose(ndiMappedFile* file, bool writable, size_t size)
+  {
+    ndiMappedFileUnmap(file);
+#if defined(_WIN32)
+    if (writable)
+    {
+      LARGE_INTEGER position;
+      position.QuadPart = (LONGLONG)size;
+      SetFilePointerEx(file->File, position, NULL, FILE_BEGIN);
+      SetEndOfFile(file->File);
+    }
+    CloseHandle(file->File);
+#else
+    if (writable)
+    {
+      if (ftruncate(file->File, (off_t)size) != 0)
+      {
+        // the file is still readable, it just has unused space at the end
+      }
+    }
+    close(file->File);
+#endif
+  }
+}
+
+//----------------------------------------------------------------------------
+// A capture file that is being written.
+struct ndiCapture
+{
+  ndiMappedFile File;
+  NDIMutex Mutex;                         // serializes the writers
+  unsigned long long DataEnd;             // offset just past the last record
+  std::vector<unsigned long long> Index;  // offsets of the records
+};
+
+//----------------------------------------------------------------------------
+ndicapiExport ndiCapture* ndiCaptureCreate(const char* filename)
+{
+  ndiCapture* capture = new ndiCapture;
+  if (!ndiMappedFileOpen(&capture->File, filename, true, NDI_CAPTURE_MIN_SIZE))
+  {
+    delete capture;
+    return NULL;
+  }
+
+  ndiCaptureFileHeader* header = (ndiCaptureFileHeader*)capture->File.Data;
+  memset(header, 0, sizeof(ndiCaptureFileHeader));
+  memcpy(header->Magic, NDI_CAPTURE_MAGIC, 8);
+  header->HeaderSize = sizeof(ndiCaptureFileHeader);
+  header->ByteOrder = NDI_CAPTURE_BYTE_ORDER;
+  header->DataEnd = sizeof(ndiCaptureFileHeader);
+
+  capture->DataEnd = sizeof(ndiCaptureFileHeader);
+  capture->Mutex = ndiMutexCreate();
+
+  return capture;
+}
+
+//----------------------------------------------------------------------------
+// Make room for at least 'size' bytes, the mutex must be held.
+static bool ndiCaptureReserve(ndiCapture* capture, unsigned long long size)
+{
+  if (size <= capture->File.Size)
+  {
+    return true;
+  }
+
+  size_t newSize = capture->File.Size;
+  while (newSize < size)
+  {
+    newSize += (newSize < NDI_CAPTURE_MAX_GROWTH ? newSize : NDI_CAPTURE_MAX_GROWTH);
+  }
+
+  size_t oldSize = capture->File.Size;
+  ndiMappedFileUnmap(&capture->File);
+  if (!ndiMappedFileMap(&capture->File, newSize, true))
+  {
+    // keep the old mapping so that the records so far are not lost
+    ndiMappedFileMap(&capture->File, oldSize, true);
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiCaptureWrite(ndiCapture* capture, int direction, unsigned long long timestamp,
+                                  const char* data, int n)
+{
+  if (capture == NULL || n < 0)
+  {
+    return 0;
+  }
+
+  unsigned long long recordSize = sizeof(ndiCaptureRecordHeader) + ((n + 7) & ~7);
+
+  ndiMutexLock(capture->Mutex);
+  if (capture->File.Data == NULL || !ndiCaptureReserve(capture, capture->DataEnd + recordSize))
+  {
+    ndiMutexUnlock(capture->Mutex);
+    return -1;
+  }
+
+  char* cp = capture->File.Data + capture->DataEnd;
+  ndiCaptureRecordHeader* record = (ndiCaptureRecordHeader*)cp;
+  record->Timestamp = timestamp;
+  record->Length = (unsigned int)n;
+  record->Direction = (unsigned short)direction;
+  record->Reserved = 0;
+  cp += sizeof(ndiCaptureRecordHeader);
+  memcpy(cp, data, n);
+  memset(cp + n, 0, (size_t)(recordSize - sizeof(ndiCaptureRecordHeader) - n));
+
+  capture->Index.push_back(capture->DataEnd);
+  capture->DataEnd += recordSize;
+
+  // the record is complete, so it can be added to the header
+  ndiCaptureFileHeader* header = (ndiCaptureFileHeader*)capture->File.Data;
+  header->DataEnd = capture->DataEnd;
+  header->NumberOfRecords = capture->Index.size();
+  ndiMutexUnlock(capture->Mutex);
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiCaptureDestroy(ndiCapture* capture)
+{
+  if (capture == NULL)
+  {
+    return;
+  }
+
+  unsigned long long size = capture->DataEnd;
+  if (capture->File.Data != NULL)
+  {
+    // append the index, so that readers do not have to scan the records
+    unsigned long long indexSize = capture->Index.size() * sizeof(unsigned long long);
+    if (indexSize > 0 && ndiCaptureReserve(capture, size + indexSize))
+    {
+      memcpy(capture->File.Data + size, &capture->Index[0], indexSize);
+      ndiCaptureFileHeader* header = (ndiCaptureFileHeader*)capture->File.Data;
+      header->IndexOffset = size;
+      size += indexSize;
+    }
+  }
+  ndiMappedFileClose(&capture->File, true, (size_t)size);
+
+  ndiMutexDestroy(capture->Mutex);
+  delete capture;
+}
+
+//----------------------------------------------------------------------------
+// A capture file that is open for reading.
+struct ndiCaptureReader
+{
+  ndiMappedFile File;
+  unsigned long long DataEnd;             // offset just past the last record
+  long long NumberOfRecords;
+  const unsigned long long* Index;        // offsets of the records
+  std::vector<unsigned long long> ScannedIndex; // for files without an index
+};
+
+//----------------------------------------------------------------------------
+ndicapiExport ndiCaptureReader* ndiCaptureOpen(const char* filename)
+{
+  ndiCaptureReader* reader = new ndiCaptureReader;
+  if (!ndiMappedFileOpen(&reader->File, filename, false, 0))
+  {
+    delete reader;
+    return NULL;
+  }
+
+  const ndiCaptureFileHeader* header = (const ndiCaptureFileHeader*)reader->File.Data;
+  size_t size = reader->File.Size;
+  if (size < sizeof(ndiCaptureFileHeader) || memcmp(header->Magic, NDI_CAPTURE_MAGIC, 8) != 0 ||
+      (header->ByteOrder != NDI_CAPTURE_BYTE_ORDER && header->ByteOrder != 0) ||
+      header->HeaderSize < sizeof(ndiCaptureFileHeader) || header->HeaderSize > size)
+  {
+    ndiMappedFileClose(&reader->File, false, 0);
+    delete reader;
+    return NULL;
+  }
+
+  reader->DataEnd = (header->DataEnd < size ? header->DataEnd : size);
+  reader->NumberOfRecords = 0;
+  reader->Index = NULL;
+
+  unsigned long long n = header->NumberOfRecords;
+  if (header->IndexOffset != 0 && header->IndexOffset == reader->DataEnd &&
+      (header->IndexOffset & 7) == 0 && n <= (size - header->IndexOffset) / sizeof(unsigned long long))
+  {
+    reader->Index = (const unsigned long long*)(reader->File.Data + header->IndexOffset);
+    reader->NumberOfRecords = (long long)n;
+  }
+  else
+  {
+    // the capture was not closed, so find the records that were completed
+    unsigned long long offset = header->HeaderSize;
+    while (offset + sizeof(ndiCaptureRecordHeader) <= reader->DataEnd)
+    {
+      const ndiCaptureRecordHeader* record = (const ndiCaptureRecordHeader*)(reader->File.Data + offset);
+      unsigned long long next = offset + sizeof(ndiCaptureRecordHeader) + ((record->Length + 7ULL) & ~7ULL);
+      if (next > reader->DataEnd)
+      {
+        break;
+      }
+      reader->ScannedIndex.push_back(offset);
+      offset = next;
+    }
+    reader->NumberOfRecords = (long long)reader->ScannedIndex.size();
+    if (reader->NumberOfRecords > 0)
+    {
+      reader->Index = &reader->ScannedIndex[0];
+    }
+  }
+
+  return reader;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiCaptureClose(ndiCaptureReader* reader)
+{
+  if (reader)
+  {
+    ndiMappedFileClose(&reader->File, false, 0);
+    delete reader;
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport long long ndiCaptureGetNumberOfRecords(ndiCaptureReader* reader)
+{
+  return reader->NumberOfRecords;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiCaptureGetRecord(ndiCaptureReader* reader, long long i, ndiCaptureRecord* record)
+{
+  if (i < 0 || i >= reader->NumberOfRecords)
+  {
+    return -1;
+  }
+
+  // an index from the file might not be trustworthy
+  unsigned long long offset = reader->Index[i];
+  if (offset > reader->DataEnd || reader->DataEnd - offset < sizeof(ndiCaptureRecordHeader))
+  {
+    return -1;
+  }
+  const ndiCaptureRecordHeader* header = (const ndiCaptureRecordHeader*)(reader->File.Data + offset);
+  if (header->Length > reader->DataEnd - offset - sizeof(ndiCaptureRecordHeader))
+  {
+    return -1;
+  }
+
+  record->Timestamp = header->Timestamp;
+  record->Direction = header->Direction;
+  record->Length = (int)header->Length;
+  record->Data = reader->File.Data + offset + sizeof(ndiCaptureRecordHeader);
+
+  return 0;
+}
+
+#if defined(_WIN32)
+
+//----------------------------------------------------------------------------
+ndicapiExport ndiReplay* ndiReplayCreate(const char* filename, double speed, NDISocketHandle* socket)
+{
+  // replay needs a connected pair of sockets, which Windows does not provide
+  return NULL;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiReplayDestroy(ndiReplay* replay)
+{
+}
+
+#else
+
+//----------------------------------------------------------------------------
+// A capture that is being replayed by a thread.
+struct ndiReplay
+{
+  ndiCaptureReader* Reader;
+  double Speed;                           // zero for as fast as possible
+  int Socket;                             // the device end of the socket pair
+  NDIThread Thread;
+  std::atomic<bool> IsStopping;
+  std::string Pending;                    // received text after the last command
+};
+
+//----------------------------------------------------------------------------
+// Wait until the host has sent a complete command.  Returns false if the
+// replay is stopped or the host closed the connection.
+static bool ndiReplayReadCommand(ndiReplay* replay)
+{
+  for (;;)
+  {
+    size_t end = replay->Pending.find('\r');
+    if (end != std::string::npos)
+    {
+      replay->Pending.erase(0, end + 1);
+      return true;
+    }
+    if (replay->IsStopping)
+    {
+      return false;
+    }
+
+    struct pollfd pfd;
+    pfd.fd = replay->Socket;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, 50) <= 0)
+    {
+      continue;
+    }
+
+    char buffer[2048];
+    ssize_t m = recv(replay->Socket, buffer, sizeof(buffer), 0);
+    if (m <= 0)
+    {
+      return false;
+    }
+    replay->Pending.append(buffer, m);
+  }
+}
+
+//----------------------------------------------------------------------------
+// Sleep until the given time.  Returns false if the replay is stopped.
+static bool ndiReplaySleepUntil(ndiReplay* replay, unsigned long long due)
+{
+  for (;;)
+  {
+    if (replay->IsStopping)
+    {
+      return false;
+    }
+    unsigned long long now = ndiTimeNanoseconds();
+    if (now >= due)
+    {
+      return true;
+    }
+    // a sleep can oversleep by tens of microseconds, so yield instead
+    // for the last part, and wake up now and then to check whether the
+    // replay has been stopped
+    unsigned long long delay = due - now;
+    if (delay < 100000)
+    {
+      sched_yield();
+      continue;
+    }
+    delay -= 50000;
+    if (delay > 10000000)
+    {
+      delay = 10000000;
+    }
+    struct timespec ts;
+    ts.tv_sec = 0;
+    ts.tv_nsec = (long)delay;
+    nanosleep(&ts, NULL);
+  }
+}
+
+//----------------------------------------------------------------------------
+// The replay thread.
+//
+// The replay follows the capture in order.  For a command, it waits for
+// the host to send a command.  For a reply, it waits until the time since
+// the last command matches the capture, and then sends the reply.  The
+// replies of a streaming session follow each other without commands, so
+// they are timed relative to the STREAM command.
+static void* ndiReplayFunc(void* userdata)
+{
+  ndiReplay* replay = (ndiReplay*)userdata;
+  long long n = ndiCaptureGetNumberOfRecords(replay->Reader);
+  unsigned long long anchorTime = ndiTimeNanoseconds();
+  unsigned long long anchorRecordTime = 0;
+  ndiCaptureRecord record;
+
+  for (long long i = 0; i < n; i++)
+  {
+    if (ndiCaptureGetRecord(replay->Reader, i, &record) != 0)
+    {
+      break;
+    }
+    if (i == 0)
+    {
+      anchorRecordTime = record.Timestamp;
+    }
+
+    if (record.Direction == NDI_CAPTURE_COMMAND)
+    {
+      if (!ndiReplayReadCommand(replay))
+      {
+        break;
+      }
+      anchorTime = ndiTimeNanoseconds();
+      anchorRecordTime = record.Timestamp;
+      continue;
+    }
+
+    if (replay->Speed > 0 && record.Timestamp > anchorRecordTime)
+    {
+      unsigned long long delay = (unsigned long long)((record.Timestamp - anchorRecordTime) / replay->Speed);
+      if (!ndiReplaySleepUntil(replay, anchorTime + delay))
+      {
+        break;
+      }
+    }
+
+    int total = 0;
+    while (total < record.Length)
+    {
+      ssize_t m = send(replay->Socket, record.Data + total, record.Length - total, MSG_NOSIGNAL);
+      if (m <= 0)
+      {
+        break;
+      }
+      total += (int)m;
+    }
+    if (total < record.Length)
+    {
+      break;
+    }
+  }
+
+  // the host sees the end of the capture as a closed connection
+  shutdown(replay->Socket, SHUT_RDWR);
+
+  return NULL;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport ndiReplay* ndiReplayCreate(const char* filename, double speed, NDISocketHandle* socket)
+{
+  ndiCaptureReader* reader = ndiCaptureOpen(filename);
+  if (reader == NULL)
+  {
+    return NULL;
+  }
+
+  int sockets[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0)
+  {
+    ndiCaptureClose(reader);
+    return NULL;
+  }
+
+  // the host end is non-blocking like a network socket, so that the host
+  // times out with poll() if it sends commands that are not in the capture,
+  // and can drain the socket without waiting
+  int flags = fcntl(sockets[0], F_GETFL, 0);
+  if (flags == -1 || fcntl(sockets[0], F_SETFL, flags | O_NONBLOCK) != 0)
+  {
+    close(sockets[0]);
+    close(sockets[1]);
+    ndiCaptureClose(reader);
+    return NULL;
+  }
+
+  ndiReplay* replay = new ndiReplay;
+  replay->Reader = reader;
+  replay->Speed = (speed > 0 ? speed : 0.0);
+  replay->Socket = sockets[1];
+  replay->IsStopping = false;
+  replay->Thread = ndiThreadSplit(ndiReplayFunc, replay);
+
+  *socket = sockets[0];
+  return replay;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiReplayDestroy(ndiReplay* replay)
+{
+  if (replay == NULL)
+  {
+    return;
+  }
+
+  replay->IsStopping = true;
+  ndiThreadJoin(replay->Thread);
+  close(replay->Socket);
+  ndiCaptureClose(replay->Reader);
+  delete replay;
+}
+
+#endif
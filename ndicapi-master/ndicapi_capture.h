@@ -0,0 +1,166 @@
+/*=======================================================================
+
+Copyright (c) 2000-2005 Atamai, Inc.
+
+Use, modification and redistribution of the software, in source or
+binary forms, are permitted provided that the following terms and
+conditions are met:
+
+1) Redistribution of the source code, in verbatim or modified
+   form, must retain the above copyright notice, this license,
+   the following disclaimer, and any notices that refer to this
+   license and/or the following disclaimer.
+
+2) Redistribution in binary form must include the above copyright
+   notice, a copy of this license and the following disclaimer
+   in the documentation or with other materials provided with the
+   distribution.
+
+3) Modified copies of the source code must be clearly marked as such,
+   and must not be misrepresented as verbatim copies of the source code.
+
+THE COPYRIGHT HOLDERS AND/OR OTHER PARTIES PROVIDE THE SOFTWARE "AS IS"
+WITHOUT EXPRESSED OR IMPLIED WARRANTY INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE.  IN NO EVENT SHALL ANY COPYRIGHT HOLDER OR OTHER PARTY WHO MAY
+MODIFY AND/OR REDISTRIBUTE THE SOFTWARE UNDER THE TERMS OF THIS LICENSE
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, LOSS OF DATA OR DATA BECOMING INACCURATE
+OR LOSS OF PROFIT OR BUSINESS INTERRUPTION) ARISING IN ANY WAY OUT OF
+THE USE OR INABILITY TO USE THE SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGES.
+
+=======================================================================*/
+
+/*! \file ndicapi_capture.h
+  This file contains the methods for recording the traffic between
+  ndicapi and a device to a capture file, for reading capture files,
+  and for replaying them as if they came from a device.
+*/
+
+#ifndef NDICAPI_CAPTURE_H
+#define NDICAPI_CAPTURE_H
+
+#include "ndicapiExport.h"
+#include "ndicapi_socket.h"
+
+/*=====================================================================*/
+/*! \defgroup NDICapture NDI Capture Methods
+  These are low-level methods for capture files.  A capture file holds
+  every command that was sent to a device and every reply that was
+  received from it, each with a timestamp from ndiTimeNanoseconds().
+  Use ndiStartCapture() to record the traffic of an open device, and
+  open "capture:<file>" with ndiOpenSerial() or ndiOpenNetwork() to
+  replay it.
+
+  The file starts with a 64-byte header, which is followed by the
+  records, and then by an index of record offsets that is written when
+  the capture is closed.  Each record is a 16-byte header (timestamp,
+  length, direction) followed by the bytes, padded to a multiple of 8.
+  The values are stored in the byte order of the host that wrote the
+  file, so that the records can be read in place, and the header holds a
+  byte-order marker.  A file from a host with the other byte order is
+  rejected by ndiCaptureOpen().  The header is updated after every
+  record, so a capture that was not closed properly (e.g. because the
+  application crashed) can still be read, only the index is missing.
+*/
+
+// the direction of a record
+#define NDI_CAPTURE_COMMAND  0   // sent from the host to the device
+#define NDI_CAPTURE_REPLY    1   // sent from the device to the host
+
+/*! \ingroup NDICapture
+  A record in a capture file.  The data points into the file, which is
+  memory-mapped, so it is valid until the capture is closed.
+*/
+typedef struct ndiCaptureRecord
+{
+  unsigned long long Timestamp;           // ndiTimeNanoseconds() when sent or received
+  int Direction;                          // NDI_CAPTURE_COMMAND or NDI_CAPTURE_REPLY
+  int Length;                             // number of bytes
+  const char* Data;                       // the bytes, not null-terminated
+} ndiCaptureRecord;
+
+typedef struct ndiCapture ndiCapture;
+typedef struct ndiCaptureReader ndiCaptureReader;
+typedef struct ndiReplay ndiReplay;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! \ingroup NDICapture
+  Create a new capture file for writing, an existing file is replaced.
+  Returns NULL if the file could not be created.
+*/
+ndicapiExport ndiCapture* ndiCaptureCreate(const char* filename);
+
+/*! \ingroup NDICapture
+  Append a record to a capture file.  This can be called from any
+  thread.  Nothing is done if the capture is NULL.  Returns zero, or
+  -1 if the file could not be extended.
+*/
+ndicapiExport int ndiCaptureWrite(ndiCapture* capture, int direction, unsigned long long timestamp,
+                                  const char* data, int n);
+
+/*! \ingroup NDICapture
+  Write the index, close the capture file and free the capture.
+*/
+ndicapiExport void ndiCaptureDestroy(ndiCapture* capture);
+
+/*! \ingroup NDICapture
+  Open a capture file for reading.  The file is mapped into memory, so
+  even a large capture opens instantly.  If the file has no index, the
+  records are scanned to build one.  Returns NULL on failure.
+*/
+ndicapiExport ndiCaptureReader* ndiCaptureOpen(const char* filename);
+
+/*! \ingroup NDICapture
+  Close a capture file that was opened with ndiCaptureOpen().
+*/
+ndicapiExport void ndiCaptureClose(ndiCaptureReader* reader);
+
+/*! \ingroup NDICapture
+  Get the number of records in a capture file.
+*/
+ndicapiExport long long ndiCaptureGetNumberOfRecords(ndiCaptureReader* reader);
+
+/*! \ingroup NDICapture
+  Get a record from a capture file without copying its data.
+  Returns zero, or -1 if the index is out of range.
+*/
+ndicapiExport int ndiCaptureGetRecord(ndiCaptureReader* reader, long long i, ndiCaptureRecord* record);
+
+/*! \ingroup NDICapture
+  Start replaying a capture file.  The replay acts as the device: it
+  waits for the host to send each recorded command, and then sends the
+  replies that were recorded after it.  A reply is delayed until the
+  same time has passed since the command as in the recording, divided
+  by 'speed', or it is sent immediately if 'speed' is zero.
+
+  \param filename  the capture file
+  \param speed     the replay speed, 1.0 for the original speed
+  \param socket    the host end of the connection to the replay, which is
+                   non-blocking and should be given to ndiSocketAttach()
+
+  \return the replay, or NULL on failure (always on Windows, where
+          there is no socketpair())
+
+  The host should send the same commands as the application that made
+  the recording.  The connection is closed once the replay has sent the
+  last record.  ndiOpenSerial() and ndiOpenNetwork() call this for
+  device names of the form "capture:<file>" or "capture:<file>?speed=<x>".
+*/
+ndicapiExport ndiReplay* ndiReplayCreate(const char* filename, double speed, NDISocketHandle* socket);
+
+/*! \ingroup NDICapture
+  Stop a replay and free it.  The host end of the connection must be
+  closed by the caller.
+*/
+ndicapiExport void ndiReplayDestroy(ndiReplay* replay);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
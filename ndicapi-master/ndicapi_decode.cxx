@@ -0,0 +1,593 @@
+/*=======================================================================
+
+Copyright (c) 2000-2005 Atamai, Inc.
+
+Use, modification and redistribution of the software, in source or
+binary forms, are permitted provided that the following terms and
+conditions are met:
+
+1) Redistribution of the source code, in verbatim or modified
+   form, must retain the above copyright notice, this license,
+   the following disclaimer, and any notices that refer to this
+   license and/or the following disclaimer.
+
+2) Redistribution in binary form must include the above copyright
+   notice, a copy of this license and the following disclaimer
+   in the documentation or with other materials provided with the
+   distribution.
+
+3) Modified copies of the source code must be clearly marked as such,
+   and must not be misrepresented as verbatim copies of the source code.
+
+THE COPYRIGHT HOLDERS AND/OR OTHER PARTIES PROVIDE THE SOFTWARE "AS IS"
+WITHOUT EXPRESSED OR IMPLIED WARRANTY INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE.  IN NO EVENT SHALL ANY COPYRIGHT HOLDER OR OTHER PARTY WHO MAY
+MODIFY AND/OR REDISTRIBUTE THE SOFTWARE UNDER THE TERMS OF THIS LICENSE
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, LOSS OF DATA OR DATA BECOMING INACCURATE
+OR LOSS OF PROFIT OR BUSINESS INTERRUPTION) ARISING IN ANY WAY OUT OF
+THE USE OR INABILITY TO USE THE SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGES.
+
+=======================================================================*/
+
+#include "ndicapi_decode.h"
+#include "ndicapi.h"
+
+#include <atomic>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define NDI_DECODE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define NDI_TARGET_SSSE3
+#define NDI_TARGET_AVX2
+#else
+#define NDI_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define NDI_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define NDI_DECODE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // The shuffles for decoding two signed fields from 16 characters.  The
+  // digits of each field are moved to the end of an 8-byte lane, so that
+  // every field is decoded as an 8-digit number with leading zeros.
+  struct ndiFieldPairMask
+  {
+    alignas(16) unsigned char Digits[16]; // the source of each digit, or 0x80
+    alignas(16) unsigned char Zeros[16];  // '0' where there is a digit
+    alignas(16) unsigned char Signs[16];  // the source of each sign, in 32-bit lanes
+  };
+
+  //----------------------------------------------------------------------------
+  struct ndiDecodeTables
+  {
+    ndiFieldPairMask Pairs[9];            // two consecutive fields of width 2 to 8
+    ndiFieldPairMask Transform[4];        // the transform, from ndiTransformOffset
+  };
+
+  // the start of each 16-character piece of a 51-character transform
+  const int ndiTransformOffset[4] = { 0, 12, 24, 35 };
+
+  // the scale of each field of a transform
+  const double ndiTransformScale[8] = { 0.0001, 0.0001, 0.0001, 0.0001, 0.01, 0.01, 0.01, 0.0001 };
+
+  //----------------------------------------------------------------------------
+  void ndiSetFieldMask(ndiFieldPairMask* mask, int lane, int offset, int width)
+  {
+    int digits = width - 1;
+    for (int j = 0; j < digits; j++)
+    {
+      mask->Digits[8 * lane + 8 - digits + j] = (unsigned char)(offset + 1 + j);
+      mask->Zeros[8 * lane + 8 - digits + j] = '0';
+    }
+    mask->Signs[4 * lane] = (unsigned char)offset;
+  }
+
+  //----------------------------------------------------------------------------
+  void ndiMakeFieldPairMask(ndiFieldPairMask* mask, int offset0, int width0, int offset1, int width1)
+  {
+    memset(mask->Digits, 0x80, sizeof(mask->Digits));
+    memset(mask->Zeros, 0, sizeof(mask->Zeros));
+    memset(mask->Signs, 0x80, sizeof(mask->Signs));
+    ndiSetFieldMask(mask, 0, offset0, width0);
+    ndiSetFieldMask(mask, 1, offset1, width1);
+  }
+
+  //----------------------------------------------------------------------------
+  const ndiDecodeTables& ndiGetDecodeTables()
+  {
+    static const ndiDecodeTables* tables = []()
+    {
+      static ndiDecodeTables t;
+      for (int n = 2; n <= 8; n++)
+      {
+        ndiMakeFieldPairMask(&t.Pairs[n], 0, n, n, n);
+      }
+      ndiMakeFieldPairMask(&t.Transform[0], 0, 6, 6, 6);
+      ndiMakeFieldPairMask(&t.Transform[1], 0, 6, 6, 6);
+      ndiMakeFieldPairMask(&t.Transform[2], 0, 7, 7, 7);
+      ndiMakeFieldPairMask(&t.Transform[3], 3, 7, 10, 6);
+      return &t;
+    }();
+    return *tables;
+  }
+
+  //----------------------------------------------------------------------------
+  void ndiTransformToDoubleScalar(const char* cp, double transform[8])
+  {
+    transform[0] = ndiSignedToLong(&cp[0],  6) * 0.0001;
+    transform[1] = ndiSignedToLong(&cp[6],  6) * 0.0001;
+    transform[2] = ndiSignedToLong(&cp[12], 6) * 0.0001;
+    transform[3] = ndiSignedToLong(&cp[18], 6) * 0.0001;
+    transform[4] = ndiSignedToLong(&cp[24], 7) * 0.01;
+    transform[5] = ndiSignedToLong(&cp[31], 7) * 0.01;
+    transform[6] = ndiSignedToLong(&cp[38], 7) * 0.01;
+    transform[7] = ndiSignedToLong(&cp[45], 6) * 0.0001;
+  }
+
+  //----------------------------------------------------------------------------
+  // Decode the fields of a piece of a transform one at a time.
+  void ndiTransformPieceScalar(const char* cp, int piece, double* transform)
+  {
+    static const int fieldOffset[9] = { 0, 6, 12, 18, 24, 31, 38, 45, 51 };
+    for (int i = 2 * piece; i < 2 * piece + 2; i++)
+    {
+      transform[i] = ndiSignedToLong(&cp[fieldOffset[i]], fieldOffset[i + 1] - fieldOffset[i]) *
+                     ndiTransformScale[i];
+    }
+  }
+
+#if defined(NDI_DECODE_X86) || defined(NDI_DECODE_NEON)
+  //----------------------------------------------------------------------------
+  // Decode up to 8 hex characters with 64-bit integer operations, this is
+  // only used with the SIMD decoders because it assumes little-endian.
+  // Returns false if a character is not a hex digit.
+  inline bool ndiHexToUnsignedLongSWAR(const char* cp, int n, unsigned long* value)
+  {
+    const unsigned long long ones = 0x0101010101010101ULL;
+    const unsigned long long high = 0x8080808080808080ULL;
+    unsigned long long x = 0x3030303030303030ULL;
+    memcpy(reinterpret_cast<char*>(&x) + 8 - n, cp, n);
+
+    // find the bytes that are strictly between two values
+    unsigned long long low7 = x & (ones * 127);
+#define NDI_BYTES_BETWEEN(m, n) \
+  ((ones * (127 + (n)) - low7) & ~x & (low7 + ones * (127 - (m))) & high)
+    unsigned long long valid = NDI_BYTES_BETWEEN('0' - 1, '9' + 1) |
+                               NDI_BYTES_BETWEEN('A' - 1, 'F' + 1) |
+                               NDI_BYTES_BETWEEN('a' - 1, 'f' + 1);
+#undef NDI_BYTES_BETWEEN
+    if (valid != high)
+    {
+      return false;
+    }
+
+    // convert to nibbles, then combine them into bytes, shorts and ints
+    unsigned long long v = (x & (ones * 0x0F)) + ((x >> 6) & ones) * 9;
+    v = ((v << 4) | (v >> 8)) & 0x00FF00FF00FF00FFULL;
+    v = ((v << 8) | (v >> 16)) & 0x0000FFFF0000FFFFULL;
+    v = ((v << 16) | (v >> 32)) & 0xFFFFFFFFULL;
+    *value = (unsigned long)v;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  void ndiHexToUnsignedLongArraySWAR(const char* cp, int n, int count, unsigned long* values)
+  {
+    for (int i = 0; i < count; i++)
+    {
+      if (n < 1 || n > 8 || !ndiHexToUnsignedLongSWAR(&cp[i * n], n, &values[i]))
+      {
+        values[i] = ndiHexToUnsignedLong(&cp[i * n], n);
+      }
+    }
+  }
+#endif
+
+#if defined(NDI_DECODE_X86)
+  //----------------------------------------------------------------------------
+  // Decode two fields from 16 characters, the values are put in the first
+  // two 32-bit lanes.  Returns false if either field is not well-formed.
+  NDI_TARGET_SSSE3 inline bool ndiDecodePairSSSE3(const char* cp, const ndiFieldPairMask& mask, __m128i* values)
+  {
+    __m128i text = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cp));
+    __m128i digits = _mm_sub_epi8(_mm_shuffle_epi8(text, _mm_load_si128(reinterpret_cast<const __m128i*>(mask.Digits))),
+                                  _mm_load_si128(reinterpret_cast<const __m128i*>(mask.Zeros)));
+    __m128i signs = _mm_shuffle_epi8(text, _mm_load_si128(reinterpret_cast<const __m128i*>(mask.Signs)));
+    __m128i negative = _mm_cmpeq_epi32(signs, _mm_set1_epi32('-'));
+    __m128i positive = _mm_cmpeq_epi32(signs, _mm_set1_epi32('+'));
+
+    __m128i nine = _mm_set1_epi8(9);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(digits, nine), nine)) != 0xFFFF ||
+        (_mm_movemask_epi8(_mm_or_si128(negative, positive)) & 0xFF) != 0xFF)
+    {
+      return false;
+    }
+
+    // multiply-add the digits in pairs: 2 digits, 4 digits, 8 digits
+    __m128i v = _mm_maddubs_epi16(digits, _mm_set1_epi16(0x010A));
+    v = _mm_madd_epi16(v, _mm_set1_epi32(0x00010064));
+    v = _mm_packs_epi32(v, v);
+    v = _mm_madd_epi16(v, _mm_set1_epi32(0x00012710));
+    *values = _mm_sign_epi32(v, _mm_or_si128(negative, _mm_set1_epi32(1)));
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  NDI_TARGET_SSSE3 void ndiSignedToLongArraySSSE3(const char* cp, int n, int count, long* values)
+  {
+    int i = 0;
+    if (n >= 2 && n <= 8)
+    {
+      const ndiFieldPairMask& mask = ndiGetDecodeTables().Pairs[n];
+      for (; i + 1 < count && (i * n) + 16 <= count * n; i += 2)
+      {
+        __m128i v;
+        if (ndiDecodePairSSSE3(&cp[i * n], mask, &v))
+        {
+          values[i] = _mm_cvtsi128_si32(v);
+          values[i + 1] = _mm_cvtsi128_si32(_mm_srli_si128(v, 4));
+        }
+        else
+        {
+          values[i] = ndiSignedToLong(&cp[i * n], n);
+          values[i + 1] = ndiSignedToLong(&cp[(i + 1) * n], n);
+        }
+      }
+    }
+    for (; i < count; i++)
+    {
+      values[i] = ndiSignedToLong(&cp[i * n], n);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  NDI_TARGET_SSSE3 void ndiTransformToDoubleSSSE3(const char* cp, double transform[8])
+  {
+    const ndiDecodeTables& tables = ndiGetDecodeTables();
+    for (int piece = 0; piece < 4; piece++)
+    {
+      __m128i v;
+      if (ndiDecodePairSSSE3(&cp[ndiTransformOffset[piece]], tables.Transform[piece], &v))
+      {
+        _mm_storeu_pd(&transform[2 * piece],
+                      _mm_mul_pd(_mm_cvtepi32_pd(v), _mm_loadu_pd(&ndiTransformScale[2 * piece])));
+      }
+      else
+      {
+        ndiTransformPieceScalar(cp, piece, transform);
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Decode two fields from each of two 16-character pieces, the values are
+  // put in the first four 32-bit lanes.
+  NDI_TARGET_AVX2 inline bool ndiDecodePairsAVX2(const char* cp0, const ndiFieldPairMask& mask0,
+                                                 const char* cp1, const ndiFieldPairMask& mask1,
+                                                 __m128i* values)
+  {
+#define NDI_LOAD_PAIR(f, p0, p1) \
+  _mm256_inserti128_si256(_mm256_castsi128_si256(f(reinterpret_cast<const __m128i*>(p0))), \
+                          f(reinterpret_cast<const __m128i*>(p1)), 1)
+    __m256i text = NDI_LOAD_PAIR(_mm_loadu_si128, cp0, cp1);
+    __m256i digits = _mm256_sub_epi8(_mm256_shuffle_epi8(text, NDI_LOAD_PAIR(_mm_load_si128, mask0.Digits, mask1.Digits)),
+                                     NDI_LOAD_PAIR(_mm_load_si128, mask0.Zeros, mask1.Zeros));
+    __m256i signs = _mm256_shuffle_epi8(text, NDI_LOAD_PAIR(_mm_load_si128, mask0.Signs, mask1.Signs));
+#undef NDI_LOAD_PAIR
+    __m256i negative = _mm256_cmpeq_epi32(signs, _mm256_set1_epi32('-'));
+    __m256i positive = _mm256_cmpeq_epi32(signs, _mm256_set1_epi32('+'));
+
+    __m256i nine = _mm256_set1_epi8(9);
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(digits, nine), nine)) != -1 ||
+        (_mm256_movemask_epi8(_mm256_or_si256(negative, positive)) & 0x00FF00FF) != 0x00FF00FF)
+    {
+      return false;
+    }
+
+    __m256i v = _mm256_maddubs_epi16(digits, _mm256_set1_epi16(0x010A));
+    v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00010064));
+    v = _mm256_packs_epi32(v, v);
+    v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00012710));
+    v = _mm256_sign_epi32(v, _mm256_or_si256(negative, _mm256_set1_epi32(1)));
+    *values = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 4, 5, 0, 1, 4, 5)));
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  NDI_TARGET_AVX2 void ndiSignedToLongArrayAVX2(const char* cp, int n, int count, long* values)
+  {
+    int i = 0;
+    if (n >= 2 && n <= 8)
+    {
+      const ndiFieldPairMask& mask = ndiGetDecodeTables().Pairs[n];
+      for (; i + 3 < count && (i + 2) * n + 16 <= count * n; i += 4)
+      {
+        __m128i v;
+        if (ndiDecodePairsAVX2(&cp[i * n], mask, &cp[(i + 2) * n], mask, &v))
+        {
+          alignas(16) int fields[4];
+          _mm_store_si128(reinterpret_cast<__m128i*>(fields), v);
+          values[i] = fields[0];
+          values[i + 1] = fields[1];
+          values[i + 2] = fields[2];
+          values[i + 3] = fields[3];
+        }
+        else
+        {
+          for (int j = i; j < i + 4; j++)
+          {
+            values[j] = ndiSignedToLong(&cp[j * n], n);
+          }
+        }
+      }
+    }
+    if (i < count)
+    {
+      ndiSignedToLongArraySSSE3(&cp[i * n], n, count - i, &values[i]);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  NDI_TARGET_AVX2 void ndiTransformToDoubleAVX2(const char* cp, double transform[8])
+  {
+    const ndiDecodeTables& tables = ndiGetDecodeTables();
+    for (int half = 0; half < 2; half++)
+    {
+      __m128i v;
+      if (ndiDecodePairsAVX2(&cp[ndiTransformOffset[2 * half]], tables.Transform[2 * half],
+                             &cp[ndiTransformOffset[2 * half + 1]], tables.Transform[2 * half + 1], &v))
+      {
+        _mm256_storeu_pd(&transform[4 * half],
+                         _mm256_mul_pd(_mm256_cvtepi32_pd(v), _mm256_loadu_pd(&ndiTransformScale[4 * half])));
+      }
+      else
+      {
+        ndiTransformPieceScalar(cp, 2 * half, transform);
+        ndiTransformPieceScalar(cp, 2 * half + 1, transform);
+      }
+    }
+  }
+#endif
+
+#if defined(NDI_DECODE_NEON)
+  //----------------------------------------------------------------------------
+  // Decode two fields from 16 characters.  Returns false if either field
+  // is not well-formed.
+  inline bool ndiDecodePairNEON(const char* cp, const ndiFieldPairMask& mask, long values[2])
+  {
+    static const uint8_t weights10[16] = { 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1 };
+    static const uint16_t weights100[8] = { 100, 1, 100, 1, 100, 1, 100, 1 };
+    static const uint32_t weights10000[4] = { 10000, 1, 10000, 1 };
+
+    uint8x16_t text = vld1q_u8(reinterpret_cast<const uint8_t*>(cp));
+    uint8x16_t digits = vsubq_u8(vqtbl1q_u8(text, vld1q_u8(mask.Digits)), vld1q_u8(mask.Zeros));
+    int sign0 = cp[mask.Signs[0]];
+    int sign1 = cp[mask.Signs[4]];
+    if (vmaxvq_u8(digits) > 9 || (sign0 != '+' && sign0 != '-') || (sign1 != '+' && sign1 != '-'))
+    {
+      return false;
+    }
+
+    // multiply-add the digits in pairs: 2 digits, 4 digits, 8 digits
+    uint16x8_t v2 = vpaddlq_u8(vmulq_u8(digits, vld1q_u8(weights10)));
+    uint32x4_t v4 = vpaddlq_u16(vmulq_u16(v2, vld1q_u16(weights100)));
+    uint64x2_t v8 = vpaddlq_u32(vmulq_u32(v4, vld1q_u32(weights10000)));
+    long field0 = (long)vgetq_lane_u64(v8, 0);
+    long field1 = (long)vgetq_lane_u64(v8, 1);
+    values[0] = (sign0 == '-' ? -field0 : field0);
+    values[1] = (sign1 == '-' ? -field1 : field1);
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  void ndiSignedToLongArrayNEON(const char* cp, int n, int count, long* values)
+  {
+    int i = 0;
+    if (n >= 2 && n <= 8)
+    {
+      const ndiFieldPairMask& mask = ndiGetDecodeTables().Pairs[n];
+      for (; i + 1 < count && (i * n) + 16 <= count * n; i += 2)
+      {
+        if (!ndiDecodePairNEON(&cp[i * n], mask, &values[i]))
+        {
+          values[i] = ndiSignedToLong(&cp[i * n], n);
+          values[i + 1] = ndiSignedToLong(&cp[(i + 1) * n], n);
+        }
+      }
+    }
+    for (; i < count; i++)
+    {
+      values[i] = ndiSignedToLong(&cp[i * n], n);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void ndiTransformToDoubleNEON(const char* cp, double transform[8])
+  {
+    const ndiDecodeTables& tables = ndiGetDecodeTables();
+    for (int piece = 0; piece < 4; piece++)
+    {
+      long fields[2];
+      if (ndiDecodePairNEON(&cp[ndiTransformOffset[piece]], tables.Transform[piece], fields))
+      {
+        transform[2 * piece] = fields[0] * ndiTransformScale[2 * piece];
+        transform[2 * piece + 1] = fields[1] * ndiTransformScale[2 * piece + 1];
+      }
+      else
+      {
+        ndiTransformPieceScalar(cp, piece, transform);
+      }
+    }
+  }
+#endif
+
+  //----------------------------------------------------------------------------
+  // Find the best decoder that this CPU supports.
+  int ndiDetectDecoder()
+  {
+#if defined(NDI_DECODE_X86)
+    bool ssse3 = false;
+    bool avx2 = false;
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    ssse3 = ((info[2] & (1 << 9)) != 0);
+    // AVX2 also needs the OS to save the AVX registers
+    bool osAVX = ((info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6);
+    if (maxLeaf >= 7 && osAVX)
+    {
+      __cpuidex(info, 7, 0);
+      avx2 = ((info[1] & (1 << 5)) != 0);
+    }
+#else
+    __builtin_cpu_init();
+    ssse3 = (__builtin_cpu_supports("ssse3") != 0);
+    avx2 = (__builtin_cpu_supports("avx2") != 0);
+#endif
+    if (avx2 && ssse3)
+    {
+      return NDI_DECODER_AVX2;
+    }
+    else if (ssse3)
+    {
+      return NDI_DECODER_SSSE3;
+    }
+#elif defined(NDI_DECODE_NEON)
+    return NDI_DECODER_NEON;
+#endif
+    return NDI_DECODER_SCALAR;
+  }
+
+  //----------------------------------------------------------------------------
+  // The decoder in use, or -1 until the first call.
+  std::atomic<int> ndiCurrentDecoder(-1);
+
+  //----------------------------------------------------------------------------
+  inline int ndiDecoder()
+  {
+    int decoder = ndiCurrentDecoder.load(std::memory_order_relaxed);
+    if (decoder < 0)
+    {
+      decoder = ndiDetectDecoder();
+      ndiCurrentDecoder.store(decoder, std::memory_order_relaxed);
+    }
+    return decoder;
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiSignedToLongArray(const char* cp, int n, int count, long* values)
+{
+  switch (ndiDecoder())
+  {
+#if defined(NDI_DECODE_X86)
+    case NDI_DECODER_AVX2:
+      ndiSignedToLongArrayAVX2(cp, n, count, values);
+      return;
+    case NDI_DECODER_SSSE3:
+      ndiSignedToLongArraySSSE3(cp, n, count, values);
+      return;
+#elif defined(NDI_DECODE_NEON)
+    case NDI_DECODER_NEON:
+      ndiSignedToLongArrayNEON(cp, n, count, values);
+      return;
+#endif
+    default:
+      break;
+  }
+
+  for (int i = 0; i < count; i++)
+  {
+    values[i] = ndiSignedToLong(&cp[i * n], n);
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiHexToUnsignedLongArray(const char* cp, int n, int count, unsigned long* values)
+{
+#if defined(NDI_DECODE_X86) || defined(NDI_DECODE_NEON)
+  if (ndiDecoder() != NDI_DECODER_SCALAR)
+  {
+    ndiHexToUnsignedLongArraySWAR(cp, n, count, values);
+    return;
+  }
+#endif
+
+  for (int i = 0; i < count; i++)
+  {
+    values[i] = ndiHexToUnsignedLong(&cp[i * n], n);
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiTransformToDouble(const char* cp, double transform[8])
+{
+  switch (ndiDecoder())
+  {
+#if defined(NDI_DECODE_X86)
+    case NDI_DECODER_AVX2:
+      ndiTransformToDoubleAVX2(cp, transform);
+      return;
+    case NDI_DECODER_SSSE3:
+      ndiTransformToDoubleSSSE3(cp, transform);
+      return;
+#elif defined(NDI_DECODE_NEON)
+    case NDI_DECODER_NEON:
+      ndiTransformToDoubleNEON(cp, transform);
+      return;
+#endif
+    default:
+      break;
+  }
+
+  ndiTransformToDoubleScalar(cp, transform);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetDecoder()
+{
+  return ndiDecoder();
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiSetDecoder(int decoder)
+{
+  int best = ndiDetectDecoder();
+  bool supported = (decoder == NDI_DECODER_SCALAR || decoder == best ||
+                    (decoder == NDI_DECODER_SSSE3 && best == NDI_DECODER_AVX2));
+  if (!supported)
+  {
+    decoder = NDI_DECODER_SCALAR;
+  }
+  ndiCurrentDecoder.store(decoder, std::memory_order_relaxed);
+  return decoder;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport const char* ndiDecoderName(int decoder)
+{
+  switch (decoder)
+  {
+    case NDI_DECODER_SCALAR:
+      return "scalar";
+    case NDI_DECODER_SSSE3:
+      return "SSSE3";
+    case NDI_DECODER_AVX2:
+      return "AVX2";
+    case NDI_DECODER_NEON:
+      return "NEON";
+  }
+  return "unknown";
+}
@@ -0,0 +1,115 @@
+/*=======================================================================
+
+Copyright (c) 2000-2005 Atamai, Inc.
+
+Use, modification and redistribution of the software, in source or
+binary forms, are permitted provided that the following terms and
+conditions are met:
+
+1) Redistribution of the source code, in verbatim or modified
+   form, must retain the above copyright notice, this license,
+   the following disclaimer, and any notices that refer to this
+   license and/or the following disclaimer.
+
+2) Redistribution in binary form must include the above copyright
+   notice, a copy of this license and the following disclaimer
+   in the documentation or with other materials provided with the
+   distribution.
+
+3) Modified copies of the source code must be clearly marked as such,
+   and must not be misrepresented as verbatim copies of the source code.
+
+THE COPYRIGHT HOLDERS AND/OR OTHER PARTIES PROVIDE THE SOFTWARE "AS IS"
+WITHOUT EXPRESSED OR IMPLIED WARRANTY INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE.  IN NO EVENT SHALL ANY COPYRIGHT HOLDER OR OTHER PARTY WHO MAY
+MODIFY AND/OR REDISTRIBUTE THE SOFTWARE UNDER THE TERMS OF THIS LICENSE
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, LOSS OF DATA OR DATA BECOMING INACCURATE
+OR LOSS OF PROFIT OR BUSINESS INTERRUPTION) ARISING IN ANY WAY OUT OF
+THE USE OR INABILITY TO USE THE SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGES.
+
+=======================================================================*/
+
+/*! \file ndicapi_decode.h
+  This file contains vectorized methods for decoding the fixed-width
+  fields of the ASCII replies from the device.
+*/
+
+#ifndef NDICAPI_DECODE_H
+#define NDICAPI_DECODE_H
+
+#include "ndicapiExport.h"
+
+/*=====================================================================*/
+/*! \defgroup NDIDecode NDI Decode Methods
+  These methods decode many fixed-width reply fields at once.  They
+  give exactly the same results as calling ndiSignedToLong() or
+  ndiHexToUnsignedLong() on each field, including for fields that
+  are not well-formed, but they use SIMD instructions (SSSE3 or AVX2
+  on x86, NEON on ARM64) where the CPU has them.  The instruction set
+  is chosen at run time, the first time that a method is called.
+
+  Each method reads exactly the characters that it is asked to decode,
+  it never reads past the end of the last field.
+
+  The TX helper spends most of its time checking the CRC and copying
+  the reply text, so a vector decoder speeds up the parsing of a TX
+  reply by a quarter at most.  The larger gains are in the transforms
+  themselves, the GX helper and ndiGetTXPassiveStrays().
+*/
+
+// the decoders, from ndiGetDecoder()
+#define NDI_DECODER_SCALAR  0   // plain C++, one character at a time
+#define NDI_DECODER_SSSE3   1   // x86 with SSSE3
+#define NDI_DECODER_AVX2    2   // x86 with AVX2
+#define NDI_DECODER_NEON    3   // ARM64 with NEON
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! \ingroup NDIDecode
+  Decode \em count consecutive signed decimal fields, each \em n
+  characters wide, as ndiSignedToLong() would decode each of them.
+*/
+ndicapiExport void ndiSignedToLongArray(const char* cp, int n, int count, long* values);
+
+/*! \ingroup NDIDecode
+  Decode \em count consecutive hexadecimal fields, each \em n
+  characters wide, as ndiHexToUnsignedLong() would decode each of them.
+*/
+ndicapiExport void ndiHexToUnsignedLongArray(const char* cp, int n, int count, unsigned long* values);
+
+/*! \ingroup NDIDecode
+  Decode the 51 characters of a TX or GX transform: the quaternion
+  (four fields of 6 characters, scaled by 0.0001), the translation
+  (three fields of 7 characters, scaled by 0.01) and the error (6
+  characters, scaled by 0.0001).  The caller must check for "MISSING"
+  and "DISABLED" first.
+*/
+ndicapiExport void ndiTransformToDouble(const char* cp, double transform[8]);
+
+/*! \ingroup NDIDecode
+  Get the decoder that is used, e.g. NDI_DECODER_AVX2.
+*/
+ndicapiExport int ndiGetDecoder();
+
+/*! \ingroup NDIDecode
+  Choose the decoder, e.g. for benchmarking.  If the CPU does not
+  support it, NDI_DECODER_SCALAR is used instead.  Returns the decoder
+  that will be used.
+*/
+ndicapiExport int ndiSetDecoder(int decoder);
+
+/*! \ingroup NDIDecode
+  Get the name of a decoder, e.g. "AVX2".
+*/
+ndicapiExport const char* ndiDecoderName(int decoder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
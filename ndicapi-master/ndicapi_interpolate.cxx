@@ -0,0 +1,441 @@
+/*=======================================================================
+
+Copyright (c) 2000-2005 Atamai, Inc.
+
+Use, modification and redistribution of the software, in source or
+binary forms, are permitted provided that the following terms and
+conditions are met:
+
+1) Redistribution of the source code, in verbatim or modified
+   form, must retain the above copyright notice, this license,
+   the following disclaimer, and any notices that refer to this
+   license and/or the following disclaimer.
+
+2) Redistribution in binary form must include the above copyright
+   notice, a copy of this license and the following disclaimer
+   in the documentation or with other materials provided with the
+   distribution.
+
+3) Modified copies of the source code must be clearly marked as such,
+   and must not be misrepresented as verbatim copies of the source code.
+
+THE COPYRIGHT HOLDERS AND/OR OTHER PARTIES PROVIDE THE SOFTWARE "AS IS"
+WITHOUT EXPRESSED OR IMPLIED WARRANTY INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE.  IN NO EVENT SHALL ANY COPYRIGHT HOLDER OR OTHER PARTY WHO MAY
+MODIFY AND/OR REDISTRIBUTE THE SOFTWARE UNDER THE TERMS OF THIS LICENSE
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, LOSS OF DATA OR DATA BECOMING INACCURATE
+OR LOSS OF PROFIT OR BUSINESS INTERRUPTION) ARISING IN ANY WAY OUT OF
+THE USE OR INABILITY TO USE THE SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGES.
+
+=======================================================================*/
+
+#include "ndicapi_interpolate.h"
+#include "ndicapi_math.h"
+#include "ndicapi_thread.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//----------------------------------------------------------------------------
+// One measurement of one tool.
+struct ndiPoseSample
+{
+  unsigned long long Time;                // host time in nanoseconds
+  unsigned long Frame;                    // device frame number, or zero
+  int Status;                             // NDI_OKAY, NDI_MISSING or NDI_DISABLED
+  double Transform[8];                    // quaternion, translation, error
+};
+
+//----------------------------------------------------------------------------
+// The measurements of one tool, in a ring buffer.
+struct ndiPoseTrack
+{
+  int Handle;
+  int Count;                              // number of samples, up to Depth
+  int Next;                               // where the next sample goes
+  ndiPoseSample* Samples;
+};
+
+//----------------------------------------------------------------------------
+struct ndiPoseHistory
+{
+  NDIMutex Mutex;
+  int Depth;
+  int NumberOfTracks;
+  ndiPoseTrack Tracks[NDI_MAX_HANDLES];
+  ndiPoseSample* Samples;                 // storage for all of the tracks
+};
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Get the k'th oldest sample of a track.
+  const ndiPoseSample* ndiPoseTrackSample(const ndiPoseHistory* history, const ndiPoseTrack* track, int k)
+  {
+    return &track->Samples[(track->Next - track->Count + k + history->Depth) % history->Depth];
+  }
+
+  //----------------------------------------------------------------------------
+  ndiPoseTrack* ndiPoseTrackFind(ndiPoseHistory* history, int handle)
+  {
+    for (int i = 0; i < history->NumberOfTracks; i++)
+    {
+      if (history->Tracks[i].Handle == handle)
+      {
+        return &history->Tracks[i];
+      }
+    }
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  // The key of a sample, relative to the key of the newest sample of the
+  // track, so that the doubles keep full precision.
+  double ndiPoseSampleKey(const ndiPoseSample* sample, const ndiPoseSample* newest, bool byFrame)
+  {
+    if (byFrame)
+    {
+      return (double)sample->Frame - (double)newest->Frame;
+    }
+    return (double)(long long)(sample->Time - newest->Time);
+  }
+
+  //----------------------------------------------------------------------------
+  void ndiPoseCopy(const double a[8], double c[8])
+  {
+    memcpy(c, a, 8 * sizeof(double));
+  }
+
+  //----------------------------------------------------------------------------
+  // Replace the translation with a cubic Hermite spline through a and b,
+  // with tangents from the samples before a and after b, if present.
+  void ndiPoseHermite(const double* before, double kBefore, const double a[8], double ka,
+                      const double b[8], double kb, const double* after, double kAfter,
+                      double s, double c[8])
+  {
+    double h = kb - ka;
+    double s2 = s * s;
+    double s3 = s2 * s;
+    double h00 = 2 * s3 - 3 * s2 + 1;
+    double h10 = s3 - 2 * s2 + s;
+    double h01 = -2 * s3 + 3 * s2;
+    double h11 = s3 - s2;
+
+    for (int j = 4; j < 7; j++)
+    {
+      double m = (b[j] - a[j]) / h;
+      double m0 = (before ? (b[j] - before[j]) / (kb - kBefore) : m);
+      double m1 = (after ? (after[j] - a[j]) / (kAfter - ka) : m);
+      c[j] = h00 * a[j] + h10 * h * m0 + h01 * b[j] + h11 * h * m1;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Find the pose of one tool at the key q, which is relative to the key
+  // of the newest sample.  Returns one of the NDI_POSE values.
+  int ndiPoseTrackGet(const ndiPoseHistory* history, const ndiPoseTrack* track, bool byFrame,
+                      double q, int mode, double horizon, double c[8])
+  {
+    int n = track->Count;
+    if (n == 0)
+    {
+      return NDI_POSE_MISSING;
+    }
+
+    const ndiPoseSample* newest = ndiPoseTrackSample(history, track, n - 1);
+    if (q >= 0)
+    {
+      if (newest->Status != NDI_OKAY)
+      {
+        return NDI_POSE_MISSING;
+      }
+      if (q == 0)
+      {
+        ndiPoseCopy(newest->Transform, c);
+        return NDI_POSE_INTERPOLATED;
+      }
+      if (q > horizon)
+      {
+        return NDI_POSE_MISSING;
+      }
+      // continue the motion between the two newest samples
+      const ndiPoseSample* previous = (n > 1 ? ndiPoseTrackSample(history, track, n - 2) : 0);
+      double k = (previous ? ndiPoseSampleKey(previous, newest, byFrame) : 0.0);
+      if (previous && previous->Status == NDI_OKAY && k < 0)
+      {
+        ndiInterpolateTransform(previous->Transform, newest->Transform, (q - k) / (0.0 - k), c);
+      }
+      else
+      {
+        ndiPoseCopy(newest->Transform, c);
+      }
+      return NDI_POSE_EXTRAPOLATED;
+    }
+
+    // find the newest sample at or before q
+    int i = n - 2;
+    double ka = 0.0;
+    for (; i >= 0; i--)
+    {
+      ka = ndiPoseSampleKey(ndiPoseTrackSample(history, track, i), newest, byFrame);
+      if (ka <= q)
+      {
+        break;
+      }
+    }
+    if (i < 0)
+    {
+      return NDI_POSE_MISSING;
+    }
+
+    const ndiPoseSample* a = ndiPoseTrackSample(history, track, i);
+    const ndiPoseSample* b = ndiPoseTrackSample(history, track, i + 1);
+    double kb = ndiPoseSampleKey(b, newest, byFrame);
+    if (a->Status != NDI_OKAY || b->Status != NDI_OKAY)
+    {
+      return NDI_POSE_MISSING;
+    }
+    if (q == ka || kb <= ka)
+    {
+      ndiPoseCopy(a->Transform, c);
+      return NDI_POSE_INTERPOLATED;
+    }
+
+    double s = (q - ka) / (kb - ka);
+    ndiInterpolateTransform(a->Transform, b->Transform, s, c);
+
+    if (mode == NDI_INTERPOLATE_CUBIC)
+    {
+      const double* before = 0;
+      const double* after = 0;
+      double kBefore = 0.0;
+      double kAfter = 0.0;
+      if (i > 0)
+      {
+        const ndiPoseSample* sample = ndiPoseTrackSample(history, track, i - 1);
+        kBefore = ndiPoseSampleKey(sample, newest, byFrame);
+        if (sample->Status == NDI_OKAY && kBefore < ka)
+        {
+          before = sample->Transform;
+        }
+      }
+      if (i + 2 < n)
+      {
+        const ndiPoseSample* sample = ndiPoseTrackSample(history, track, i + 2);
+        kAfter = ndiPoseSampleKey(sample, newest, byFrame);
+        if (sample->Status == NDI_OKAY && kAfter > kb)
+        {
+          after = sample->Transform;
+        }
+      }
+      ndiPoseHermite(before, kBefore, a->Transform, ka, b->Transform, kb, after, kAfter, s, c);
+    }
+
+    return NDI_POSE_INTERPOLATED;
+  }
+
+  //----------------------------------------------------------------------------
+  int ndiPoseHistoryGet(ndiPoseHistory* history, bool byFrame, unsigned long long time, double frame,
+                        int mode, double horizon, int n, const int handles[],
+                        double transforms[][8], int status[])
+  {
+    int found = 0;
+
+    ndiMutexLock(history->Mutex);
+    for (int i = 0; i < n; i++)
+    {
+      ndiPoseTrack* track = ndiPoseTrackFind(history, handles[i]);
+      int result = NDI_POSE_MISSING;
+      if (track && track->Count > 0)
+      {
+        const ndiPoseSample* newest = ndiPoseTrackSample(history, track, track->Count - 1);
+        double q = (byFrame ? frame - (double)newest->Frame : (double)(long long)(time - newest->Time));
+        result = ndiPoseTrackGet(history, track, byFrame, q, mode, horizon, transforms[i]);
+      }
+      if (result == NDI_POSE_MISSING)
+      {
+        memset(transforms[i], 0, 8 * sizeof(double));
+      }
+      else
+      {
+        found++;
+      }
+      status[i] = result;
+    }
+    ndiMutexUnlock(history->Mutex);
+
+    return found;
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport ndiPoseHistory* ndiPoseHistoryCreate(int depth)
+{
+  if (depth < 2)
+  {
+    return 0;
+  }
+
+  ndiPoseHistory* history = (ndiPoseHistory*)calloc(1, sizeof(ndiPoseHistory));
+  if (history == 0)
+  {
+    return 0;
+  }
+  history->Samples = (ndiPoseSample*)calloc((size_t)depth * NDI_MAX_HANDLES, sizeof(ndiPoseSample));
+  if (history->Samples == 0)
+  {
+    free(history);
+    return 0;
+  }
+  history->Depth = depth;
+  for (int i = 0; i < NDI_MAX_HANDLES; i++)
+  {
+    history->Tracks[i].Samples = history->Samples + (size_t)depth * i;
+  }
+  history->Mutex = ndiMutexCreate();
+
+  return history;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiPoseHistoryDestroy(ndiPoseHistory* history)
+{
+  if (history)
+  {
+    ndiMutexDestroy(history->Mutex);
+    free(history->Samples);
+    free(history);
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiPoseHistoryClear(ndiPoseHistory* history)
+{
+  ndiMutexLock(history->Mutex);
+  for (int i = 0; i < NDI_MAX_HANDLES; i++)
+  {
+    history->Tracks[i].Handle = 0;
+    history->Tracks[i].Count = 0;
+    history->Tracks[i].Next = 0;
+  }
+  history->NumberOfTracks = 0;
+  ndiMutexUnlock(history->Mutex);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiPoseHistoryAdd(ndiPoseHistory* history, int handle, unsigned long frame,
+                                    unsigned long long time, int status, const double transform[8])
+{
+  int errnum = 0;
+
+  ndiMutexLock(history->Mutex);
+  ndiPoseTrack* track = ndiPoseTrackFind(history, handle);
+  if (track == 0 && history->NumberOfTracks < NDI_MAX_HANDLES)
+  {
+    track = &history->Tracks[history->NumberOfTracks++];
+    track->Handle = handle;
+    track->Count = 0;
+    track->Next = 0;
+  }
+
+  if (track == 0)
+  {
+    errnum = -1;
+  }
+  else
+  {
+    if (track->Count > 0)
+    {
+      const ndiPoseSample* newest = ndiPoseTrackSample(history, track, track->Count - 1);
+      if (time <= newest->Time || (frame != 0 && newest->Frame != 0 && frame <= newest->Frame))
+      {
+        errnum = -1;
+      }
+    }
+    if (errnum == 0)
+    {
+      ndiPoseSample* sample = &track->Samples[track->Next];
+      sample->Time = time;
+      sample->Frame = frame;
+      sample->Status = status;
+      if (status == NDI_OKAY)
+      {
+        ndiPoseCopy(transform, sample->Transform);
+      }
+      else
+      {
+        memset(sample->Transform, 0, 8 * sizeof(double));
+      }
+      track->Next = (track->Next + 1) % history->Depth;
+      if (track->Count < history->Depth)
+      {
+        track->Count++;
+      }
+    }
+  }
+  ndiMutexUnlock(history->Mutex);
+
+  return errnum;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiPoseHistoryAddFrame(ndiPoseHistory* history, ndicapi* pol, const ndiFrame* frame)
+{
+  int added = 0;
+
+  if (frame->ErrorCode != 0)
+  {
+    return 0;
+  }
+
+  unsigned long long arrival = (frame->FirstByteTime != 0 ? frame->FirstByteTime : frame->Timestamp);
+  for (int i = 0; i < frame->HandleCount && i < NDI_MAX_HANDLES; i++)
+  {
+    unsigned long long time;
+    unsigned long frameNumber = frame->FrameNumber[i];
+    if (pol == 0 || frameNumber == 0 || ndiGetFrameHostTime(pol, frameNumber, &time) != NDI_OKAY)
+    {
+      time = arrival;
+    }
+    if (ndiPoseHistoryAdd(history, frame->Handles[i], frameNumber, time,
+                          frame->HandleStatus[i], frame->Transforms[i]) == 0)
+    {
+      added++;
+    }
+  }
+
+  return added;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiPoseHistoryGetHandles(ndiPoseHistory* history, int handles[NDI_MAX_HANDLES])
+{
+  ndiMutexLock(history->Mutex);
+  int n = history->NumberOfTracks;
+  for (int i = 0; i < n; i++)
+  {
+    handles[i] = history->Tracks[i].Handle;
+  }
+  ndiMutexUnlock(history->Mutex);
+
+  return n;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiPoseHistoryGetPoses(ndiPoseHistory* history, unsigned long long time, int mode,
+                                         unsigned long long horizon, int n, const int handles[],
+                                         double transforms[][8], int status[])
+{
+  return ndiPoseHistoryGet(history, false, time, 0.0, mode, (double)horizon, n, handles, transforms, status);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiPoseHistoryGetPosesAtFrame(ndiPoseHistory* history, double frame, int mode,
+                                                double horizon, int n, const int handles[],
+                                                double transforms[][8], int status[])
+{
+  return ndiPoseHistoryGet(history, true, 0, frame, mode, horizon, n, handles, transforms, status);
+}
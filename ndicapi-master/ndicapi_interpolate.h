@@ -0,0 +1,184 @@
+/*=======================================================================
+
+Copyright (c) 2000-2005 Atamai, Inc.
+
+Use, modification and redistribution of the software, in source or
+binary forms, are permitted provided that the following terms and
+conditions are met:
+
+1) Redistribution of the source code, in verbatim or modified
+   form, must retain the above copyright notice, this license,
+   the following disclaimer, and any notices that refer to this
+   license and/or the following disclaimer.
+
+2) Redistribution in binary form must include the above copyright
+   notice, a copy of this license and the following disclaimer
+   in the documentation or with other materials provided with the
+   distribution.
+
+3) Modified copies of the source code must be clearly marked as such,
+   and must not be misrepresented as verbatim copies of the source code.
+
+THE COPYRIGHT HOLDERS AND/OR OTHER PARTIES PROVIDE THE SOFTWARE "AS IS"
+WITHOUT EXPRESSED OR IMPLIED WARRANTY INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+PURPOSE.  IN NO EVENT SHALL ANY COPYRIGHT HOLDER OR OTHER PARTY WHO MAY
+MODIFY AND/OR REDISTRIBUTE THE SOFTWARE UNDER THE TERMS OF THIS LICENSE
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, LOSS OF DATA OR DATA BECOMING INACCURATE
+OR LOSS OF PROFIT OR BUSINESS INTERRUPTION) ARISING IN ANY WAY OUT OF
+THE USE OR INABILITY TO USE THE SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGES.
+
+=======================================================================*/
+
+/*! \file ndicapi_interpolate.h
+  This file contains methods for keeping a short history of the tool
+  transformations, and for finding the transformations at any time
+  within (or shortly after) that history.
+*/
+
+#ifndef NDICAPI_INTERPOLATE_H
+#define NDICAPI_INTERPOLATE_H
+
+#include "ndicapiExport.h"
+#include "ndicapi.h"
+
+/*=====================================================================*/
+/*! \defgroup NDIInterpolate NDI Interpolation Methods
+  These methods keep the most recent transformations of each tool,
+  keyed by the device frame number and the host time, so that the
+  pose of every tool can be found at the time of a video frame or a
+  control cycle that does not match the frames of the device.
+
+  Feed the frames to ndiPoseHistoryAddFrame() as they arrive, e.g.
+  from ndiGetFramesSince(), and then call ndiPoseHistoryGetPoses()
+  with the host time (from ndiTimeNanoseconds()) that the poses are
+  needed for.  The rotations are interpolated with SLERP, and the
+  translations are interpolated linearly or with a cubic spline.  A
+  time after the newest frame is extrapolated, up to a given limit.
+*/
+
+// the interpolation of the translations
+#define NDI_INTERPOLATE_LINEAR  0   // linear interpolation
+#define NDI_INTERPOLATE_CUBIC   1   // cubic Hermite spline
+
+// the status of each pose returned by ndiPoseHistoryGetPoses()
+#define NDI_POSE_INTERPOLATED   0   // between two measurements, or exact
+#define NDI_POSE_EXTRAPOLATED   1   // after the newest measurement
+#define NDI_POSE_MISSING        2   // not available at the requested time
+
+typedef struct ndiPoseHistory ndiPoseHistory;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! \ingroup NDIInterpolate
+  Create a pose history that keeps the last 'depth' measurements of
+  each tool, depth must be at least 2.  The history can be used from
+  several threads at once.  Returns NULL on failure.
+*/
+ndicapiExport ndiPoseHistory* ndiPoseHistoryCreate(int depth);
+
+/*! \ingroup NDIInterpolate
+  Free a pose history.
+*/
+ndicapiExport void ndiPoseHistoryDestroy(ndiPoseHistory* history);
+
+/*! \ingroup NDIInterpolate
+  Forget all of the measurements, e.g. after the device was restarted.
+*/
+ndicapiExport void ndiPoseHistoryClear(ndiPoseHistory* history);
+
+/*! \ingroup NDIInterpolate
+  Add the transformations of all tools in a frame.
+
+  \param history  the pose history
+  \param pol      the device that the frame came from, or NULL
+  \param frame    a frame from ndiGetLatestFrame() or ndiGetFramesSince()
+
+  \return the number of measurements that were added
+
+  If the device is given and its clock model is ready, the host time of
+  each measurement is found from its frame number with
+  ndiGetFrameHostTime(), which removes the jitter of the reply arrival
+  times.  Otherwise the time when the first byte of the frame arrived is
+  used.  Frames with
+  a nonzero ErrorCode are ignored, and so is a measurement whose frame
+  number is the same as the newest measurement of that tool.  Tools
+  that are missing in the frame are recorded as missing, so that no
+  pose is interpolated across the gap.
+*/
+ndicapiExport int ndiPoseHistoryAddFrame(ndiPoseHistory* history, ndicapi* pol, const ndiFrame* frame);
+
+/*! \ingroup NDIInterpolate
+  Add one measurement of one tool.
+
+  \param history    the pose history
+  \param handle     the port handle of the tool
+  \param frame      the device frame number of the measurement
+  \param time       the host time of the measurement, in nanoseconds
+  \param status     NDI_OKAY, NDI_MISSING or NDI_DISABLED
+  \param transform  the quaternion, translation and error
+
+  \return zero, or -1 if the measurement is not newer than the newest
+          one for this tool (in both time and frame number), or if the
+          history is already full of tools
+
+  Up to NDI_MAX_HANDLES tools are kept.  A frame number of zero means
+  that the frame number is not known.
+*/
+ndicapiExport int ndiPoseHistoryAdd(ndiPoseHistory* history, int handle, unsigned long frame,
+                                    unsigned long long time, int status, const double transform[8]);
+
+/*! \ingroup NDIInterpolate
+  Get the handles of the tools in the history.  Returns the number of
+  handles that were stored in 'handles'.
+*/
+ndicapiExport int ndiPoseHistoryGetHandles(ndiPoseHistory* history, int handles[NDI_MAX_HANDLES]);
+
+/*! \ingroup NDIInterpolate
+  Get the poses of several tools at a host time.
+
+  \param history     the pose history
+  \param time        the host time, in the units of ndiTimeNanoseconds()
+  \param mode        NDI_INTERPOLATE_LINEAR or NDI_INTERPOLATE_CUBIC
+  \param horizon     how far past the newest measurement to extrapolate,
+                     in nanoseconds, or zero to never extrapolate
+  \param n           the number of tools
+  \param handles     the port handles of the tools
+  \param transforms  the resulting transformations, one per tool
+  \param status      the resulting NDI_POSE_INTERPOLATED,
+                     NDI_POSE_EXTRAPOLATED or NDI_POSE_MISSING per tool
+
+  \return the number of tools for which a pose was found
+
+  The rotation is interpolated with SLERP between the measurements on
+  either side of the time.  In cubic mode the translation follows a
+  Hermite spline whose tangents come from the neighbouring
+  measurements, so the velocity is continuous.  Extrapolation continues
+  the motion between the two newest measurements at a constant velocity.
+  A pose is missing if either measurement around the time is missing,
+  or if the time is before the oldest measurement or beyond the horizon,
+  and its transform is set to zero.
+*/
+ndicapiExport int ndiPoseHistoryGetPoses(ndiPoseHistory* history, unsigned long long time, int mode,
+                                         unsigned long long horizon, int n, const int handles[],
+                                         double transforms[][8], int status[]);
+
+/*! \ingroup NDIInterpolate
+  Get the poses of several tools at a device frame number.  This is
+  the same as ndiPoseHistoryGetPoses(), except that the measurements are
+  located by frame number instead of by host time.  The frame number can
+  have a fractional part, and the horizon is given in frames.
+*/
+ndicapiExport int ndiPoseHistoryGetPosesAtFrame(ndiPoseHistory* history, double frame, int mode,
+                                                double horizon, int n, const int handles[],
+                                                double transforms[][8], int status[]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
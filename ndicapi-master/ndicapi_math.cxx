@@ -35,6 +35,23 @@ POSSIBILITY OF SUCH DAMAGES.
 #include <math.h>
 #include "ndicapi_math.h"
 
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define NDI_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define NDI_TARGET_SIMD
+#else
+#define NDI_TARGET_SIMD __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define NDI_SIMD_NEON 1
+#include <arm_neon.h>
+#define NDI_TARGET_SIMD
+#endif
+
 //----------------------------------------------------------------------------
 // Divide the transform 'trans' by the transform 'ref':
 // trans = trans * ref^(-1)
@@ -88,6 +105,85 @@ ndicapiExport void ndiRelativeTransform(const double a[8], const double b[8], do
   c[7] = 0.0;
 }
 
+//----------------------------------------------------------------------------
+// Interpolate from 'a' to 'b', the rotation is found from q = qa*(qa\qb)^s
+ndicapiExport void ndiInterpolateTransform(const double a[8], const double b[8], double s, double c[8])
+{
+  double r[8], f, v, t, w1, x1, y1, z1, w2, x2, y2, z2;
+
+  /* the rotation from a to b, as a unit quaternion */
+  ndiRelativeTransform(b, a, r);
+  f = sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2] + r[3] * r[3]);
+  if (f == 0.0)
+  {
+    f = 1.0;
+  }
+  /* take the shortest arc */
+  if (r[0] < 0)
+  {
+    f = -f;
+  }
+  w2 = r[0] / f;
+  x2 = r[1] / f;
+  y2 = r[2] / f;
+  z2 = r[3] / f;
+
+  /* raise it to the power s */
+  v = sqrt(x2 * x2 + y2 * y2 + z2 * z2);
+  if (v > 1e-12)
+  {
+    t = atan2(v, w2) * s;
+    w2 = cos(t);
+    f = sin(t) / v;
+    x2 *= f;
+    y2 *= f;
+    z2 *= f;
+  }
+  else
+  {
+    w2 = 1.0;
+    x2 = y2 = z2 = 0.0;
+  }
+
+  /* q = qa*r, with qa normalized */
+  f = sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2] + a[3] * a[3]);
+  if (f == 0.0)
+  {
+    f = 1.0;
+  }
+  w1 = a[0] / f;
+  x1 = a[1] / f;
+  y1 = a[2] / f;
+  z1 = a[3] / f;
+
+  r[0] = w1 * w2 - x1 * x2 - y1 * y2 - z1 * z2;
+  r[1] = w1 * x2 + x1 * w2 + y1 * z2 - z1 * y2;
+  r[2] = w1 * y2 - x1 * z2 + y1 * w2 + z1 * x2;
+  r[3] = w1 * z2 + x1 * y2 - y1 * x2 + z1 * w2;
+
+  r[4] = a[4] + (b[4] - a[4]) * s;
+  r[5] = a[5] + (b[5] - a[5]) * s;
+  r[6] = a[6] + (b[6] - a[6]) * s;
+
+  if (s <= 0.0)
+  {
+    r[7] = a[7];
+  }
+  else if (s >= 1.0)
+  {
+    r[7] = b[7];
+  }
+  else
+  {
+    r[7] = a[7] + (b[7] - a[7]) * s;
+  }
+
+  for (int i = 0; i < 8; i++)
+  {
+    c[i] = r[i];
+  }
+}
+
 //----------------------------------------------------------------------------
 // Converts the quaternion rotation + translation transform returned
 // by the NDICAPI into a 4x4 base-zero row-major matrix, following
@@ -292,4 +388,491 @@ ndicapiExport void ndiCoordsFromMatrixd(double coords[3], const double matrix[16
   coords[0] = matrix[12];
   coords[1] = matrix[13];
   coords[2] = matrix[14];
-}
\ No newline at end of file
+}
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Get transformation i from an array in the layout of ndiTransformsToArrayd().
+  template <typename T>
+  void ndiGatherTransform(const T* array, int n, int i, T trans[8])
+  {
+    for (int j = 0; j < 8; j++)
+    {
+      trans[j] = array[j * n + i];
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  template <typename T>
+  void ndiScatterTransform(const T trans[8], int n, int i, T* array)
+  {
+    for (int j = 0; j < 8; j++)
+    {
+      array[j * n + i] = trans[j];
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // The same as ndiRelativeTransform(), but in single precision.
+  void ndiRelativeTransformf(const float a[8], const float b[8], float c[8])
+  {
+    float f, x, y, z, w1, x1, y1, z1, w2, x2, y2, z2;
+
+    w1 = b[0];
+    x1 = b[1];
+    y1 = b[2];
+    z1 = b[3];
+
+    w2 = a[0];
+    x2 = a[1];
+    y2 = a[2];
+    z2 = a[3];
+
+    c[0] = w1 * w2 + x1 * x2 + y1 * y2 + z1 * z2;
+    c[1] = w1 * x2 - x1 * w2 - y1 * z2 + z1 * y2;
+    c[2] = w1 * y2 + x1 * z2 - y1 * w2 - z1 * x2;
+    c[3] = w1 * z2 - x1 * y2 + y1 * x2 - z1 * w2;
+
+    x = a[4] - b[4];
+    y = a[5] - b[5];
+    z = a[6] - b[6];
+
+    w2 = x1 * x + y1 * y + z1 * z;
+    x2 = w1 * x - y1 * z + z1 * y;
+    y2 = w1 * y + x1 * z - z1 * x;
+    z2 = w1 * z - x1 * y + y1 * x;
+
+    x = w2 * x1 + x2 * w1 + y2 * z1 - z2 * y1;
+    y = w2 * y1 - x2 * z1 + y2 * w1 + z2 * x1;
+    z = w2 * z1 + x2 * y1 - y2 * x1 + z2 * w1;
+
+    f = 1.0f / (w1 * w1 + x1 * x1 + y1 * y1 + z1 * z1);
+    c[4] = x * f;
+    c[5] = y * f;
+    c[6] = z * f;
+
+    c[7] = 0.0f;
+  }
+
+#if defined(NDI_SIMD_X86)
+  //----------------------------------------------------------------------------
+  // The vector operations for AVX2, four doubles or eight floats at once.
+  template <typename T> struct ndiVector;
+  template <> struct ndiVector<double> { typedef __m256d Type; enum { Lanes = 4 }; };
+  template <> struct ndiVector<float> { typedef __m256 Type; enum { Lanes = 8 }; };
+
+  NDI_TARGET_SIMD inline __m256d ndiAdd(__m256d a, __m256d b) { return _mm256_add_pd(a, b); }
+  NDI_TARGET_SIMD inline __m256d ndiSub(__m256d a, __m256d b) { return _mm256_sub_pd(a, b); }
+  NDI_TARGET_SIMD inline __m256d ndiMul(__m256d a, __m256d b) { return _mm256_mul_pd(a, b); }
+  NDI_TARGET_SIMD inline __m256d ndiDiv(__m256d a, __m256d b) { return _mm256_div_pd(a, b); }
+  NDI_TARGET_SIMD inline __m256d ndiSplat(double a) { return _mm256_set1_pd(a); }
+  NDI_TARGET_SIMD inline __m256d ndiLoad(const double* p) { return _mm256_loadu_pd(p); }
+  NDI_TARGET_SIMD inline void ndiStore(double* p, __m256d a) { _mm256_storeu_pd(p, a); }
+
+  NDI_TARGET_SIMD inline __m256 ndiAdd(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+  NDI_TARGET_SIMD inline __m256 ndiSub(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+  NDI_TARGET_SIMD inline __m256 ndiMul(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+  NDI_TARGET_SIMD inline __m256 ndiDiv(__m256 a, __m256 b) { return _mm256_div_ps(a, b); }
+  NDI_TARGET_SIMD inline __m256 ndiSplat(float a) { return _mm256_set1_ps(a); }
+  NDI_TARGET_SIMD inline __m256 ndiLoad(const float* p) { return _mm256_loadu_ps(p); }
+  NDI_TARGET_SIMD inline void ndiStore(float* p, __m256 a) { _mm256_storeu_ps(p, a); }
+
+  //----------------------------------------------------------------------------
+  // Store elements 4*j to 4*j+3 of four matrices, where a holds element
+  // 4*j of each matrix, b holds element 4*j+1, and so on.
+  NDI_TARGET_SIMD inline void ndiStoreMatrixColumn(__m256d a, __m256d b, __m256d c, __m256d d,
+                                                   double (*m)[16], int j)
+  {
+    __m256d t0 = _mm256_unpacklo_pd(a, b);
+    __m256d t1 = _mm256_unpackhi_pd(a, b);
+    __m256d t2 = _mm256_unpacklo_pd(c, d);
+    __m256d t3 = _mm256_unpackhi_pd(c, d);
+    _mm256_storeu_pd(&m[0][4 * j], _mm256_permute2f128_pd(t0, t2, 0x20));
+    _mm256_storeu_pd(&m[1][4 * j], _mm256_permute2f128_pd(t1, t3, 0x20));
+    _mm256_storeu_pd(&m[2][4 * j], _mm256_permute2f128_pd(t0, t2, 0x31));
+    _mm256_storeu_pd(&m[3][4 * j], _mm256_permute2f128_pd(t1, t3, 0x31));
+  }
+
+  //----------------------------------------------------------------------------
+  // Store elements 4*j to 4*j+3 of eight matrices.
+  NDI_TARGET_SIMD inline void ndiStoreMatrixColumn(__m256 a, __m256 b, __m256 c, __m256 d,
+                                                   float (*m)[16], int j)
+  {
+    __m256 t0 = _mm256_unpacklo_ps(a, b);
+    __m256 t1 = _mm256_unpackhi_ps(a, b);
+    __m256 t2 = _mm256_unpacklo_ps(c, d);
+    __m256 t3 = _mm256_unpackhi_ps(c, d);
+    __m256 r0 = _mm256_shuffle_ps(t0, t2, 0x44);
+    __m256 r1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+    __m256 r2 = _mm256_shuffle_ps(t1, t3, 0x44);
+    __m256 r3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+    _mm_storeu_ps(&m[0][4 * j], _mm256_castps256_ps128(r0));
+    _mm_storeu_ps(&m[1][4 * j], _mm256_castps256_ps128(r1));
+    _mm_storeu_ps(&m[2][4 * j], _mm256_castps256_ps128(r2));
+    _mm_storeu_ps(&m[3][4 * j], _mm256_castps256_ps128(r3));
+    _mm_storeu_ps(&m[4][4 * j], _mm256_extractf128_ps(r0, 1));
+    _mm_storeu_ps(&m[5][4 * j], _mm256_extractf128_ps(r1, 1));
+    _mm_storeu_ps(&m[6][4 * j], _mm256_extractf128_ps(r2, 1));
+    _mm_storeu_ps(&m[7][4 * j], _mm256_extractf128_ps(r3, 1));
+  }
+#elif defined(NDI_SIMD_NEON)
+  //----------------------------------------------------------------------------
+  // The vector operations for NEON, two doubles or four floats at once.
+  template <typename T> struct ndiVector;
+  template <> struct ndiVector<double> { typedef float64x2_t Type; enum { Lanes = 2 }; };
+  template <> struct ndiVector<float> { typedef float32x4_t Type; enum { Lanes = 4 }; };
+
+  inline float64x2_t ndiAdd(float64x2_t a, float64x2_t b) { return vaddq_f64(a, b); }
+  inline float64x2_t ndiSub(float64x2_t a, float64x2_t b) { return vsubq_f64(a, b); }
+  inline float64x2_t ndiMul(float64x2_t a, float64x2_t b) { return vmulq_f64(a, b); }
+  inline float64x2_t ndiDiv(float64x2_t a, float64x2_t b) { return vdivq_f64(a, b); }
+  inline float64x2_t ndiSplat(double a) { return vdupq_n_f64(a); }
+  inline float64x2_t ndiLoad(const double* p) { return vld1q_f64(p); }
+  inline void ndiStore(double* p, float64x2_t a) { vst1q_f64(p, a); }
+
+  inline float32x4_t ndiAdd(float32x4_t a, float32x4_t b) { return vaddq_f32(a, b); }
+  inline float32x4_t ndiSub(float32x4_t a, float32x4_t b) { return vsubq_f32(a, b); }
+  inline float32x4_t ndiMul(float32x4_t a, float32x4_t b) { return vmulq_f32(a, b); }
+  inline float32x4_t ndiDiv(float32x4_t a, float32x4_t b) { return vdivq_f32(a, b); }
+  inline float32x4_t ndiSplat(float a) { return vdupq_n_f32(a); }
+  inline float32x4_t ndiLoad(const float* p) { return vld1q_f32(p); }
+  inline void ndiStore(float* p, float32x4_t a) { vst1q_f32(p, a); }
+
+  //----------------------------------------------------------------------------
+  // Store elements 4*j to 4*j+3 of two matrices, where a holds element
+  // 4*j of each matrix, b holds element 4*j+1, and so on.
+  inline void ndiStoreMatrixColumn(float64x2_t a, float64x2_t b, float64x2_t c, float64x2_t d,
+                                   double (*m)[16], int j)
+  {
+    vst1q_f64(&m[0][4 * j], vzip1q_f64(a, b));
+    vst1q_f64(&m[0][4 * j + 2], vzip1q_f64(c, d));
+    vst1q_f64(&m[1][4 * j], vzip2q_f64(a, b));
+    vst1q_f64(&m[1][4 * j + 2], vzip2q_f64(c, d));
+  }
+
+  //----------------------------------------------------------------------------
+  // Store elements 4*j to 4*j+3 of four matrices.
+  inline void ndiStoreMatrixColumn(float32x4_t a, float32x4_t b, float32x4_t c, float32x4_t d,
+                                   float (*m)[16], int j)
+  {
+    float32x4_t t0 = vzip1q_f32(a, c);
+    float32x4_t t1 = vzip2q_f32(a, c);
+    float32x4_t t2 = vzip1q_f32(b, d);
+    float32x4_t t3 = vzip2q_f32(b, d);
+    vst1q_f32(&m[0][4 * j], vzip1q_f32(t0, t2));
+    vst1q_f32(&m[1][4 * j], vzip2q_f32(t0, t2));
+    vst1q_f32(&m[2][4 * j], vzip1q_f32(t1, t3));
+    vst1q_f32(&m[3][4 * j], vzip2q_f32(t1, t3));
+  }
+#endif
+
+#if defined(NDI_SIMD_X86) || defined(NDI_SIMD_NEON)
+  //----------------------------------------------------------------------------
+  // Convert as many transformations to matrices as fit in whole vectors,
+  // with the same operations as ndiTransformToMatrixd(), so the results
+  // are the same.  Returns the number of transformations that were done.
+  template <typename T>
+  NDI_TARGET_SIMD int ndiTransformArrayToMatrixSIMD(const T* a, int n, T (*m)[16])
+  {
+    typedef typename ndiVector<T>::Type V;
+    const int lanes = ndiVector<T>::Lanes;
+    V half = ndiSplat((T)0.5);
+    V two = ndiSplat((T)2.0);
+    V zero = ndiSplat((T)0.0);
+    V one = ndiSplat((T)1.0);
+
+    int i = 0;
+    for (; i + lanes <= n; i += lanes)
+    {
+      V w = ndiLoad(&a[i]);
+      V x = ndiLoad(&a[n + i]);
+      V y = ndiLoad(&a[2 * n + i]);
+      V z = ndiLoad(&a[3 * n + i]);
+
+      V ww = ndiMul(w, w);
+      V xx = ndiMul(x, x);
+      V yy = ndiMul(y, y);
+      V zz = ndiMul(z, z);
+      V wx = ndiMul(w, x);
+      V wy = ndiMul(w, y);
+      V wz = ndiMul(w, z);
+      V xy = ndiMul(x, y);
+      V xz = ndiMul(x, z);
+      V yz = ndiMul(y, z);
+
+      V rr = ndiAdd(ndiAdd(xx, yy), zz);
+      V ss = ndiMul(ndiSub(ww, rr), half);
+      V f = ndiDiv(two, ndiAdd(ww, rr));
+
+      ndiStoreMatrixColumn(ndiMul(ndiAdd(ss, xx), f), ndiMul(ndiAdd(wz, xy), f),
+                           ndiMul(ndiSub(xz, wy), f), zero, &m[i], 0);
+      ndiStoreMatrixColumn(ndiMul(ndiSub(xy, wz), f), ndiMul(ndiAdd(ss, yy), f),
+                           ndiMul(ndiAdd(wx, yz), f), zero, &m[i], 1);
+      ndiStoreMatrixColumn(ndiMul(ndiAdd(wy, xz), f), ndiMul(ndiSub(yz, wx), f),
+                           ndiMul(ndiAdd(ss, zz), f), zero, &m[i], 2);
+      ndiStoreMatrixColumn(ndiLoad(&a[4 * n + i]), ndiLoad(&a[5 * n + i]),
+                           ndiLoad(&a[6 * n + i]), one, &m[i], 3);
+    }
+
+    return i;
+  }
+
+  //----------------------------------------------------------------------------
+  // Divide as many transformations by 'ref' as fit in whole vectors, with
+  // the same operations as ndiRelativeTransform().  The factor 'f' is the
+  // inverse of the squared norm of the reference quaternion.  Returns the
+  // number of transformations that were done.
+  template <typename T>
+  NDI_TARGET_SIMD int ndiRelativeTransformArraySIMD(const T* a, int n, const T ref[8], T f, T* c)
+  {
+    typedef typename ndiVector<T>::Type V;
+    const int lanes = ndiVector<T>::Lanes;
+    V w1 = ndiSplat(ref[0]);
+    V x1 = ndiSplat(ref[1]);
+    V y1 = ndiSplat(ref[2]);
+    V z1 = ndiSplat(ref[3]);
+    V bx = ndiSplat(ref[4]);
+    V by = ndiSplat(ref[5]);
+    V bz = ndiSplat(ref[6]);
+    V scale = ndiSplat(f);
+    V zero = ndiSplat((T)0.0);
+
+    int i = 0;
+    for (; i + lanes <= n; i += lanes)
+    {
+      V w2 = ndiLoad(&a[i]);
+      V x2 = ndiLoad(&a[n + i]);
+      V y2 = ndiLoad(&a[2 * n + i]);
+      V z2 = ndiLoad(&a[3 * n + i]);
+      V x = ndiSub(ndiLoad(&a[4 * n + i]), bx);
+      V y = ndiSub(ndiLoad(&a[5 * n + i]), by);
+      V z = ndiSub(ndiLoad(&a[6 * n + i]), bz);
+
+      /* q = q1\q2 */
+      ndiStore(&c[i], ndiAdd(ndiAdd(ndiAdd(ndiMul(w1, w2), ndiMul(x1, x2)), ndiMul(y1, y2)), ndiMul(z1, z2)));
+      ndiStore(&c[n + i], ndiAdd(ndiSub(ndiSub(ndiMul(w1, x2), ndiMul(x1, w2)), ndiMul(y1, z2)), ndiMul(z1, y2)));
+      ndiStore(&c[2 * n + i], ndiSub(ndiSub(ndiAdd(ndiMul(w1, y2), ndiMul(x1, z2)), ndiMul(y1, w2)), ndiMul(z1, x2)));
+      ndiStore(&c[3 * n + i], ndiSub(ndiAdd(ndiSub(ndiMul(w1, z2), ndiMul(x1, y2)), ndiMul(y1, x2)), ndiMul(z1, w2)));
+
+      /* qtmp = q1\q, then q = qtmp*q1 */
+      w2 = ndiAdd(ndiAdd(ndiMul(x1, x), ndiMul(y1, y)), ndiMul(z1, z));
+      x2 = ndiAdd(ndiSub(ndiMul(w1, x), ndiMul(y1, z)), ndiMul(z1, y));
+      y2 = ndiSub(ndiAdd(ndiMul(w1, y), ndiMul(x1, z)), ndiMul(z1, x));
+      z2 = ndiAdd(ndiSub(ndiMul(w1, z), ndiMul(x1, y)), ndiMul(y1, x));
+
+      x = ndiSub(ndiAdd(ndiAdd(ndiMul(w2, x1), ndiMul(x2, w1)), ndiMul(y2, z1)), ndiMul(z2, y1));
+      y = ndiAdd(ndiAdd(ndiSub(ndiMul(w2, y1), ndiMul(x2, z1)), ndiMul(y2, w1)), ndiMul(z2, x1));
+      z = ndiAdd(ndiSub(ndiAdd(ndiMul(w2, z1), ndiMul(x2, y1)), ndiMul(y2, x1)), ndiMul(z2, w1));
+
+      ndiStore(&c[4 * n + i], ndiMul(x, scale));
+      ndiStore(&c[5 * n + i], ndiMul(y, scale));
+      ndiStore(&c[6 * n + i], ndiMul(z, scale));
+      ndiStore(&c[7 * n + i], zero);
+    }
+
+    return i;
+  }
+#endif
+
+  //----------------------------------------------------------------------------
+  // Find the best math kernel that this CPU supports.
+  int ndiDetectMathKernel()
+  {
+#if defined(NDI_SIMD_X86)
+    bool avx2 = false;
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    // AVX2 also needs the OS to save the AVX registers
+    bool osAVX = ((info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6);
+    if (maxLeaf >= 7 && osAVX)
+    {
+      __cpuidex(info, 7, 0);
+      avx2 = ((info[1] & (1 << 5)) != 0);
+    }
+#else
+    __builtin_cpu_init();
+    avx2 = (__builtin_cpu_supports("avx2") != 0);
+#endif
+    if (avx2)
+    {
+      return NDI_MATH_AVX2;
+    }
+#elif defined(NDI_SIMD_NEON)
+    return NDI_MATH_NEON;
+#endif
+    return NDI_MATH_SCALAR;
+  }
+
+  //----------------------------------------------------------------------------
+  // The kernel in use, or -1 until the first call.
+  std::atomic<int> ndiCurrentMathKernel(-1);
+
+  //----------------------------------------------------------------------------
+  inline int ndiMathKernel()
+  {
+    int kernel = ndiCurrentMathKernel.load(std::memory_order_relaxed);
+    if (kernel < 0)
+    {
+      kernel = ndiDetectMathKernel();
+      ndiCurrentMathKernel.store(kernel, std::memory_order_relaxed);
+    }
+    return kernel;
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiTransformsToArrayd(const double transforms[][8], int n, double* array)
+{
+  for (int i = 0; i < n; i++)
+  {
+    ndiScatterTransform(transforms[i], n, i, array);
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiTransformsToArrayf(const double transforms[][8], int n, float* array)
+{
+  for (int i = 0; i < n; i++)
+  {
+    for (int j = 0; j < 8; j++)
+    {
+      array[j * n + i] = (float)transforms[i][j];
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiArrayToTransformsd(const double* array, int n, double transforms[][8])
+{
+  for (int i = 0; i < n; i++)
+  {
+    ndiGatherTransform(array, n, i, transforms[i]);
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiArrayToTransformsf(const float* array, int n, double transforms[][8])
+{
+  for (int i = 0; i < n; i++)
+  {
+    for (int j = 0; j < 8; j++)
+    {
+      transforms[i][j] = array[j * n + i];
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiTransformArrayToMatrixd(const double* array, int n, double matrices[][16])
+{
+  int i = 0;
+#if defined(NDI_SIMD_X86) || defined(NDI_SIMD_NEON)
+  if (ndiMathKernel() != NDI_MATH_SCALAR)
+  {
+    i = ndiTransformArrayToMatrixSIMD(array, n, matrices);
+  }
+#endif
+
+  for (; i < n; i++)
+  {
+    double trans[8];
+    ndiGatherTransform(array, n, i, trans);
+    ndiTransformToMatrixd(trans, matrices[i]);
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiTransformArrayToMatrixf(const float* array, int n, float matrices[][16])
+{
+  int i = 0;
+#if defined(NDI_SIMD_X86) || defined(NDI_SIMD_NEON)
+  if (ndiMathKernel() != NDI_MATH_SCALAR)
+  {
+    i = ndiTransformArrayToMatrixSIMD(array, n, matrices);
+  }
+#endif
+
+  for (; i < n; i++)
+  {
+    float trans[8];
+    ndiGatherTransform(array, n, i, trans);
+    ndiTransformToMatrixf(trans, matrices[i]);
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiRelativeTransformArrayd(const double* array, int n, const double ref[8], double* result)
+{
+  int i = 0;
+#if defined(NDI_SIMD_X86) || defined(NDI_SIMD_NEON)
+  if (ndiMathKernel() != NDI_MATH_SCALAR)
+  {
+    double f = 1.0 / (ref[0] * ref[0] + ref[1] * ref[1] + ref[2] * ref[2] + ref[3] * ref[3]);
+    i = ndiRelativeTransformArraySIMD(array, n, ref, f, result);
+  }
+#endif
+
+  for (; i < n; i++)
+  {
+    double trans[8];
+    ndiGatherTransform(array, n, i, trans);
+    ndiRelativeTransform(trans, ref, trans);
+    ndiScatterTransform(trans, n, i, result);
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiRelativeTransformArrayf(const float* array, int n, const float ref[8], float* result)
+{
+  int i = 0;
+#if defined(NDI_SIMD_X86) || defined(NDI_SIMD_NEON)
+  if (ndiMathKernel() != NDI_MATH_SCALAR)
+  {
+    float f = 1.0f / (ref[0] * ref[0] + ref[1] * ref[1] + ref[2] * ref[2] + ref[3] * ref[3]);
+    i = ndiRelativeTransformArraySIMD(array, n, ref, f, result);
+  }
+#endif
+
+  for (; i < n; i++)
+  {
+    float trans[8];
+    ndiGatherTransform(array, n, i, trans);
+    ndiRelativeTransformf(trans, ref, trans);
+    ndiScatterTransform(trans, n, i, result);
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiGetMathKernel()
+{
+  return ndiMathKernel();
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiSetMathKernel(int kernel)
+{
+  if (kernel != NDI_MATH_SCALAR && kernel != ndiDetectMathKernel())
+  {
+    kernel = NDI_MATH_SCALAR;
+  }
+  ndiCurrentMathKernel.store(kernel, std::memory_order_relaxed);
+  return kernel;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport const char* ndiMathKernelName(int kernel)
+{
+  switch (kernel)
+  {
+    case NDI_MATH_SCALAR:
+      return "scalar";
+    case NDI_MATH_AVX2:
+      return "AVX2";
+    case NDI_MATH_NEON:
+      return "NEON";
+  }
+  return "unknown";
+}
@@ -59,6 +59,11 @@ POSSIBILITY OF SUCH DAMAGES.
   \f]
 */
 
+// the instructions used by the batch methods, from ndiGetMathKernel()
+#define NDI_MATH_SCALAR  0   // plain C++
+#define NDI_MATH_AVX2    1   // x86 with AVX2
+#define NDI_MATH_NEON    2   // ARM64 with NEON
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -76,6 +81,23 @@ extern "C" {
 */
 ndicapiExport void ndiRelativeTransform(const double a[8], const double b[8], double c[8]);
 
+/*! \ingroup NdicapiMath
+  Interpolate between two tool transformations.  The rotation is
+  interpolated along the shortest arc (SLERP), and the translation and
+  the error are interpolated linearly.
+
+  \param a   the transformation at \em s = 0
+  \param b   the transformation at \em s = 1
+  \param s   the interpolation parameter
+  \param c   the resulting transformation
+
+  Values of \em s outside of [0,1] extrapolate the motion from \em a
+  to \em b at constant angular and linear velocity, but the error is
+  taken from the nearest of \em a and \em b.  The pointer \em c can be
+  the same as \em a or \em b.
+*/
+ndicapiExport void ndiInterpolateTransform(const double a[8], const double b[8], double s, double c[8]);
+
 /*! \ingroup NdicapiMath
   Convert a quaternion transformation into a 4x4 float matrix.
 */
@@ -120,6 +142,82 @@ ndicapiExport void ndiCoordsFromMatrixf(float coords[3], const float matrix[16])
 */
 ndicapiExport void ndiCoordsFromMatrixd(double coords[3], const double matrix[16]);
 
+/*! \ingroup NdicapiMath
+  Copy \em n transformations, e.g. the Transforms of an ndiFrame, into
+  an array in the "structure of arrays" layout that is used by the
+  batch methods below.  The array holds 8 rows of \em n values: the
+  \em w, \em x, \em y and \em z of the quaternions, then the
+  \em x, \em y and \em z of the translations, and then the errors,
+  so that value \em j of transformation \em i is array[j*n + i].
+*/
+ndicapiExport void ndiTransformsToArrayd(const double transforms[][8], int n, double* array);
+/*! \ingroup NdicapiMath
+  Copy \em n transformations into a float array, see ndiTransformsToArrayd().
+*/
+ndicapiExport void ndiTransformsToArrayf(const double transforms[][8], int n, float* array);
+
+/*! \ingroup NdicapiMath
+  Copy \em n transformations out of an array, the reverse of
+  ndiTransformsToArrayd().
+*/
+ndicapiExport void ndiArrayToTransformsd(const double* array, int n, double transforms[][8]);
+/*! \ingroup NdicapiMath
+  Copy \em n transformations out of a float array, the reverse of
+  ndiTransformsToArrayf().
+*/
+ndicapiExport void ndiArrayToTransformsf(const float* array, int n, double transforms[][8]);
+
+/*! \ingroup NdicapiMath
+  Convert an array of \em n transformations (see ndiTransformsToArrayd())
+  into 4x4 double matrices, as ndiTransformToMatrixd() would convert each
+  of them.  This uses AVX2 or NEON instructions where the CPU has them.
+*/
+ndicapiExport void ndiTransformArrayToMatrixd(const double* array, int n, double matrices[][16]);
+/*! \ingroup NdicapiMath
+  Convert an array of \em n transformations into 4x4 float matrices, as
+  ndiTransformToMatrixf() would convert each of them.
+*/
+ndicapiExport void ndiTransformArrayToMatrixf(const float* array, int n, float matrices[][16]);
+
+/*! \ingroup NdicapiMath
+  Find the position and orientation of \em n tools relative to one
+  reference tool, as ndiRelativeTransform() would for each of them.
+
+  \param array   the tool transformations, see ndiTransformsToArrayd()
+  \param n       the number of tools
+  \param ref     the reference tool transformation
+  \param result  the resulting relative transformations, in the same
+                 layout as \em array
+
+  The \em result can be the same as \em array.  This uses AVX2 or NEON
+  instructions where the CPU has them.
+*/
+ndicapiExport void ndiRelativeTransformArrayd(const double* array, int n, const double ref[8], double* result);
+/*! \ingroup NdicapiMath
+  Find the relative transformations of \em n tools in single precision,
+  see ndiRelativeTransformArrayd().
+*/
+ndicapiExport void ndiRelativeTransformArrayf(const float* array, int n, const float ref[8], float* result);
+
+/*! \ingroup NdicapiMath
+  Get the instructions that are used by the batch methods, e.g.
+  NDI_MATH_AVX2.  These are chosen at run time, the first time that a
+  batch method is called.
+*/
+ndicapiExport int ndiGetMathKernel();
+
+/*! \ingroup NdicapiMath
+  Choose the instructions for the batch methods, e.g. for benchmarking.
+  If the CPU does not support them, NDI_MATH_SCALAR is used instead.
+  Returns the kernel that will be used.
+*/
+ndicapiExport int ndiSetMathKernel(int kernel);
+
+/*! \ingroup NdicapiMath
+  Get the name of a math kernel, e.g. "AVX2".
+*/
+ndicapiExport const char* ndiMathKernelName(int kernel);
+
 #ifdef __cplusplus
 }
 #endif
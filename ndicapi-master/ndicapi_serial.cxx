@@ -45,6 +45,7 @@ POSSIBILITY OF SUCH DAMAGES.
 #include <string.h>
 
 #include "ndicapi_serial.h"
+#include "ndicapi_thread.h"
 
 // time out period in milliseconds
 #define TIMEOUT_PERIOD 5000
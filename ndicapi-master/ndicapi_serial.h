@@ -182,7 +182,10 @@ ndicapiExport int ndiSerialFlush(NDIFileHandle serial_port, int flushtype);
 /*! \ingroup NDISerial
   Change the baud rate and other comm parameters.
 
-  The baud rate should be one of 9600, 14400, 19200, 38400, 57600, 115200.
+  The baud rate should be one of 9600, 14400, 19200, 38400, 57600, 115200,
+  230400, 921600 or 1228739.  Other rates are passed to the driver on
+  Windows, on macOS (with IOSSIOSPEED) and on Linux (with termios2 and
+  BOTHER), which is how 1228739 is set on Linux and macOS.
 
   The mode string should be one of "8N1", "7O2" etc. The first character
   is the number of data bits (7 or 8), the second character is the parity
@@ -215,6 +218,29 @@ ndicapiExport int ndiSerialComm(NDIFileHandle serial_port, int baud, const char*
 */
 ndicapiExport int ndiSerialTimeout(NDIFileHandle serial_port, int milliseconds);
 
+/*! \ingroup NDISerial
+  Change the timeout for the serial port in microseconds.  On Unix the
+  reads wait with poll(), so timeouts well below 100 ms are honoured.
+  On Windows the timeout is rounded up to whole milliseconds.
+
+  The return value will be 0 if the call was successful.
+  A negative return value signals failure.
+*/
+ndicapiExport int ndiSerialTimeoutMicroseconds(NDIFileHandle serial_port, long microseconds);
+
+/*! \ingroup NDISerial
+  Ask the serial driver to deliver received characters immediately.
+  On Linux this sets ASYNC_LOW_LATENCY, and for FTDI USB adapters it
+  also sets the latency timer to 1 ms instead of the default 16 ms,
+  which usually requires write access to sysfs.  Pass zero to restore
+  the defaults.
+
+  The return value will be 0 if any of the settings could be changed.
+  A negative return value signals that the platform or the driver
+  does not support it.
+*/
+ndicapiExport int ndiSerialSetLowLatency(NDIFileHandle serial_port, int enable);
+
 /*! \ingroup NDISerial
   Write a stream of 'n' characters from the string 'text' to the serial
   port.  The number of characters actually written is returned.
@@ -244,6 +270,28 @@ ndicapiExport int ndiSerialWrite(NDIFileHandle serial_port, const char* text, in
 */
 ndicapiExport int ndiSerialRead(NDIFileHandle serial_port, char* reply, int n, bool isBinary, int* errorCode);
 
+/*! \ingroup NDISerial
+  This is the same as ndiSerialRead(), but it also provides the times
+  at which the first and the last characters of the reply arrived, as
+  given by ndiTimeNanoseconds().  Either pointer can be NULL.
+*/
+ndicapiExport int ndiSerialReadTimed(NDIFileHandle serial_port, char* reply, int n, bool isBinary, int* errorCode,
+                                     unsigned long long* firstByteTime, unsigned long long* lastByteTime);
+
+/*! \ingroup NDISerial
+  Read whatever characters have arrived, up to a maximum of 'n'.  This
+  waits for the first character for at most the timeout period, but does
+  not wait for a complete reply, so it is suitable for reading a stream
+  of replies.
+
+  The time at which the characters arrived is stored in 'timestamp'
+  unless it is NULL.
+
+  If the return value is negative, then an IO error occurred.
+  If the return value is zero, then a timeout error occurred.
+*/
+ndicapiExport int ndiSerialReadAvailable(NDIFileHandle serial_port, char* buffer, int n, unsigned long long* timestamp);
+
 /*! \ingroup NDISerial
   Sleep for the specified number of milliseconds.  The actual sleep time
   is likely to last for 10ms longer than the specifed time due to
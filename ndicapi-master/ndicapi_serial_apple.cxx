@@ -51,17 +51,31 @@ POSSIBILITY OF SUCH DAMAGES.
 #include <sys/ioctl.h>
 #include <fcntl.h>
 #include <termios.h>
+#include <IOKit/serial/ioss.h>
+
+#include <mutex>
 
 //----------------------------------------------------------------------------
 // Some static variables to keep track of which ports are open, so that
 // we can restore the comm parameters (baud rate etc) when they are closed.
 // Restoring the comm parameters is just part of being a good neighbor.
+// The table is shared by all threads, since ndiProbeAll() opens several
+// ports at once.
 
 #define NDI_MAX_SAVE_STATE 4
 static int ndi_open_handles[4] = { -1, -1, -1, -1 };
 
 static struct termios ndi_save_termios[4];
 
+static std::mutex ndi_save_state_mutex;
+
+// Forget the state that was saved in slot i.
+static void ndiSerialForgetState(int i)
+{
+  std::lock_guard<std::mutex> lock(ndi_save_state_mutex);
+  ndi_open_handles[i] = -1;
+}
+
 //----------------------------------------------------------------------------
 ndicapiExport int ndiSerialOpen(const char* device)
 {
@@ -93,13 +107,16 @@ ndicapiExport int ndiSerialOpen(const char* device)
 
   /* save the serial port state so that it can be restored when
      the serial port is closed in ndiSerialClose() */
-  for (i = 0; i < NDI_MAX_SAVE_STATE; i++)
   {
-    if (ndi_open_handles[i] == serial_port || ndi_open_handles[i] == -1)
+    std::lock_guard<std::mutex> lock(ndi_save_state_mutex);
+    for (i = 0; i < NDI_MAX_SAVE_STATE; i++)
     {
-      ndi_open_handles[i] = serial_port;
-      tcgetattr(serial_port, &ndi_save_termios[i]);
-      break;
+      if (ndi_open_handles[i] == serial_port || ndi_open_handles[i] == -1)
+      {
+        ndi_open_handles[i] = serial_port;
+        tcgetattr(serial_port, &ndi_save_termios[i]);
+        break;
+      }
     }
   }
 
@@ -115,7 +132,7 @@ ndicapiExport int ndiSerialOpen(const char* device)
   {
     if (i < NDI_MAX_SAVE_STATE)   /* if we saved the state, forget the state */
     {
-      ndi_open_handles[i] = -1;
+      ndiSerialForgetState(i);
     }
     fcntl(serial_port, F_SETLK, &fu);
     close(serial_port);
@@ -134,13 +151,16 @@ ndicapiExport void ndiSerialClose(int serial_port)
   int i;
 
   /* restore the comm port state to from before it was opened */
-  for (i = 0; i < NDI_MAX_SAVE_STATE; i++)
   {
-    if (ndi_open_handles[i] == serial_port && ndi_open_handles[i] != -1)
+    std::lock_guard<std::mutex> lock(ndi_save_state_mutex);
+    for (i = 0; i < NDI_MAX_SAVE_STATE; i++)
     {
-      tcsetattr(serial_port, TCSANOW, &ndi_save_termios[i]);
-      ndi_open_handles[i] = -1;
-      break;
+      if (ndi_open_handles[i] == serial_port && ndi_open_handles[i] != -1)
+      {
+        tcsetattr(serial_port, TCSANOW, &ndi_save_termios[i]);
+        ndi_open_handles[i] = -1;
+        break;
+      }
     }
   }
 
@@ -190,6 +210,7 @@ ndicapiExport int ndiSerialComm(int serial_port, int baud, const char mode[4], i
 {
   struct termios t;
   int newbaud;
+  speed_t otherbaud = 0;
 
   switch (baud)
   {
@@ -214,7 +235,15 @@ ndicapiExport int ndiSerialComm(int serial_port, int baud, const char mode[4], i
       newbaud = B230400;
       break;
     default:
-      return -1;
+      // e.g. 921600 or the 1228739 baud of the NDI USB adapters,
+      // which are set with IOSSIOSPEED once the rest is in place
+      if (baud <= 0)
+      {
+        return -1;
+      }
+      newbaud = B38400;
+      otherbaud = baud;
+      break;
   }
 
   tcgetattr(serial_port, &t);         /* get I/O information */
@@ -278,7 +307,17 @@ ndicapiExport int ndiSerialComm(int serial_port, int baud, const char mode[4], i
     t.c_cflag &= ~CRTSCTS;
   }
 
-  return tcsetattr(serial_port, TCSADRAIN, &t); /* set I/O information */
+  if (tcsetattr(serial_port, TCSADRAIN, &t) != 0) /* set I/O information */
+  {
+    return -1;
+  }
+
+  if (otherbaud)
+  {
+    return ioctl(serial_port, IOSSIOSPEED, &otherbaud);
+  }
+
+  return 0;
 }
 
 //----------------------------------------------------------------------------
@@ -302,6 +341,19 @@ ndicapiExport int ndiSerialTimeout(int serial_port, int milliseconds)
   return 0;
 }
 
+//----------------------------------------------------------------------------
+ndicapiExport int ndiSerialTimeoutMicroseconds(int serial_port, long microseconds)
+{
+  /* VTIME only has 100 ms resolution, so round up */
+  return ndiSerialTimeout(serial_port, (int)((microseconds + 99999) / 100000) * 100);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiSerialSetLowLatency(int serial_port, int enable)
+{
+  return -1;
+}
+
 //----------------------------------------------------------------------------
 ndicapiExport int ndiSerialWrite(int serial_port, const char* text, int n)
 {
@@ -330,7 +382,8 @@ ndicapiExport int ndiSerialWrite(int serial_port, const char* text, int n)
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiSerialRead(int serial_port, char* reply, int numberOfBytesToRead, bool isBinary, int* errorCode)
+ndicapiExport int ndiSerialReadTimed(int serial_port, char* reply, int numberOfBytesToRead, bool isBinary, int* errorCode,
+                                     unsigned long long* firstByteTime, unsigned long long* lastByteTime)
 {
   int totalNumberOfBytesRead = 0;
   int totalNumberOfBytesToRead = numberOfBytesToRead;
@@ -355,6 +408,20 @@ ndicapiExport int ndiSerialRead(int serial_port, char* reply, int numberOfBytesT
       return 0;
     }
 
+    // note when the first and the last characters arrived
+    if (numberOfBytesRead > 0)
+    {
+      unsigned long long arrivalTime = ndiTimeNanoseconds();
+      if (totalNumberOfBytesRead == 0 && firstByteTime != NULL)
+      {
+        *firstByteTime = arrivalTime;
+      }
+      if (lastByteTime != NULL)
+      {
+        *lastByteTime = arrivalTime;
+      }
+    }
+
     totalNumberOfBytesRead += numberOfBytesRead;
     if ((!isBinary && reply[totalNumberOfBytesRead - 1] == '\r')       /* done when carriage return received (ASCII) or when ERROR... received (binary)*/
         || (isBinary && strncmp(reply, "ERROR", 5) == 0 && reply[totalNumberOfBytesRead - 1] == '\r'))
@@ -374,6 +441,34 @@ ndicapiExport int ndiSerialRead(int serial_port, char* reply, int numberOfBytesT
   return totalNumberOfBytesRead;
 }
 
+//----------------------------------------------------------------------------
+ndicapiExport int ndiSerialRead(int serial_port, char* reply, int numberOfBytesToRead, bool isBinary, int* errorCode)
+{
+  return ndiSerialReadTimed(serial_port, reply, numberOfBytesToRead, isBinary, errorCode, NULL, NULL);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiSerialReadAvailable(int serial_port, char* buffer, int n, unsigned long long* timestamp)
+{
+  int m = read(serial_port, buffer, n);
+
+  if (m == -1)
+  {
+    if (errno == EAGAIN || errno == EINTR) /* canceled, treat as timeout */
+    {
+      return 0;
+    }
+    return -1; /* IO error occurred */
+  }
+
+  if (m > 0 && timestamp != NULL)
+  {
+    *timestamp = ndiTimeNanoseconds();
+  }
+
+  return m;
+}
+
 //----------------------------------------------------------------------------
 ndicapiExport int ndiSerialSleep(int serial_port, int milliseconds)
 {
@@ -51,17 +51,150 @@ POSSIBILITY OF SUCH DAMAGES.
 #include <sys/ioctl.h>
 #include <fcntl.h>
 #include <termios.h>
+#include <poll.h>
+#include <limits.h>
+
+#include <mutex>
+
+#if defined(linux) || defined(__linux__)
+  #include <linux/serial.h>
+  #include <asm/ioctls.h>
+  // Rates without a Bxxx constant are set with termios2 and BOTHER.  The
+  // struct is in <asm/termbits.h>, which conflicts with <termios.h>, so it
+  // is declared here with the layout that x86, ARM and RISC-V use.
+  #if (defined(__i386__) || defined(__x86_64__) || defined(__arm__) || defined(__aarch64__) || \
+       defined(__riscv)) && defined(TCGETS2) && defined(TCSETSW2)
+    #define NDI_HAVE_TERMIOS2
+    struct termios2
+    {
+      tcflag_t c_iflag;
+      tcflag_t c_oflag;
+      tcflag_t c_cflag;
+      tcflag_t c_lflag;
+      cc_t c_line;
+      cc_t c_cc[19];
+      speed_t c_ispeed;
+      speed_t c_ospeed;
+    };
+    #ifndef BOTHER
+      #define BOTHER 0010000
+    #endif
+  #endif
+#endif
+
+#include "ndicapi.h"
 
 //----------------------------------------------------------------------------
 // Some static variables to keep track of which ports are open, so that
 // we can restore the comm parameters (baud rate etc) when they are closed.
 // Restoring the comm parameters is just part of being a good neighbor.
+// The table is shared by all threads, since ndiProbeAll() opens several
+// ports at once.
 
 #define NDI_MAX_SAVE_STATE 4
 static int ndi_open_handles[4] = { -1, -1, -1, -1 };
 
 static struct termios ndi_save_termios[4];
 
+static std::mutex ndi_save_state_mutex;
+
+// Forget the state that was saved in slot i.
+static void ndiSerialForgetState(int i)
+{
+  std::lock_guard<std::mutex> lock(ndi_save_state_mutex);
+  ndi_open_handles[i] = -1;
+}
+
+//----------------------------------------------------------------------------
+// The read timeout for each port in microseconds, indexed by the file
+// descriptor, where zero means the default of TIMEOUT_PERIOD.  Reads wait
+// with poll() rather than VTIME, which only has 100 ms resolution.
+
+#define NDI_MAX_TIMEOUT_PORTS 1024
+static long ndi_timeout_us[NDI_MAX_TIMEOUT_PORTS];
+
+static void ndiSerialSetTimeoutUs(int serial_port, long microseconds)
+{
+  if (serial_port >= 0 && serial_port < NDI_MAX_TIMEOUT_PORTS)
+  {
+    ndi_timeout_us[serial_port] = microseconds;
+  }
+}
+
+static long ndiSerialGetTimeoutUs(int serial_port)
+{
+  if (serial_port >= 0 && serial_port < NDI_MAX_TIMEOUT_PORTS &&
+      ndi_timeout_us[serial_port] > 0)
+  {
+    return ndi_timeout_us[serial_port];
+  }
+  return TIMEOUT_PERIOD * 1000L;
+}
+
+//----------------------------------------------------------------------------
+// Get the time that is the given number of microseconds from now.
+static void ndiSerialDeadline(long microseconds, struct timespec* deadline)
+{
+  clock_gettime(CLOCK_MONOTONIC, deadline);
+  deadline->tv_sec += microseconds / 1000000;
+  deadline->tv_nsec += (microseconds % 1000000) * 1000;
+  if (deadline->tv_nsec >= 1000000000)
+  {
+    deadline->tv_sec++;
+    deadline->tv_nsec -= 1000000000;
+  }
+}
+
+//----------------------------------------------------------------------------
+// Wait until the port has data or the deadline passes.  Returns 1 if
+// there is data, 0 on timeout, or -1 if the port failed or hung up
+// (e.g. a USB adapter was unplugged).
+static int ndiSerialWaitReadable(int serial_port, const struct timespec* deadline)
+{
+  for (;;)
+  {
+    struct timespec now, remaining;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    remaining.tv_sec = deadline->tv_sec - now.tv_sec;
+    remaining.tv_nsec = deadline->tv_nsec - now.tv_nsec;
+    if (remaining.tv_nsec < 0)
+    {
+      remaining.tv_sec--;
+      remaining.tv_nsec += 1000000000;
+    }
+    if (remaining.tv_sec < 0)
+    {
+      return 0;
+    }
+
+    struct pollfd pfd;
+    pfd.fd = serial_port;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+#if defined(linux) || defined(__linux__)
+    int r = ppoll(&pfd, 1, &remaining, NULL);
+#else
+    int r = poll(&pfd, 1, (int)(remaining.tv_sec * 1000 + (remaining.tv_nsec + 999999) / 1000000));
+#endif
+    if (r < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return -1;
+    }
+    else if (r > 0)
+    {
+      if ((pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) && !(pfd.revents & POLLIN))
+      {
+        return -1;
+      }
+      return 1;
+    }
+  }
+}
+
 //----------------------------------------------------------------------------
 ndicapiExport int ndiSerialOpen(const char* device)
 {
@@ -101,13 +234,16 @@ ndicapiExport int ndiSerialOpen(const char* device)
 
   /* save the serial port state so that it can be restored when
      the serial port is closed in ndiSerialClose() */
-  for (i = 0; i < NDI_MAX_SAVE_STATE; i++)
   {
-    if (ndi_open_handles[i] == serial_port || ndi_open_handles[i] == -1)
+    std::lock_guard<std::mutex> lock(ndi_save_state_mutex);
+    for (i = 0; i < NDI_MAX_SAVE_STATE; i++)
     {
-      ndi_open_handles[i] = serial_port;
-      tcgetattr(serial_port, &ndi_save_termios[i]);
-      break;
+      if (ndi_open_handles[i] == serial_port || ndi_open_handles[i] == -1)
+      {
+        ndi_open_handles[i] = serial_port;
+        tcgetattr(serial_port, &ndi_save_termios[i]);
+        break;
+      }
     }
   }
 
@@ -116,14 +252,14 @@ ndicapiExport int ndiSerialOpen(const char* device)
   t.c_iflag = 0;
   t.c_oflag = 0;
 
-  t.c_cc[VMIN] = 0;                    /* use constant, not interval timeout */
-  t.c_cc[VTIME] = TIMEOUT_PERIOD / 100; /* wait for 5 secs max */
+  t.c_cc[VMIN] = 0;                    /* read() never blocks, the wait */
+  t.c_cc[VTIME] = 0;                   /* is done with poll() instead */
 
   if (tcsetattr(serial_port, TCSANOW, &t) == -1) /* set I/O information */
   {
     if (i < NDI_MAX_SAVE_STATE)   /* if we saved the state, forget the state */
     {
-      ndi_open_handles[i] = -1;
+      ndiSerialForgetState(i);
     }
     fcntl(serial_port, F_SETLK, &fu);
     close(serial_port);
@@ -132,6 +268,8 @@ ndicapiExport int ndiSerialOpen(const char* device)
 
   tcflush(serial_port, TCIOFLUSH);        /* flush the buffers for good luck */
 
+  ndiSerialSetTimeoutUs(serial_port, TIMEOUT_PERIOD * 1000L);
+
   return serial_port;
 }
 
@@ -142,19 +280,24 @@ ndicapiExport void ndiSerialClose(int serial_port)
   int i;
 
   /* restore the comm port state to from before it was opened */
-  for (i = 0; i < NDI_MAX_SAVE_STATE; i++)
   {
-    if (ndi_open_handles[i] == serial_port && ndi_open_handles[i] != -1)
+    std::lock_guard<std::mutex> lock(ndi_save_state_mutex);
+    for (i = 0; i < NDI_MAX_SAVE_STATE; i++)
     {
-      tcsetattr(serial_port, TCSANOW, &ndi_save_termios[i]);
-      ndi_open_handles[i] = -1;
-      break;
+      if (ndi_open_handles[i] == serial_port && ndi_open_handles[i] != -1)
+      {
+        tcsetattr(serial_port, TCSANOW, &ndi_save_termios[i]);
+        ndi_open_handles[i] = -1;
+        break;
+      }
     }
   }
 
   /* release our lock on the serial port */
   fcntl(serial_port, F_SETLK, &fu);
 
+  ndiSerialSetTimeoutUs(serial_port, 0);
+
   close(serial_port);
 }
 
@@ -206,6 +349,7 @@ ndicapiExport int ndiSerialComm(int serial_port, int baud, const char mode[4], i
 {
   struct termios t;
   int newbaud;
+  int otherbaud = 0;
 
 #if defined(linux) || defined(__linux__)
   switch (baud)
@@ -230,8 +374,25 @@ ndicapiExport int ndiSerialComm(int serial_port, int baud, const char mode[4], i
     case 230400:
       newbaud = B230400;
       break;
+    case 460800:
+      newbaud = B460800;
+      break;
+    case 921600:
+      newbaud = B921600;
+      break;
     default:
+#ifdef NDI_HAVE_TERMIOS2
+      // e.g. the 1228739 baud of the NDI USB adapters
+      if (baud <= 0)
+      {
+        return -1;
+      }
+      newbaud = B38400;
+      otherbaud = baud;
+      break;
+#else
       return -1;
+#endif
   }
 #elif defined(sgi) && defined(__NEW_MAX_BAUD)
   switch (baud)
@@ -355,28 +516,102 @@ ndicapiExport int ndiSerialComm(int serial_port, int baud, const char mode[4], i
 #endif
   }
 
-  return tcsetattr(serial_port, TCSADRAIN, &t); /* set I/O information */
+  if (tcsetattr(serial_port, TCSADRAIN, &t) != 0) /* set I/O information */
+  {
+    return -1;
+  }
+
+#ifdef NDI_HAVE_TERMIOS2
+  if (otherbaud)
+  {
+    struct termios2 t2;
+    if (ioctl(serial_port, TCGETS2, &t2) != 0)
+    {
+      return -1;
+    }
+    t2.c_cflag &= ~CBAUD;
+    t2.c_cflag |= BOTHER;
+    t2.c_ispeed = otherbaud;
+    t2.c_ospeed = otherbaud;
+    return ioctl(serial_port, TCSETSW2, &t2);
+  }
+#endif
+
+  return (otherbaud ? -1 : 0);
 }
 
 //----------------------------------------------------------------------------
 ndicapiExport int ndiSerialTimeout(int serial_port, int milliseconds)
 {
-  struct termios t;
+  return ndiSerialTimeoutMicroseconds(serial_port, milliseconds * 1000L);
+}
 
-  if (tcgetattr(serial_port, &t) == -1)
+//----------------------------------------------------------------------------
+ndicapiExport int ndiSerialTimeoutMicroseconds(int serial_port, long microseconds)
+{
+  if (microseconds <= 0 || fcntl(serial_port, F_GETFD) == -1)
   {
     return -1;
   }
 
-  t.c_cc[VMIN] = 0;                  /* use constant, not interval timout */
-  t.c_cc[VTIME] = milliseconds / 100; /* wait time is in 10ths of a second */
+  ndiSerialSetTimeoutUs(serial_port, microseconds);
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiSerialSetLowLatency(int serial_port, int enable)
+{
+#if defined(linux) || defined(__linux__)
+  int result = -1;
 
-  if (tcsetattr(serial_port, TCSANOW, &t) == -1)
+  /* ask the driver to push received data up without delay, the ftdi_sio
+     driver also sets its latency timer to 1 ms when this flag is set */
+  struct serial_struct info;
+  if (ioctl(serial_port, TIOCGSERIAL, &info) == 0)
   {
-    return -1;
+    if (enable)
+    {
+      info.flags |= ASYNC_LOW_LATENCY;
+    }
+    else
+    {
+      info.flags &= ~ASYNC_LOW_LATENCY;
+    }
+    if (ioctl(serial_port, TIOCSSERIAL, &info) == 0)
+    {
+      result = 0;
+    }
   }
 
-  return 0;
+  /* FTDI adapters otherwise hold received data for up to 16 ms before
+     sending it over USB, so set the latency timer directly as well */
+  char path[64];
+  char device[PATH_MAX];
+  snprintf(path, sizeof(path), "/proc/self/fd/%d", serial_port);
+  ssize_t n = readlink(path, device, sizeof(device) - 1);
+  if (n > 0)
+  {
+    device[n] = '\0';
+    const char* name = strrchr(device, '/');
+    name = (name ? name + 1 : device);
+    char latencyPath[sizeof(device) + 64];
+    snprintf(latencyPath, sizeof(latencyPath), "/sys/bus/usb-serial/devices/%s/latency_timer", name);
+    FILE* file = fopen(latencyPath, "w");
+    if (file)
+    {
+      fprintf(file, "%d", (enable ? 1 : 16));
+      if (fclose(file) == 0)
+      {
+        result = 0;
+      }
+    }
+  }
+
+  return result;
+#else
+  return -1;
+#endif
 }
 
 //----------------------------------------------------------------------------
@@ -407,29 +642,71 @@ ndicapiExport int ndiSerialWrite(int serial_port, const char* text, int n)
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiSerialRead(int serial_port, char* reply, int numberOfBytesToRead, bool isBinary, int* errorCode)
+ndicapiExport int ndiSerialReadTimed(int serial_port, char* reply, int numberOfBytesToRead, bool isBinary, int* errorCode,
+                                     unsigned long long* firstByteTime, unsigned long long* lastByteTime)
 {
   int totalNumberOfBytesRead = 0;
   int totalNumberOfBytesToRead = numberOfBytesToRead;
   int numberOfBytesRead;
   bool binarySizeCalculated = false;
+  struct timespec deadline;
+
+  /* the timeout applies to the whole reply, not to each read */
+  ndiSerialDeadline(ndiSerialGetTimeoutUs(serial_port), &deadline);
 
   do
   {
-    if ((numberOfBytesRead = read(serial_port, &reply[totalNumberOfBytesRead], numberOfBytesToRead)) == -1)
+    int ready = ndiSerialWaitReadable(serial_port, &deadline);
+    if (ready < 0)
+    {
+      if (errorCode != NULL)
+      {
+        *errorCode = NDI_READ_ERROR;
+      }
+      return -1; /* IO error occurred */
+    }
+    else if (ready == 0)   /* deadline passed, must have timed out */
+    {
+      return 0;
+    }
+    unsigned long long arrivalTime = ndiTimeNanoseconds();
+
+    /* never read past the end of the expected reply */
+    if ((numberOfBytesRead = read(serial_port, &reply[totalNumberOfBytesRead], totalNumberOfBytesToRead - totalNumberOfBytesRead)) == -1)
     {
-      if (errno == EAGAIN) /* canceled, so retry */
+      if (errno == EAGAIN || errno == EINTR) /* canceled, so retry */
       {
         numberOfBytesRead = 0;
       }
       else
       {
+        if (errorCode != NULL)
+        {
+          *errorCode = NDI_READ_ERROR;
+        }
         return -1; /* IO error occurred */
       }
     }
-    else if (numberOfBytesRead == 0)   /* no characters read, must have timed out */
+    else if (numberOfBytesRead == 0)   /* readable but no data, the port hung up */
     {
-      return 0;
+      if (errorCode != NULL)
+      {
+        *errorCode = NDI_READ_ERROR;
+      }
+      return -1;
+    }
+
+    // note when the first and the last characters arrived
+    if (numberOfBytesRead > 0)
+    {
+      if (totalNumberOfBytesRead == 0 && firstByteTime != NULL)
+      {
+        *firstByteTime = arrivalTime;
+      }
+      if (lastByteTime != NULL)
+      {
+        *lastByteTime = arrivalTime;
+      }
     }
 
     totalNumberOfBytesRead += numberOfBytesRead;
@@ -439,11 +716,12 @@ ndicapiExport int ndiSerialRead(int serial_port, char* reply, int numberOfBytesT
       break;
     }
 
-    if (isBinary && !binarySizeCalculated && reply[0] == (char)0xc4 && reply[1] == (char)0xa5)
+    if (isBinary && !binarySizeCalculated && totalNumberOfBytesRead >= 4 && reply[0] == (char)0xc4 && reply[1] == (char)0xa5)
     {
       // recalculate n based on the reply length (reported from ndi device) and the amount of data received so far
-      unsigned short size = ((unsigned char)reply[2] | (unsigned char)reply[3] << 8) + 8; // 8 bytes -> 2 for Start Sequence (a5c4), 2 for reply length, 2 for header CRC, 2 for CRC16
-      totalNumberOfBytesToRead = size;
+      int size = ((unsigned char)reply[2] | (unsigned char)reply[3] << 8) + 8; // 8 bytes -> 2 for Start Sequence (a5c4), 2 for reply length, 2 for header CRC, 2 for CRC16
+      totalNumberOfBytesToRead = (size < numberOfBytesToRead ? size : numberOfBytesToRead);
+      binarySizeCalculated = true;
     }
   }
   while (totalNumberOfBytesRead != totalNumberOfBytesToRead);
@@ -451,6 +729,48 @@ ndicapiExport int ndiSerialRead(int serial_port, char* reply, int numberOfBytesT
   return totalNumberOfBytesRead;
 }
 
+//----------------------------------------------------------------------------
+ndicapiExport int ndiSerialRead(int serial_port, char* reply, int numberOfBytesToRead, bool isBinary, int* errorCode)
+{
+  return ndiSerialReadTimed(serial_port, reply, numberOfBytesToRead, isBinary, errorCode, NULL, NULL);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiSerialReadAvailable(int serial_port, char* buffer, int n, unsigned long long* timestamp)
+{
+  struct timespec deadline;
+
+  ndiSerialDeadline(ndiSerialGetTimeoutUs(serial_port), &deadline);
+  int ready = ndiSerialWaitReadable(serial_port, &deadline);
+  if (ready <= 0)
+  {
+    return ready;
+  }
+  unsigned long long arrivalTime = ndiTimeNanoseconds();
+
+  int m = read(serial_port, buffer, n);
+
+  if (m == -1)
+  {
+    if (errno == EAGAIN || errno == EINTR) /* canceled, treat as timeout */
+    {
+      return 0;
+    }
+    return -1; /* IO error occurred */
+  }
+  else if (m == 0) /* readable but no data, the port hung up */
+  {
+    return -1;
+  }
+
+  if (timestamp != NULL)
+  {
+    *timestamp = arrivalTime;
+  }
+
+  return m;
+}
+
 //----------------------------------------------------------------------------
 ndicapiExport int ndiSerialSleep(int serial_port, int milliseconds)
 {
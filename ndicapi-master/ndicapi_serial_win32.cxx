@@ -41,6 +41,8 @@ POSSIBILITY OF SUCH DAMAGES.
 #include <winbase.h>
 #include <sys/timeb.h>
 
+#include <mutex>
+
 // USB versions of NDI tracking can communicate at baud rate 921600 but is not defined in WinBase.h
 #ifndef CBR_921600
   #define CBR_921600 921600
@@ -52,6 +54,8 @@ POSSIBILITY OF SUCH DAMAGES.
 // Some static variables to keep track of which ports are open, so that
 // we can restore the comm parameters (baud rate etc) when they are closed.
 // Restoring the comm parameters is just part of being a good neighbor.
+// The table is shared by all threads, since ndiProbeAll() opens several
+// ports at once.
 
 #define NDI_MAX_SAVE_STATE 4
 static HANDLE ndi_open_handles[4] = { INVALID_HANDLE_VALUE,
@@ -63,6 +67,15 @@ static HANDLE ndi_open_handles[4] = { INVALID_HANDLE_VALUE,
 static COMMTIMEOUTS ndi_save_timeouts[4];
 static DCB ndi_save_dcb[4];
 
+static std::mutex ndi_save_state_mutex;
+
+// Forget the state that was saved in slot i.
+static void ndiSerialForgetState(int i)
+{
+  std::lock_guard<std::mutex> lock(ndi_save_state_mutex);
+  ndi_open_handles[i] = INVALID_HANDLE_VALUE;
+}
+
 //----------------------------------------------------------------------------
 ndicapiExport HANDLE ndiSerialOpen(const char* device)
 {
@@ -84,14 +97,17 @@ ndicapiExport HANDLE ndiSerialOpen(const char* device)
 
   // Save the serial port state so that it can be restored when
   //   the serial port is closed in ndiSerialClose()
-  for (i = 0; i < NDI_MAX_SAVE_STATE; i++)
   {
-    if (ndi_open_handles[i] == serial_port || ndi_open_handles[i] == INVALID_HANDLE_VALUE)
+    std::lock_guard<std::mutex> lock(ndi_save_state_mutex);
+    for (i = 0; i < NDI_MAX_SAVE_STATE; i++)
     {
-      ndi_open_handles[i] = serial_port;
-      GetCommTimeouts(serial_port, &ndi_save_timeouts[i]);
-      GetCommState(serial_port, &ndi_save_dcb[i]);
-      break;
+      if (ndi_open_handles[i] == serial_port || ndi_open_handles[i] == INVALID_HANDLE_VALUE)
+      {
+        ndi_open_handles[i] = serial_port;
+        GetCommTimeouts(serial_port, &ndi_save_timeouts[i]);
+        GetCommState(serial_port, &ndi_save_dcb[i]);
+        break;
+      }
     }
   }
 
@@ -99,7 +115,7 @@ ndicapiExport HANDLE ndiSerialOpen(const char* device)
   {
     if (i < NDI_MAX_SAVE_STATE)   /* if we saved the state, forget the state */
     {
-      ndi_open_handles[i] = INVALID_HANDLE_VALUE;
+      ndiSerialForgetState(i);
     }
     CloseHandle(serial_port);
     return INVALID_HANDLE_VALUE;
@@ -109,7 +125,7 @@ ndicapiExport HANDLE ndiSerialOpen(const char* device)
   {
     if (i < NDI_MAX_SAVE_STATE)   /* if we saved the state, forget the state */
     {
-      ndi_open_handles[i] = INVALID_HANDLE_VALUE;
+      ndiSerialForgetState(i);
     }
     CloseHandle(serial_port);
     return INVALID_HANDLE_VALUE;
@@ -125,7 +141,7 @@ ndicapiExport HANDLE ndiSerialOpen(const char* device)
   {
     if (i < NDI_MAX_SAVE_STATE)   /* if we saved the state, forget the state */
     {
-      ndi_open_handles[i] = INVALID_HANDLE_VALUE;
+      ndiSerialForgetState(i);
     }
     CloseHandle(serial_port);
     return INVALID_HANDLE_VALUE;
@@ -137,7 +153,7 @@ ndicapiExport HANDLE ndiSerialOpen(const char* device)
     if (i < NDI_MAX_SAVE_STATE)   /* if we saved the state, forget the state */
     {
       SetCommState(serial_port, &ndi_save_dcb[i]);
-      ndi_open_handles[i] = INVALID_HANDLE_VALUE;
+      ndiSerialForgetState(i);
     }
     CloseHandle(serial_port);
     return INVALID_HANDLE_VALUE;
@@ -152,15 +168,18 @@ ndicapiExport void ndiSerialClose(HANDLE serial_port)
   int i;
 
   /* restore the comm port state to from before it was opened */
-  for (i = 0; i < NDI_MAX_SAVE_STATE; i++)
   {
-    if (ndi_open_handles[i] == serial_port &&
-        ndi_open_handles[i] != INVALID_HANDLE_VALUE)
+    std::lock_guard<std::mutex> lock(ndi_save_state_mutex);
+    for (i = 0; i < NDI_MAX_SAVE_STATE; i++)
     {
-      SetCommTimeouts(serial_port, &ndi_save_timeouts[i]);
-      SetCommState(serial_port, &ndi_save_dcb[i]);
-      ndi_open_handles[i] = INVALID_HANDLE_VALUE;
-      break;
+      if (ndi_open_handles[i] == serial_port &&
+          ndi_open_handles[i] != INVALID_HANDLE_VALUE)
+      {
+        SetCommTimeouts(serial_port, &ndi_save_timeouts[i]);
+        SetCommState(serial_port, &ndi_save_dcb[i]);
+        ndi_open_handles[i] = INVALID_HANDLE_VALUE;
+        break;
+      }
     }
   }
 
@@ -248,7 +267,13 @@ ndicapiExport int ndiSerialComm(HANDLE serial_port, int baud, const char* mode,
       newbaud = 230400;
       break;
     default:
-      return -1;
+      // the DCB takes any rate that the driver supports
+      if (baud <= 0)
+      {
+        return -1;
+      }
+      newbaud = baud;
+      break;
   }
 
   GetCommState(serial_port, &comm_settings);
@@ -337,6 +362,20 @@ ndicapiExport int ndiSerialTimeout(HANDLE serial_port, int milliseconds)
   return 0;
 }
 
+//----------------------------------------------------------------------------
+ndicapiExport int ndiSerialTimeoutMicroseconds(HANDLE serial_port, long microseconds)
+{
+  // COMMTIMEOUTS only has millisecond resolution
+  return ndiSerialTimeout(serial_port, (int)((microseconds + 999) / 1000));
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiSerialSetLowLatency(HANDLE serial_port, int enable)
+{
+  // the FTDI latency timer can only be changed in the driver settings
+  return -1;
+}
+
 //----------------------------------------------------------------------------
 ndicapiExport int ndiSerialWrite(HANDLE serial_port, const char* text, int n)
 {
@@ -369,7 +408,8 @@ ndicapiExport int ndiSerialWrite(HANDLE serial_port, const char* text, int n)
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiSerialRead(HANDLE serial_port, char* reply, int numberOfBytesToRead, bool isBinary, int* errorCode)
+ndicapiExport int ndiSerialReadTimed(HANDLE serial_port, char* reply, int numberOfBytesToRead, bool isBinary, int* errorCode,
+                                     unsigned long long* firstByteTime, unsigned long long* lastByteTime)
 {
   int totalNumberOfBytesRead = 0;
   int totalNumberOfBytesToRead = numberOfBytesToRead;
@@ -395,6 +435,20 @@ ndicapiExport int ndiSerialRead(HANDLE serial_port, char* reply, int numberOfByt
       return 0;
     }
 
+    // note when the first and the last characters arrived
+    if (numberOfBytesRead > 0)
+    {
+      unsigned long long arrivalTime = ndiTimeNanoseconds();
+      if (totalNumberOfBytesRead == 0 && firstByteTime != NULL)
+      {
+        *firstByteTime = arrivalTime;
+      }
+      if (lastByteTime != NULL)
+      {
+        *lastByteTime = arrivalTime;
+      }
+    }
+
     totalNumberOfBytesRead += numberOfBytesRead;
     if (!isBinary && reply[totalNumberOfBytesRead - 1] == '\r'       /* done when carriage return received (ASCII) or when ERROR... received (binary)*/
         || isBinary && strncmp(reply, "ERROR", 5) == 0 && reply[totalNumberOfBytesRead - 1] == '\r')
@@ -422,6 +476,38 @@ ndicapiExport int ndiSerialRead(HANDLE serial_port, char* reply, int numberOfByt
   return totalNumberOfBytesRead;
 }
 
+//----------------------------------------------------------------------------
+ndicapiExport int ndiSerialRead(HANDLE serial_port, char* reply, int numberOfBytesToRead, bool isBinary, int* errorCode)
+{
+  return ndiSerialReadTimed(serial_port, reply, numberOfBytesToRead, isBinary, errorCode, NULL, NULL);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiSerialReadAvailable(HANDLE serial_port, char* buffer, int n, unsigned long long* timestamp)
+{
+  DWORD m;
+
+  // the timeouts set by ndiSerialTimeout() make ReadFile() return as soon
+  // as at least one character has arrived
+  if (ReadFile(serial_port, buffer, n, &m, NULL) == FALSE)
+  {
+    if (GetLastError() == ERROR_OPERATION_ABORTED)  /* canceled */
+    {
+      DWORD dummyVariable;
+      ClearCommError(serial_port, &dummyVariable, NULL);
+      return 0;
+    }
+    return -1;  /* IO error occurred */
+  }
+
+  if (m > 0 && timestamp != NULL)
+  {
+    *timestamp = ndiTimeNanoseconds();
+  }
+
+  return (int)m;
+}
+
 //----------------------------------------------------------------------------
 ndicapiExport int ndiSerialSleep(HANDLE serial_port, int milliseconds)
 {
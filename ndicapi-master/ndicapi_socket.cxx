@@ -15,15 +15,498 @@ See License.md for details.
 #include <stdlib.h>
 #include <string.h>
 
+#include <deque>
+#include <map>
+#include <mutex>
+
+#include "ndicapi.h"
 #include "ndicapi_socket.h"
+#include "ndicapi_thread.h"
+
+// time out period in milliseconds, for connecting and for each reply
+#define TIMEOUT_PERIOD_MS 5000
 
-// time out period in milliseconds
-#define TIMEOUT_PERIOD_MS 500
+// return values of ndiSocketRecv() and ndiSocketSend() besides the count
+#define NDI_SOCKET_CLOSED       0
+#define NDI_SOCKET_WOULD_BLOCK -1
+#define NDI_SOCKET_ERROR       -2
 
+// The platform files provide the following, for a non-blocking socket:
+//   bool ndiSocketStartup()
+//   void ndiSocketCloseHandle(NDISocketHandle socket)
+//   bool ndiSocketConfigure(NDISocketHandle socket)  - options, non-blocking
+//   bool ndiSocketConnectInProgress()                 - after connect() fails
+//   int ndiSocketConnectError(NDISocketHandle socket) - SO_ERROR
+//   int ndiSocketWait(NDISocketHandle socket, bool write, int milliseconds)
+//   int ndiSocketRecv(NDISocketHandle socket, char* buffer, int n, unsigned long long* arrivalTime)
+//   int ndiSocketSend(NDISocketHandle socket, const char* buffer, int n)
 #ifdef _WIN32
   #include "ndicapi_socket_win32.cxx"
 #elif defined(unix) || defined(__unix__) || defined(__linux__)
   #include "ndicapi_socket_unix.cxx"
 #elif defined(__APPLE__)
   #include "ndicapi_socket_apple.cxx"
-#endif
\ No newline at end of file
+#endif
+
+//----------------------------------------------------------------------------
+// The read-ahead buffer for each open socket.  Whatever recv() returns goes
+// into the buffer, and the replies are cut from it, so that a reply costs
+// one or two system calls no matter how it is split into TCP segments,
+// and bytes that arrive after a reply are kept for the next one.
+namespace
+{
+  const int NDI_SOCKET_BUFFER_SIZE = 2 * 65544;
+
+  struct ndiSocketState
+  {
+    int TimeoutMs;
+    int Start;                            // first unread byte in Buffer
+    int End;                              // end of the unread bytes
+    unsigned long long Received;          // bytes ever put in the buffer
+    unsigned long long Consumed;          // bytes ever taken from it
+    // for each recv(), the value of Received afterwards and the time
+    std::deque<std::pair<unsigned long long, unsigned long long> > Arrivals;
+    char Buffer[NDI_SOCKET_BUFFER_SIZE];
+  };
+
+  std::mutex ndiSocketStatesMutex;
+  std::map<NDISocketHandle, ndiSocketState*> ndiSocketStates;
+
+  // Give a socket that was just opened an empty buffer, replacing any that
+  // was left behind by an earlier socket with the same handle.
+  void ndiSocketNewState(NDISocketHandle socket)
+  {
+    ndiSocketState* state = new ndiSocketState;
+    state->TimeoutMs = TIMEOUT_PERIOD_MS;
+    state->Start = 0;
+    state->End = 0;
+    state->Received = 0;
+    state->Consumed = 0;
+
+    std::lock_guard<std::mutex> lock(ndiSocketStatesMutex);
+    ndiSocketState*& entry = ndiSocketStates[socket];
+    delete entry;
+    entry = state;
+  }
+
+  // The buffer for an open socket, or NULL if the socket was not opened
+  // with ndiSocketOpen() or ndiSocketAttach().
+  ndiSocketState* ndiSocketGetState(NDISocketHandle socket)
+  {
+    std::lock_guard<std::mutex> lock(ndiSocketStatesMutex);
+    std::map<NDISocketHandle, ndiSocketState*>::iterator it = ndiSocketStates.find(socket);
+    return (it != ndiSocketStates.end() ? it->second : NULL);
+  }
+
+  void ndiSocketFreeState(NDISocketHandle socket)
+  {
+    std::lock_guard<std::mutex> lock(ndiSocketStatesMutex);
+    std::map<NDISocketHandle, ndiSocketState*>::iterator it = ndiSocketStates.find(socket);
+    if (it != ndiSocketStates.end())
+    {
+      delete it->second;
+      ndiSocketStates.erase(it);
+    }
+  }
+
+  // The time at which the given byte (counting from the first byte ever
+  // received) arrived.
+  unsigned long long ndiSocketArrivalTime(ndiSocketState* state, unsigned long long byte)
+  {
+    for (size_t i = 0; i < state->Arrivals.size(); i++)
+    {
+      if (state->Arrivals[i].first > byte)
+      {
+        return state->Arrivals[i].second;
+      }
+    }
+    return ndiTimeNanoseconds();
+  }
+
+  // Take n bytes from the buffer, and say when they arrived.
+  void ndiSocketConsume(ndiSocketState* state, char* data, int n,
+                        unsigned long long* firstByteTime, unsigned long long* lastByteTime)
+  {
+    memcpy(data, &state->Buffer[state->Start], n);
+    if (firstByteTime != NULL)
+    {
+      *firstByteTime = ndiSocketArrivalTime(state, state->Consumed);
+    }
+    if (lastByteTime != NULL)
+    {
+      *lastByteTime = ndiSocketArrivalTime(state, state->Consumed + n - 1);
+    }
+    state->Start += n;
+    state->Consumed += n;
+    while (!state->Arrivals.empty() && state->Arrivals.front().first <= state->Consumed)
+    {
+      state->Arrivals.pop_front();
+    }
+    if (state->Start == state->End)
+    {
+      state->Start = 0;
+      state->End = 0;
+    }
+  }
+
+  void ndiSocketDiscard(ndiSocketState* state)
+  {
+    state->Consumed = state->Received;
+    state->Arrivals.clear();
+    state->Start = 0;
+    state->End = 0;
+  }
+
+  // Receive into the buffer, the return value is as for ndiSocketRecv().
+  int ndiSocketFill(NDISocketHandle socket, ndiSocketState* state)
+  {
+    if (state->End == NDI_SOCKET_BUFFER_SIZE && state->Start > 0)
+    {
+      memmove(state->Buffer, &state->Buffer[state->Start], state->End - state->Start);
+      state->End -= state->Start;
+      state->Start = 0;
+    }
+    unsigned long long arrivalTime;
+    int m = ndiSocketRecv(socket, &state->Buffer[state->End], NDI_SOCKET_BUFFER_SIZE - state->End, &arrivalTime);
+    if (m > 0)
+    {
+      state->End += m;
+      state->Received += m;
+      state->Arrivals.push_back(std::make_pair(state->Received, arrivalTime));
+    }
+    return m;
+  }
+
+  // The length of the complete reply at the start of the data, or zero if
+  // more data is needed.  Binary replies start with 0xA5C4 (or 0xB5D4 when
+  // streamed) and give their length in the header, all other replies end
+  // with a carriage return.
+  int ndiSocketReplyLength(const char* data, int n, bool isBinary)
+  {
+    if (isBinary && n >= 2 &&
+        (((unsigned char)data[0] == 0xc4 && (unsigned char)data[1] == 0xa5) ||
+         ((unsigned char)data[0] == 0xd4 && (unsigned char)data[1] == 0xb5)))
+    {
+      if (n < 4)
+      {
+        return 0;
+      }
+      // 2 bytes for the start sequence, 2 for the length, 2 for the header CRC and 2 for the CRC
+      int size = ((unsigned char)data[2] | ((unsigned char)data[3] << 8)) + 8;
+      return (n >= size ? size : 0);
+    }
+    if (isBinary && n == 1 && ((unsigned char)data[0] == 0xc4 || (unsigned char)data[0] == 0xd4))
+    {
+      return 0;
+    }
+    const char* cp = (const char*)memchr(data, '\r', n);
+    return (cp != NULL ? (int)(cp - data) + 1 : 0);
+  }
+
+  // Milliseconds until the deadline, or zero if it has passed.
+  int ndiSocketRemainingMs(unsigned long long deadline)
+  {
+    unsigned long long now = ndiTimeNanoseconds();
+    return (now >= deadline ? 0 : (int)((deadline - now + 999999) / 1000000));
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport bool ndiSocketOpen(const char* hostname, int port, NDISocketHandle& outSocket)
+{
+  if (!ndiSocketStartup())
+  {
+    return false;
+  }
+
+  struct addrinfo hints;
+  struct addrinfo* addresses = NULL;
+  char service[16];
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = IPPROTO_TCP;
+  snprintf(service, sizeof(service), "%d", port);
+
+  // allow IPv6 addresses in brackets, as in URLs
+  char host[256];
+  size_t length = strlen(hostname);
+  if (length > 2 && length < sizeof(host) + 2 && hostname[0] == '[' && hostname[length - 1] == ']')
+  {
+    memcpy(host, hostname + 1, length - 2);
+    host[length - 2] = '\0';
+    hostname = host;
+  }
+
+  if (getaddrinfo(hostname, service, &hints, &addresses) != 0 || addresses == NULL)
+  {
+    return false;
+  }
+
+  // try each of the addresses (e.g. IPv6 and IPv4) until one connects
+  unsigned long long deadline = ndiTimeNanoseconds() + TIMEOUT_PERIOD_MS * 1000000ULL;
+  NDISocketHandle sock = NDI_INVALID_SOCKET;
+  for (struct addrinfo* address = addresses; address != NULL; address = address->ai_next)
+  {
+    sock = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+    if (sock == NDI_INVALID_SOCKET)
+    {
+      continue;
+    }
+    if (ndiSocketConfigure(sock))
+    {
+      if (connect(sock, address->ai_addr, (int)address->ai_addrlen) == 0)
+      {
+        break;
+      }
+      if (ndiSocketConnectInProgress() &&
+          ndiSocketWait(sock, true, ndiSocketRemainingMs(deadline)) > 0 &&
+          ndiSocketConnectError(sock) == 0)
+      {
+        break;
+      }
+    }
+    ndiSocketCloseHandle(sock);
+    sock = NDI_INVALID_SOCKET;
+  }
+  freeaddrinfo(addresses);
+
+  if (sock == NDI_INVALID_SOCKET)
+  {
+    return false;
+  }
+
+  ndiSocketNewState(sock);
+
+  outSocket = sock;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport bool ndiSocketAttach(NDISocketHandle socket)
+{
+  if (socket == NDI_INVALID_SOCKET)
+  {
+    return false;
+  }
+  ndiSocketNewState(socket);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport void ndiSocketClose(NDISocketHandle socket)
+{
+  if (socket == NDI_INVALID_SOCKET)
+  {
+    return;
+  }
+  ndiSocketFreeState(socket);
+  ndiSocketCloseHandle(socket);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport bool ndiSocketFlush(NDISocketHandle socket, int flushtype)
+{
+  if (flushtype & NDI_IFLUSH)
+  {
+    // discard what was read ahead, and whatever else has arrived
+    ndiSocketState* state = ndiSocketGetState(socket);
+    if (state == NULL)
+    {
+      return false;
+    }
+    ndiSocketDiscard(state);
+    while (ndiSocketFill(socket, state) > 0)
+    {
+      ndiSocketDiscard(state);
+    }
+  }
+  // data that was sent cannot be taken back, so NDI_OFLUSH does nothing
+  return true;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport bool ndiSocketTimeout(NDISocketHandle socket, int timeoutMs)
+{
+  ndiSocketState* state = ndiSocketGetState(socket);
+  if (state != NULL && timeoutMs > 0)
+  {
+    state->TimeoutMs = timeoutMs;
+    return true;
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiSocketWrite(NDISocketHandle socket, const char* data, int length)
+{
+  ndiSocketState* state = ndiSocketGetState(socket);
+  if (state == NULL)
+  {
+    return -1;
+  }
+  unsigned long long deadline = ndiTimeNanoseconds() + state->TimeoutMs * 1000000ULL;
+  int total = 0;
+
+  while (total < length)
+  {
+    int n = ndiSocketSend(socket, data + total, length - total);
+    if (n > 0)
+    {
+      total += n;
+    }
+    else if (n == NDI_SOCKET_WOULD_BLOCK)
+    {
+      int r = ndiSocketWait(socket, true, ndiSocketRemainingMs(deadline));
+      if (r < 0)
+      {
+        return -1;
+      }
+      else if (r == 0)
+      {
+        // timed out
+        break;
+      }
+    }
+    else
+    {
+      return -1;
+    }
+  }
+
+  return total;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiSocketReadTimed(NDISocketHandle socket, char* reply, int numberOfBytesToRead, bool isBinary, int* outErrorCode,
+                                     unsigned long long* firstByteTime, unsigned long long* lastByteTime)
+{
+  ndiSocketState* state = ndiSocketGetState(socket);
+  if (state == NULL)
+  {
+    if (outErrorCode != NULL)
+    {
+      *outErrorCode = NDI_READ_ERROR;
+    }
+    return -1;
+  }
+  unsigned long long deadline = ndiTimeNanoseconds() + state->TimeoutMs * 1000000ULL;
+
+  for (;;)
+  {
+    int available = state->End - state->Start;
+    int n = ndiSocketReplyLength(&state->Buffer[state->Start], available, isBinary);
+    if (n == 0 && available >= numberOfBytesToRead)
+    {
+      // the reply is larger than the caller's buffer
+      n = numberOfBytesToRead;
+    }
+    if (n > 0)
+    {
+      if (n > numberOfBytesToRead)
+      {
+        n = numberOfBytesToRead;
+      }
+      ndiSocketConsume(state, reply, n, firstByteTime, lastByteTime);
+      return n;
+    }
+
+    int m = ndiSocketFill(socket, state);
+    if (m == NDI_SOCKET_WOULD_BLOCK)
+    {
+      int r = ndiSocketWait(socket, false, ndiSocketRemainingMs(deadline));
+      if (r < 0)
+      {
+        if (outErrorCode != NULL)
+        {
+          *outErrorCode = NDI_READ_ERROR;
+        }
+        return -1;
+      }
+      else if (r == 0)
+      {
+        // NDI handles 0 bytes returned as a timeout
+        if (outErrorCode != NULL)
+        {
+          *outErrorCode = NDI_TIMEOUT;
+        }
+        return 0;
+      }
+    }
+    else if (m <= 0)
+    {
+      // the connection was closed, or failed
+      if (outErrorCode != NULL)
+      {
+        *outErrorCode = NDI_READ_ERROR;
+      }
+      return -1;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiSocketRead(NDISocketHandle socket, char* reply, int numberOfBytesToRead, bool isBinary, int* outErrorCode)
+{
+  return ndiSocketReadTimed(socket, reply, numberOfBytesToRead, isBinary, outErrorCode, NULL, NULL);
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiSocketReadAvailable(NDISocketHandle socket, char* buffer, int n, unsigned long long* timestamp)
+{
+  ndiSocketState* state = ndiSocketGetState(socket);
+  if (state == NULL)
+  {
+    return -1;
+  }
+
+  // what was read ahead comes first
+  int available = state->End - state->Start;
+  if (available > 0)
+  {
+    if (available > n)
+    {
+      available = n;
+    }
+    ndiSocketConsume(state, buffer, available, NULL, timestamp);
+    return available;
+  }
+
+  unsigned long long arrivalTime;
+  int m = ndiSocketRecv(socket, buffer, n, &arrivalTime);
+  if (m == NDI_SOCKET_WOULD_BLOCK)
+  {
+    int r = ndiSocketWait(socket, false, state->TimeoutMs);
+    if (r <= 0)
+    {
+      return r;
+    }
+    m = ndiSocketRecv(socket, buffer, n, &arrivalTime);
+  }
+
+  if (m == NDI_SOCKET_WOULD_BLOCK)
+  {
+    return 0;
+  }
+  else if (m <= 0)
+  {
+    // the connection was closed, or failed
+    return -1;
+  }
+
+  state->Received += m;
+  state->Consumed += m;
+  if (timestamp != NULL)
+  {
+    *timestamp = arrivalTime;
+  }
+
+  return m;
+}
+
+//----------------------------------------------------------------------------
+ndicapiExport int ndiSocketBufferedBytes(NDISocketHandle socket)
+{
+  ndiSocketState* state = ndiSocketGetState(socket);
+  return (state != NULL ? state->End - state->Start : 0);
+}
@@ -35,15 +35,25 @@ typedef SOCKET NDISocketHandle;
 #elif defined(unix) || defined(__unix__) || defined(__APPLE__)
 typedef int NDISocketHandle;
 #define NDI_INVALID_HANDLE -1
+#define NDI_INVALID_SOCKET -1
 #elif defined(macintosh)
 typedef long NDISocketHandle;
 #define NDI_INVALID_HANDLE -1
+#define NDI_INVALID_SOCKET -1
 #endif
 
 /*! \ingroup NDISocket
 Open the specified socket.
 A return value of false means that an error occurred.
 
+The host name is resolved with getaddrinfo(), so it can be a name, an
+IPv4 address or an IPv6 address, and each address that it resolves to is
+tried until one connects within the timeout period (5 seconds).  Nagle's
+algorithm is turned off so that commands are sent at once, and TCP
+keepalive is turned on so that a device that disappears is noticed
+within seconds.  The socket is non-blocking, and the timeouts are done
+by waiting for it with poll().
+
 /return Connected or not
 /param hostname URL to connect to
 /param port Port to connect to
@@ -51,17 +61,32 @@ A return value of false means that an error occurred.
 */
 ndicapiExport bool ndiSocketOpen(const char* hostname, int port, NDISocketHandle& outSocket);
 
+/*! \ingroup NDISocket
+Use a socket that was connected by other means, e.g. one end of a
+socketpair(), with the other ndiSocket methods.  The socket must already
+be non-blocking.  It is given a read-ahead buffer, which is freed by
+ndiSocketClose().  The other methods fail for sockets that were neither
+opened nor attached.
+
+/return False if the socket is not valid
+*/
+ndicapiExport bool ndiSocketAttach(NDISocketHandle socket);
+
 /*! \ingroup NDISocket
 Close the socket.
 */
 ndicapiExport void ndiSocketClose(NDISocketHandle socket);
 
 /*! \ingroup NDISocket
-Flush out the serial I/O buffers. The following options are available:
+Flush out the socket I/O buffers. The following options are available:
 - NDI_IFLUSH:  discard the contents of the input buffer
 - NDI_OFLUSH:  discard the contents of the output buffer
 - NDI_IOFLUSH: discard the contents of both buffers.
 
+The input buffer is the data that was read ahead, together with anything
+that has arrived but has not been read.  Data that has been sent cannot
+be taken back, so NDI_OFLUSH has no effect.
+
 <p>The return value of this function will be if the call was successful.
 */
 ndicapiExport bool ndiSocketFlush(NDISocketHandle socket, int flushtype);
@@ -72,7 +97,8 @@ ndicapiExport bool ndiSocketFlush(NDISocketHandle socket, int flushtype);
 
 /*! \ingroup NDISocket
 Change the timeout for the socket in milliseconds.
-The default is 0.5 seconds, but this might be too long for certain applications.
+The default is 5 seconds, as for the serial port.  The timeout applies to
+each whole reply, and to each write.
 
 The return value will be true if the call was successful.
 */
@@ -88,11 +114,15 @@ If the return value is less than 'n', then a timeout error occurred.
 ndicapiExport int ndiSocketWrite(NDISocketHandle socket, const char* text, int n);
 
 /*! \ingroup NDISocket
-Read characters from the serial port until a carriage return is
-received.  A maximum of 'n' characters will be read.  The number
+Read characters from the socket until a carriage return is
+received, or until the whole of a binary reply is received.  A maximum of 'n' characters will be read.  The number
 of characters actually read is returned.  The resulting string will
 not be null-terminated.
 
+The socket is read in large blocks into a read-ahead buffer, and the
+reply is cut from it, so any bytes that follow the reply are kept for the
+next read.
+
 If the return value is negative, then an IO error occurred.
 If the return value is zero, then a timeout error occurred.
 If the return value is equal to 'n' and the final character
@@ -102,6 +132,36 @@ be read.
 */
 ndicapiExport int ndiSocketRead(NDISocketHandle socket, char* reply, int numberOfBytesToRead, bool isBinary, int* outErrorCode);
 
+/*! \ingroup NDISocket
+This is the same as ndiSocketRead(), but it also provides the times at
+which the first and the last characters of the reply arrived, as given
+by ndiTimeNanoseconds().  On Linux these come from the kernel receive
+timestamps (SO_TIMESTAMPNS).  Either pointer can be NULL.
+*/
+ndicapiExport int ndiSocketReadTimed(NDISocketHandle socket, char* reply, int numberOfBytesToRead, bool isBinary, int* outErrorCode,
+                                     unsigned long long* firstByteTime, unsigned long long* lastByteTime);
+
+/*! \ingroup NDISocket
+Read whatever characters have arrived, up to a maximum of 'n'.  This
+waits for the first character for at most the timeout period, but does
+not wait for a complete reply, so it is suitable for reading a stream
+of replies.
+
+If the return value is negative, then an IO error occurred or the
+connection was closed.  If the return value is zero, then a timeout
+error occurred.  The time at which the characters arrived is stored in
+'timestamp' unless it is NULL.  Characters that were read ahead by
+ndiSocketRead() are returned first, without waiting.
+*/
+ndicapiExport int ndiSocketReadAvailable(NDISocketHandle socket, char* buffer, int n, unsigned long long* timestamp);
+
+/*! \ingroup NDISocket
+The number of characters that were read ahead and are waiting in the
+buffer.  These will not make the socket readable for poll() or select(),
+so they should be read before waiting for the socket.
+*/
+ndicapiExport int ndiSocketBufferedBytes(NDISocketHandle socket);
+
 /*! \ingroup NDISocket
 Sleep the socket
 */
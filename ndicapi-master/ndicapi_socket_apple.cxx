@@ -12,146 +12,123 @@ See License.md for details.
 #include <netdb.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 
 //----------------------------------------------------------------------------
-ndicapiExport bool ndiSocketOpen(const char* hostname, int port, NDISocketHandle& outSocket)
+static int ndiSocketRecv(NDISocketHandle socket, char* buffer, int n, unsigned long long* arrivalTime)
 {
-  NDISocketHandle sock = socket(AF_INET, SOCK_STREAM, 0);
-
-  // Eliminate windows 0.2 second delay sending (buffering) data.
-  int on = 1;
-  if (setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (char*)&on, sizeof(on)))
+  int m = recv(socket, buffer, n, 0);
+  *arrivalTime = ndiTimeNanoseconds();
+  if (m < 0)
   {
-    return false;
+    return ((errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? NDI_SOCKET_WOULD_BLOCK : NDI_SOCKET_ERROR);
   }
+  return m;
+}
 
-  struct hostent* hp;
-  hp = gethostbyname(hostname);
-  if (!hp)
+//----------------------------------------------------------------------------
+static int ndiSocketSend(NDISocketHandle socket, const char* buffer, int n)
+{
+  // SIGPIPE is turned off with SO_NOSIGPIPE in ndiSocketConfigure()
+#if defined(MSG_NOSIGNAL)
+  int flags = MSG_NOSIGNAL;
+#else
+  int flags = 0;
+#endif
+  int m = send(socket, buffer, n, flags);
+  if (m < 0)
   {
-    unsigned long addr = inet_addr(hostname);
-    hp = gethostbyaddr((char*)&addr, sizeof(addr), AF_INET);
+    return ((errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? NDI_SOCKET_WOULD_BLOCK : NDI_SOCKET_ERROR);
   }
+  return m;
+}
 
-  if (!hp)
-  {
-    return false;
-  }
-
-  struct sockaddr_in name;
-  name.sin_family = AF_INET;
-  memcpy(&name.sin_addr, hp->h_addr, hp->h_length);
-  name.sin_port = htons(port);
-
-  int r = connect(sock, reinterpret_cast<sockaddr*>(&name), sizeof(name));
+//----------------------------------------------------------------------------
+// Wait until the socket can be read or written, returns 1 if it can,
+// 0 on timeout, or -1 on error.
+static int ndiSocketWait(NDISocketHandle socket, bool write, int milliseconds)
+{
+  struct pollfd pfd;
+  pfd.fd = socket;
+  pfd.events = (write ? POLLOUT : POLLIN);
+  pfd.revents = 0;
 
-  if (r < 0)
+  int r;
+  do
   {
-    shutdown(sock, 2);
-    close(sock);
-    return false;
+    r = poll(&pfd, 1, milliseconds);
   }
+  while (r < 0 && errno == EINTR);
 
-  outSocket = sock;
-  return true;
+  // a hangup or an error is reported by the recv() or send() that follows
+  return (r < 0 ? -1 : (r > 0 ? 1 : 0));
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport void ndiSocketClose(NDISocketHandle socket)
-{
-  shutdown(socket, 2);
-  close(socket);
-}
-
-//----------------------------------------------------------------------------
-ndicapiExport bool ndiSocketFlush(NDISocketHandle socket, int flushtype)
+static bool ndiSocketStartup()
 {
   return true;
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport bool ndiSocketTimeout(NDISocketHandle socket, int timeoutMs)
+static void ndiSocketCloseHandle(NDISocketHandle socket)
 {
-  if (timeoutMs > 0)
-  {
-    setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, (char*) & (timeoutMs), sizeof(timeoutMs));
-    return true;
-  }
-  return false;
+  shutdown(socket, 2);
+  close(socket);
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiSocketWrite(NDISocketHandle socket, const char* data, int length)
+static bool ndiSocketConfigure(NDISocketHandle sock)
 {
-  if (length == 0)
-  {
-    // nothing to send.
-    return 0;
-  }
+  int on = 1;
 
-  const char* buffer = reinterpret_cast<const char*>(data);
-  int total = 0;
-  do
+  // send commands right away instead of waiting for more data (Nagle)
+  if (setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (char*)&on, sizeof(on)))
   {
-    int flags;
+    return false;
+  }
 
-    // On unix boxes if the client disconnects and the server attempts
-    // to send data through the socket then the application crashes
-    // due to SIGPIPE signal. Disable the signal to prevent crash.
-#if defined(MSG_NOSIGNAL)
-    flags = MSG_NOSIGNAL;
-#else
-#if defined(SO_NOSIGPIPE) // Mac OS X
-    int set = 1;
-    setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, (void*)&set, sizeof(int));
+  // notice within seconds if the device is switched off or unplugged
+  setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, (char*)&on, sizeof(on));
+#if defined(TCP_KEEPALIVE)
+  int idle = 5;
+  setsockopt(sock, IPPROTO_TCP, TCP_KEEPALIVE, (char*)&idle, sizeof(idle));
 #endif
-    flags = 0;
+#if defined(TCP_KEEPINTVL) && defined(TCP_KEEPCNT)
+  int interval = 1;
+  int count = 3;
+  setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, (char*)&interval, sizeof(interval));
+  setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, (char*)&count, sizeof(count));
 #endif
-    int n = send(socket, buffer + total, length - total, flags);
-    if (n < 0)
-    {
-      return -1;
-    }
-    total += n;
-  }
-  while (total < length);
-  return total;
+
+#if defined(SO_NOSIGPIPE)
+  // don't let a closed connection raise SIGPIPE in send()
+  setsockopt(sock, SOL_SOCKET, SO_NOSIGPIPE, (char*)&on, sizeof(on));
+#endif
+
+  // the timeouts are done with poll()
+  int flags = fcntl(sock, F_GETFL, 0);
+  return (flags != -1 && fcntl(sock, F_SETFL, flags | O_NONBLOCK) == 0);
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiSocketRead(NDISocketHandle socket, char* reply, int numberOfBytesToRead, bool isBinary, int* outErrorCode)
+static bool ndiSocketConnectInProgress()
 {
-  int totalNumberOfBytesRead = 0;
-  int totalNumberOfBytesToRead = numberOfBytesToRead;
-  int numberOfBytesRead;
-  bool binarySizeCalculated = false;
+  return (errno == EINPROGRESS || errno == EINTR);
+}
 
-  do
+//----------------------------------------------------------------------------
+static int ndiSocketConnectError(NDISocketHandle sock)
+{
+  int error = 0;
+  socklen_t length = sizeof(error);
+  if (getsockopt(sock, SOL_SOCKET, SO_ERROR, (char*)&error, &length) != 0)
   {
-    numberOfBytesRead = recv(socket, reply + totalNumberOfBytesRead, numberOfBytesToRead, 0);
-
-    if (numberOfBytesRead < 1)
-    {
-      return -1;
-    }
-
-    totalNumberOfBytesRead += numberOfBytesRead;
-    if (!isBinary && reply[totalNumberOfBytesRead - 1] == '\r'       /* done when carriage return received (ASCII) or when ERROR... received (binary)*/
-        || isBinary && strncmp(reply, "ERROR", 5) == 0 && reply[totalNumberOfBytesRead - 1] == '\r')
-    {
-      break;
-    }
-
-    if (isBinary && !binarySizeCalculated && reply[0] == (char)0xc4 && reply[1] == (char)0xa5)
-    {
-      // recalculate n based on the reply length (reported from ndi device) and the amount of data received so far
-      unsigned short size = ((unsigned char)reply[2] | (unsigned char)reply[3] << 8) + 8; // 8 bytes -> 2 for Start Sequence (a5c4), 2 for reply length, 2 for header CRC, 2 for CRC16
-      totalNumberOfBytesToRead = size;
-    }
+    return errno;
   }
-  while (totalNumberOfBytesRead != totalNumberOfBytesToRead);
-
-  return totalNumberOfBytesRead;
+  return error;
 }
 
 //----------------------------------------------------------------------------
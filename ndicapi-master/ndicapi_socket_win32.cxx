@@ -5,161 +5,107 @@ See License.md for details.
 =========================================================Plus=header=end*/
 
 #include <string.h>
+#include <ws2tcpip.h>
+#include <mstcpip.h>
 
 //----------------------------------------------------------------------------
-ndicapiExport bool ndiSocketOpen(const char* hostname, int port, NDISocketHandle& outSocket)
+static int ndiSocketRecv(NDISocketHandle socket, char* buffer, int n, unsigned long long* arrivalTime)
 {
-  // Declare variables
-  WSADATA wsaData;
-
-  // Initialize Winsock
-  int iResult = WSAStartup(MAKEWORD(2, 2), &wsaData);
-  if (iResult != NO_ERROR)
-  {
-    return false;
-  }
-
-  NDISocketHandle sock = socket(AF_INET, SOCK_STREAM, 0);
-  // Eliminate windows 0.2 second delay sending (buffering) data.
-  int on = 1;
-  if (setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (char*)&on, sizeof(on)))
-  {
-    return false;
-  }
-
-  struct hostent* hp;
-  hp = gethostbyname(hostname);
-  if (!hp)
+  int m = recv(socket, buffer, n, 0);
+  *arrivalTime = ndiTimeNanoseconds();
+  if (m == SOCKET_ERROR)
   {
-    unsigned long addr = inet_addr(hostname);
-    hp = gethostbyaddr((char*)&addr, sizeof(addr), AF_INET);
+    int error = WSAGetLastError();
+    return ((error == WSAEWOULDBLOCK || error == WSAENOBUFS) ? NDI_SOCKET_WOULD_BLOCK : NDI_SOCKET_ERROR);
   }
+  return m;
+}
 
-  if (!hp)
+//----------------------------------------------------------------------------
+static int ndiSocketSend(NDISocketHandle socket, const char* buffer, int n)
+{
+  int m = send(socket, buffer, n, 0);
+  if (m == SOCKET_ERROR)
   {
-    return false;
+    int error = WSAGetLastError();
+    return ((error == WSAEWOULDBLOCK || error == WSAENOBUFS) ? NDI_SOCKET_WOULD_BLOCK : NDI_SOCKET_ERROR);
   }
+  return m;
+}
 
-  struct sockaddr_in name;
-  name.sin_family = AF_INET;
-  memcpy(&name.sin_addr, hp->h_addr, hp->h_length);
-  name.sin_port = htons(port);
+//----------------------------------------------------------------------------
+// Wait until the socket can be read or written, returns 1 if it can,
+// 0 on timeout, or -1 on error.
+static int ndiSocketWait(NDISocketHandle socket, bool write, int milliseconds)
+{
+  WSAPOLLFD pfd;
+  pfd.fd = socket;
+  pfd.events = (write ? POLLWRNORM : POLLRDNORM);
+  pfd.revents = 0;
 
-  int r = connect(sock, reinterpret_cast<sockaddr*>(&name), sizeof(name));
+  int r = WSAPoll(&pfd, 1, milliseconds);
 
-  if (r < 0)
+  // a hangup or an error is reported by the recv() or send() that follows,
+  // except that a failed connect() only shows up as POLLERR
+  if (r > 0 && write && (pfd.revents & (POLLERR | POLLHUP)))
   {
-    closesocket(sock);
-    return false;
+    return -1;
   }
-
-  outSocket = sock;
-  return true;
+  return (r == SOCKET_ERROR ? -1 : (r > 0 ? 1 : 0));
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport void ndiSocketClose(NDISocketHandle socket)
+static bool ndiSocketStartup()
 {
-  if (socket < 0)
-  {
-    return;
-  }
-  closesocket(socket);
+  WSADATA wsaData;
+  return (WSAStartup(MAKEWORD(2, 2), &wsaData) == NO_ERROR);
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport bool ndiSocketFlush(NDISocketHandle socket, int flushtype)
+static void ndiSocketCloseHandle(NDISocketHandle socket)
 {
-  return true;
+  closesocket(socket);
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport bool ndiSocketTimeout(NDISocketHandle socket, int timeoutMs)
+static bool ndiSocketConfigure(NDISocketHandle sock)
 {
-  if (timeoutMs > 0)
+  // Eliminate windows 0.2 second delay sending (buffering) data.
+  int on = 1;
+  if (setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (char*)&on, sizeof(on)))
   {
-    setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, (char*) & (timeoutMs), sizeof(timeoutMs));
-    return true;
+    return false;
   }
-  return false;
+
+  // notice within seconds if the device is switched off or unplugged
+  struct tcp_keepalive keepalive;
+  DWORD bytes = 0;
+  keepalive.onoff = 1;
+  keepalive.keepalivetime = 5000;
+  keepalive.keepaliveinterval = 1000;
+  WSAIoctl(sock, SIO_KEEPALIVE_VALS, &keepalive, sizeof(keepalive), NULL, 0, &bytes, NULL, NULL);
+
+  // the timeouts are done with WSAPoll()
+  u_long nonBlocking = 1;
+  return (ioctlsocket(sock, FIONBIO, &nonBlocking) == 0);
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiSocketWrite(NDISocketHandle socket, const char* data, int length)
+static bool ndiSocketConnectInProgress()
 {
-  if (length == 0)
-  {
-    // nothing to send.
-    return 0;
-  }
-  const char* buffer = reinterpret_cast<const char*>(data);
-  int total = 0;
-  do
-  {
-    int flags = 0;
-
-    int n = send(socket, buffer + total, length - total, flags);
-    if (n < 0)
-    {
-      return -1;
-    }
-    total += n;
-  }
-  while (total < length);
-  return total;
+  return (WSAGetLastError() == WSAEWOULDBLOCK);
 }
 
 //----------------------------------------------------------------------------
-ndicapiExport int ndiSocketRead(NDISocketHandle socket, char* reply, int numberOfBytesToRead, bool isBinary, int* outErrorCode)
+static int ndiSocketConnectError(NDISocketHandle sock)
 {
-  int totalNumberOfBytesRead = 0;
-  int totalNumberOfBytesToRead = numberOfBytesToRead;
-  int numberOfBytesRead;
-  bool binarySizeCalculated = false;
-
-  do
+  int error = 0;
+  int length = sizeof(error);
+  if (getsockopt(sock, SOL_SOCKET, SO_ERROR, (char*)&error, &length) != 0)
   {
-    int trys = 0;
-    numberOfBytesRead = recv(socket, reply + totalNumberOfBytesRead, numberOfBytesToRead, 0);
-
-    if (numberOfBytesRead == SOCKET_ERROR)
-    {
-      *outErrorCode = WSAGetLastError();
-      if ((*outErrorCode == WSAENOBUFS) && (trys++ < 1000))
-      {
-        Sleep(1);
-        continue;
-      }
-      if (*outErrorCode == WSAETIMEDOUT)
-      {
-        // NDI handles 0 bytes returned as a timeout
-        return 0;
-      }
-      return -1;
-    }
-    else if (numberOfBytesRead == 0)
-    {
-      // Connection has been closed
-      return 0;
-    }
-
-    totalNumberOfBytesRead += numberOfBytesRead;
-    if (!isBinary && reply[totalNumberOfBytesRead - 1] == '\r'       /* done when carriage return received (ASCII) or when ERROR... received (binary)*/
-        || isBinary && strncmp(reply, "ERROR", 5) == 0 && reply[totalNumberOfBytesRead - 1] == '\r')
-    {
-      break;
-    }
-
-    if (isBinary && !binarySizeCalculated && reply[0] == (char)0xc4 && reply[1] == (char)0xa5)
-    {
-      // recalculate n based on the reply length (reported from ndi device) and the amount of data received so far
-      unsigned short size = ((unsigned char)reply[2] | (unsigned char)reply[3] << 8) + 8; // 8 bytes -> 2 for Start Sequence (a5c4), 2 for reply length, 2 for header CRC, 2 for CRC16
-      totalNumberOfBytesToRead = size;
-    }
+    return WSAGetLastError();
   }
-  while (totalNumberOfBytesRead != totalNumberOfBytesToRead);
-
-  return totalNumberOfBytesRead;
+  return error;
 }
 
 //----------------------------------------------------------------------------
@@ -34,6 +34,7 @@ POSSIBILITY OF SUCH DAMAGES.
 
 #include "ndicapi_thread.h"
 #include <stdlib.h>
+#include <time.h>
 
 // The interface is modeled after the Windows threading interface,
 // but the only real difference from POSIX threads is the "Event"
@@ -270,4 +271,28 @@ ndicapiExport void ndiThreadJoin(pthread_t Thread)
   pthread_join(Thread, 0);
 }
 
-#endif
\ No newline at end of file
+#endif
+#ifdef _WIN32
+
+//----------------------------------------------------------------------------
+ndicapiExport unsigned long long ndiTimeNanoseconds()
+{
+  LARGE_INTEGER frequency, counter;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  // split the conversion to avoid overflowing 64 bits
+  return (unsigned long long)(counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+         (unsigned long long)(counter.QuadPart % frequency.QuadPart) * 1000000000ULL / frequency.QuadPart;
+}
+
+#elif defined(unix) || defined(__unix__) || defined(__APPLE__)
+
+//----------------------------------------------------------------------------
+ndicapiExport unsigned long long ndiTimeNanoseconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+#endif
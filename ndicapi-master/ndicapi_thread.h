@@ -97,6 +97,13 @@ ndicapiExport int ndiEventWait(NDIEvent event, int milliseconds);
 ndicapiExport NDIThread ndiThreadSplit(void* thread_func(void* userdata), void* userdata);
 ndicapiExport void ndiThreadJoin(NDIThread Thread);
 
+/*! \ingroup NDIThread
+  Get the time from a monotonic clock in nanoseconds.  The zero point
+  is arbitrary, so the value is only useful for measuring intervals
+  and for ordering events.
+*/
+ndicapiExport unsigned long long ndiTimeNanoseconds();
+
 #ifdef __cplusplus
 }
 #endif
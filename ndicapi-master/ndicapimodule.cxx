@@ -7,6 +7,7 @@
 
 // Python includes
 #include <Python.h>
+#include <pythread.h>
 
 // Conditional definitions for Python-version-based compilation
 #if PY_MAJOR_VERSION >= 3
@@ -28,6 +29,9 @@
   //#define PY_INT_OBJECT_OB_IVAL(ob) PyLong_AsLong((PyObject*)(ob))
   #define PY_INT_OBJECT_OB_IVAL(ob) ob->ob_digit[0]
   #define cmpfunc PyAsyncMethods*
+  #if PY_VERSION_HEX < 0x030900A4
+    #define Py_SET_TYPE(ob, type) (Py_TYPE(ob) = (type))
+  #endif
 #else
   #define MOD_ERROR_VAL
   #define MOD_SUCCESS_VAL(val)
@@ -35,22 +39,51 @@
   #define MOD_DEF(ob, name, doc, methods) \
           ob = Py_InitModule3(name, methods, doc);
   #define PY_INT_OBJECT_OB_IVAL(ob) ob->ob_ival
+  #define Py_SET_TYPE(ob, type) ((ob)->ob_type = (type))
 #endif
 
 //--------------------------------------------------------------
 // PyNdicapi structure
+// The GIL is released while a command waits for the device, so the
+// lock is held by whichever thread is using pl_ndicapi for a command.
+// pl_ndicapi is NULL once the object has been closed.
 typedef struct
 {
   PyObject_HEAD
   ndicapi* pl_ndicapi;
+  PyThread_type_lock pl_lock;
+  PyObject* pl_callback;                  // for ndiStartStreaming()
 } PyNdicapi;
 
+/* Close a device with the function that matches how it was opened */
+static void _ndiCloseDevice(ndicapi* pol)
+{
+  if (ndiGetSerialDeviceName(pol) != NULL)
+  {
+    ndiCloseSerial(pol);
+  }
+  else
+  {
+    ndiCloseNetwork(pol);
+  }
+}
+
 static void PyNdicapi_PyDelete(PyObject* self)
 {
   ndicapi* pol;
 
   pol = ((PyNdicapi*)self)->pl_ndicapi;
-  ndiCloseSerial(pol);
+  if (pol != NULL)
+  {
+    Py_BEGIN_ALLOW_THREADS
+    _ndiCloseDevice(pol);
+    Py_END_ALLOW_THREADS
+  }
+  if (((PyNdicapi*)self)->pl_lock)
+  {
+    PyThread_free_lock(((PyNdicapi*)self)->pl_lock);
+  }
+  Py_XDECREF(((PyNdicapi*)self)->pl_callback);
   PyMem_DEL(self);
 }
 
@@ -60,6 +93,11 @@ static char* PyNdicapi_PrintHelper(PyObject* self, char* space)
 
   pol = ((PyNdicapi*)self)->pl_ndicapi;
 
+  if (pol == NULL)
+  {
+    sprintf(space, "<closed polaris object>");
+    return space;
+  }
   sprintf(space, "<polaris object %p, %s>", (void*)pol, ndiGetSerialDeviceName(pol));
 
   return space;
@@ -129,6 +167,223 @@ int PyNdicapi_Check(PyObject* obj)
   return (obj->ob_type == &PyNdicapiType);
 }
 
+static PyObject* PyNdicapi_New(ndicapi* pol)
+{
+  PyNdicapi* self;
+
+  self = PyObject_NEW(PyNdicapi, &PyNdicapiType);
+  if (self == NULL)
+  {
+    return NULL;
+  }
+  self->pl_ndicapi = pol;
+  self->pl_callback = NULL;
+  self->pl_lock = PyThread_allocate_lock();
+  if (self->pl_lock == NULL)
+  {
+    Py_DECREF(self);
+    PyErr_NoMemory();
+    return NULL;
+  }
+  return (PyObject*)self;
+}
+
+/* Take the lock of a PyNdicapi object.  The lock is only ever taken
+   while holding the GIL, and getters hold the GIL while they read the
+   reply data, so a command can never change the reply data while a
+   getter is reading it. */
+static void PyNdicapi_Acquire(PyNdicapi* self)
+{
+  while (!PyThread_acquire_lock(self->pl_lock, NOWAIT_LOCK))
+  {
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(self->pl_lock, WAIT_LOCK);
+    PyThread_release_lock(self->pl_lock);
+    Py_END_ALLOW_THREADS
+  }
+}
+
+/* Take the lock to use the device.  Another thread may have closed the
+   object while this one waited, so this returns 0 with an exception set,
+   and without the lock, if the object is closed. */
+static int PyNdicapi_Lock(PyNdicapi* self)
+{
+  PyNdicapi_Acquire(self);
+  if (self->pl_ndicapi == NULL)
+  {
+    PyThread_release_lock(self->pl_lock);
+    PyErr_SetString(PyExc_ValueError, "the NDICAPI object is closed.");
+    return 0;
+  }
+  return 1;
+}
+
+static void PyNdicapi_Unlock(PyNdicapi* self)
+{
+  PyThread_release_lock(self->pl_lock);
+}
+
+/*=================================================================
+  array type: a block of numbers that is given to numpy (or to
+  memoryview) through the buffer protocol, so that bulk getters
+  need no python object per number
+*/
+
+typedef struct
+{
+  PyObject_HEAD
+  void* ar_data;
+  int ar_ndim;
+  Py_ssize_t ar_itemsize;
+  Py_ssize_t ar_shape[3];
+  Py_ssize_t ar_strides[3];
+  char ar_format[2];
+} PyNdicapiArray;
+
+static void PyNdicapiArray_PyDelete(PyObject* self)
+{
+  PyMem_Free(((PyNdicapiArray*)self)->ar_data);
+  PyObject_Del(self);
+}
+
+static int PyNdicapiArray_GetBuffer(PyObject* self, Py_buffer* view, int flags)
+{
+  PyNdicapiArray* array = (PyNdicapiArray*)self;
+  int i;
+
+  view->buf = array->ar_data;
+  view->obj = self;
+  Py_INCREF(self);
+  view->len = array->ar_itemsize;
+  for (i = 0; i < array->ar_ndim; i++)
+  {
+    view->len *= array->ar_shape[i];
+  }
+  view->readonly = 0;
+  view->itemsize = array->ar_itemsize;
+  view->format = ((flags & PyBUF_FORMAT) ? array->ar_format : NULL);
+  view->ndim = array->ar_ndim;
+  view->shape = ((flags & PyBUF_ND) ? array->ar_shape : NULL);
+  view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES ? array->ar_strides : NULL);
+  view->suboffsets = NULL;
+  view->internal = NULL;
+
+  return 0;
+}
+
+static PyBufferProcs PyNdicapiArray_AsBuffer;
+
+static PyTypeObject PyNdicapiArrayType =
+{
+  PyVarObject_HEAD_INIT(NULL, 0) /* (&PyType_Type) */
+  "ndicapy.array",                                            /* tp_name */
+  sizeof(PyNdicapiArray),                                     /* tp_basicsize */
+  0,                                                          /* tp_itemsize */
+  (destructor)PyNdicapiArray_PyDelete,                        /* tp_dealloc */
+  0,                                                          /* tp_print */
+  0,                                                          /* tp_getattr */
+  0,                                                          /* tp_setattr */
+  0,                                                          /* tp_compare */
+  0,                                                          /* tp_repr */
+  0,                                                          /* tp_as_number  */
+  0,                                                          /* tp_as_sequence */
+  0,                                                          /* tp_as_mapping */
+  0,                                                          /* tp_hash */
+  0,                                                          /* tp_call */
+  0,                                                          /* tp_string */
+  0,                                                          /* tp_getattro */
+  0,                                                          /* tp_setattro */
+  &PyNdicapiArray_AsBuffer,                                   /* tp_as_buffer */
+  Py_TPFLAGS_DEFAULT,                                         /* tp_flags */
+  "ndicapy.array: numbers from a bulk getter, use numpy.asarray()" /* tp_doc */
+};
+
+/* Make an array of the given shape, with ndim of 1 to 3 and a struct
+   format of 'i', 'L', 'f' or 'd'.  The contents are not initialized. */
+static PyNdicapiArray* PyNdicapiArray_New(char format, int ndim, Py_ssize_t n0,
+                                          Py_ssize_t n1, Py_ssize_t n2)
+{
+  PyNdicapiArray* array;
+  Py_ssize_t shape[3] = { n0, n1, n2 };
+  Py_ssize_t size;
+  int i;
+
+  array = PyObject_NEW(PyNdicapiArray, &PyNdicapiArrayType);
+  if (array == NULL)
+  {
+    return NULL;
+  }
+
+  array->ar_format[0] = format;
+  array->ar_format[1] = '\0';
+  array->ar_itemsize = (format == 'd' ? sizeof(double) : format == 'f' ? sizeof(float) :
+                        format == 'L' ? sizeof(unsigned long) : sizeof(int));
+  array->ar_ndim = ndim;
+  size = array->ar_itemsize;
+  for (i = ndim - 1; i >= 0; i--)
+  {
+    array->ar_shape[i] = shape[i];
+    array->ar_strides[i] = size;
+    size *= shape[i];
+  }
+  array->ar_data = PyMem_Malloc(size > 0 ? size : 1);
+  if (array->ar_data == NULL)
+  {
+    PyObject_Del(array);
+    PyErr_NoMemory();
+    return NULL;
+  }
+
+  return array;
+}
+
+/* Wrap an array with numpy.asarray(), which shares the memory instead
+   of copying it.  If numpy is not available, the array is returned as
+   it is, and can still be used with memoryview(). */
+static PyObject* PyNdicapiArray_ToNumPy(PyNdicapiArray* array)
+{
+  static PyObject* asarray = NULL;
+  static int haveNumPy = -1;
+  PyObject* result;
+
+  if (array == NULL)
+  {
+    return NULL;
+  }
+
+  if (haveNumPy < 0)
+  {
+    PyObject* numpy = PyImport_ImportModule("numpy");
+    haveNumPy = 0;
+    if (numpy == NULL)
+    {
+      PyErr_Clear();
+    }
+    else
+    {
+      asarray = PyObject_GetAttrString(numpy, "asarray");
+      Py_DECREF(numpy);
+      if (asarray == NULL)
+      {
+        PyErr_Clear();
+      }
+      else
+      {
+        haveNumPy = 1;
+      }
+    }
+  }
+
+  if (!haveNumPy)
+  {
+    return (PyObject*)array;
+  }
+
+  result = PyObject_CallFunctionObjArgs(asarray, (PyObject*)array, NULL);
+  Py_DECREF(array);
+  return result;
+}
+
 /*=================================================================
   bitfield type: this code is a ripoff of the python integer type
   that prints itself as a hexadecimal value
@@ -429,7 +684,33 @@ static int _ndiConverter(PyObject* obj, ndicapi** polptr)
 {
   if (PyNdicapi_Check(obj))
   {
+    /* wait for any command that another thread is running */
+    if (!PyNdicapi_Lock((PyNdicapi*)obj))
+    {
+      return 0;
+    }
     *polptr = ((PyNdicapi*)obj)->pl_ndicapi;
+    PyNdicapi_Unlock((PyNdicapi*)obj);
+  }
+  else
+  {
+    PyErr_SetString(PyExc_ValueError, "expected an NDICAPI object.");
+    return 0;
+  }
+  return 1;
+}
+
+/* For methods that talk to the device, which must call PyNdicapi_Lock() */
+static int _ndiObjectConverter(PyObject* obj, PyNdicapi** selfptr)
+{
+  if (PyNdicapi_Check(obj) && ((PyNdicapi*)obj)->pl_ndicapi == NULL)
+  {
+    PyErr_SetString(PyExc_ValueError, "the NDICAPI object is closed.");
+    return 0;
+  }
+  else if (PyNdicapi_Check(obj))
+  {
+    *selfptr = (PyNdicapi*)obj;
   }
   else
   {
@@ -587,31 +868,64 @@ static PyObject* Py_ndiProbe(PyObject* module, PyObject* args)
 
   if (PyArg_ParseTuple(args, "s:plProbe", &device))
   {
+    Py_BEGIN_ALLOW_THREADS
     result = ndiSerialProbe(device, false);
+    Py_END_ALLOW_THREADS
     return PyNDIBitfield_FromUnsignedLong(result);
   }
 
   return NULL;
 }
 
+static PyObject* Py_ndiProbeAll(PyObject* module, PyObject* args)
+{
+  int resetTimeout = 1000;
+  int checkDSR = 0;
+  ndiProbeResult results[32];
+  int n, i;
+  PyObject* obj;
+
+  if (PyArg_ParseTuple(args, "|ii:plProbeAll", &resetTimeout, &checkDSR))
+  {
+    Py_BEGIN_ALLOW_THREADS
+    n = ndiProbeAll(results, 32, resetTimeout, (checkDSR != 0));
+    Py_END_ALLOW_THREADS
+
+    obj = PyList_New(n);
+    for (i = 0; obj != NULL && i < n; i++)
+    {
+      PyObject* item = Py_BuildValue("(ss)", results[i].DeviceName, results[i].Version);
+      if (item == NULL)
+      {
+        Py_DECREF(obj);
+        return NULL;
+      }
+      PyList_SET_ITEM(obj, i, item);
+    }
+    return obj;
+  }
+
+  return NULL;
+}
+
 static PyObject* Py_ndiOpen(PyObject* module, PyObject* args)
 {
   ndicapi* pol;
   char* device;
-  PyNdicapi* self;
+  PyObject* self;
 
   if (PyArg_ParseTuple(args, "s:plOpen", &device))
   {
+    Py_BEGIN_ALLOW_THREADS
     pol = ndiOpenSerial(device);
+    Py_END_ALLOW_THREADS
     if (pol == NULL)
     {
       Py_INCREF(Py_None);
       return Py_None;
     }
-    self = PyObject_NEW(PyNdicapi, &PyNdicapiType);
-    self->pl_ndicapi = pol;
-    Py_INCREF(self);
-    return (PyObject*)self;
+    self = PyNdicapi_New(pol);
+    return self;
   }
 
   return NULL;
@@ -623,20 +937,20 @@ static PyObject* Py_ndiOpenNetwork(PyObject* module, PyObject* args)
   ndicapi* pol;
   char* hostname;
   int port;
-  PyNdicapi* self;
+  PyObject* self;
 
   if (PyArg_ParseTuple(args, "si:plOpenNetwork", &hostname, &port))
   {
+    Py_BEGIN_ALLOW_THREADS
     pol = ndiOpenNetwork(hostname, port);
+    Py_END_ALLOW_THREADS
     if (pol == NULL)
     {
       Py_INCREF(Py_None);
       return Py_None;
     }
-    self = PyObject_NEW(PyNdicapi, &PyNdicapiType);
-    self->pl_ndicapi = pol;
-    Py_INCREF(self);
-    return (PyObject*)self;
+    self = PyNdicapi_New(pol);
+    return self;
   }
 
   return NULL;
@@ -661,305 +975,1006 @@ static PyObject* Py_ndiGetDeviceName(PyObject* module, PyObject* args)
   return NULL;
 }
 
-static PyObject* Py_ndiClose(PyObject* module, PyObject* args)
+/* Close the device and free it, so that neither the getters nor the
+   dealloc can use it again.  Closing an object twice does nothing. */
+static PyObject* _ndiCloseHelper(PyObject* args, const char* format)
+{
+  PyNdicapi* self;
+  ndicapi* pol;
+  PyObject* callback;
+
+  if (!PyArg_ParseTuple(args, format, &PyNdicapiType, &self))
+  {
+    return NULL;
+  }
+
+  PyNdicapi_Acquire(self);
+  pol = self->pl_ndicapi;
+  if (pol != NULL)
+  {
+    Py_BEGIN_ALLOW_THREADS
+    _ndiCloseDevice(pol);
+    Py_END_ALLOW_THREADS
+    self->pl_ndicapi = NULL;
+  }
+  callback = self->pl_callback;
+  self->pl_callback = NULL;
+  PyNdicapi_Unlock(self);
+  Py_XDECREF(callback);
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject* Py_ndiClose(PyObject* module, PyObject* args)
+{
+  return _ndiCloseHelper(args, "O!:plClose");
+}
+
+/* close a networked tracker */
+static PyObject* Py_ndiCloseNetwork(PyObject* module, PyObject* args)
+{
+  return _ndiCloseHelper(args, "O!:plCloseNetwork");
+}
+
+static PyObject* Py_ndiSetThreadMode(PyObject* module, PyObject* args)
+{
+  PyNdicapi* self;
+  int mode;
+
+  if (PyArg_ParseTuple(args, "O&i:plSetThreadMode", &_ndiObjectConverter, &self,
+                       &mode))
+  {
+    if (!PyNdicapi_Lock(self))
+    {
+      return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    ndiSetThreadMode(self->pl_ndicapi, mode);
+    Py_END_ALLOW_THREADS
+    PyNdicapi_Unlock(self);
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  return NULL;
+}
+
+static PyObject* Py_ndiCommand(PyObject* module, PyObject* args)
+{
+  int n;
+  PyNdicapi* self;
+  ndicapi* pol;
+  char* format;
+  const char* command;
+  char* result;
+  int errnum;
+  PyObject* initial;
+  PyObject* remainder;
+  PyObject* newstring = NULL;
+  PyObject* obj;
+
+  if ((n = PySequence_Length(args)) < 2)
+  {
+    PyErr_SetString(PyExc_TypeError,
+                    "plCommand requires at least 2 arguments");
+    return NULL;
+  }
+
+  remainder = PySequence_GetSlice(args, 2, n);
+  initial = PySequence_GetSlice(args, 0, 2);
+
+  if (!PyArg_ParseTuple(initial, "O&z:plCommand",
+                        &_ndiObjectConverter, &self, &format))
+  {
+    Py_DECREF(initial);
+    Py_DECREF(remainder);
+    return NULL;
+  }
+
+  if (format != NULL)
+  {
+    obj = PySequence_GetItem(args, 1);
+    newstring = PyString_Format(obj, remainder);
+    Py_DECREF(obj);
+    Py_DECREF(initial);
+    Py_DECREF(remainder);
+
+    if (newstring == NULL)
+    {
+      return NULL;
+    }
+
+    command = PyString_AsString(newstring);
+    if (command == NULL)
+    {
+      Py_DECREF(newstring);
+      return NULL;
+    }
+  }
+  else
+  {
+    Py_DECREF(initial);
+    Py_DECREF(remainder);
+    command = NULL;
+  }
+
+  // the device is not touched by python, so other threads can run
+  if (!PyNdicapi_Lock(self))
+  {
+    Py_XDECREF(newstring);
+    return NULL;
+  }
+  pol = self->pl_ndicapi;
+  Py_BEGIN_ALLOW_THREADS
+  if (command != NULL)
+  {
+    result = ndiCommand(pol, "%s", command);
+  }
+  else
+  {
+    result = ndiCommand(pol, NULL);
+  }
+  Py_END_ALLOW_THREADS
+
+  errnum = ndiGetError(pol);
+  if (result == NULL || errnum != NDI_OKAY)
+  {
+    // the reply is discarded when there is an error
+    Py_INCREF(Py_None);
+    obj = Py_None;
+  }
+  else if ((result[0] == (char)0xc4 && result[1] == (char)0xa5) ||
+           (result[0] == (char)0xd4 && result[1] == (char)0xb5))
+  {
+    // binary replies, e.g. to BX, can contain NUL so they are returned as
+    // bytes: the 6 byte header, then the body whose length is in the header
+    obj = PyBytes_FromStringAndSize(result, 6 + ((unsigned char)result[3] << 8 | (unsigned char)result[2]));
+  }
+  else
+  {
+    obj = PyString_FromString(result);
+  }
+  PyNdicapi_Unlock(self);
+
+  if (newstring != NULL)
+  {
+    Py_DECREF(newstring);
+  }
+  if (obj == NULL)
+  {
+    return NULL;
+  }
+
+  return _ndiErrorHelper(errnum, obj);
+}
+
+static PyObject* Py_ndiCommand2(PyObject* module, const char* format, PyObject* args)
+{
+  int i, n;
+  PyObject* newargs;
+  PyObject* obj;
+
+  if ((n = PySequence_Length(args)) < 1)
+  {
+    PyErr_SetString(PyExc_TypeError,
+                    "plCommand requires at least 2 arguments");
+    return NULL;
+  }
+
+  newargs = PyTuple_New(n + 1);
+  obj = PySequence_GetItem(args, 0);
+  Py_INCREF(obj);
+  PyTuple_SET_ITEM(newargs, 0, obj);
+
+  if (format != NULL)
+  {
+    obj = PyString_FromString(format);
+  }
+  else
+  {
+    Py_INCREF(Py_None);
+    obj = Py_None;
+  }
+  PyTuple_SET_ITEM(newargs, 1, obj);
+
+  for (i = 1; i < n; i++)
+  {
+    obj = PySequence_GetItem(args, i);
+    Py_INCREF(obj);
+    PyTuple_SET_ITEM(newargs, i + 1, obj);
+  }
+
+  obj = Py_ndiCommand(module, newargs);
+
+  Py_DECREF(newargs);
+
+  return obj;
+}
+
+#define PyCommandMacro(name,format) \
+  static PyObject *Py_##name(PyObject *module, PyObject *args) \
+  { \
+    return Py_ndiCommand2(module, format, args); \
+  }
+
+PyCommandMacro(ndiRESET, NULL)
+PyCommandMacro(ndiINIT, "INIT:")
+PyCommandMacro(ndiCOMM, "COMM:%d%03d%d")
+PyCommandMacro(ndiPVWR, "PVWR:%c%04X%.128s")
+PyCommandMacro(ndiPVCLR, "PVCLR:%c")
+PyCommandMacro(ndiPINIT, "PINIT:%c")
+PyCommandMacro(ndiPENA, "PENA:%c%c")
+PyCommandMacro(ndiPDIS, "PDIS:%c")
+PyCommandMacro(ndiTSTART, "TSTART:")
+PyCommandMacro(ndiTSTOP, "TSTOP:")
+PyCommandMacro(ndiGX, "GX:%04X")
+PyCommandMacro(ndiBX, "BX:%04X")
+PyCommandMacro(ndiTX, "TX:%04X")
+PyCommandMacro(ndiLED, "LED:%c%d%c")
+PyCommandMacro(ndiBEEP, "BEEP:%i")
+PyCommandMacro(ndiVER, "VER:%d")
+PyCommandMacro(ndiVSEL, "VSEL:%d")
+PyCommandMacro(ndiSFLIST, "SFLIST:%02X")
+PyCommandMacro(ndiPSTAT, "PSTAT:%04X")
+PyCommandMacro(ndiSSTAT, "SSTAT:%04X")
+
+PyCommandMacro(ndiPPRD, "PPRD:%c%04X")
+PyCommandMacro(ndiPPWR, "PPWR:%c%04X%.128s")
+PyCommandMacro(ndiPURD, "PURD:%c%04X")
+PyCommandMacro(ndiPUWR, "PPWR:%c%04X%.128s")
+PyCommandMacro(ndiPSEL, "PSEL:%c%s")
+PyCommandMacro(ndiPSRCH, "PSRCH:%c")
+PyCommandMacro(ndiPVTIP, "PVTIP:%c%d%d")
+PyCommandMacro(ndiTCTST, "TCTST:%c")
+PyCommandMacro(ndiTTCFG, "TTCFG:%c")
+
+PyCommandMacro(ndiDSTART, "DSTART:")
+PyCommandMacro(ndiDSTOP, "DSTOP:")
+PyCommandMacro(ndiIRINIT, "IRINIT:")
+PyCommandMacro(ndiIRCHK, "IRCHK:%04X")
+PyCommandMacro(ndiIRED, "IRED:%c%08X")
+PyCommandMacro(ndi3D, "3D:%c%d")
+
+
+static PyObject* Py_ndiPVWRFromFile(PyObject* module, PyObject* args)
+{
+  int port;
+  int result;
+  char* filename;
+  PyNdicapi* self;
+
+  if (PyArg_ParseTuple(args, "O&is:plPVWRFromFile",
+                       &_ndiObjectConverter, &self, &port, &filename))
+  {
+    if (!PyNdicapi_Lock(self))
+    {
+      return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    result = ndiPVWRFromFile(self->pl_ndicapi, port, filename);
+    Py_END_ALLOW_THREADS
+    PyNdicapi_Unlock(self);
+    return PyNDIBitfield_FromUnsignedLong(result);
+  }
+
+  return NULL;
+}
+
+static PyObject* Py_ndiNegotiateBaudRate(PyObject* module, PyObject* args)
+{
+  int maxBaudRate = 0;
+  int handshake = 0;
+  int result;
+  PyNdicapi* self;
+
+  if (PyArg_ParseTuple(args, "O&|ii:plNegotiateBaudRate",
+                       &_ndiObjectConverter, &self, &maxBaudRate, &handshake))
+  {
+    if (!PyNdicapi_Lock(self))
+    {
+      return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    result = ndiNegotiateBaudRate(self->pl_ndicapi, maxBaudRate, handshake);
+    Py_END_ALLOW_THREADS
+    PyNdicapi_Unlock(self);
+    return PyInt_FromLong(result);
+  }
+
+  return NULL;
+}
+
+static PyObject* Py_ndiReconnect(PyObject* module, PyObject* args)
+{
+  int result;
+  PyNdicapi* self;
+
+  if (PyArg_ParseTuple(args, "O&:plReconnect", &_ndiObjectConverter, &self))
+  {
+    if (!PyNdicapi_Lock(self))
+    {
+      return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    result = ndiReconnect(self->pl_ndicapi);
+    Py_END_ALLOW_THREADS
+    PyNdicapi_Unlock(self);
+    return PyNDIBitfield_FromUnsignedLong(result);
+  }
+
+  return NULL;
+}
+
+static PyObject* Py_ndiSetAutoReconnect(PyObject* module, PyObject* args)
+{
+  int maxAttempts;
+  ndicapi* pol;
+
+  if (PyArg_ParseTuple(args, "O&i:plSetAutoReconnect", &_ndiConverter, &pol, &maxAttempts))
+  {
+    ndiSetAutoReconnect(pol, maxAttempts);
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  return NULL;
+}
+
+static PyObject* Py_ndiGetGXTransform(PyObject* module, PyObject* args)
+{
+  char port;
+  int result;
+  double transform[8];
+  ndicapi* pol;
+
+  if (PyArg_ParseTuple(args, "O&c:plGetGXTransform",
+                       &_ndiConverter, &pol, &port))
+  {
+    result = ndiGetGXTransform(pol, port, transform);
+
+    if (result == NDI_MISSING)
+    {
+      return PyString_FromString("MISSING");
+    }
+    else if (result == NDI_DISABLED)
+    {
+      return PyString_FromString("DISABLED");
+    }
+
+    return Py_BuildValue("(dddddddd)", transform[0], transform[1],
+                         transform[2], transform[3], transform[4],
+                         transform[5], transform[6], transform[7]);
+  }
+
+  return NULL;
+}
+
+static PyObject* Py_ndiGetBXTransform(PyObject* module, PyObject* args)
+{
+  char port;
+  int result;
+  float transform[8];
+  ndicapi* pol;
+
+  if (PyArg_ParseTuple(args, "O&c:plGetBXTransform",
+                       &_ndiConverter, &pol, &port))
+  {
+    result = ndiGetBXTransform(pol, port, transform);
+
+    if (result == NDI_MISSING)
+    {
+      return PyString_FromString("MISSING");
+    }
+    else if (result == NDI_DISABLED)
+    {
+      return PyString_FromString("DISABLED");
+    }
+
+    return Py_BuildValue("(dddddddd)", transform[0], transform[1],
+                         transform[2], transform[3], transform[4],
+                         transform[5], transform[6], transform[7]);
+  }
+
+  return NULL;
+}
+
+static PyObject* Py_ndiGetTXTransform(PyObject* module, PyObject* args)
+{
+  char port;
+  int result;
+  double transform[8];
+  ndicapi* pol;
+
+  if (PyArg_ParseTuple(args, "O&c:plGetTXTransform",
+                       &_ndiConverter, &pol, &port))
+  {
+    result = ndiGetTXTransform(pol, port, transform);
+
+    if (result == NDI_MISSING)
+    {
+      return PyString_FromString("MISSING");
+    }
+    else if (result == NDI_DISABLED)
+    {
+      return PyString_FromString("DISABLED");
+    }
+
+    return Py_BuildValue("(dddddddd)", transform[0], transform[1],
+                         transform[2], transform[3], transform[4],
+                         transform[5], transform[6], transform[7]);
+  }
+
+  return NULL;
+}
+
+/* Get (handles, transforms) for all the tools in the last BX reply, as
+   arrays of shape (N,) and (N, 8), with NaN for missing tools */
+static PyObject* Py_ndiGetBXTransforms(PyObject* module, PyObject* args)
+{
+  ndicapi* pol;
+  int i, j, n;
+  int* status;
+  PyNdicapiArray* handles;
+  PyNdicapiArray* transforms;
+
+  if (!PyArg_ParseTuple(args, "O&:plGetBXTransforms", &_ndiConverter, &pol))
+  {
+    return NULL;
+  }
+
+  n = ndiGetBXNumberOfHandles(pol);
+  handles = PyNdicapiArray_New('i', 1, n, 0, 0);
+  transforms = PyNdicapiArray_New('f', 2, n, 8, 0);
+  status = (int*)PyMem_Malloc(n * sizeof(int) + 1);
+  if (handles == NULL || transforms == NULL || status == NULL)
+  {
+    Py_XDECREF(handles);
+    Py_XDECREF(transforms);
+    PyMem_Free(status);
+    return (status == NULL ? PyErr_NoMemory() : NULL);
+  }
+
+  float(*values)[8] = (float(*)[8])transforms->ar_data;
+  n = ndiGetBXTransforms(pol, (int*)handles->ar_data, status, values, n);
+  for (i = 0; i < n; i++)
+  {
+    if (status[i] != NDI_OKAY)
+    {
+      for (j = 0; j < 8; j++)
+      {
+        values[i][j] = (float)Py_NAN;
+      }
+    }
+  }
+  PyMem_Free(status);
+
+  return Py_BuildValue("(NN)", PyNdicapiArray_ToNumPy(handles),
+                       PyNdicapiArray_ToNumPy(transforms));
+}
+
+/* Get (handles, transforms) for all the tools in the last TX reply, as
+   arrays of shape (N,) and (N, 8), with NaN for missing tools */
+static PyObject* Py_ndiGetTXTransforms(PyObject* module, PyObject* args)
+{
+  ndicapi* pol;
+  int i, j, n;
+  int* status;
+  PyNdicapiArray* handles;
+  PyNdicapiArray* transforms;
+
+  if (!PyArg_ParseTuple(args, "O&:plGetTXTransforms", &_ndiConverter, &pol))
+  {
+    return NULL;
+  }
+
+  n = ndiGetTXNumberOfHandles(pol);
+  handles = PyNdicapiArray_New('i', 1, n, 0, 0);
+  transforms = PyNdicapiArray_New('d', 2, n, 8, 0);
+  status = (int*)PyMem_Malloc(n * sizeof(int) + 1);
+  if (handles == NULL || transforms == NULL || status == NULL)
+  {
+    Py_XDECREF(handles);
+    Py_XDECREF(transforms);
+    PyMem_Free(status);
+    return (status == NULL ? PyErr_NoMemory() : NULL);
+  }
+
+  double(*values)[8] = (double(*)[8])transforms->ar_data;
+  n = ndiGetTXTransforms(pol, (int*)handles->ar_data, status, values, n);
+  for (i = 0; i < n; i++)
+  {
+    if (status[i] != NDI_OKAY)
+    {
+      for (j = 0; j < 8; j++)
+      {
+        values[i][j] = Py_NAN;
+      }
+    }
+  }
+  PyMem_Free(status);
+
+  return Py_BuildValue("(NN)", PyNdicapiArray_ToNumPy(handles),
+                       PyNdicapiArray_ToNumPy(transforms));
+}
+
+/* Get the 3D markers of all the tools in the last BX reply as an array
+   of shape (N, M, 3), where M is the largest number of markers of any
+   tool, with NaN where a tool has fewer markers.  The tools are in the
+   same order as for ndiGetBXTransforms(). */
+static PyObject* Py_ndiGetBXMarkers(PyObject* module, PyObject* args)
+{
+  ndicapi* pol;
+  int i, j, n, m;
+  int* counts;
+  PyNdicapiArray* markers;
+
+  if (!PyArg_ParseTuple(args, "O&:plGetBXMarkers", &_ndiConverter, &pol))
+  {
+    return NULL;
+  }
+
+  n = ndiGetBXNumberOfHandles(pol);
+  counts = (int*)PyMem_Malloc(n * sizeof(int) + 1);
+  if (counts == NULL)
+  {
+    return PyErr_NoMemory();
+  }
+  n = ndiGetBXMarkerPositions(pol, counts, NULL, 0, n);
+  m = 0;
+  for (i = 0; i < n; i++)
+  {
+    m = (counts[i] > m ? counts[i] : m);
+  }
+
+  markers = PyNdicapiArray_New('f', 3, n, m, 3);
+  if (markers == NULL)
+  {
+    PyMem_Free(counts);
+    return NULL;
+  }
+
+  float(*values)[3] = (float(*)[3])markers->ar_data;
+  ndiGetBXMarkerPositions(pol, counts, values, m, n);
+  for (i = 0; i < n; i++)
+  {
+    for (j = counts[i]; j < m; j++)
+    {
+      values[i * m + j][0] = (float)Py_NAN;
+      values[i * m + j][1] = (float)Py_NAN;
+      values[i * m + j][2] = (float)Py_NAN;
+    }
+  }
+  PyMem_Free(counts);
+
+  return PyNdicapiArray_ToNumPy(markers);
+}
+
+/* Called from the streaming thread for every frame */
+static void _ndiFrameCallback(ndicapi* pol, const ndiFrame* frame, void* userdata)
+{
+  PyGILState_STATE state;
+  PyObject* result;
+
+  state = PyGILState_Ensure();
+  result = PyObject_CallObject((PyObject*)userdata, NULL);
+  if (result == NULL)
+  {
+    PyErr_WriteUnraisable((PyObject*)userdata);
+  }
+  Py_XDECREF(result);
+  PyGILState_Release(state);
+}
+
+/* Start streaming with a thread.  The optional callback is called
+   without arguments from the streaming thread after each frame, it
+   must not use the device, e.g. loop.call_soon_threadsafe() */
+static PyObject* Py_ndiStartStreaming(PyObject* module, PyObject* args)
+{
+  PyNdicapi* self;
+  char* command;
+  PyObject* callback = NULL;
+  int errnum;
+
+  if (!PyArg_ParseTuple(args, "O&s|O:plStartStreaming",
+                        &_ndiObjectConverter, &self, &command, &callback))
+  {
+    return NULL;
+  }
+  if (callback == Py_None)
+  {
+    callback = NULL;
+  }
+  if (callback != NULL && !PyCallable_Check(callback))
+  {
+    PyErr_SetString(PyExc_TypeError, "plStartStreaming callback must be callable");
+    return NULL;
+  }
+
+  if (!PyNdicapi_Lock(self))
+  {
+    return NULL;
+  }
+  if (ndiGetStreamingMode(self->pl_ndicapi))
+  {
+    errnum = NDI_INVALID_MODE;
+  }
+  else
+  {
+    Py_XINCREF(callback);
+    Py_XDECREF(self->pl_callback);
+    self->pl_callback = callback;
+    Py_BEGIN_ALLOW_THREADS
+    errnum = ndiStartStreaming(self->pl_ndicapi, command, (callback ? &_ndiFrameCallback : NULL), callback);
+    Py_END_ALLOW_THREADS
+  }
+  PyNdicapi_Unlock(self);
+
+  Py_INCREF(Py_None);
+  return _ndiErrorHelper(errnum, Py_None);
+}
+
+/* Start streaming without a thread, for use with an event loop */
+static PyObject* Py_ndiStartStreamingPolled(PyObject* module, PyObject* args)
+{
+  PyNdicapi* self;
+  char* command;
+  int errnum;
+
+  if (!PyArg_ParseTuple(args, "O&s:plStartStreamingPolled",
+                        &_ndiObjectConverter, &self, &command))
+  {
+    return NULL;
+  }
+
+  if (!PyNdicapi_Lock(self))
+  {
+    return NULL;
+  }
+  Py_BEGIN_ALLOW_THREADS
+  errnum = ndiStartStreamingPolled(self->pl_ndicapi, command, NULL, NULL);
+  Py_END_ALLOW_THREADS
+  PyNdicapi_Unlock(self);
+
+  Py_INCREF(Py_None);
+  return _ndiErrorHelper(errnum, Py_None);
+}
+
+static PyObject* Py_ndiPollStream(PyObject* module, PyObject* args)
+{
+  PyNdicapi* self;
+  int result;
+
+  if (!PyArg_ParseTuple(args, "O&:plPollStream", &_ndiObjectConverter, &self))
+  {
+    return NULL;
+  }
+
+  // this does not wait for the device, so the GIL is kept
+  if (!PyNdicapi_Lock(self))
+  {
+    return NULL;
+  }
+  result = ndiPollStream(self->pl_ndicapi);
+  PyNdicapi_Unlock(self);
+
+  return PyInt_FromLong(result);
+}
+
+static PyObject* Py_ndiStopStreaming(PyObject* module, PyObject* args)
+{
+  PyNdicapi* self;
+  PyObject* callback;
+  int errnum;
+
+  if (!PyArg_ParseTuple(args, "O&:plStopStreaming", &_ndiObjectConverter, &self))
+  {
+    return NULL;
+  }
+
+  if (!PyNdicapi_Lock(self))
+  {
+    return NULL;
+  }
+  Py_BEGIN_ALLOW_THREADS
+  errnum = ndiStopStreaming(self->pl_ndicapi);
+  Py_END_ALLOW_THREADS
+  callback = self->pl_callback;
+  self->pl_callback = NULL;
+  PyNdicapi_Unlock(self);
+  Py_XDECREF(callback);
+
+  Py_INCREF(Py_None);
+  return _ndiErrorHelper(errnum, Py_None);
+}
+
+static PyObject* Py_ndiGetStreamingMode(PyObject* module, PyObject* args)
+{
+  ndicapi* pol;
+
+  if (PyArg_ParseTuple(args, "O&:plGetStreamingMode", &_ndiConverter, &pol))
+  {
+    return PyInt_FromLong(ndiGetStreamingMode(pol));
+  }
+
+  return NULL;
+}
+
+static PyObject* Py_ndiGetStreamDescriptor(PyObject* module, PyObject* args)
 {
   ndicapi* pol;
 
-  if (PyArg_ParseTuple(args, "O&:plClose", &_ndiConverter, &pol))
+  if (PyArg_ParseTuple(args, "O&:plGetStreamDescriptor", &_ndiConverter, &pol))
   {
-    ndiSerialClose(pol->SerialDevice);
-    Py_INCREF(Py_None);
-    return Py_None;
+    return PyInt_FromLong(ndiGetStreamDescriptor(pol));
   }
 
   return NULL;
 }
 
-/* close a networked tracker */
-static PyObject* Py_ndiCloseNetwork(PyObject* module, PyObject* args)
+/* Make an array that holds a copy of the given data */
+static PyObject* _ndiArrayFromData(char format, int ndim, Py_ssize_t n0, Py_ssize_t n1,
+                                   const void* data)
 {
-  ndicapi* pol;
+  PyNdicapiArray* array;
 
-  if (PyArg_ParseTuple(args, "O&:plClose", &_ndiConverter, &pol))
+  array = PyNdicapiArray_New(format, ndim, n0, n1, 0);
+  if (array == NULL)
   {
-    ndiCloseNetwork(pol);
-    Py_INCREF(Py_None);
-    return Py_None;
+    return NULL;
   }
+  memcpy(array->ar_data, data, array->ar_itemsize * n0 * (ndim > 1 ? n1 : 1));
 
-  return NULL;
+  return PyNdicapiArray_ToNumPy(array);
 }
 
-static PyObject* Py_ndiSetThreadMode(PyObject* module, PyObject* args)
+/* Add a value to a dict, and release the reference to the value */
+static int _ndiSetItem(PyObject* dict, const char* key, PyObject* value)
 {
-  ndicapi* pol;
-  int mode;
+  int result;
 
-  if (PyArg_ParseTuple(args, "O&i:plSetThreadMode", &_ndiConverter, &pol,
-                       &mode))
+  if (value == NULL)
   {
-    ndiSetThreadMode(pol, mode);
-    Py_INCREF(Py_None);
-    return Py_None;
+    return -1;
   }
-
-  return NULL;
+  result = PyDict_SetItemString(dict, key, value);
+  Py_DECREF(value);
+  return result;
 }
 
-static PyObject* Py_ndiCommand(PyObject* module, PyObject* args)
+/* Convert an ndiFrame into a dict with the same keys as the fields
+   of ndiFrame, where the per-handle fields are arrays */
+static PyObject* _ndiFrameToDict(const ndiFrame* frame)
 {
+  PyObject* dict;
   int n;
-  ndicapi* pol;
-  char* format;
-  char* result;
-  PyObject* initial;
-  PyObject* remainder;
-  PyObject* newstring = NULL;
-  PyObject* obj;
 
-  if ((n = PySequence_Length(args)) < 2)
+  dict = PyDict_New();
+  if (dict == NULL)
   {
-    PyErr_SetString(PyExc_TypeError,
-                    "plCommand requires at least 2 arguments");
     return NULL;
   }
 
-  remainder = PySequence_GetSlice(args, 2, n);
-  initial = PySequence_GetSlice(args, 0, 2);
+  n = frame->HandleCount;
+  if (_ndiSetItem(dict, "Sequence", PyLong_FromUnsignedLongLong(frame->Sequence)) < 0 ||
+      _ndiSetItem(dict, "Timestamp", PyLong_FromUnsignedLongLong(frame->Timestamp)) < 0 ||
+      _ndiSetItem(dict, "FirstByteTime", PyLong_FromUnsignedLongLong(frame->FirstByteTime)) < 0 ||
+      _ndiSetItem(dict, "ErrorCode", PyNDIBitfield_FromUnsignedLong(frame->ErrorCode)) < 0 ||
+      _ndiSetItem(dict, "Command", PyString_FromStringAndSize(frame->Command, strnlen(frame->Command, 4))) < 0 ||
+      _ndiSetItem(dict, "HandleCount", PyInt_FromLong(n)) < 0 ||
+      _ndiSetItem(dict, "Handles", _ndiArrayFromData('i', 1, n, 0, frame->Handles)) < 0 ||
+      _ndiSetItem(dict, "HandleStatus", _ndiArrayFromData('i', 1, n, 0, frame->HandleStatus)) < 0 ||
+      _ndiSetItem(dict, "Transforms", _ndiArrayFromData('d', 2, n, 8, frame->Transforms)) < 0 ||
+      _ndiSetItem(dict, "PortStatus", _ndiArrayFromData('i', 1, n, 0, frame->PortStatus)) < 0 ||
+      _ndiSetItem(dict, "FrameNumber", _ndiArrayFromData('L', 1, n, 0, frame->FrameNumber)) < 0 ||
+      _ndiSetItem(dict, "SystemStatus", PyNDIBitfield_FromUnsignedLong(frame->SystemStatus)) < 0)
+  {
+    Py_DECREF(dict);
+    return NULL;
+  }
 
-  if (!PyArg_ParseTuple(initial, "O&z:plCommand",
-                        &_ndiConverter, &pol, &format))
+  return dict;
+}
+
+/* Get a list of the frames newer than the given sequence number from the
+   frame ring of thread mode or streaming, oldest first */
+static PyObject* Py_ndiGetFramesSince(PyObject* module, PyObject* args)
+{
+  ndicapi* pol;
+  unsigned long long sequence = 0;
+  ndiFrame frames[NDI_FRAME_RING_SIZE];
+  PyObject* list;
+  PyObject* obj;
+  int i, n;
+
+  if (!PyArg_ParseTuple(args, "O&|K:plGetFramesSince", &_ndiConverter, &pol, &sequence))
   {
-    Py_DECREF(initial);
-    Py_DECREF(remainder);
     return NULL;
   }
 
-  if (format != NULL)
+  n = ndiGetFramesSince(pol, sequence, frames, NDI_FRAME_RING_SIZE);
+  list = PyList_New(n);
+  if (list == NULL)
   {
-    obj = PySequence_GetItem(args, 1);
-    newstring = PyString_Format(obj, remainder);
-    Py_DECREF(obj);
-    Py_DECREF(initial);
-    Py_DECREF(remainder);
-
-    if (newstring == NULL)
+    return NULL;
+  }
+  for (i = 0; i < n; i++)
+  {
+    obj = _ndiFrameToDict(&frames[i]);
+    if (obj == NULL)
     {
+      Py_DECREF(list);
       return NULL;
     }
-
-    result = ndiCommand(pol, "%s", PyString_AsString(newstring));
-  }
-  else
-  {
-    result = ndiCommand(pol, NULL);
+    PyList_SET_ITEM(list, i, obj);
   }
 
-  if (newstring != NULL)
+  return list;
+}
+
+/* Get the totals from ndiGetReconnectStats() as a dict */
+static PyObject* Py_ndiGetReconnectStats(PyObject* module, PyObject* args)
+{
+  ndicapi* pol;
+  ndiReconnectStats stats;
+  PyObject* dict;
+
+  if (!PyArg_ParseTuple(args, "O&:plGetReconnectStats", &_ndiConverter, &pol))
   {
-    Py_DECREF(newstring);
+    return NULL;
   }
 
-  if (result == NULL)
+  ndiGetReconnectStats(pol, &stats);
+  dict = PyDict_New();
+  if (dict == NULL)
   {
-    Py_INCREF(Py_None);
-    obj = Py_None;
+    return NULL;
   }
-  else
+  if (_ndiSetItem(dict, "Incidents", PyInt_FromLong(stats.Incidents)) < 0 ||
+      _ndiSetItem(dict, "Recovered", PyInt_FromLong(stats.Recovered)) < 0 ||
+      _ndiSetItem(dict, "Attempts", PyInt_FromLong(stats.Attempts)) < 0 ||
+      _ndiSetItem(dict, "IsReconnecting", PyInt_FromLong(stats.IsReconnecting)) < 0 ||
+      _ndiSetItem(dict, "TotalDowntime", PyLong_FromUnsignedLongLong(stats.TotalDowntime)) < 0 ||
+      _ndiSetItem(dict, "MaxDowntime", PyLong_FromUnsignedLongLong(stats.MaxDowntime)) < 0)
   {
-    obj = PyString_FromString(result);
+    Py_DECREF(dict);
+    return NULL;
   }
 
-  return _ndiErrorHelper(ndiGetError(pol), obj);
+  return dict;
 }
 
-static PyObject* Py_ndiCommand2(PyObject* module, const char* format, PyObject* args)
+/* Get a list of the recent incidents from ndiGetReconnectIncidents(),
+   each as a dict with the same keys as the fields of ndiReconnectIncident */
+static PyObject* Py_ndiGetReconnectIncidents(PyObject* module, PyObject* args)
 {
+  ndicapi* pol;
+  ndiReconnectIncident incidents[32];
+  PyObject* list;
+  PyObject* dict;
   int i, n;
-  PyObject* newargs;
-  PyObject* obj;
 
-  if ((n = PySequence_Length(args)) < 1)
+  if (!PyArg_ParseTuple(args, "O&:plGetReconnectIncidents", &_ndiConverter, &pol))
   {
-    PyErr_SetString(PyExc_TypeError,
-                    "plCommand requires at least 2 arguments");
     return NULL;
   }
 
-  newargs = PyTuple_New(n + 1);
-  obj = PySequence_GetItem(args, 0);
-  Py_INCREF(obj);
-  PyTuple_SET_ITEM(newargs, 0, obj);
-
-  if (format != NULL)
-  {
-    obj = PyString_FromString(format);
-  }
-  else
+  n = ndiGetReconnectIncidents(pol, incidents, 32);
+  list = PyList_New(n);
+  if (list == NULL)
   {
-    Py_INCREF(Py_None);
-    obj = Py_None;
+    return NULL;
   }
-  PyTuple_SET_ITEM(newargs, 1, obj);
-
-  for (i = 1; i < n; i++)
+  for (i = 0; i < n; i++)
   {
-    obj = PySequence_GetItem(args, i);
-    Py_INCREF(obj);
-    PyTuple_SET_ITEM(newargs, i + 1, obj);
+    dict = PyDict_New();
+    if (dict == NULL ||
+        _ndiSetItem(dict, "StartTime", PyLong_FromUnsignedLongLong(incidents[i].StartTime)) < 0 ||
+        _ndiSetItem(dict, "Downtime", PyLong_FromUnsignedLongLong(incidents[i].Downtime)) < 0 ||
+        _ndiSetItem(dict, "ErrorCode", PyNDIBitfield_FromUnsignedLong(incidents[i].ErrorCode)) < 0 ||
+        _ndiSetItem(dict, "ResultCode", PyNDIBitfield_FromUnsignedLong(incidents[i].ResultCode)) < 0 ||
+        _ndiSetItem(dict, "Attempts", PyInt_FromLong(incidents[i].Attempts)) < 0)
+    {
+      Py_XDECREF(dict);
+      Py_DECREF(list);
+      return NULL;
+    }
+    PyList_SET_ITEM(list, i, dict);
   }
 
-  obj = Py_ndiCommand(module, newargs);
-
-  Py_DECREF(newargs);
-
-  return obj;
+  return list;
 }
 
-#define PyCommandMacro(name,format) \
-  static PyObject *Py_##name(PyObject *module, PyObject *args) \
-  { \
-    return Py_ndiCommand2(module, format, args); \
-  }
-
-PyCommandMacro(ndiRESET, NULL)
-PyCommandMacro(ndiINIT, "INIT:")
-PyCommandMacro(ndiCOMM, "COMM:%d%03d%d")
-PyCommandMacro(ndiPVWR, "PVWR:%c%04X%.128s")
-PyCommandMacro(ndiPVCLR, "PVCLR:%c")
-PyCommandMacro(ndiPINIT, "PINIT:%c")
-PyCommandMacro(ndiPENA, "PENA:%c%c")
-PyCommandMacro(ndiPDIS, "PDIS:%c")
-PyCommandMacro(ndiTSTART, "TSTART:")
-PyCommandMacro(ndiTSTOP, "TSTOP:")
-PyCommandMacro(ndiGX, "GX:%04X")
-PyCommandMacro(ndiBX, "BX:%04X")
-PyCommandMacro(ndiTX, "TX:%04X")
-PyCommandMacro(ndiLED, "LED:%c%d%c")
-PyCommandMacro(ndiBEEP, "BEEP:%i")
-PyCommandMacro(ndiVER, "VER:%d")
-PyCommandMacro(ndiVSEL, "VSEL:%d")
-PyCommandMacro(ndiSFLIST, "SFLIST:%02X")
-PyCommandMacro(ndiPSTAT, "PSTAT:%04X")
-PyCommandMacro(ndiSSTAT, "SSTAT:%04X")
-
-PyCommandMacro(ndiPPRD, "PPRD:%c%04X")
-PyCommandMacro(ndiPPWR, "PPWR:%c%04X%.128s")
-PyCommandMacro(ndiPURD, "PURD:%c%04X")
-PyCommandMacro(ndiPUWR, "PPWR:%c%04X%.128s")
-PyCommandMacro(ndiPSEL, "PSEL:%c%s")
-PyCommandMacro(ndiPSRCH, "PSRCH:%c")
-PyCommandMacro(ndiPVTIP, "PVTIP:%c%d%d")
-PyCommandMacro(ndiTCTST, "TCTST:%c")
-PyCommandMacro(ndiTTCFG, "TTCFG:%c")
-
-PyCommandMacro(ndiDSTART, "DSTART:")
-PyCommandMacro(ndiDSTOP, "DSTOP:")
-PyCommandMacro(ndiIRINIT, "IRINIT:")
-PyCommandMacro(ndiIRCHK, "IRCHK:%04X")
-PyCommandMacro(ndiIRED, "IRED:%c%08X")
-PyCommandMacro(ndi3D, "3D:%c%d")
-
-
-static PyObject* Py_ndiPVWRFromFile(PyObject* module, PyObject* args)
+/* Convert an ndiLatencyHistogram into a dict, where "Buckets" is a list */
+static PyObject* _ndiHistogramToDict(const ndiLatencyHistogram* histogram)
 {
-  int port;
-  int result;
-  char* filename;
-  ndicapi* pol;
+  PyObject* dict;
+  PyObject* buckets;
+  int i;
 
-  if (PyArg_ParseTuple(args, "O&is:plPVWRFromFile",
-                       &_ndiConverter, &pol, &port, &filename))
+  buckets = PyList_New(NDI_HISTOGRAM_BUCKETS);
+  if (buckets == NULL)
   {
-    result = ndiPVWRFromFile(pol, port, filename);
-    return PyNDIBitfield_FromUnsignedLong(result);
+    return NULL;
   }
-
-  return NULL;
-}
-
-static PyObject* Py_ndiGetGXTransform(PyObject* module, PyObject* args)
-{
-  char port;
-  int result;
-  double transform[8];
-  ndicapi* pol;
-
-  if (PyArg_ParseTuple(args, "O&c:plGetGXTransform",
-                       &_ndiConverter, &pol, &port))
+  for (i = 0; i < NDI_HISTOGRAM_BUCKETS; i++)
   {
-    result = ndiGetGXTransform(pol, port, transform);
-
-    if (result == NDI_MISSING)
+    PyObject* value = PyLong_FromUnsignedLongLong(histogram->Buckets[i]);
+    if (value == NULL)
     {
-      return PyString_FromString("MISSING");
-    }
-    else if (result == NDI_DISABLED)
-    {
-      return PyString_FromString("DISABLED");
+      Py_DECREF(buckets);
+      return NULL;
     }
+    PyList_SET_ITEM(buckets, i, value);
+  }
 
-    return Py_BuildValue("(dddddddd)", transform[0], transform[1],
-                         transform[2], transform[3], transform[4],
-                         transform[5], transform[6], transform[7]);
+  dict = PyDict_New();
+  if (dict == NULL)
+  {
+    Py_DECREF(buckets);
+    return NULL;
+  }
+  if (_ndiSetItem(dict, "Count", PyLong_FromUnsignedLongLong(histogram->Count)) < 0 ||
+      _ndiSetItem(dict, "Total", PyLong_FromUnsignedLongLong(histogram->Total)) < 0 ||
+      _ndiSetItem(dict, "Max", PyLong_FromUnsignedLongLong(histogram->Max)) < 0 ||
+      _ndiSetItem(dict, "Median", PyLong_FromUnsignedLongLong(ndiGetHistogramPercentile(histogram, 0.5))) < 0 ||
+      _ndiSetItem(dict, "P99", PyLong_FromUnsignedLongLong(ndiGetHistogramPercentile(histogram, 0.99))) < 0 ||
+      _ndiSetItem(dict, "Buckets", buckets) < 0)
+  {
+    Py_DECREF(dict);
+    return NULL;
   }
 
-  return NULL;
+  return dict;
 }
 
-static PyObject* Py_ndiGetBXTransform(PyObject* module, PyObject* args)
+/* Get the counters and histograms from ndiGetMetrics() as a dict */
+static PyObject* Py_ndiGetMetrics(PyObject* module, PyObject* args)
 {
-  char port;
-  int result;
-  float transform[8];
   ndicapi* pol;
+  ndiMetricsInfo info;
+  PyObject* dict;
 
-  if (PyArg_ParseTuple(args, "O&c:plGetBXTransform",
-                       &_ndiConverter, &pol, &port))
+  if (!PyArg_ParseTuple(args, "O&:plGetMetrics", &_ndiConverter, &pol))
   {
-    result = ndiGetBXTransform(pol, port, transform);
-
-    if (result == NDI_MISSING)
-    {
-      return PyString_FromString("MISSING");
-    }
-    else if (result == NDI_DISABLED)
-    {
-      return PyString_FromString("DISABLED");
-    }
+    return NULL;
+  }
 
-    return Py_BuildValue("(dddddddd)", transform[0], transform[1],
-                         transform[2], transform[3], transform[4],
-                         transform[5], transform[6], transform[7]);
+  ndiGetMetrics(pol, &info);
+  dict = PyDict_New();
+  if (dict == NULL)
+  {
+    return NULL;
+  }
+  if (_ndiSetItem(dict, "Commands", PyLong_FromUnsignedLongLong(info.Commands)) < 0 ||
+      _ndiSetItem(dict, "Replies", PyLong_FromUnsignedLongLong(info.Replies)) < 0 ||
+      _ndiSetItem(dict, "BytesSent", PyLong_FromUnsignedLongLong(info.BytesSent)) < 0 ||
+      _ndiSetItem(dict, "BytesReceived", PyLong_FromUnsignedLongLong(info.BytesReceived)) < 0 ||
+      _ndiSetItem(dict, "CrcErrors", PyLong_FromUnsignedLongLong(info.CrcErrors)) < 0 ||
+      _ndiSetItem(dict, "Timeouts", PyLong_FromUnsignedLongLong(info.Timeouts)) < 0 ||
+      _ndiSetItem(dict, "Errors", PyLong_FromUnsignedLongLong(info.Errors)) < 0 ||
+      _ndiSetItem(dict, "DroppedFrames", PyLong_FromUnsignedLongLong(info.DroppedFrames)) < 0 ||
+      _ndiSetItem(dict, "ReplyLatency", _ndiHistogramToDict(&info.ReplyLatency)) < 0 ||
+      _ndiSetItem(dict, "TransferTime", _ndiHistogramToDict(&info.TransferTime)) < 0 ||
+      _ndiSetItem(dict, "ParseTime", _ndiHistogramToDict(&info.ParseTime)) < 0 ||
+      _ndiSetItem(dict, "WakeupLatency", _ndiHistogramToDict(&info.WakeupLatency)) < 0)
+  {
+    Py_DECREF(dict);
+    return NULL;
   }
 
-  return NULL;
+  return dict;
 }
 
-static PyObject* Py_ndiGetTXTransform(PyObject* module, PyObject* args)
+static PyObject* Py_ndiResetMetrics(PyObject* module, PyObject* args)
 {
-  char port;
-  int result;
-  double transform[8];
   ndicapi* pol;
 
-  if (PyArg_ParseTuple(args, "O&c:plGetTXTransform",
-                       &_ndiConverter, &pol, &port))
+  if (PyArg_ParseTuple(args, "O&:plResetMetrics", &_ndiConverter, &pol))
   {
-    result = ndiGetTXTransform(pol, port, transform);
-
-    if (result == NDI_MISSING)
-    {
-      return PyString_FromString("MISSING");
-    }
-    else if (result == NDI_DISABLED)
-    {
-      return PyString_FromString("DISABLED");
-    }
-
-    return Py_BuildValue("(dddddddd)", transform[0], transform[1],
-                         transform[2], transform[3], transform[4],
-                         transform[5], transform[6], transform[7]);
+    ndiResetMetrics(pol);
+    Py_INCREF(Py_None);
+    return Py_None;
   }
 
   return NULL;
@@ -1608,6 +2623,7 @@ static PyMethodDef NdicapiMethods[] =
 
   Py_NDIMethodMacro(ndiDeviceName),
   Py_NDIMethodMacro(ndiProbe),
+  Py_NDIMethodMacro(ndiProbeAll),
   Py_NDIMethodMacro(ndiOpen),
   Py_NDIMethodMacro(ndiOpenNetwork),
   Py_NDIMethodMacro(ndiGetDeviceName),
@@ -1616,6 +2632,14 @@ static PyMethodDef NdicapiMethods[] =
   Py_NDIMethodMacro(ndiSetThreadMode),
   Py_NDIMethodMacro(ndiCommand),
 
+  Py_NDIMethodMacro(ndiStartStreaming),
+  Py_NDIMethodMacro(ndiStartStreamingPolled),
+  Py_NDIMethodMacro(ndiPollStream),
+  Py_NDIMethodMacro(ndiStopStreaming),
+  Py_NDIMethodMacro(ndiGetStreamingMode),
+  Py_NDIMethodMacro(ndiGetStreamDescriptor),
+  Py_NDIMethodMacro(ndiGetFramesSince),
+
   Py_NDIMethodMacro(ndiGetError),
   Py_NDIMethodMacro(ndiErrorString),
 
@@ -1624,6 +2648,13 @@ static PyMethodDef NdicapiMethods[] =
   Py_NDIMethodMacro(ndiCOMM),
 
   Py_NDIMethodMacro(ndiPVWRFromFile),
+  Py_NDIMethodMacro(ndiNegotiateBaudRate),
+  Py_NDIMethodMacro(ndiReconnect),
+  Py_NDIMethodMacro(ndiSetAutoReconnect),
+  Py_NDIMethodMacro(ndiGetReconnectStats),
+  Py_NDIMethodMacro(ndiGetReconnectIncidents),
+  Py_NDIMethodMacro(ndiGetMetrics),
+  Py_NDIMethodMacro(ndiResetMetrics),
 
   Py_NDIMethodMacro(ndiPVWR),
   Py_NDIMethodMacro(ndiPVCLR),
@@ -1647,6 +2678,8 @@ static PyMethodDef NdicapiMethods[] =
   Py_NDIMethodMacro(ndiBX),
 
   Py_NDIMethodMacro(ndiGetBXTransform),
+  Py_NDIMethodMacro(ndiGetBXTransforms),
+  Py_NDIMethodMacro(ndiGetBXMarkers),
   Py_NDIMethodMacro(ndiGetBXPortStatus),
   Py_NDIMethodMacro(ndiGetBXSystemStatus),
   //Py_NDIMethodMacro(ndiGetBXToolInfo),
@@ -1659,6 +2692,7 @@ static PyMethodDef NdicapiMethods[] =
   Py_NDIMethodMacro(ndiTX),
 
   Py_NDIMethodMacro(ndiGetTXTransform),
+  Py_NDIMethodMacro(ndiGetTXTransforms),
   Py_NDIMethodMacro(ndiGetTXPortStatus),
   Py_NDIMethodMacro(ndiGetTXSystemStatus),
   //Py_NDIMethodMacro(ndiGetTXToolInfo),
@@ -1748,10 +2782,19 @@ ndicapiExport MOD_INIT(ndicapy)
   PyNdicapiType.ob_type = &PyType_Type;
   PyNDIBitfield_Type.ob_type = &PyType_Type;
 #else
-  Py_TYPE(&PyNdicapiType) = &PyType_Type;
-  Py_TYPE(&PyNDIBitfield_Type) = &PyType_Type;
+  Py_SET_TYPE(&PyNdicapiType, &PyType_Type);
+  Py_SET_TYPE(&PyNDIBitfield_Type, &PyType_Type);
+#endif
+
+#if PY_VERSION_HEX < 0x03070000
+  // the streaming thread calls back into python
+  PyEval_InitThreads();
 #endif
 
+  PyNdicapiArray_AsBuffer.bf_getbuffer = PyNdicapiArray_GetBuffer;
+  if (PyType_Ready(&PyNdicapiArrayType) < 0)
+    return MOD_ERROR_VAL;
+
   MOD_DEF(module, "ndicapy", NULL, NdicapiMethods);
   if (module == NULL)
     return MOD_ERROR_VAL;
@@ -1763,6 +2806,7 @@ ndicapiExport MOD_INIT(ndicapy)
   Py_NDIConstantMacro(NDICAPI_MINOR_VERSION);
 
   Py_NDIConstantMacro(NDI_OKAY);
+  Py_NDIConstantMacro(NDI_FRAME_RING_SIZE);
 
   Py_NDIErrcodeMacro(NDI_INVALID);
   Py_NDIErrcodeMacro(NDI_TOO_LONG);
@@ -1935,6 +2979,12 @@ ndicapiExport MOD_INIT(ndicapy)
   Py_NDIConstantMacro(NDI_LEFT);
   Py_NDIConstantMacro(NDI_RIGHT);
 
+  Py_NDIConstantMacro(NDI_ALL_HANDLES);
+  Py_NDIConstantMacro(NDI_STALE_HANDLES);
+  Py_NDIConstantMacro(NDI_UNINITIALIZED_HANDLES);
+  Py_NDIConstantMacro(NDI_UNENABLED_HANDLES);
+  Py_NDIConstantMacro(NDI_ENABLED_HANDLES);
+
   return MOD_SUCCESS_VAL(module);
 }
 
@@ -0,0 +1,174 @@
+"""asyncio interface to NDI tracking devices, built on ndicapy.
+
+The replies are read and parsed by ndicapi, and the frames are delivered
+through an async iterator.  Where the device has a file descriptor (serial
+ports and network connections, except on Windows), the descriptor is
+watched by the event loop, so any number of devices can stream from one
+thread.  Otherwise ndicapi's streaming thread wakes up the event loop.
+Commands run in the loop's default executor, and ndicapy releases the
+GIL while they wait for the device.
+
+    tracker = await Tracker.open("192.168.1.10:8765")
+    await tracker.command("INIT:")
+    await tracker.enable_tools()
+    await tracker.command("TSTART:")
+    await tracker.start("BX:0801")
+    async for frame in tracker.frames():
+        print(frame["Handles"], frame["Transforms"])
+
+Each frame is a dict with the fields of ndiFrame, see ndicapy.ndiGetFramesSince().
+"""
+
+import asyncio
+import functools
+
+import ndicapy
+
+
+class Tracker(object):
+    """One NDI tracking device."""
+
+    # frames that are kept for each consumer that falls behind
+    queue_size = 64
+
+    def __init__(self, device, is_network=False):
+        self.device = device
+        self.is_network = is_network
+        self.dropped_frames = 0
+        self._loop = None
+        self._queues = []
+        self._sequence = 0
+        self._descriptor = -1
+        self._is_streaming = False
+        self._is_closed = False
+
+    @classmethod
+    async def open(cls, name):
+        """Open a serial port, or a network device given as "host:port"."""
+        loop = asyncio.get_running_loop()
+        host, colon, port = name.rpartition(":")
+        if colon and not name.startswith("COM"):
+            device = await loop.run_in_executor(None, ndicapy.ndiOpenNetwork, host, int(port))
+        else:
+            device = await loop.run_in_executor(None, ndicapy.ndiOpen, name)
+        if device is None:
+            raise IOError("could not open " + name)
+        return cls(device, bool(colon) and not name.startswith("COM"))
+
+    async def close(self):
+        """Close the device.  Closing it again does nothing, and the device
+        is not closed a second time when it is garbage collected."""
+        if self._is_closed:
+            return
+        if self._is_streaming:
+            await self.stop()
+        self._is_closed = True
+        close = ndicapy.ndiCloseNetwork if self.is_network else ndicapy.ndiClose
+        await asyncio.get_running_loop().run_in_executor(None, close, self.device)
+
+    async def command(self, format, *args):
+        """Send a command, like ndicapy.ndiCommand(), without blocking the loop."""
+        call = functools.partial(ndicapy.ndiCommand, self.device, format, *args)
+        return await asyncio.get_running_loop().run_in_executor(None, call)
+
+    async def enable_tools(self):
+        """Initialize all the ports that need it, and then enable them all."""
+        await self.command("PHSR:%02X", ndicapy.NDI_UNINITIALIZED_HANDLES)
+        handles = [ndicapy.ndiGetPHSRHandle(self.device, i)
+                   for i in range(ndicapy.ndiGetPHSRNumberOfHandles(self.device))]
+        for handle in handles:
+            await self.command("PINIT:%02X", handle)
+        await self.command("PHSR:%02X", ndicapy.NDI_UNENABLED_HANDLES)
+        handles = [ndicapy.ndiGetPHSRHandle(self.device, i)
+                   for i in range(ndicapy.ndiGetPHSRNumberOfHandles(self.device))]
+        for handle in handles:
+            await self.command("PENA:%02X%c", handle, ndicapy.NDI_DYNAMIC)
+
+    async def start(self, command="BX:0801"):
+        """Ask the device to stream a GX, TX or BX command.  The device
+        must be tracking, and no commands can be sent until stop()."""
+        loop = asyncio.get_running_loop()
+        self._loop = loop
+        self._sequence = 0
+        descriptor = ndicapy.ndiGetStreamDescriptor(self.device)
+        if descriptor >= 0 and self._can_add_reader(loop, descriptor):
+            await loop.run_in_executor(None, ndicapy.ndiStartStreamingPolled, self.device, command)
+            loop.add_reader(descriptor, self._on_readable)
+            self._descriptor = descriptor
+        else:
+            wake = functools.partial(loop.call_soon_threadsafe, self._deliver)
+            await loop.run_in_executor(None, ndicapy.ndiStartStreaming, self.device, command, wake)
+        self._is_streaming = True
+        # frames can arrive together with the reply to STREAM
+        self._deliver()
+
+    async def stop(self):
+        """Stop streaming, and end all of the frames() iterators."""
+        if not self._is_streaming:
+            return
+        self._is_streaming = False
+        self._remove_reader()
+        try:
+            await self._loop.run_in_executor(None, ndicapy.ndiStopStreaming, self.device)
+        finally:
+            self._deliver()
+            self._finish()
+
+    async def frames(self):
+        """Iterate over the frames as they arrive, until the stream stops.
+        Frames with a nonzero "ErrorCode" report communication errors."""
+        queue = asyncio.Queue(self.queue_size)
+        self._queues.append(queue)
+        try:
+            while True:
+                frame = await queue.get()
+                if frame is None:
+                    return
+                yield frame
+        finally:
+            self._queues.remove(queue)
+
+    def _can_add_reader(self, loop, descriptor):
+        # the proactor loop on Windows cannot watch descriptors
+        try:
+            loop.add_reader(descriptor, lambda: None)
+        except NotImplementedError:
+            return False
+        loop.remove_reader(descriptor)
+        return True
+
+    def _remove_reader(self):
+        if self._descriptor >= 0:
+            self._loop.remove_reader(self._descriptor)
+            self._descriptor = -1
+
+    def _on_readable(self):
+        n = ndicapy.ndiPollStream(self.device)
+        if n != 0:
+            self._deliver()
+        if n < 0:
+            # the connection failed, the error is in the last frame
+            self._remove_reader()
+            self._finish()
+
+    def _deliver(self):
+        frames = ndicapy.ndiGetFramesSince(self.device, self._sequence)
+        if not frames:
+            return
+        if self._sequence and frames[0]["Sequence"] > self._sequence + 1:
+            self.dropped_frames += frames[0]["Sequence"] - self._sequence - 1
+        self._sequence = frames[-1]["Sequence"]
+        for queue in self._queues:
+            for frame in frames:
+                self._put(queue, frame)
+
+    def _finish(self):
+        for queue in self._queues:
+            self._put(queue, None)
+
+    def _put(self, queue, frame):
+        # a consumer that falls behind loses its oldest frames
+        if queue.full():
+            queue.get_nowait()
+            self.dropped_frames += 1
+        queue.put_nowait(frame)